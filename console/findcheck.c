@@ -0,0 +1,232 @@
+/*\
+ *  findcheck - change the elements tidyFindByTag() and tidyFindByClass()
+ *  find as they are found
+ *
+ *  A document of blocks like <div id=.. class="a b"><span class="a">
+ *  is iterated while the class or id of each element found is discarded,
+ *  or the element itself, or while the document is saved.  Every element
+ *  must still be found once, and the memory in use may not grow beyond
+ *  that of a few indexes, however many times the index is rebuilt.
+ *
+ *  usage: findcheck [blocks]
+ *
+\*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tidy.h"
+#include "tidybuffio.h"
+
+/* an allocator that keeps count of the bytes in use */
+typedef struct _CountingAllocator {
+    TidyAllocator base;
+    size_t inUse;
+    size_t peak;
+} CountingAllocator;
+
+typedef union _BlockHead {
+    size_t size;
+    double align;
+} BlockHead;
+
+static void* TIDY_CALL countAlloc( TidyAllocator* base, size_t size )
+{
+    CountingAllocator* self = (CountingAllocator*) base;
+    BlockHead* head = (BlockHead*) malloc( sizeof(BlockHead) + size );
+
+    if ( !head )
+        return NULL;
+    head->size = size;
+    self->inUse += size;
+    if ( self->inUse > self->peak )
+        self->peak = self->inUse;
+    return head + 1;
+}
+
+static void TIDY_CALL countFree( TidyAllocator* base, void* block )
+{
+    CountingAllocator* self = (CountingAllocator*) base;
+    BlockHead* head = (BlockHead*) block;
+
+    if ( !block )
+        return;
+    --head;
+    self->inUse -= head->size;
+    free( head );
+}
+
+static void* TIDY_CALL countRealloc( TidyAllocator* base, void* block, size_t size )
+{
+    void* grown = countAlloc( base, size );
+    BlockHead* head = (BlockHead*) block;
+
+    if ( grown && block )
+    {
+        --head;
+        memcpy( grown, block, head->size < size ? head->size : size );
+        countFree( base, block );
+    }
+    return grown;
+}
+
+static void TIDY_CALL countPanic( TidyAllocator* ARG_UNUSED(base), ctmbstr msg )
+{
+    fprintf( stderr, "findcheck: %s\n", msg );
+    exit( 1 );
+}
+
+static const TidyAllocatorVtbl countVtbl = {
+    countAlloc, countRealloc, countFree, countPanic
+};
+
+static TidyAttr findAttr( TidyNode node, TidyAttrId id )
+{
+    TidyAttr attr;
+
+    for ( attr = tidyAttrFirst(node); attr; attr = tidyAttrNext(attr) )
+        if ( tidyAttrGetId(attr) == id )
+            return attr;
+    return NULL;
+}
+
+typedef enum {
+    CHANGE_NONE,
+    CHANGE_CLASS,
+    CHANGE_ID,
+    CHANGE_SAVE,
+    CHANGE_DISCARD
+} Change;
+
+/* the elements found, changing each one; the peak memory above what was
+   in use before is set in *extra */
+static int findAll( TidyDoc tdoc, CountingAllocator* counter, TidyIterator iter,
+                    Change change, size_t* extra )
+{
+    size_t before = counter->inUse;
+    TidyNode node;
+    int found = 0;
+
+    counter->peak = counter->inUse;
+    while ( (node = tidyGetNextFound(tdoc, &iter)) != NULL )
+    {
+        ++found;
+        if ( change == CHANGE_CLASS )
+            tidyAttrDiscard( tdoc, node, findAttr(node, TidyAttr_CLASS) );
+        else if ( change == CHANGE_ID )
+            tidyAttrDiscard( tdoc, node, findAttr(node, TidyAttr_ID) );
+        else if ( change == CHANGE_SAVE && found % 100 == 0 )
+        {
+            /* saving rebuilds the index */
+            TidyBuffer output;
+            tidyBufInit( &output );
+            tidySaveBuffer( tdoc, &output );
+            tidyBufFree( &output );
+        }
+        else if ( change == CHANGE_DISCARD )
+            tidyDiscardElement( tdoc, node );
+        /* an index is built before the first change */
+        if ( found == 1 )
+            before = counter->inUse;
+    }
+    *extra = counter->peak - before;
+    return found;
+}
+
+static int check( ctmbstr what, int found, int expected )
+{
+    if ( found == expected )
+        return 0;
+    fprintf( stderr, "findcheck: %s found %d, expected %d\n", what, found, expected );
+    return 1;
+}
+
+int main( int argc, char **argv )
+{
+    CountingAllocator counter = { { &countVtbl }, 0, 0 };
+    int blocks = argc > 1 ? atoi( argv[1] ) : 2000;
+    int i, failed = 0;
+    size_t indexSize, extra;
+    TidyBuffer input;
+    TidyDoc tdoc;
+    TidyIterator iter;
+    char block[80];
+
+    if ( blocks < 1 )
+    {
+        fprintf( stderr, "usage: findcheck [blocks]\n" );
+        return 1;
+    }
+
+    tidyBufInit( &input );
+    for ( i = 0; i < blocks; ++i )
+    {
+        sprintf( block, "<div id=d%d class=\"a b\"><span class=a>%d</span></div>\n", i, i );
+        tidyBufAppend( &input, block, (uint) strlen(block) );
+    }
+    tidyBufPutByte( &input, '\0' );
+
+    tdoc = tidyCreateWithAllocator( &counter.base );
+    tidyOptSetBool( tdoc, TidyQuiet, yes );
+    tidyOptSetBool( tdoc, TidyShowWarnings, no );
+    tidyParseString( tdoc, (ctmbstr) input.bp );
+
+    /* the first query builds the index */
+    indexSize = counter.inUse;
+    iter = tidyFindByClass( tdoc, "a" );
+    indexSize = counter.inUse - indexSize;
+    failed += check( "class a", findAll(tdoc, &counter, iter, CHANGE_NONE, &extra),
+                     2 * blocks );
+    failed += check( "div", findAll(tdoc, &counter, tidyFindByTag(tdoc, TidyTag_DIV),
+                                    CHANGE_NONE, &extra), blocks );
+
+    failed += check( "class b, dropping classes",
+                     findAll(tdoc, &counter, tidyFindByClass(tdoc, "b"),
+                             CHANGE_CLASS, &extra), blocks );
+    if ( extra > 2 * indexSize + 65536 )
+    {
+        fprintf( stderr, "findcheck: dropping classes took %lu bytes more, an index %lu\n",
+                 (unsigned long) extra, (unsigned long) indexSize );
+        failed++;
+    }
+    failed += check( "class b afterwards",
+                     findAll(tdoc, &counter, tidyFindByClass(tdoc, "b"),
+                             CHANGE_NONE, &extra), 0 );
+
+    failed += check( "div, dropping ids",
+                     findAll(tdoc, &counter, tidyFindByTag(tdoc, TidyTag_DIV),
+                             CHANGE_ID, &extra), blocks );
+    if ( extra > 2 * indexSize + 65536 )
+    {
+        fprintf( stderr, "findcheck: dropping ids took %lu bytes more, an index %lu\n",
+                 (unsigned long) extra, (unsigned long) indexSize );
+        failed++;
+    }
+    failed += check( "id d0 afterwards", tidyFindById(tdoc, "d0") != NULL, 0 );
+
+    /* only the spans keep class a */
+    failed += check( "class a, saving as it goes",
+                     findAll(tdoc, &counter, tidyFindByClass(tdoc, "a"),
+                             CHANGE_SAVE, &extra), blocks );
+
+    /* each span goes with its div */
+    failed += check( "div, discarding them",
+                     findAll(tdoc, &counter, tidyFindByTag(tdoc, TidyTag_DIV),
+                             CHANGE_DISCARD, &extra), blocks );
+    failed += check( "span afterwards",
+                     findAll(tdoc, &counter, tidyFindByTag(tdoc, TidyTag_SPAN),
+                             CHANGE_NONE, &extra), 0 );
+
+    tidyRelease( tdoc );
+    tidyBufFree( &input );
+    if ( counter.inUse != 0 )
+    {
+        fprintf( stderr, "findcheck: %lu bytes not freed\n", (unsigned long) counter.inUse );
+        failed++;
+    }
+
+    printf( "%d blocks, %d checks failed\n", blocks, failed );
+    return failed ? 2 : 0;
+}
+
+/* eof */
@@ -0,0 +1,201 @@
+/*\
+ *  headcheck - check that parse-head-only reads no more than the head
+ *
+ *  Each document is a head followed by a large body.  With
+ *  parse-head-only the document is parsed from a source that counts the
+ *  bytes taken from it, and
+ *
+ *  - the body must be left empty, with the attributes of its start tag,
+ *  - the output must be that of the head alone parsed as usual, so the
+ *    head is complete,
+ *  - no more may be read than the head and the token that starts the
+ *    body, and a little look ahead.
+ *
+ *  usage: headcheck
+ *
+\*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tidy.h"
+#include "tidybuffio.h"
+
+/* how far the lexer may read past the token that ends the head */
+#define LOOK_AHEAD 4
+
+typedef struct _HeadCase {
+    const char* name;
+    const char* head;       /* the input up to the body */
+    const char* first;      /* the token that starts the body */
+    const char* bodyClass;  /* of an explicit <body>, or NULL */
+} HeadCase;
+
+static const HeadCase cases[] = {
+    { "explicit body",
+      "<!DOCTYPE html>\n<html lang=en>\n<head>\n<title>Head only</title>\n"
+      "<meta charset=utf-8>\n<link rel=stylesheet href=a.css>\n"
+      "<style>p { color: red }</style>\n"
+      "<script>var s = '<p>not yet';</script>\n</head>\n",
+      "<body class=main>", "main" },
+    { "implied head and body",
+      "<title>No tags</title>\n<meta name=a content=b>\n<!-- between -->\n",
+      "<p>", NULL },
+    { "text starts the body",
+      "<!DOCTYPE html>\n<title>Text</title>\n<base href=\"http://example.com/\">\n",
+      "Some text", NULL },
+    { "head closed early",
+      "<html><head><title>Closed</title></head>\n<meta name=late content=x>\n",
+      "<div>", NULL },
+};
+
+#define CASES ( sizeof(cases) / sizeof(cases[0]) )
+
+/* a source over a buffer that keeps the furthest byte taken */
+typedef struct _CountingSource {
+    TidyBuffer* buf;
+    uint pos;
+    uint furthest;
+} CountingSource;
+
+static int TIDY_CALL countGetByte( void* data )
+{
+    CountingSource* src = (CountingSource*) data;
+
+    if ( src->pos >= src->buf->size )
+        return EndOfStream;
+    if ( ++src->pos > src->furthest )
+        src->furthest = src->pos;
+    return src->buf->bp[src->pos - 1];
+}
+
+static void TIDY_CALL countUngetByte( void* data, byte ARG_UNUSED(bv) )
+{
+    CountingSource* src = (CountingSource*) data;
+
+    if ( src->pos > 0 )
+        --src->pos;
+}
+
+static Bool TIDY_CALL countEOF( void* data )
+{
+    CountingSource* src = (CountingSource*) data;
+
+    return src->pos >= src->buf->size;
+}
+
+static TidyDoc newDoc( Bool headOnly, TidyBuffer* msgs )
+{
+    TidyDoc tdoc = tidyCreate();
+
+    tidySetErrorBuffer( tdoc, msgs );
+    tidyOptSetBool( tdoc, TidyParseHeadOnly, headOnly );
+    tidyOptSetBool( tdoc, TidyForceOutput, yes );
+    return tdoc;
+}
+
+static Bool sameBuffers( TidyBuffer* a, TidyBuffer* b )
+{
+    return a->size == b->size && ( a->size == 0 || memcmp(a->bp, b->bp, a->size) == 0 );
+}
+
+static int runCase( const HeadCase* hc, int paragraphs )
+{
+    TidyBuffer input, head, msgs, output, expected;
+    TidyInputSource source;
+    CountingSource counter;
+    TidyDoc tdoc;
+    TidyNode body;
+    TidyAttr attr;
+    uint headSize, limit;
+    int i, failed = 0;
+    char para[80];
+
+    tidyBufInit( &input );
+    tidyBufInit( &head );
+    tidyBufInit( &msgs );
+    tidyBufInit( &output );
+    tidyBufInit( &expected );
+
+    tidyBufAppend( &input, (void*) hc->head, (uint) strlen(hc->head) );
+    headSize = input.size;
+    tidyBufAppend( &input, (void*) hc->first, (uint) strlen(hc->first) );
+    limit = input.size + LOOK_AHEAD;
+    for ( i = 0; i < paragraphs; ++i )
+    {
+        sprintf( para, "<p>Paragraph %d of a body that must not be read.</p>\n", i );
+        tidyBufAppend( &input, para, (uint) strlen(para) );
+    }
+
+    /* the head alone, and an explicit <body> start tag, parsed as usual */
+    tidyBufAppend( &head, input.bp, headSize );
+    if ( hc->bodyClass )
+        tidyBufAppend( &head, (void*) hc->first, (uint) strlen(hc->first) );
+    tdoc = newDoc( no, &msgs );
+    tidyParseBuffer( tdoc, &head );
+    tidyCleanAndRepair( tdoc );
+    tidySaveBuffer( tdoc, &expected );
+    tidyRelease( tdoc );
+
+    /* the whole input, head only */
+    counter.buf = &input;
+    counter.pos = 0;
+    counter.furthest = 0;
+    tidyInitSource( &source, &counter, countGetByte, countUngetByte, countEOF );
+    tdoc = newDoc( yes, &msgs );
+    tidyParseSource( tdoc, &source );
+
+    body = tidyGetBody( tdoc );
+    if ( !body || tidyGetChild(body) )
+    {
+        fprintf( stderr, "headcheck: %s: the body is not empty\n", hc->name );
+        failed++;
+    }
+    if ( hc->bodyClass )
+    {
+        for ( attr = body ? tidyAttrFirst(body) : NULL; attr; attr = tidyAttrNext(attr) )
+            if ( tidyAttrGetId(attr) == TidyAttr_CLASS )
+                break;
+        if ( !attr || strcmp(tidyAttrValue(attr), hc->bodyClass) != 0 )
+        {
+            fprintf( stderr, "headcheck: %s: the body lost its class\n", hc->name );
+            failed++;
+        }
+    }
+    if ( counter.furthest > limit )
+    {
+        fprintf( stderr, "headcheck: %s: read %u bytes of %u, the head ends at %u\n",
+                 hc->name, counter.furthest, input.size, headSize );
+        failed++;
+    }
+
+    tidyCleanAndRepair( tdoc );
+    tidySaveBuffer( tdoc, &output );
+    if ( !sameBuffers(&output, &expected) )
+    {
+        fprintf( stderr, "headcheck: %s: the output is not that of the head\n", hc->name );
+        failed++;
+    }
+    tidyRelease( tdoc );
+
+    tidyBufFree( &input );
+    tidyBufFree( &head );
+    tidyBufFree( &msgs );
+    tidyBufFree( &output );
+    tidyBufFree( &expected );
+    return failed;
+}
+
+int main( int ARG_UNUSED(argc), char** ARG_UNUSED(argv) )
+{
+    uint i;
+    int failed = 0;
+
+    for ( i = 0; i < CASES; ++i )
+        failed += runCase( &cases[i], 20000 );
+
+    printf( "%u cases, %d checks failed\n", (uint) CASES, failed );
+    return failed ? 2 : 0;
+}
+
+/* eof */
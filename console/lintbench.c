@@ -0,0 +1,170 @@
+/*\
+ *  lintbench - compare the full pipeline with lint-only mode
+ *
+ *  Each file is run through tidyParseFile(), tidyCleanAndRepair(),
+ *  tidyRunDiagnostics() and tidySaveBuffer(), once as usual and once
+ *  with lint-only set. The messages and counts of both runs must be
+ *  the same; the time taken and the memory requested are reported.
+ *
+ *  usage: lintbench [-n repeat] [-c config] file...
+ *
+\*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "tidy.h"
+#include "tidybuffio.h"
+
+typedef struct _CountingAllocator {
+    TidyAllocator base;
+    unsigned long allocs;
+    unsigned long bytes;
+} CountingAllocator;
+
+static void* TIDY_CALL countingAlloc( TidyAllocator *base, size_t nBytes )
+{
+    CountingAllocator *self = (CountingAllocator*)base;
+    self->allocs++;
+    self->bytes += nBytes;
+    return malloc( nBytes );
+}
+
+static void* TIDY_CALL countingRealloc( TidyAllocator *base, void *block, size_t nBytes )
+{
+    CountingAllocator *self = (CountingAllocator*)base;
+    self->allocs++;
+    self->bytes += nBytes;
+    return realloc( block, nBytes );
+}
+
+static void TIDY_CALL countingFree( TidyAllocator *ARG_UNUSED(base), void *block )
+{
+    free( block );
+}
+
+static void TIDY_CALL countingPanic( TidyAllocator *ARG_UNUSED(base), ctmbstr msg )
+{
+    fprintf( stderr, "lintbench: %s\n", msg );
+    exit( 2 );
+}
+
+static const TidyAllocatorVtbl countingVtbl = {
+    countingAlloc,
+    countingRealloc,
+    countingFree,
+    countingPanic
+};
+
+typedef struct _RunResult {
+    clock_t ticks;
+    int status;
+    uint errors;
+    uint warnings;
+    uint outsize;
+} RunResult;
+
+static void runFile( CountingAllocator *allocator, ctmbstr config, Bool lint,
+                     ctmbstr file, TidyBuffer *msgs, RunResult *result )
+{
+    TidyDoc tdoc = tidyCreateWithAllocator( &allocator->base );
+    TidyBuffer output;
+    clock_t start;
+
+    tidyBufInit( &output );
+    tidyBufClear( msgs );
+    tidySetErrorBuffer( tdoc, msgs );
+    if ( config )
+        tidyLoadConfig( tdoc, config );
+    tidyOptSetBool( tdoc, TidyLintOnly, lint );
+
+    start = clock();
+    result->status = tidyParseFile( tdoc, file );
+    if ( result->status >= 0 )
+        result->status = tidyCleanAndRepair( tdoc );
+    if ( result->status >= 0 )
+        result->status = tidyRunDiagnostics( tdoc );
+    if ( result->status >= 0 )
+        result->status = tidySaveBuffer( tdoc, &output );
+    result->ticks = clock() - start;
+
+    result->errors = tidyErrorCount( tdoc );
+    result->warnings = tidyWarningCount( tdoc );
+    result->outsize = output.size;
+
+    tidyBufFree( &output );
+    tidyRelease( tdoc );
+}
+
+int main( int argc, char **argv )
+{
+    CountingAllocator full = { { &countingVtbl }, 0, 0 };
+    CountingAllocator lint = { { &countingVtbl }, 0, 0 };
+    clock_t fullTicks = 0, lintTicks = 0;
+    unsigned long outBytes = 0;
+    ctmbstr config = NULL;
+    int repeat = 10, mismatches = 0, files = 0;
+    TidyBuffer fullMsgs, lintMsgs;
+    int i, n;
+
+    for ( i = 1; i + 1 < argc && argv[i][0] == '-'; i += 2 )
+    {
+        if ( strcmp(argv[i], "-n") == 0 )
+            repeat = atoi( argv[i + 1] );
+        else if ( strcmp(argv[i], "-c") == 0 )
+            config = argv[i + 1];
+        else
+            break;
+    }
+    if ( i >= argc || repeat < 1 )
+    {
+        fprintf( stderr, "usage: lintbench [-n repeat] [-c config] file...\n" );
+        return 1;
+    }
+
+    tidyBufInit( &fullMsgs );
+    tidyBufInit( &lintMsgs );
+
+    for ( ; i < argc; ++i, ++files )
+    {
+        for ( n = 0; n < repeat; ++n )
+        {
+            RunResult a, b;
+
+            runFile( &full, config, no, argv[i], &fullMsgs, &a );
+            runFile( &lint, config, yes, argv[i], &lintMsgs, &b );
+
+            fullTicks += a.ticks;
+            lintTicks += b.ticks;
+            outBytes += a.outsize;
+
+            if ( n == 0 &&
+                 ( a.status != b.status || a.errors != b.errors ||
+                   a.warnings != b.warnings || b.outsize != 0 ||
+                   fullMsgs.size != lintMsgs.size ||
+                   memcmp(fullMsgs.bp, lintMsgs.bp, fullMsgs.size) != 0 ) )
+            {
+                fprintf( stderr, "lintbench: %s: messages differ\n", argv[i] );
+                ++mismatches;
+            }
+        }
+    }
+
+    tidyBufFree( &fullMsgs );
+    tidyBufFree( &lintMsgs );
+
+    printf( "%d files x %d runs, %lu bytes of output\n", files, repeat, outBytes );
+    printf( "%-10s %10s %12s %14s\n", "mode", "seconds", "allocations", "requested" );
+    printf( "%-10s %10.3f %12lu %14lu\n", "full",
+            (double)fullTicks / CLOCKS_PER_SEC, full.allocs, full.bytes );
+    printf( "%-10s %10.3f %12lu %14lu\n", "lint-only",
+            (double)lintTicks / CLOCKS_PER_SEC, lint.allocs, lint.bytes );
+    if ( fullTicks > 0 )
+        printf( "lint-only takes %.1f%% of the time\n",
+                100.0 * (double)lintTicks / (double)fullTicks );
+
+    return mismatches ? 2 : 0;
+}
+
+/* eof */
@@ -0,0 +1,152 @@
+/*\
+ *  printcheck - compare threaded printing with serial printing
+ *
+ *  Each file is parsed, cleaned and saved under a set of option
+ *  combinations, once with print-threads 1 and once with print-threads
+ *  set to the given count. The status and output of both runs must be
+ *  the same. Only bodies of 64K or more are split, so a small file may
+ *  be repeated to make one document of it.
+ *
+ *  usage: printcheck [-t threads] [-r repeat] [-c config] file...
+ *
+\*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tidy.h"
+#include "tidybuffio.h"
+
+/* option name and value pairs, ending with a NULL name */
+static const char* const optionSets[][8] = {
+    { NULL },
+    { "indent", "yes", NULL },
+    { "wrap", "0", NULL },
+    { "wrap", "40", "indent", "yes", "indent-spaces", "3", NULL },
+    { "indent", "auto", NULL },
+    { "output-xhtml", "yes", "indent", "yes", NULL },
+    { "output-xml", "yes", NULL },
+    { "vertical-space", "yes", NULL },
+    { "vertical-space", "no", "indent", "yes", NULL },
+    { "omit-optional-tags", "yes", "indent", "yes", NULL },
+    { "newline", "CRLF", "wrap", "60", NULL },
+    { "output-encoding", "utf16", NULL },
+    { "clean", "yes", "indent", "yes", NULL },
+};
+
+#define OPTION_SETS ( sizeof(optionSets) / sizeof(optionSets[0]) )
+
+typedef struct _RunResult {
+    int status;
+    TidyBuffer output;
+} RunResult;
+
+static Bool readFile( ctmbstr file, int repeat, TidyBuffer *input )
+{
+    FILE *fin = fopen( file, "rb" );
+    TidyBuffer once;
+    int c, n;
+
+    if ( !fin )
+        return no;
+    tidyBufInit( &once );
+    while ( (c = getc(fin)) != EOF )
+        tidyBufPutByte( &once, (byte)c );
+    fclose( fin );
+
+    for ( n = 0; n < repeat; ++n )
+        tidyBufAppend( input, once.bp, once.size );
+    tidyBufFree( &once );
+    return yes;
+}
+
+static void runInput( ctmbstr config, const char* const *options, int threads,
+                      TidyBuffer *input, RunResult *result )
+{
+    TidyDoc tdoc = tidyCreate();
+    TidyBuffer msgs;
+
+    tidyBufInit( &msgs );
+    tidySetErrorBuffer( tdoc, &msgs );
+    if ( config )
+        tidyLoadConfig( tdoc, config );
+    for ( ; *options; options += 2 )
+        tidyOptParseValue( tdoc, options[0], options[1] );
+    tidyOptSetBool( tdoc, TidyForceOutput, yes );
+    tidyOptSetInt( tdoc, TidyPrintThreads, threads );
+
+    /* parsing reads the buffer through */
+    input->next = 0;
+    tidyBufInit( &result->output );
+    result->status = tidyParseBuffer( tdoc, input );
+    if ( result->status >= 0 )
+        result->status = tidyCleanAndRepair( tdoc );
+    if ( result->status >= 0 )
+        result->status = tidySaveBuffer( tdoc, &result->output );
+
+    tidyBufFree( &msgs );
+    tidyRelease( tdoc );
+}
+
+int main( int argc, char **argv )
+{
+    ctmbstr config = NULL;
+    int threads = 4, repeat = 1, runs = 0, mismatches = 0;
+    uint i, set;
+
+    for ( i = 1; i + 1 < (uint)argc && argv[i][0] == '-'; i += 2 )
+    {
+        if ( strcmp(argv[i], "-t") == 0 )
+            threads = atoi( argv[i + 1] );
+        else if ( strcmp(argv[i], "-r") == 0 )
+            repeat = atoi( argv[i + 1] );
+        else if ( strcmp(argv[i], "-c") == 0 )
+            config = argv[i + 1];
+        else
+            break;
+    }
+    if ( i >= (uint)argc || threads < 2 || repeat < 1 )
+    {
+        fprintf( stderr, "usage: printcheck [-t threads] [-r repeat] [-c config] file...\n" );
+        return 1;
+    }
+
+    for ( ; i < (uint)argc; ++i )
+    {
+        TidyBuffer input;
+
+        tidyBufInit( &input );
+        if ( !readFile(argv[i], repeat, &input) )
+        {
+            fprintf( stderr, "printcheck: can't read %s\n", argv[i] );
+            ++mismatches;
+            continue;
+        }
+
+        for ( set = 0; set < OPTION_SETS; ++set )
+        {
+            RunResult a, b;
+
+            runInput( config, optionSets[set], 1, &input, &a );
+            runInput( config, optionSets[set], threads, &input, &b );
+            ++runs;
+
+            if ( a.status != b.status || a.output.size != b.output.size ||
+                 ( a.output.size &&
+                   memcmp(a.output.bp, b.output.bp, a.output.size) != 0 ) )
+            {
+                fprintf( stderr, "printcheck: %s: output differs with option set %u\n",
+                         argv[i], set );
+                ++mismatches;
+            }
+            tidyBufFree( &a.output );
+            tidyBufFree( &b.output );
+        }
+        tidyBufFree( &input );
+    }
+
+    printf( "%d runs with %d threads, %d differ\n", runs, threads, mismatches );
+    return mismatches ? 2 : 0;
+}
+
+/* eof */
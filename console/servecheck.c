@@ -0,0 +1,393 @@
+/*\
+ *  servecheck - compare tidy -serve responses with the library's results
+ *
+ *  Starts the console tidy with -serve on a number of threads, sends it
+ *  each file under a few sets of request options, an empty document and
+ *  a document over -serve-max-size, and checks that the responses come
+ *  back in the order of the requests with the status, output and
+ *  diagnostics that running the same request here gives.
+ *
+ *  usage: servecheck [-t threads] [-r repeat] tidy file...
+ *
+\*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "tidy.h"
+#include "tidybuffio.h"
+
+/* the options on tidy's command line, which empty request options keep */
+static const char* const commandLine[] = { "indent", "auto", NULL };
+
+/* request options, as sent; NULL ends the list */
+static const char* const requestOptions[] = {
+    "",
+    "wrap: 40\nindent: no\n",
+    "# xhtml\noutput-xhtml: yes\nindent-spaces 4\n",
+    "clean: yes\n\nbare: yes\n",
+    NULL
+};
+
+#define MAX_SIZE  1     /* -serve-max-size, in MB */
+
+typedef struct _Request {
+    const char* options;
+    TidyBuffer  input;      /* not owned */
+    Bool        oversize;
+    int         status;
+    TidyBuffer  output;
+    TidyBuffer  diag;
+} Request;
+
+typedef struct _Sender {
+    int      fd;
+    Request* requests;
+    int      count;
+} Sender;
+
+static void putWord( byte* p, uint v )
+{
+    p[0] = (byte)( v >> 24 );
+    p[1] = (byte)( v >> 16 );
+    p[2] = (byte)( v >> 8 );
+    p[3] = (byte) v;
+}
+
+static uint getWord( const byte* p )
+{
+    return ((uint)p[0] << 24) | ((uint)p[1] << 16) | ((uint)p[2] << 8) | p[3];
+}
+
+static Bool writeFull( int fd, const void* buf, size_t len )
+{
+    const byte* p = (const byte*) buf;
+
+    while ( len > 0 )
+    {
+        ssize_t n = write( fd, p, len );
+        if ( n < 0 && errno == EINTR )
+            continue;
+        if ( n <= 0 )
+            return no;
+        p += n;
+        len -= (size_t) n;
+    }
+    return yes;
+}
+
+static Bool readFull( int fd, void* buf, size_t len )
+{
+    byte* p = (byte*) buf;
+
+    while ( len > 0 )
+    {
+        ssize_t n = read( fd, p, len );
+        if ( n < 0 && errno == EINTR )
+            continue;
+        if ( n <= 0 )
+            return no;
+        p += n;
+        len -= (size_t) n;
+    }
+    return yes;
+}
+
+static Bool writePart( int fd, const void* bp, uint size )
+{
+    byte word[4];
+
+    putWord( word, size );
+    return writeFull( fd, word, 4 ) && ( size == 0 || writeFull(fd, bp, size) );
+}
+
+static Bool readPart( int fd, TidyBuffer* buf )
+{
+    byte word[4];
+    uint size;
+
+    tidyBufClear( buf );
+    if ( !readFull(fd, word, 4) )
+        return no;
+    size = getWord( word );
+    tidyBufCheckAlloc( buf, size + 1, 0 );
+    if ( !readFull(fd, buf->bp, size) )
+        return no;
+    buf->size = size;
+    return yes;
+}
+
+static void setOptions( TidyDoc tdoc, const char* const* options )
+{
+    for ( ; *options; options += 2 )
+        tidyOptParseValue( tdoc, options[0], options[1] );
+}
+
+/* the request options are simple enough to set line by line */
+static void setRequestOptions( TidyDoc tdoc, const char* text )
+{
+    char line[256];
+
+    while ( *text )
+    {
+        size_t len = strcspn( text, "\n" );
+        char *name = line, *value;
+
+        sprintf( line, "%.*s", (int) len, text );
+        text += len + ( text[len] != '\0' );
+        if ( *name == '\0' || *name == '#' )
+            continue;
+        value = name + strcspn( name, ": " );
+        if ( *value )
+            *value++ = '\0';
+        value += strspn( value, ": " );
+        tidyOptParseValue( tdoc, name, value );
+    }
+}
+
+/* what tidy -serve should answer, run as it runs a request */
+static void expect( Request* req )
+{
+    TidyDoc tdoc = tidyCreate();
+    int status;
+
+    tidyBufInit( &req->output );
+    tidyBufInit( &req->diag );
+    if ( req->oversize )
+    {
+        tidyRelease( tdoc );
+        req->status = -1;
+        return;
+    }
+
+    tidySetErrorBuffer( tdoc, &req->diag );
+    setOptions( tdoc, commandLine );
+    setRequestOptions( tdoc, req->options );
+    tidySetErrorBuffer( tdoc, &req->diag );
+
+    req->input.next = 0;
+    status = tidyParseBuffer( tdoc, &req->input );
+    if ( status >= 0 )
+        status = tidyCleanAndRepair( tdoc );
+    if ( status >= 0 )
+    {
+        status = tidyRunDiagnostics( tdoc );
+        if ( !tidyOptGetBool(tdoc, TidyShowInfo) )
+        {
+            tidyOptSetBool( tdoc, TidyShowInfo, yes );
+            tidyReportDoctype( tdoc );
+            tidyOptSetBool( tdoc, TidyShowInfo, no );
+        }
+    }
+    if ( status > 1 )
+        status = -1;
+    if ( status >= 0 )
+        status = tidySaveBuffer( tdoc, &req->output );
+    if ( tidyErrorCount(tdoc) + tidyWarningCount(tdoc) > 0 )
+        tidyErrorSummary( tdoc );
+
+    req->status = status;
+    tidyRelease( tdoc );
+}
+
+static void* sendRequests( void* arg )
+{
+    Sender* sender = (Sender*) arg;
+    int i;
+
+    for ( i = 0; i < sender->count; ++i )
+    {
+        Request* req = &sender->requests[i];
+
+        if ( !writePart(sender->fd, req->options, (uint) strlen(req->options)) )
+            break;
+        if ( req->oversize )
+        {
+            /* the length is all that is checked before reading past it */
+            static byte zeros[4096];
+            uint left = ( MAX_SIZE << 20 ) + 1;
+            byte word[4];
+
+            putWord( word, left );
+            if ( !writeFull(sender->fd, word, 4) )
+                break;
+            for ( ; left > 0; left -= ( left < sizeof(zeros) ? left : sizeof(zeros) ) )
+                if ( !writeFull(sender->fd, zeros, left < sizeof(zeros) ? left : sizeof(zeros)) )
+                    break;
+        }
+        else if ( !writePart(sender->fd, req->input.bp, req->input.size) )
+            break;
+    }
+    close( sender->fd );
+    return NULL;
+}
+
+static Bool readFile( const char* file, TidyBuffer* input )
+{
+    FILE *fin = fopen( file, "rb" );
+    int c;
+
+    if ( !fin )
+        return no;
+    while ( (c = getc(fin)) != EOF )
+        tidyBufPutByte( input, (byte)c );
+    fclose( fin );
+    return yes;
+}
+
+int main( int argc, char **argv )
+{
+    const char* threads = "4";
+    int repeat = 3, files, count, i, n, mismatches = 0;
+    int toServer[2], fromServer[2], status;
+    TidyBuffer *inputs, empty, output, diag;
+    Request* requests;
+    Sender sender;
+    pthread_t thread;
+    pid_t pid;
+    byte word[4];
+
+    for ( i = 1; i + 1 < argc && argv[i][0] == '-'; i += 2 )
+    {
+        if ( strcmp(argv[i], "-t") == 0 )
+            threads = argv[i + 1];
+        else if ( strcmp(argv[i], "-r") == 0 )
+            repeat = atoi( argv[i + 1] );
+        else
+            break;
+    }
+    if ( i + 1 >= argc || atoi(threads) < 1 || repeat < 1 )
+    {
+        fprintf( stderr, "usage: servecheck [-t threads] [-r repeat] tidy file...\n" );
+        return 1;
+    }
+
+    /* every file with every set of options, with an empty document and
+       one too large in between, repeated to keep the threads busy */
+    files = argc - i - 1;
+    inputs = (TidyBuffer*) calloc( files, sizeof(TidyBuffer) );
+    for ( n = 0; n < files; ++n )
+    {
+        tidyBufInit( &inputs[n] );
+        if ( !readFile(argv[i + 1 + n], &inputs[n]) )
+        {
+            fprintf( stderr, "servecheck: can't read %s\n", argv[i + 1 + n] );
+            return 1;
+        }
+    }
+    tidyBufInit( &empty );
+    tidyBufCheckAlloc( &empty, 1, 0 );
+
+    count = repeat * ( files * 4 + 2 );
+    requests = (Request*) calloc( count, sizeof(Request) );
+    for ( n = 0; n < count; ++n )
+    {
+        int k = n % ( files * 4 + 2 );
+        Request* req = &requests[n];
+
+        if ( k < files * 4 )
+        {
+            req->options = requestOptions[k % 4];
+            req->input = inputs[k / 4];
+        }
+        else
+        {
+            req->options = requestOptions[k % 2];
+            req->input = empty;
+            req->oversize = ( k == files * 4 + 1 );
+        }
+        expect( req );
+    }
+
+    signal( SIGPIPE, SIG_IGN );
+    if ( pipe(toServer) != 0 || pipe(fromServer) != 0 )
+    {
+        perror( "servecheck" );
+        return 1;
+    }
+    pid = fork();
+    if ( pid == 0 )
+    {
+        dup2( toServer[0], 0 );
+        dup2( fromServer[1], 1 );
+        close( toServer[0] );
+        close( toServer[1] );
+        close( fromServer[0] );
+        close( fromServer[1] );
+        execl( argv[i], argv[i], "-serve", "-serve-threads", threads,
+               "-serve-max-size", "1", "-indent", (char*) NULL );
+        perror( argv[i] );
+        _exit( 127 );
+    }
+    close( toServer[0] );
+    close( fromServer[1] );
+
+    sender.fd = toServer[1];
+    sender.requests = requests;
+    sender.count = count;
+    pthread_create( &thread, NULL, sendRequests, &sender );
+
+    tidyBufInit( &output );
+    tidyBufInit( &diag );
+    for ( n = 0; n < count; ++n )
+    {
+        Request* req = &requests[n];
+
+        if ( !readFull(fromServer[0], word, 4) ||
+             !readPart(fromServer[0], &output) || !readPart(fromServer[0], &diag) )
+        {
+            fprintf( stderr, "servecheck: response %d of %d is missing\n", n, count );
+            ++mismatches;
+            break;
+        }
+        status = (int) getWord( word );
+        if ( status != req->status ||
+             output.size != req->output.size ||
+             ( output.size && memcmp(output.bp, req->output.bp, output.size) != 0 ) ||
+             ( req->oversize ? diag.size == 0 :
+               ( diag.size != req->diag.size ||
+                 ( diag.size && memcmp(diag.bp, req->diag.bp, diag.size) != 0 ) ) ) )
+        {
+            fprintf( stderr, "servecheck: response %d differs (status %d, expected %d)\n",
+                     n, status, req->status );
+            ++mismatches;
+        }
+    }
+    if ( mismatches == 0 && read(fromServer[0], word, 1) != 0 )
+    {
+        fprintf( stderr, "servecheck: more responses than requests\n" );
+        ++mismatches;
+    }
+
+    pthread_join( thread, NULL );
+    close( fromServer[0] );
+    waitpid( pid, &status, 0 );
+    if ( !WIFEXITED(status) || WEXITSTATUS(status) != 0 )
+    {
+        fprintf( stderr, "servecheck: tidy -serve exited with %d\n", status );
+        ++mismatches;
+    }
+
+    printf( "%d requests on %s threads, %d differ\n", count, threads, mismatches );
+
+    for ( n = 0; n < count; ++n )
+    {
+        tidyBufFree( &requests[n].output );
+        tidyBufFree( &requests[n].diag );
+    }
+    for ( n = 0; n < files; ++n )
+        tidyBufFree( &inputs[n] );
+    tidyBufFree( &empty );
+    tidyBufFree( &output );
+    tidyBufFree( &diag );
+    free( requests );
+    free( inputs );
+    return mismatches ? 2 : 0;
+}
+
+/* eof */
@@ -0,0 +1,209 @@
+/*\
+ *  streamcheck - compare streamed output with the usual parse and save
+ *
+ *  Each file is parsed, cleaned, checked and saved under a set of option
+ *  combinations, once as usual and once with tidySetStreamingOutput().
+ *  The status, output and messages of both runs must be the same, but
+ *  for the differences tidy.h allows: the messages may come in another
+ *  order, and the usual run may switch to XHTML output on xml:lang or
+ *  xml:space, which the streamed run has to ignore. Every file must be
+ *  streamed under at least one option set.
+ *
+ *  usage: streamcheck file...
+ *
+\*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tidy.h"
+#include "tidybuffio.h"
+
+/* option name and value pairs, ending with a NULL name; all of them
+   can be streamed */
+static const char* const optionSets[][8] = {
+    { NULL },
+    { "wrap", "0", NULL },
+    { "wrap", "40", "break-before-br", "yes", NULL },
+    { "newline", "CRLF", "wrap", "60", NULL },
+    { "uppercase-tags", "yes", "uppercase-attributes", "yes", NULL },
+    { "numeric-entities", "yes", "quote-marks", "yes", NULL },
+    { "output-encoding", "utf16", NULL },
+    { "vertical-space", "no", NULL },
+};
+
+#define OPTION_SETS ( sizeof(optionSets) / sizeof(optionSets[0]) )
+
+typedef struct _RunResult {
+    int status;
+    Bool streamed;      /* output came out while parsing */
+    Bool xhtml;         /* the output was switched to XHTML */
+    TidyBuffer output;
+    TidyBuffer msgs;
+} RunResult;
+
+static Bool readFile( ctmbstr file, TidyBuffer *input )
+{
+    FILE *fin = fopen( file, "rb" );
+    int c;
+
+    if ( !fin )
+        return no;
+    while ( (c = getc(fin)) != EOF )
+        tidyBufPutByte( input, (byte)c );
+    fclose( fin );
+    return yes;
+}
+
+static void runInput( const char* const *options, Bool stream,
+                      TidyBuffer *input, RunResult *result )
+{
+    TidyDoc tdoc = tidyCreate();
+    TidyOutputSink sink;
+
+    tidyBufInit( &result->output );
+    tidyBufInit( &result->msgs );
+    tidySetErrorBuffer( tdoc, &result->msgs );
+    tidyOptParseValue( tdoc, "doctype", "html5" );
+    for ( ; *options; options += 2 )
+        tidyOptParseValue( tdoc, options[0], options[1] );
+    tidyOptSetBool( tdoc, TidyForceOutput, yes );
+
+    tidyInitOutputBuffer( &sink, &result->output );
+    if ( stream )
+        tidySetStreamingOutput( tdoc, &sink );
+
+    /* parsing reads the buffer through */
+    input->next = 0;
+    result->status = tidyParseBuffer( tdoc, input );
+    result->streamed = ( result->output.size > 0 );
+    result->xhtml = tidyOptGetBool( tdoc, TidyXhtmlOut );
+    if ( result->status >= 0 )
+        result->status = tidyCleanAndRepair( tdoc );
+    if ( result->status >= 0 )
+        result->status = tidyRunDiagnostics( tdoc );
+    if ( result->status >= 0 )
+        result->status = tidySaveSink( tdoc, &sink );
+    tidyErrorSummary( tdoc );
+
+    tidyRelease( tdoc );
+}
+
+static int compareLines( const void *a, const void *b )
+{
+    return strcmp( *(char* const*) a, *(char* const*) b );
+}
+
+/* the lines of msgs, sorted; free the result */
+static char** sortedLines( TidyBuffer *msgs, uint *count )
+{
+    char **lines, *p;
+    uint n = 0;
+
+    tidyBufPutByte( msgs, '\0' );
+    for ( p = (char*) msgs->bp; *p; ++p )
+        n += ( *p == '\n' );
+    lines = (char**) calloc( n + 1, sizeof(char*) );
+    *count = 0;
+    for ( p = (char*) msgs->bp; *p; )
+    {
+        lines[(*count)++] = p;
+        p += strcspn( p, "\n" );
+        if ( *p )
+            *p++ = '\0';
+    }
+    qsort( lines, *count, sizeof(char*), compareLines );
+    return lines;
+}
+
+/* the same messages, in any order */
+static Bool sameMessages( TidyBuffer *a, TidyBuffer *b )
+{
+    uint na, nb, n;
+    char **la = sortedLines( a, &na );
+    char **lb = sortedLines( b, &nb );
+    Bool same = ( na == nb );
+
+    for ( n = 0; same && n < na; ++n )
+        same = ( strcmp(la[n], lb[n]) == 0 );
+    free( la );
+    free( lb );
+    return same;
+}
+
+int main( int argc, char **argv )
+{
+    int i, runs = 0, streamed = 0, switched = 0, mismatches = 0;
+    uint set;
+
+    if ( argc < 2 )
+    {
+        fprintf( stderr, "usage: streamcheck file...\n" );
+        return 1;
+    }
+
+    for ( i = 1; i < argc; ++i )
+    {
+        TidyBuffer input;
+        int streamedFile = 0;
+
+        tidyBufInit( &input );
+        if ( !readFile(argv[i], &input) )
+        {
+            fprintf( stderr, "streamcheck: can't read %s\n", argv[i] );
+            ++mismatches;
+            continue;
+        }
+
+        for ( set = 0; set < OPTION_SETS; ++set )
+        {
+            RunResult a, b;
+
+            runInput( optionSets[set], no, &input, &a );
+            runInput( optionSets[set], yes, &input, &b );
+            ++runs;
+            streamedFile += b.streamed;
+
+            if ( a.status != b.status )
+            {
+                fprintf( stderr, "streamcheck: %s: status %d, streamed %d with option set %u\n",
+                         argv[i], a.status, b.status, set );
+                ++mismatches;
+            }
+            else if ( a.xhtml && !b.xhtml )
+                ++switched;
+            else if ( a.output.size != b.output.size ||
+                      ( a.output.size &&
+                        memcmp(a.output.bp, b.output.bp, a.output.size) != 0 ) )
+            {
+                fprintf( stderr, "streamcheck: %s: output differs with option set %u\n",
+                         argv[i], set );
+                ++mismatches;
+            }
+            if ( !sameMessages(&a.msgs, &b.msgs) )
+            {
+                fprintf( stderr, "streamcheck: %s: messages differ with option set %u\n",
+                         argv[i], set );
+                ++mismatches;
+            }
+            tidyBufFree( &a.output );
+            tidyBufFree( &a.msgs );
+            tidyBufFree( &b.output );
+            tidyBufFree( &b.msgs );
+        }
+        tidyBufFree( &input );
+
+        if ( streamedFile == 0 )
+        {
+            fprintf( stderr, "streamcheck: %s was never streamed\n", argv[i] );
+            ++mismatches;
+        }
+        streamed += streamedFile;
+    }
+
+    printf( "%d runs, %d streamed, %d switched to XHTML, %d differ\n",
+            runs, streamed, switched, mismatches );
+    return mismatches ? 2 : 0;
+}
+
+/* eof */
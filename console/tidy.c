@@ -21,6 +21,43 @@
 #define SPRTF printf
 #endif
 
+/* The result cache, see -cache-dir, needs POSIX directories and times. */
+#ifndef SUPPORT_RESULT_CACHE
+#if defined(_WIN32)
+#define SUPPORT_RESULT_CACHE 0
+#else
+#define SUPPORT_RESULT_CACHE 1
+#endif
+#endif
+
+#if SUPPORT_RESULT_CACHE
+#include "tidybuffio.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+/* Serving requests, see -serve, needs threads and UNIX domain sockets. */
+#ifndef SUPPORT_SERVE
+#if SUPPORT_PARALLEL_PRINT && !defined(_WIN32)
+#define SUPPORT_SERVE 1
+#else
+#define SUPPORT_SERVE 0
+#endif
+#endif
+
+#if SUPPORT_SERVE
+#include "tidybuffio.h"
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
 static FILE* errout = NULL;  /* set to stderr */
 /* static FILE* txtout = NULL; */  /* set to stdout */
 
@@ -237,6 +274,10 @@ static const CmdOptDesc cmdopt_defs[] =  {
     { CmdOptFileManip, "-config <%s>",         TC_OPT_CONFIG,   TC_LABEL_FILE, NULL },
     { CmdOptFileManip, "-file <%s>",           TC_OPT_FILE,     TC_LABEL_FILE, "error-file: <%s>", "-f <%s>" },
     { CmdOptFileManip, "-modify",              TC_OPT_MODIFY,   0,             "write-back: yes", "-m" },
+#if SUPPORT_RESULT_CACHE
+    { CmdOptFileManip, "-cache-dir <%s>",      TC_OPT_CACHEDIR, TC_LABEL_DIR,  NULL },
+    { CmdOptFileManip, "-cache-size <%s>",     TC_OPT_CACHESIZE, TC_LABEL_SIZE, NULL },
+#endif
     { CmdOptProcDir,   "-indent",              TC_OPT_INDENT,   0,             "indent: auto", "-i" },
     { CmdOptProcDir,   "-wrap <%s>",           TC_OPT_WRAP,     TC_LABEL_COL,  "wrap: <%s>", "-w <%s>" },
     { CmdOptProcDir,   "-upper",               TC_OPT_UPPER,    0,             "uppercase-tags: yes", "-u" },
@@ -279,6 +320,12 @@ static const CmdOptDesc cmdopt_defs[] =  {
     { CmdOptMisc,      "-show-config",         TC_OPT_SHOWCFG,  0,             NULL },
     { CmdOptMisc,      "-help-option <%s>",    TC_OPT_HELPOPT,  TC_LABEL_OPT,  NULL },
     { CmdOptMisc,      "-language <%s>",       TC_OPT_LANGUAGE, TC_LABEL_LANG, "language: <%s>" },
+#if SUPPORT_SERVE
+    { CmdOptMisc,      "-serve",               TC_OPT_SERVE,    0,             NULL },
+    { CmdOptMisc,      "-serve-max-size <%s>", TC_OPT_SERVEMAXSIZE, TC_LABEL_SIZE, NULL },
+    { CmdOptMisc,      "-serve-socket <%s>",   TC_OPT_SERVESOCKET, TC_LABEL_FILE, NULL },
+    { CmdOptMisc,      "-serve-threads <%s>",  TC_OPT_SERVETHREADS, TC_LABEL_COUNT, NULL },
+#endif
     { CmdOptXML,       "-xml-help",            TC_OPT_XMLHELP,  0,             NULL },
     { CmdOptXML,       "-xml-config",          TC_OPT_XMLCFG,   0,             NULL },
     { CmdOptXML,       "-xml-strings",         TC_OPT_XMLSTRG,  0,             NULL },
@@ -1518,6 +1565,1102 @@ static void unknownOption( uint c )
 }
 
 
+#if SUPPORT_RESULT_CACHE
+/**
+ **  The result cache, see -cache-dir.  Each entry is a file named for
+ **  the SHA-256 of the library version, the language, the option values
+ **  and the input, and holds what tidy wrote for that input: the counts,
+ **  the output, the diagnostics and the error summary.
+ */
+
+#define CACHE_MAGIC "tidy-cache 1"
+
+/* seconds after which a temporary file no process renamed is removed */
+#define CACHE_TEMP_GRACE 600
+
+typedef struct {
+    uint  h[8];
+    ulong length;       /* bytes hashed */
+    byte  block[64];
+    uint  used;         /* bytes in block */
+} Sha256;
+
+typedef struct {
+    ctmbstr        dir;         /* NULL unless -cache-dir is given */
+    ulong          maxBytes;    /* 0 for no limit */
+    ulong          bytes;       /* in the entries, once counted */
+    Bool           counted;
+    Bool           active;      /* the current file is to be stored */
+    Bool           last;        /* summary is that of the last file */
+    Bool           tee;         /* diagnostics go to errout, */
+    TidyBuffer*    into;        /* and to this buffer if not NULL */
+    char           key[65];
+    uint           errors;
+    uint           warnings;
+    uint           accessWarnings;
+    Bool           hasOutput;
+    TidyBuffer     input;
+    TidyBuffer     output;
+    TidyBuffer     diag;
+    TidyBuffer     summary;
+    TidyOutputSink sink;
+    FILE*          sinkOut;     /* errout when the sink was set */
+    FILE*          errfile;     /* error file, opened again for the sink */
+    ulong          errEncoding; /* how tidy writes to the error file */
+    ulong          errNewline;
+} ResultCache;
+
+typedef struct {
+    char   name[65];
+    time_t used;
+    ulong  size;
+} CacheFile;
+
+static ResultCache cache;
+
+static const uint sha256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR(x, n) ( ((x) >> (n)) | ((x) << (32 - (n))) )
+
+static void sha256Block( Sha256* ctx, const byte* p )
+{
+    uint w[64], s[8], t1, t2;
+    int i;
+
+    for ( i = 0; i < 16; ++i, p += 4 )
+        w[i] = ((uint)p[0] << 24) | ((uint)p[1] << 16) | ((uint)p[2] << 8) | p[3];
+    for ( ; i < 64; ++i )
+        w[i] = w[i-16] + w[i-7] +
+               ( ROTR(w[i-15], 7) ^ ROTR(w[i-15], 18) ^ (w[i-15] >> 3) ) +
+               ( ROTR(w[i-2], 17) ^ ROTR(w[i-2], 19) ^ (w[i-2] >> 10) );
+
+    memcpy( s, ctx->h, sizeof(s) );
+    for ( i = 0; i < 64; ++i )
+    {
+        t1 = s[7] + ( ROTR(s[4], 6) ^ ROTR(s[4], 11) ^ ROTR(s[4], 25) ) +
+             ( (s[4] & s[5]) ^ (~s[4] & s[6]) ) + sha256K[i] + w[i];
+        t2 = ( ROTR(s[0], 2) ^ ROTR(s[0], 13) ^ ROTR(s[0], 22) ) +
+             ( (s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]) );
+        memmove( s + 1, s, 7 * sizeof(uint) );
+        s[4] += t1;
+        s[0] = t1 + t2;
+    }
+    for ( i = 0; i < 8; ++i )
+        ctx->h[i] += s[i];
+}
+
+static void sha256Init( Sha256* ctx )
+{
+    static const uint h0[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    memcpy( ctx->h, h0, sizeof(h0) );
+    ctx->length = 0;
+    ctx->used = 0;
+}
+
+static void sha256Update( Sha256* ctx, const void* data, size_t len )
+{
+    const byte* p = (const byte*) data;
+
+    ctx->length += len;
+    while ( len > 0 )
+    {
+        size_t n = 64 - ctx->used;
+        if ( n > len )
+            n = len;
+        memcpy( ctx->block + ctx->used, p, n );
+        ctx->used += (uint) n;
+        p += n;
+        len -= n;
+        if ( ctx->used == 64 )
+        {
+            sha256Block( ctx, ctx->block );
+            ctx->used = 0;
+        }
+    }
+}
+
+static void sha256Final( Sha256* ctx, char hex[65] )
+{
+    uint hi = (uint)( ctx->length >> 29 ), lo = (uint)( ctx->length << 3 );
+    byte pad[8];
+    int i;
+
+    sha256Update( ctx, "\x80", 1 );
+    while ( ctx->used != 56 )
+        sha256Update( ctx, "", 1 );
+    for ( i = 0; i < 4; ++i )
+    {
+        pad[i] = (byte)( hi >> (24 - 8 * i) );
+        pad[4 + i] = (byte)( lo >> (24 - 8 * i) );
+    }
+    sha256Update( ctx, pad, 8 );
+    for ( i = 0; i < 8; ++i )
+        sprintf( hex + 8 * i, "%08x", ctx->h[i] );
+}
+
+static void TIDY_CALL cachePutByte( void* ARG_UNUSED(sinkData), byte bv )
+{
+    if ( cache.tee )
+        putc( bv, errout );
+    if ( cache.into )
+        tidyBufPutByte( cache.into, bv );
+}
+
+static Bool cacheReadFile( ctmbstr path, TidyBuffer* buf )
+{
+    FILE* fin = fopen( path, "rb" );
+    byte chunk[8192];
+    size_t n;
+
+    tidyBufClear( buf );
+    if ( !fin )
+        return no;
+    while ( (n = fread(chunk, 1, sizeof(chunk), fin)) > 0 )
+        tidyBufAppend( buf, chunk, (uint) n );
+    n = ferror( fin );
+    fclose( fin );
+    return n == 0;
+}
+
+static void cacheHashString( Sha256* ctx, ctmbstr s )
+{
+    sha256Update( ctx, s ? s : "", s ? strlen(s) + 1 : 1 );
+}
+
+/**
+ **  Keys the input on everything that decides what tidy writes for it.
+ */
+static void cacheKey( TidyDoc tdoc, ctmbstr htmlfil )
+{
+    TidyBuffer options;
+    TidyOutputSink sink;
+    Sha256 ctx;
+    char errstream[32] = "stderr";
+
+    tidyBufInit( &options );
+    tidyInitOutputBuffer( &sink, &options );
+    tidyOptSaveSink( tdoc, &sink );
+
+    sha256Init( &ctx );
+    cacheHashString( &ctx, CACHE_MAGIC );
+    cacheHashString( &ctx, tidyLibraryVersion() );
+    cacheHashString( &ctx, tidyReleaseDate() );
+    cacheHashString( &ctx, tidyGetLanguage() );
+    /* messages name the file in emacs format */
+    cacheHashString( &ctx, tidyOptGetBool(tdoc, TidyEmacs) ? htmlfil : NULL );
+    /* and are written as the options were when the error file was set */
+    if ( errout && errout != stderr )
+        sprintf( errstream, "%lu %lu", cache.errEncoding, cache.errNewline );
+    cacheHashString( &ctx, errstream );
+    sha256Update( &ctx, options.bp, options.size );
+    cacheHashString( &ctx, NULL );
+    sha256Update( &ctx, cache.input.bp, cache.input.size );
+    sha256Final( &ctx, cache.key );
+
+    tidyBufFree( &options );
+}
+
+/**
+ **  Diagnostics go through the cache's sink from now on, which writes
+ **  them to errout in the encoding and newlines tidy used for errout.
+ **  Setting it closes an error file tidy opened, so the file is opened
+ **  again to append to it.
+ */
+static void cacheSetSink( TidyDoc tdoc, ctmbstr errfil )
+{
+    ulong encoding = tidyOptGetInt( tdoc, TidyOutCharEncoding );
+    ulong newline = tidyOptGetInt( tdoc, TidyNewline );
+    Bool reopen = ( errout && errout != stderr );
+
+    if ( cache.sinkOut && cache.sinkOut == errout )
+        return;
+
+    if ( reopen )
+    {
+        tidyOptSetInt( tdoc, TidyOutCharEncoding, cache.errEncoding );
+        tidyOptSetInt( tdoc, TidyNewline, cache.errNewline );
+    }
+    else
+    {
+        /* as tidy's own stream for stderr */
+        tidyOptSetValue( tdoc, TidyOutCharEncoding, "ascii" );
+        tidyOptSetInt( tdoc, TidyNewline, TidyLF );
+    }
+    tidyInitSink( &cache.sink, &cache, cachePutByte );
+    tidySetErrorSink( tdoc, &cache.sink );
+    tidyOptSetInt( tdoc, TidyOutCharEncoding, encoding );
+    tidyOptSetInt( tdoc, TidyNewline, newline );
+
+    if ( reopen )
+    {
+        if ( cache.errfile )
+            fclose( cache.errfile );
+        errout = cache.errfile = fopen( errfil, "ab" );
+    }
+    if ( !errout )
+        errout = stderr;
+    cache.sinkOut = errout;
+    cache.tee = yes;
+    cache.into = NULL;
+}
+
+/**
+ **  Writes what is stored for the input, or returns no when there is no
+ **  entry, or the output file cannot be written.
+ */
+static Bool cacheReplay( TidyDoc tdoc, ctmbstr path )
+{
+    TidyBuffer entry;
+    FILE* fout = stdout;
+    char header[128];
+    uint hasOutput, outLen, diagLen, sumLen, headLen;
+    Bool hit = no;
+
+    tidyBufInit( &entry );
+    if ( cacheReadFile(path, &entry) )
+    {
+        for ( headLen = 0; headLen < entry.size && headLen + 1 < sizeof(header) &&
+                           entry.bp[headLen] != '\n'; ++headLen )
+            header[headLen] = (char) entry.bp[headLen];
+        header[headLen++] = '\0';
+
+        hit = ( sscanf(header, CACHE_MAGIC " %u %u %u %u %u %u %u",
+                       &cache.errors, &cache.warnings, &cache.accessWarnings,
+                       &hasOutput, &outLen, &diagLen, &sumLen) == 7 &&
+                headLen <= entry.size &&
+                outLen <= entry.size - headLen &&
+                diagLen <= entry.size - headLen - outLen &&
+                sumLen == entry.size - headLen - outLen - diagLen );
+    }
+
+    if ( hit && hasOutput )
+    {
+        ctmbstr outfil = tidyOptGetValue( tdoc, TidyOutFile );
+        if ( outfil && !tidyOptGetBool(tdoc, TidyLintOnly) )
+            hit = ( (fout = fopen(outfil, "wb")) != NULL );
+    }
+
+    if ( hit )
+    {
+        fwrite( entry.bp + headLen + outLen, 1, diagLen, errout );
+        if ( hasOutput && fout )
+        {
+            fwrite( entry.bp + headLen, 1, outLen, fout );
+            if ( fout != stdout )
+                fclose( fout );
+            else
+                fflush( stdout );
+        }
+        tidyBufClear( &cache.summary );
+        tidyBufAppend( &cache.summary, entry.bp + headLen + outLen + diagLen, sumLen );
+
+        /* the least recently used entries are dropped first */
+        utime( path, NULL );
+    }
+
+    tidyBufFree( &entry );
+    return hit;
+}
+
+/**
+ **  Looks the file up, and writes what is stored for it on a hit. On a
+ **  miss, the input is kept in cache.input for the parse, and what tidy
+ **  writes is collected to be stored by cacheStore().
+ */
+static Bool cacheBegin( TidyDoc tdoc, ctmbstr htmlfil, ctmbstr errfil )
+{
+    tmbstr path;
+    Bool hit;
+
+    if ( !cacheReadFile(htmlfil, &cache.input) )
+        return no;
+
+    cacheKey( tdoc, htmlfil );
+    cacheSetSink( tdoc, errfil );
+
+    path = stringWithFormat( "%s/%s", cache.dir, cache.key );
+    hit = cacheReplay( tdoc, path );
+    free( path );
+
+    cache.last = yes;
+    if ( !hit )
+    {
+        cache.active = yes;
+        cache.hasOutput = no;
+        tidyBufClear( &cache.output );
+        tidyBufClear( &cache.diag );
+        cache.into = &cache.diag;
+    }
+    return hit;
+}
+
+/**
+ **  Saves the document where tidySaveFile() or tidySaveStdout() would,
+ **  keeping a copy of the output.
+ */
+static int cacheSave( TidyDoc tdoc, ctmbstr outfil )
+{
+    FILE* fout = stdout;
+    int status;
+
+    if ( outfil && !tidyOptGetBool(tdoc, TidyLintOnly) &&
+         (fout = fopen(outfil, "wb")) == NULL )
+    {
+        /* tidy reports it, and the result is not stored */
+        cache.active = cache.last = no;
+        cache.into = NULL;
+        return tidySaveFile( tdoc, outfil );
+    }
+
+    status = tidySaveBuffer( tdoc, &cache.output );
+    if ( fout )
+    {
+        fwrite( cache.output.bp, 1, cache.output.size, fout );
+        if ( fout != stdout )
+            fclose( fout );
+        else
+            fflush( stdout );
+    }
+    cache.hasOutput = yes;
+    return status;
+}
+
+static int cmpCacheFile( const void* e1, const void* e2 )
+{
+    const CacheFile* f1 = (const CacheFile*) e1;
+    const CacheFile* f2 = (const CacheFile*) e2;
+    if ( f1->used != f2->used )
+        return f1->used < f2->used ? -1 : 1;
+    return strcmp( f1->name, f2->name );
+}
+
+/**
+ **  Counts the entries, and when they are over -cache-size, removes the
+ **  least recently used ones, down to three quarters of it so that this
+ **  is not done again for every file.  Temporary files left by a tidy
+ **  that was stopped while storing are removed once they are older than
+ **  CACHE_TEMP_GRACE; newer ones may still be renamed, and are counted.
+ */
+static void cacheTrim( void )
+{
+    DIR* dir = opendir( cache.dir );
+    struct dirent* de;
+    struct stat st;
+    CacheFile* files = NULL;
+    uint count = 0, alloced = 0, i;
+    time_t now = time( NULL );
+
+    if ( !dir )
+        return;
+
+    cache.bytes = 0;
+    while ( (de = readdir(dir)) != NULL )
+    {
+        tmbstr path;
+
+        if ( strncmp(de->d_name, "tmp-", 4) == 0 )
+        {
+            path = stringWithFormat( "%s/%s", cache.dir, de->d_name );
+            if ( stat(path, &st) == 0 )
+            {
+                if ( now - st.st_mtime > CACHE_TEMP_GRACE )
+                    unlink( path );
+                else
+                    cache.bytes += (ulong) st.st_size;
+            }
+            free( path );
+            continue;
+        }
+        if ( strlen(de->d_name) != 64 ||
+             strspn(de->d_name, "0123456789abcdef") != 64 )
+            continue;
+        path = stringWithFormat( "%s/%s", cache.dir, de->d_name );
+        if ( stat(path, &st) == 0 )
+        {
+            if ( count == alloced )
+            {
+                alloced = alloced ? 2 * alloced : 256;
+                if ( !(files = realloc(files, alloced * sizeof(CacheFile))) )
+                    outOfMemory();
+            }
+            strcpy( files[count].name, de->d_name );
+            files[count].used = st.st_mtime;
+            files[count].size = (ulong) st.st_size;
+            cache.bytes += files[count].size;
+            ++count;
+        }
+        free( path );
+    }
+    closedir( dir );
+    cache.counted = yes;
+
+    if ( cache.maxBytes && cache.bytes > cache.maxBytes )
+    {
+        qsort( files, count, sizeof(CacheFile), cmpCacheFile );
+        for ( i = 0; i < count && cache.bytes > cache.maxBytes / 4 * 3; ++i )
+        {
+            tmbstr path = stringWithFormat( "%s/%s", cache.dir, files[i].name );
+            if ( unlink(path) == 0 )
+                cache.bytes -= files[i].size;
+            free( path );
+        }
+    }
+    free( files );
+}
+
+/**
+ **  Stores what tidy wrote for the file.  The entry is written to a
+ **  temporary file and renamed, so a reader never sees half of it; the
+ **  temporary file is removed if anything fails on the way.
+ */
+static void cacheStore( TidyDoc tdoc )
+{
+    tmbstr temp, path;
+    FILE* fout;
+    Bool done = no;
+
+    cache.active = no;
+    cache.tee = no;
+    cache.into = &cache.summary;
+    tidyBufClear( &cache.summary );
+    tidyErrorSummary( tdoc );
+    cache.tee = yes;
+    cache.into = NULL;
+
+    temp = stringWithFormat( "%s/tmp-%ld-%s", cache.dir, (long) getpid(), cache.key );
+    path = stringWithFormat( "%s/%s", cache.dir, cache.key );
+    if ( (fout = fopen(temp, "wb")) != NULL )
+    {
+        ulong size;
+
+        fprintf( fout, CACHE_MAGIC " %u %u %u %u %u %u %u\n",
+                 tidyErrorCount(tdoc), tidyWarningCount(tdoc),
+                 tidyAccessWarningCount(tdoc), cache.hasOutput,
+                 cache.output.size, cache.diag.size, cache.summary.size );
+        fwrite( cache.output.bp, 1, cache.output.size, fout );
+        fwrite( cache.diag.bp, 1, cache.diag.size, fout );
+        fwrite( cache.summary.bp, 1, cache.summary.size, fout );
+        size = (ulong) ftell( fout );
+        /* a short write shows in ferror() or, once flushed, in fclose() */
+        done = !ferror( fout );
+        done = ( fclose(fout) == 0 && done && rename(temp, path) == 0 );
+        if ( done )
+            cache.bytes += size;
+    }
+    if ( !done )
+        unlink( temp );
+    free( temp );
+    free( path );
+
+    if ( done && ( !cache.counted ||
+                   (cache.maxBytes && cache.bytes > cache.maxBytes) ) )
+        cacheTrim();
+}
+
+static void cacheInit( void )
+{
+    tidyBufInit( &cache.input );
+    tidyBufInit( &cache.output );
+    tidyBufInit( &cache.diag );
+    tidyBufInit( &cache.summary );
+    cache.maxBytes = 100UL << 20;
+}
+
+static void cacheFree( void )
+{
+    if ( cache.errfile )
+        fclose( cache.errfile );
+    tidyBufFree( &cache.input );
+    tidyBufFree( &cache.output );
+    tidyBufFree( &cache.diag );
+    tidyBufFree( &cache.summary );
+}
+#endif /* SUPPORT_RESULT_CACHE */
+
+
+#if SUPPORT_SERVE
+/**
+ **  Serving requests, see -serve.  A request is the options, as lines of
+ **  "name: value" like a config file, and a document; the response is
+ **  the status, the output and the diagnostics.  Each is sent as a 32 bit
+ **  length in network byte order followed by that many bytes, and the
+ **  status as a 32 bit two's complement number:
+ **
+ **      request:   <length> options  <length> document
+ **      response:  status  <length> output  <length> diagnostics
+ **
+ **  Empty options leave those of the command line as they are; others
+ **  are set after them.  The responses on a connection come in the order
+ **  of its requests, though the requests themselves are run at the same
+ **  time, each on a TidyDoc that a thread keeps for all the requests it
+ **  runs.  A request with options or a document over -serve-max-size is
+ **  read past, and answered with status -1 and a message.
+ */
+
+#define SERVE_MAX_SIZE  16u     /* default -serve-max-size, in MB */
+
+typedef struct _ServeConn {
+    int             in;         /* requests are read from here */
+    int             out;        /* and responses written here */
+    pthread_mutex_t lock;
+    pthread_cond_t  turn;       /* written has changed */
+    ulong           submitted;  /* requests read */
+    ulong           written;    /* responses written */
+    Bool            failed;     /* writing failed, drop the rest */
+} ServeConn;
+
+typedef struct _ServeJob {
+    ServeConn*        conn;
+    ulong             seq;      /* the number of its request */
+    TidyBuffer        options;
+    TidyBuffer        input;
+    uint              refused;  /* size of a part over maxSize, or 0 */
+    struct _ServeJob* next;
+} ServeJob;
+
+typedef struct {
+    ctmbstr          socket;    /* NULL to serve stdin and stdout */
+    uint             threads;
+    uint             maxSize;   /* longest options or document, in MB */
+    Bool             on;
+    TidySharedConfig config;    /* of the command line */
+    TidyBuffer       options;   /* the same, as text */
+    pthread_mutex_t  lock;
+    pthread_cond_t   queued;    /* a job was queued, or done is set */
+    pthread_cond_t   taken;     /* a job was taken from the queue */
+    ServeJob*        head;
+    ServeJob*        tail;
+    uint             waiting;   /* jobs in the queue */
+    Bool             done;
+} ServePool;
+
+static ServePool serve;
+
+static Bool readFull( int fd, void* buf, size_t len, size_t* got )
+{
+    byte* p = (byte*) buf;
+
+    *got = 0;
+    while ( *got < len )
+    {
+        ssize_t n = read( fd, p + *got, len - *got );
+        if ( n < 0 && errno == EINTR )
+            continue;
+        if ( n <= 0 )
+            return no;
+        *got += (size_t) n;
+    }
+    return yes;
+}
+
+static Bool writeFull( int fd, const void* buf, size_t len )
+{
+    const byte* p = (const byte*) buf;
+
+    while ( len > 0 )
+    {
+        ssize_t n = write( fd, p, len );
+        if ( n < 0 && errno == EINTR )
+            continue;
+        if ( n <= 0 )
+            return no;
+        p += n;
+        len -= (size_t) n;
+    }
+    return yes;
+}
+
+static void putWord( byte* p, uint v )
+{
+    p[0] = (byte)( v >> 24 );
+    p[1] = (byte)( v >> 16 );
+    p[2] = (byte)( v >> 8 );
+    p[3] = (byte) v;
+}
+
+static uint getWord( const byte* p )
+{
+    return ((uint)p[0] << 24) | ((uint)p[1] << 16) | ((uint)p[2] << 8) | p[3];
+}
+
+/**
+ **  Reads one length prefixed part of a request.  Returns no at the end
+ **  of the requests, and sets *bad if it ends in the middle of one.  A
+ **  part over -serve-max-size is read past, not kept, and its length is
+ **  set in *refused.
+ */
+static Bool readFrame( int fd, TidyBuffer* buf, Bool first, Bool* bad,
+                       uint* refused )
+{
+    byte word[4];
+    size_t got;
+    uint len;
+
+    if ( !readFull(fd, word, 4, &got) )
+    {
+        *bad = ( got > 0 || !first );
+        return no;
+    }
+    len = getWord( word );
+    tidyBufClear( buf );
+    if ( len > ((ulong) serve.maxSize << 20) )
+    {
+        byte skip[4096];
+
+        *refused = len;
+        for ( ; len > 0; len -= (uint) got )
+        {
+            if ( !readFull(fd, skip, len < sizeof(skip) ? len : sizeof(skip), &got) )
+            {
+                *bad = yes;
+                return no;
+            }
+        }
+        return yes;
+    }
+    tidyBufCheckAlloc( buf, len + 1, 0 );
+    if ( !readFull(fd, buf->bp, len, &got) )
+    {
+        *bad = yes;
+        return no;
+    }
+    buf->size = len;
+    buf->bp[len] = '\0';
+    return yes;
+}
+
+/**
+ **  Sets the options of a request, one "name: value" or "name value" per
+ **  line.  Empty lines and comments, which start with # or //, are
+ **  skipped.  Problems are reported as diagnostics.
+ */
+static void serveOptions( TidyDoc tdoc, const TidyBuffer* text )
+{
+    tmbstr copy = stringWithFormat( "%.*s", (int) text->size, (ctmbstr) text->bp );
+    tmbstr opts = copy;
+
+    while ( *opts )
+    {
+        tmbstr line = opts, name, value, end;
+
+        opts += strcspn( opts, "\r\n" );
+        if ( *opts )
+            *opts++ = '\0';
+
+        name = line + strspn( line, " \t" );
+        if ( *name == '\0' || *name == '#' || strncmp(name, "//", 2) == 0 )
+            continue;
+
+        value = name + strcspn( name, ": \t" );
+        if ( *value )
+            *value++ = '\0';
+        value += strspn( value, ": \t" );
+        for ( end = value + strlen(value); end > value && isspace((byte)end[-1]); )
+            *--end = '\0';
+
+        tidyOptParseValue( tdoc, name, value );
+    }
+    free( copy );
+}
+
+/**
+ **  Runs one request, as the command line runs one file.
+ */
+static int serveRequest( TidyDoc tdoc, ServeJob* job,
+                         TidyBuffer* output, TidyBuffer* diag )
+{
+    int status;
+
+    tidyBufClear( output );
+    tidyBufClear( diag );
+
+    if ( job->refused )
+    {
+        tmbstr msg = stringWithFormat( tidyLocalizedString(TC_MAIN_ERROR_SERVE_SIZE),
+                                       job->refused, serve.maxSize );
+        tidyBufAppend( diag, msg, (uint) strlen(msg) );
+        tidyBufAppend( diag, "\n", 1 );
+        free( msg );
+        return -1;
+    }
+
+    if ( job->options.size == 0 )
+    {
+        tidyOptUseSharedConfig( tdoc, serve.config );
+        tidySetErrorBuffer( tdoc, diag );
+    }
+    else
+    {
+        /* The shared values are made consistent, which can lose some,
+           e.g. indent-spaces without indent, so they are set again. */
+        tidyOptResetAllToDefault( tdoc );
+        tidySetErrorBuffer( tdoc, diag );
+        serveOptions( tdoc, &serve.options );
+        serveOptions( tdoc, &job->options );
+        /* in the encoding the request asks for */
+        tidySetErrorBuffer( tdoc, diag );
+    }
+
+    status = tidyParseBuffer( tdoc, &job->input );
+
+    if ( status >= 0 )
+        status = tidyCleanAndRepair( tdoc );
+
+    if ( status >= 0 ) {
+        status = tidyRunDiagnostics( tdoc );
+        if ( !tidyOptGetBool(tdoc, TidyQuiet) ) {
+            if (!tidyOptGetBool(tdoc, TidyShowInfo)) {
+                tidyOptSetBool( tdoc, TidyShowInfo, yes );
+                tidyReportDoctype( tdoc );
+                tidyOptSetBool( tdoc, TidyShowInfo, no );
+            }
+        }
+    }
+    if ( status > 1 )
+        status = ( tidyOptGetBool(tdoc, TidyForceOutput) ? status : -1 );
+
+    if ( status >= 0 && tidyOptGetBool(tdoc, TidyShowMarkup) )
+        status = tidySaveBuffer( tdoc, output );
+
+    if ( tidyErrorCount(tdoc) + tidyWarningCount(tdoc) > 0 &&
+         !tidyOptGetBool(tdoc, TidyQuiet) )
+        tidyErrorSummary( tdoc );
+
+    tidyReset( tdoc );
+    return status;
+}
+
+/**
+ **  Writes the response to a request once those to the requests before
+ **  it on the connection have been written.
+ */
+static void serveRespond( ServeJob* job, int status,
+                          TidyBuffer* output, TidyBuffer* diag )
+{
+    ServeConn* conn = job->conn;
+    byte word[4];
+    Bool ok;
+
+    pthread_mutex_lock( &conn->lock );
+    while ( conn->written != job->seq )
+        pthread_cond_wait( &conn->turn, &conn->lock );
+    ok = !conn->failed;
+    pthread_mutex_unlock( &conn->lock );
+
+    if ( ok )
+    {
+        putWord( word, (uint) status );
+        ok = writeFull( conn->out, word, 4 );
+        putWord( word, output->size );
+        ok = ok && writeFull( conn->out, word, 4 ) &&
+             writeFull( conn->out, output->bp, output->size );
+        putWord( word, diag->size );
+        ok = ok && writeFull( conn->out, word, 4 ) &&
+             writeFull( conn->out, diag->bp, diag->size );
+    }
+
+    pthread_mutex_lock( &conn->lock );
+    if ( !ok )
+        conn->failed = yes;
+    conn->written++;
+    pthread_cond_broadcast( &conn->turn );
+    pthread_mutex_unlock( &conn->lock );
+}
+
+static void* serveWorker( void* arg )
+{
+    TidyDoc tdoc = (TidyDoc) arg;
+    TidyBuffer output, diag;
+
+    tidyBufInit( &output );
+    tidyBufInit( &diag );
+
+    for ( ;; )
+    {
+        ServeJob* job;
+        int status;
+
+        pthread_mutex_lock( &serve.lock );
+        while ( !serve.head && !serve.done )
+            pthread_cond_wait( &serve.queued, &serve.lock );
+        job = serve.head;
+        if ( job )
+        {
+            serve.head = job->next;
+            if ( !serve.head )
+                serve.tail = NULL;
+            serve.waiting--;
+            pthread_cond_signal( &serve.taken );
+        }
+        pthread_mutex_unlock( &serve.lock );
+        if ( !job )
+            break;
+
+        status = serveRequest( tdoc, job, &output, &diag );
+        serveRespond( job, status, &output, &diag );
+
+        tidyBufFree( &job->options );
+        tidyBufFree( &job->input );
+        free( job );
+    }
+
+    tidyBufFree( &output );
+    tidyBufFree( &diag );
+    return NULL;
+}
+
+/**
+ **  Reads the requests on a connection and queues them.  The queue holds
+ **  a few requests for each thread, so that a client sending faster than
+ **  they are run is made to wait.  Returns when all have been answered.
+ */
+static void serveConnection( ServeConn* conn )
+{
+    Bool bad = no;
+
+    for ( ;; )
+    {
+        ServeJob* job = (ServeJob*) malloc( sizeof(ServeJob) );
+        if ( !job )
+            outOfMemory();
+        tidyBufInit( &job->options );
+        tidyBufInit( &job->input );
+        job->refused = 0;
+
+        if ( !readFrame(conn->in, &job->options, yes, &bad, &job->refused) ||
+             !readFrame(conn->in, &job->input, no, &bad, &job->refused) )
+        {
+            tidyBufFree( &job->options );
+            tidyBufFree( &job->input );
+            free( job );
+            break;
+        }
+
+        job->conn = conn;
+        job->seq = conn->submitted++;
+        job->next = NULL;
+
+        pthread_mutex_lock( &serve.lock );
+        while ( serve.waiting >= 4 * serve.threads )
+            pthread_cond_wait( &serve.taken, &serve.lock );
+        if ( serve.tail )
+            serve.tail->next = job;
+        else
+            serve.head = job;
+        serve.tail = job;
+        serve.waiting++;
+        pthread_cond_signal( &serve.queued );
+        pthread_mutex_unlock( &serve.lock );
+    }
+
+    pthread_mutex_lock( &conn->lock );
+    while ( conn->written != conn->submitted )
+        pthread_cond_wait( &conn->turn, &conn->lock );
+    pthread_mutex_unlock( &conn->lock );
+
+    if ( bad )
+    {
+        fprintf( errout, tidyLocalizedString(TC_MAIN_ERROR_SERVE_REQUEST),
+                 serve.socket ? serve.socket : "stdin" );
+        fprintf( errout, "\n" );
+    }
+}
+
+static ServeConn* newConnection( int in, int out )
+{
+    ServeConn* conn = (ServeConn*) calloc( 1, sizeof(ServeConn) );
+    if ( !conn )
+        outOfMemory();
+    conn->in = in;
+    conn->out = out;
+    pthread_mutex_init( &conn->lock, NULL );
+    pthread_cond_init( &conn->turn, NULL );
+    return conn;
+}
+
+static void freeConnection( ServeConn* conn )
+{
+    pthread_mutex_destroy( &conn->lock );
+    pthread_cond_destroy( &conn->turn );
+    free( conn );
+}
+
+static void* serveClient( void* arg )
+{
+    ServeConn* conn = (ServeConn*) arg;
+
+    serveConnection( conn );
+    close( conn->in );
+    freeConnection( conn );
+    return NULL;
+}
+
+/**
+ **  Accepts connections on the socket, each read on a thread of its own,
+ **  until tidy is stopped.  Returns only if the socket cannot be used.
+ */
+static int serveSocket( void )
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    memset( &addr, 0, sizeof(addr) );
+    addr.sun_family = AF_UNIX;
+    if ( strlen(serve.socket) >= sizeof(addr.sun_path) )
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy( addr.sun_path, serve.socket );
+
+    if ( (fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 )
+        return -1;
+    unlink( serve.socket );
+    if ( bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0 ||
+         listen(fd, SOMAXCONN) < 0 )
+    {
+        close( fd );
+        return -1;
+    }
+
+    /* a client that goes away is noticed as a failed write */
+    signal( SIGPIPE, SIG_IGN );
+
+    for ( ;; )
+    {
+        pthread_t thread;
+        int client = accept( fd, NULL, NULL );
+
+        if ( client < 0 )
+        {
+            if ( errno == EINTR || errno == ECONNABORTED )
+                continue;
+            close( fd );
+            return -1;
+        }
+        if ( pthread_create(&thread, NULL, serveClient,
+                            newConnection(client, client)) == 0 )
+            pthread_detach( thread );
+        else
+            close( client );
+    }
+}
+
+/**
+ **  Serves requests with the options of the command line as the
+ **  defaults, until the end of stdin, or for good on a socket.
+ */
+static int serveRequests( TidyDoc tdoc )
+{
+    TidyDoc* docs;
+    pthread_t* threads;
+    TidyOutputSink sink;
+    uint count, i, started = 0;
+    int status = 0, err;
+
+    if ( serve.threads == 0 )
+    {
+        long n = sysconf( _SC_NPROCESSORS_ONLN );
+        serve.threads = ( n > 0 ? (uint) n : 1 );
+    }
+    if ( serve.maxSize == 0 )
+        serve.maxSize = SERVE_MAX_SIZE;
+
+    tidyBufInit( &serve.options );
+    tidyInitOutputBuffer( &sink, &serve.options );
+    tidyOptSaveSink( tdoc, &sink );
+    serve.config = tidyOptCreateSharedConfig( tdoc );
+    pthread_mutex_init( &serve.lock, NULL );
+    pthread_cond_init( &serve.queued, NULL );
+    pthread_cond_init( &serve.taken, NULL );
+
+    count = serve.threads;
+    docs = (TidyDoc*) calloc( count, sizeof(TidyDoc) );
+    threads = (pthread_t*) calloc( count, sizeof(pthread_t) );
+    if ( !docs || !threads )
+        outOfMemory();
+
+    /* the documents are created here, not on the threads */
+    for ( i = 0; i < count; ++i )
+    {
+        docs[i] = tidyCreate();
+        tidyOptUseSharedConfig( docs[i], serve.config );
+        if ( (err = pthread_create(&threads[i], NULL, serveWorker, (void*) docs[i])) != 0 )
+        {
+            errno = err;
+            break;
+        }
+        ++started;
+    }
+    serve.threads = started;
+
+    if ( started == 0 )
+        status = -1;
+    else if ( serve.socket )
+        status = serveSocket();
+    else
+    {
+        ServeConn* conn = newConnection( fileno(stdin), fileno(stdout) );
+        serveConnection( conn );
+        freeConnection( conn );
+    }
+
+    if ( status < 0 )
+    {
+        fprintf( errout, tidyLocalizedString(TC_MAIN_ERROR_SERVE),
+                 serve.socket ? serve.socket : "stdin", strerror(errno) );
+        fprintf( errout, "\n" );
+    }
+
+    pthread_mutex_lock( &serve.lock );
+    serve.done = yes;
+    pthread_cond_broadcast( &serve.queued );
+    pthread_mutex_unlock( &serve.lock );
+
+    for ( i = 0; i < started; ++i )
+        pthread_join( threads[i], NULL );
+    for ( i = 0; i < count; ++i )
+        if ( docs[i] )
+            tidyRelease( docs[i] );
+
+    free( docs );
+    free( threads );
+    tidyOptReleaseSharedConfig( serve.config );
+    tidyBufFree( &serve.options );
+    pthread_mutex_destroy( &serve.lock );
+    pthread_cond_destroy( &serve.queued );
+    pthread_cond_destroy( &serve.taken );
+    return status;
+}
+#endif /* SUPPORT_SERVE */
+
+
+/**
+ **  Sets the error file, noting how tidy writes to it for the result
+ **  cache.
+ */
+static FILE* setErrorFile( TidyDoc tdoc, ctmbstr errfil )
+{
+#if SUPPORT_RESULT_CACHE
+    cache.errEncoding = tidyOptGetInt( tdoc, TidyOutCharEncoding );
+    cache.errNewline = tidyOptGetInt( tdoc, TidyNewline );
+#endif
+    return tidySetErrorFile( tdoc, errfil );
+}
+
+
 /**
  **  MAIN --  let's do something here.
  */
@@ -1534,6 +2677,9 @@ int main( int argc, char** argv )
     uint accessWarnings = 0;
 
     errout = stderr;  /* initialize to stderr */
+#if SUPPORT_RESULT_CACHE
+    cacheInit();
+#endif
 
     /* Set an atexit handler. */
     atexit( tidy_cleanup );
@@ -1780,7 +2926,7 @@ int main( int argc, char** argv )
                         if ( post && (!errfil || !samefile(errfil, post)) )
                         {
                             errfil = post;
-                            errout = tidySetErrorFile( tdoc, post );
+                            errout = setErrorFile( tdoc, post );
                         }
 
                         --argc;
@@ -1806,7 +2952,7 @@ int main( int argc, char** argv )
                     if ( argc >= 3 )
                     {
                         errfil = argv[2];
-                        errout = tidySetErrorFile( tdoc, errfil );
+                        errout = setErrorFile( tdoc, errfil );
                         --argc;
                         ++argv;
                     }
@@ -1827,6 +2973,79 @@ int main( int argc, char** argv )
                         }
                     }
                 }
+#if SUPPORT_RESULT_CACHE
+                else if ( strcasecmp(arg,  "cache-dir") == 0 ||
+                         strcasecmp(arg, "-cache-dir") == 0 )
+                {
+                    if ( argc >= 3 )
+                    {
+                        cache.dir = argv[2];
+                        --argc;
+                        ++argv;
+                    }
+                }
+                else if ( strcasecmp(arg,  "cache-size") == 0 ||
+                         strcasecmp(arg, "-cache-size") == 0 )
+                {
+                    if ( argc >= 3 )
+                    {
+                        ulong megabytes = 0;
+                        if ( sscanf(argv[2], "%lu", &megabytes) > 0 )
+                        {
+                            cache.maxBytes = megabytes << 20;
+                            --argc;
+                            ++argv;
+                        }
+                    }
+                }
+#endif
+#if SUPPORT_SERVE
+                else if ( strcasecmp(arg,  "serve") == 0 ||
+                         strcasecmp(arg, "-serve") == 0 )
+                {
+                    serve.on = yes;
+                }
+                else if ( strcasecmp(arg,  "serve-max-size") == 0 ||
+                         strcasecmp(arg, "-serve-max-size") == 0 )
+                {
+                    if ( argc >= 3 )
+                    {
+                        uint megabytes = 0;
+                        if ( sscanf(argv[2], "%u", &megabytes) > 0 &&
+                             megabytes > 0 && megabytes < 4096 )
+                        {
+                            serve.maxSize = megabytes;
+                            --argc;
+                            ++argv;
+                        }
+                    }
+                }
+                else if ( strcasecmp(arg,  "serve-socket") == 0 ||
+                         strcasecmp(arg, "-serve-socket") == 0 )
+                {
+                    if ( argc >= 3 )
+                    {
+                        serve.on = yes;
+                        serve.socket = argv[2];
+                        --argc;
+                        ++argv;
+                    }
+                }
+                else if ( strcasecmp(arg,  "serve-threads") == 0 ||
+                         strcasecmp(arg, "-serve-threads") == 0 )
+                {
+                    if ( argc >= 3 )
+                    {
+                        uint threads = 0;
+                        if ( sscanf(argv[2], "%u", &threads) > 0 )
+                        {
+                            serve.threads = threads;
+                            --argc;
+                            ++argv;
+                        }
+                    }
+                }
+#endif
                 else if ( strcasecmp(arg,  "version") == 0 ||
                          strcasecmp(arg, "-version") == 0 ||
                          strcasecmp(arg,        "v") == 0 )
@@ -1845,7 +3064,7 @@ int main( int argc, char** argv )
                         if ( post && (!errfil || !samefile(errfil, post)) )
                         {
                             errfil = post;
-                            errout = tidySetErrorFile( tdoc, post );
+                            errout = setErrorFile( tdoc, post );
                         }
 
                         ++argv;
@@ -1935,6 +3154,21 @@ int main( int argc, char** argv )
             continue;
         }
 
+#if SUPPORT_SERVE
+        if ( serve.on )
+        {
+            /* the options so far are the defaults of every request */
+            status = serveRequests( tdoc );
+            tidyRelease( tdoc );
+#if SUPPORT_RESULT_CACHE
+            cacheFree();
+#endif
+            return ( status < 0 ? 2 : 0 );
+        }
+#endif
+#if SUPPORT_RESULT_CACHE
+        cache.active = cache.last = no;
+#endif
         if ( argc > 1 )
         {
             htmlfil = argv[1];
@@ -1943,6 +3177,26 @@ int main( int argc, char** argv )
 #endif /* DEBUG outout */
             if ( tidyOptGetBool(tdoc, TidyEmacs) )
                 tidySetEmacsFile( tdoc, htmlfil );
+#if SUPPORT_RESULT_CACHE
+            if ( cache.dir && !tidyOptGetBool(tdoc, TidyWriteBack) &&
+                 cacheBegin(tdoc, htmlfil, errfil) )
+            {
+                /* stored result written, nothing to parse */
+                contentErrors   += cache.errors;
+                contentWarnings += cache.warnings;
+                accessWarnings  += cache.accessWarnings;
+
+                --argc;
+                ++argv;
+
+                if ( argc <= 1 )
+                    break;
+                continue;
+            }
+            if ( cache.active )
+                status = tidyParseBuffer( tdoc, &cache.input );
+            else
+#endif
             status = tidyParseFile( tdoc, htmlfil );
         }
         else
@@ -1976,6 +3230,11 @@ int main( int argc, char** argv )
             else
             {
                 ctmbstr outfil = tidyOptGetValue( tdoc, TidyOutFile );
+#if SUPPORT_RESULT_CACHE
+                if ( cache.active ) {
+                    status = cacheSave( tdoc, outfil );
+                } else
+#endif
                 if ( outfil ) {
                     status = tidySaveFile( tdoc, outfil );
                 } else {
@@ -1994,6 +3253,10 @@ int main( int argc, char** argv )
         contentErrors   += tidyErrorCount( tdoc );
         contentWarnings += tidyWarningCount( tdoc );
         accessWarnings  += tidyAccessWarningCount( tdoc );
+#if SUPPORT_RESULT_CACHE
+        if ( cache.active )
+            cacheStore( tdoc );
+#endif
         
         --argc;
         ++argv;
@@ -2009,13 +3272,24 @@ int main( int argc, char** argv )
     
     if (contentErrors + contentWarnings > 0 &&
         !tidyOptGetBool(tdoc, TidyQuiet))
+    {
+#if SUPPORT_RESULT_CACHE
+        /* the document holds nothing of a file tidy did not parse */
+        if ( cache.last )
+            fwrite( cache.summary.bp, 1, cache.summary.size, errout );
+        else
+#endif
         tidyErrorSummary(tdoc);
+    }
     
     if (!tidyOptGetBool(tdoc, TidyQuiet))
         tidyGeneralInfo(tdoc);
     
     /* called to free hash tables etc. */
     tidyRelease( tdoc );
+#if SUPPORT_RESULT_CACHE
+    cacheFree();
+#endif
     
     /* return status can be used by scripts */
     if ( contentErrors > 0 )
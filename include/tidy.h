@@ -96,6 +96,11 @@ opaque_type( TidyNode );
 */
 opaque_type( TidyAttr );
 
+/** @struct TidySharedConfig
+**  Opaque shared configuration datatype
+*/
+opaque_type( TidySharedConfig );
+
 /** @} end Opaque group */
 
 
@@ -265,6 +270,14 @@ TIDY_EXPORT TidyDoc TIDY_CALL     tidyCreateWithAllocator( TidyAllocator *alloca
  */
 TIDY_EXPORT void TIDY_CALL        tidyRelease( TidyDoc tdoc );
 
+/** Free the document and the results of the last parse, leaving the
+ ** TidyDoc as if just created with the same configuration, callbacks and
+ ** sinks. Buffers and tables grown by earlier documents are kept, so a
+ ** long-lived TidyDoc can process one document after another without
+ ** allocating them again.
+ */
+TIDY_EXPORT void TIDY_CALL        tidyReset( TidyDoc tdoc );
+
 /** Let application store a chunk of data w/ each Tidy instance.
 **  Useful for callbacks.
 */
@@ -444,6 +457,26 @@ TIDY_EXPORT Bool TIDY_CALL          tidyOptDiffThanSnapshot( TidyDoc tdoc );
 /** Copy current configuration settings from one document to another */
 TIDY_EXPORT Bool TIDY_CALL          tidyOptCopyConfig( TidyDoc tdocTo, TidyDoc tdocFrom );
 
+/** Create an immutable configuration from the current settings of a
+**  document, e.g. one that has just loaded a config file.  The settings
+**  are made consistent once, here.  The caller holds one reference.
+*/
+TIDY_EXPORT TidySharedConfig TIDY_CALL tidyOptCreateSharedConfig( TidyDoc tdoc );
+
+/** Add a reference to a shared configuration */
+TIDY_EXPORT void TIDY_CALL          tidyOptRetainSharedConfig( TidySharedConfig tcfg );
+
+/** Drop a reference to a shared configuration; the last one frees it */
+TIDY_EXPORT void TIDY_CALL          tidyOptReleaseSharedConfig( TidySharedConfig tcfg );
+
+/** Make a document read its settings from a shared configuration
+**  without copying them.  The document holds a reference until it is
+**  released or given another configuration (NULL for its own copy).
+**  Changing a setting of the document copies the settings first, for
+**  that document only.
+*/
+TIDY_EXPORT Bool TIDY_CALL          tidyOptUseSharedConfig( TidyDoc tdoc, TidySharedConfig tcfg );
+
 /** Get character encoding name.  Used with TidyCharEncoding,
 **  TidyOutCharEncoding, TidyInCharEncoding */
 TIDY_EXPORT ctmbstr TIDY_CALL       tidyOptGetEncName( TidyDoc tdoc, TidyOptionId optId );
@@ -626,6 +659,66 @@ typedef void (TIDY_CALL *TidyPPProgress)( TidyDoc tdoc, uint line, uint col, uin
 TIDY_EXPORT Bool TIDY_CALL   tidySetPrettyPrinterCallback( TidyDoc tdoc,
                                                   TidyPPProgress callback );
 
+/** Callback to receive the tokens of a document instead of a tree.
+**  The node is only valid during the call. Use tidyNodeGetType(),
+**  tidyNodeGetId(), tidyNodeGetName(), tidyAttrFirst() and friends,
+**  and tidyNodeGetValue() for text, comments and the like; entities
+**  in text have been decoded to UTF-8. Return no to stop parsing.
+*/
+typedef Bool (TIDY_CALL *TidyTokenCallback)( TidyDoc tdoc, TidyNode tnod );
+
+/** Report each token the lexer reads to the callback while parsing,
+**  without building a tree. Script and style content is reported as
+**  a single text token, and white space is kept as it is in mixed
+**  content. Nothing is repaired: tags are reported as they appear,
+**  with their attributes, and end tags are not inferred. The
+**  document has no tree afterwards; tidyCleanAndRepair() and the
+**  save functions only return its status. Pass NULL to build a tree
+**  again.
+*/
+TIDY_EXPORT Bool TIDY_CALL   tidySetTokenCallback( TidyDoc tdoc,
+                                                  TidyTokenCallback callback );
+
+/** Write the document to the given sink while it is being parsed.
+**  Each child of the body is cleaned, repaired, printed and freed as
+**  soon as the parser is done with it, so output starts early and the
+**  tree stays small. This only happens for HTML5 output without
+**  indentation or end tag omission, with force-output and without
+**  clean, word-2000, gdoc, bare, drop-font-tags, hide-comments,
+**  escape-cdata, enclose-text, enclose-block-text, show-body-only
+**  or accessibility checks. The doctype must be html5, or auto with
+**  an HTML5 doctype in the input. Messages come in a different order,
+**  and head elements found in the body stay where they are, as the
+**  head has already been written; xml:lang and xml:space do not
+**  switch the output to XHTML either.
+**  Call tidyCleanAndRepair() and save to the same sink as usual
+**  afterwards: if the document was streamed, they only return its
+**  status. Pass NULL to stop streaming.
+*/
+TIDY_EXPORT Bool TIDY_CALL   tidySetStreamingOutput( TidyDoc tdoc,
+                                                     TidyOutputSink* sink );
+
+/** Callback to abandon work on a document. Return yes to cancel.
+*/
+typedef Bool (TIDY_CALL *TidyCancelCallback)( TidyDoc tdoc );
+
+/** Ask the callback from time to time, every few thousand characters
+**  read and every few hundred nodes cleaned, checked or printed,
+**  whether to go on. Once it returns yes, tidyParse*(),
+**  tidyCleanAndRepair(), tidyRunDiagnostics() and the save functions
+**  stop early and return -ECANCELED until the next document is
+**  parsed. The tree is left consistent but incomplete, and is freed
+**  as usual. Pass NULL to stop asking.
+*/
+TIDY_EXPORT Bool TIDY_CALL   tidySetCancelCallback( TidyDoc tdoc,
+                                                    TidyCancelCallback callback );
+
+/** Cancel work on the document, as tidySetCancelCallback() does, once
+**  the given number of milliseconds have passed from now. Parsing,
+**  cleaning and saving all count towards it. Pass 0 for no deadline.
+*/
+TIDY_EXPORT Bool TIDY_CALL   tidySetDeadline( TidyDoc tdoc, ulong milliseconds );
+
 /** @} end IO group */
 
 /* TODO: Catalog all messages for easy translation
@@ -639,6 +732,11 @@ TIDY_EXPORT ctmbstr     tidyLookupMessage( int errorNo );
 ** Parse markup from a given input source.  String and filename 
 ** functions added for convenience.  HTML/XHTML version determined
 ** from input.
+**
+** When one of the max-* options (TidyMaxInputBytes, TidyMaxNodes,
+** TidyMaxAttributes, TidyMaxDepth, TidyMaxMessages) is exceeded, parsing
+** stops with an error and these functions return -E2BIG. The document
+** then holds what was parsed up to that point.
 ** @{
 */
 
@@ -710,6 +808,33 @@ TIDY_EXPORT int TIDY_CALL         tidySaveSink( TidyDoc tdoc, TidyOutputSink* si
 /** @} end Save group */
 
 
+/** @defgroup Tree Saved Document Trees
+**
+** A parsed, and perhaps cleaned, document can be saved in a compact
+** binary form and loaded into a document later, where it is ready for
+** tidySaveBuffer() and the other Save functions without being parsed
+** again.  The tree is only good for the same build of the library,
+** and is to be loaded with the configuration it was parsed with.
+** @{
+*/
+
+/** Append the document tree to the buffer.  As saving the document
+**  undoes the option changes made while parsing, such as output-xhtml
+**  for XHTML input, call this before the Save functions.  Returns 0,
+**  or -EINVAL if the document was streamed or there is no tree.
+*/
+TIDY_EXPORT int TIDY_CALL         tidySaveTree( TidyDoc tdoc, TidyBuffer* buf );
+
+/** Load a tree written by tidySaveTree() in place of a parse.  Returns
+**  the status the parse returned, or -EINVAL if the buffer does not
+**  hold a tree for this build or its text is not UTF-8, in which case
+**  the document is empty.
+*/
+TIDY_EXPORT int TIDY_CALL         tidyLoadTree( TidyDoc tdoc, TidyBuffer* buf );
+
+/** @} end Tree group */
+
+
 /** @addtogroup Basic
 ** @{
 */
@@ -817,6 +942,22 @@ TIDY_EXPORT ctmbstr TIDY_CALL     tidyAttrValue( TidyAttr tattr );
 
 TIDY_EXPORT void TIDY_CALL        tidyAttrDiscard( TidyDoc itdoc, TidyNode tnod, TidyAttr tattr );
 
+/* Find elements without walking the tree.  An index of the elements by
+** tag, id and class is built on the first query, and rebuilt after the
+** document is parsed, cleaned and repaired or saved again, after an
+** element is discarded and after an id or class attribute is discarded.
+** An iterator carries on through these changes with the elements that
+** match now and come after the last one it returned, so elements may
+** be changed or discarded as they are found.  It ends when that element
+** is freed other than by tidyDiscardElement(), or the document is parsed
+** again.  Ids and class names are case sensitive; an id given to several
+** elements finds the first one.
+*/
+TIDY_EXPORT TidyNode TIDY_CALL     tidyFindById( TidyDoc tdoc, ctmbstr id );
+TIDY_EXPORT TidyIterator TIDY_CALL tidyFindByTag( TidyDoc tdoc, TidyTagId tagId );
+TIDY_EXPORT TidyIterator TIDY_CALL tidyFindByClass( TidyDoc tdoc, ctmbstr className );
+TIDY_EXPORT TidyNode TIDY_CALL     tidyGetNextFound( TidyDoc tdoc, TidyIterator* pos );
+
 /** @} end Tree group */
 
 
@@ -845,6 +986,25 @@ TIDY_EXPORT TidyTagId TIDY_CALL tidyNodeGetId( TidyNode tnod );
 TIDY_EXPORT uint TIDY_CALL tidyNodeLine( TidyNode tnod );
 TIDY_EXPORT uint TIDY_CALL tidyNodeColumn( TidyNode tnod );
 
+/* Byte offsets into the input of the markup or text the node was read
+** from, end exclusive.  Returns no for nodes tidy inferred or made up.
+** Offsets count raw input bytes, including any byte order mark.
+*/
+TIDY_EXPORT Bool TIDY_CALL tidyNodeGetSourceRange( TidyNode tnod, uint* start, uint* end );
+
+/* Keep the text of each token as it was read, for the next parse.  Only
+** in a library built with TIDY_STORE_ORIGINAL_TEXT; returns no otherwise.
+** Off by default, as the text read is kept until the document is freed.
+*/
+TIDY_EXPORT Bool TIDY_CALL tidySetStoreOriginalText( TidyDoc tdoc, Bool store );
+
+/* Copy the text the node's token was read from into the given TidyBuffer
+** as UTF-8: the whole of a start tag, say, with its attributes as they
+** were written.  Returns no if the text was not kept, and for nodes tidy
+** inferred or made up.
+*/
+TIDY_EXPORT Bool TIDY_CALL tidyNodeGetOriginalText( TidyDoc tdoc, TidyNode tnod, TidyBuffer* buf );
+
 /** @} End NodeAsk group */
 
 
@@ -859,6 +1019,11 @@ TIDY_EXPORT Bool TIDY_CALL tidyAttrIsEvent( TidyAttr tattr );
 
 TIDY_EXPORT TidyAttr TIDY_CALL tidyAttrGetById( TidyNode tnod, TidyAttrId attId );
 
+/* Byte offsets of the attribute's name through its value, as for
+** tidyNodeGetSourceRange().
+*/
+TIDY_EXPORT Bool TIDY_CALL tidyAttrGetSourceRange( TidyAttr tattr, uint* start, uint* end );
+
 /** @} end Attribute group */
 
     
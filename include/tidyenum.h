@@ -176,6 +176,16 @@ typedef enum
   TidySkipNested,          /**< Skip nested tags in script and style CDATA */
   TidyStrictTagsAttr,      /**< Ensure tags and attributes match output HTML version */
   TidyEscapeScripts,       /**< Escape items that look like closing tags in script tags */
+  TidyPrescanEncoding,     /**< Sniff the input encoding from the start of the document */
+  TidyParseHeadOnly,       /**< Stop parsing when the body starts */
+  TidyLintOnly,            /**< Only report diagnostics, never write output */
+  TidyPrintThreads,        /**< Number of threads to print the body with */
+  TidyMinify,              /**< Write HTML output in its shortest form */
+  TidyMaxInputBytes,       /**< Stop parsing after this many bytes of input */
+  TidyMaxNodes,            /**< Stop parsing after creating this many nodes */
+  TidyMaxAttributes,       /**< Stop parsing after creating this many attributes */
+  TidyMaxDepth,            /**< Stop parsing at this element nesting depth */
+  TidyMaxMessages,         /**< Stop parsing after this many messages */
   N_TIDY_OPTIONS           /**< Must be last */
 } TidyOptionId;
 
@@ -948,6 +958,7 @@ typedef enum
         FN(STRING_CONTENT_LOOKS)      /* `Document content looks like %s`. */                   \
         FN(STRING_DOCTYPE_GIVEN)      /* `Doctype given is \"%s\". */                           \
         FN(STRING_HTML_PROPRIETARY)   /* `HTML Proprietary`/ */                                 \
+        FN(STRING_LIMIT_EXCEEDED)     /* `%s limit of %lu exceeded, ...`. */                    \
         FN(STRING_MISSING_MALFORMED)  /* For `missing or malformed argument for option: %s`. */ \
         FN(STRING_NO_SYSID)           /* `No system identifier in emitted doctype`. */          \
         FN(STRING_UNKNOWN_OPTION)     /* For retrieving a string `unknown option: %s`. */
@@ -1193,17 +1204,25 @@ typedef enum
     tidyConsoleMessages_first = tidyMessagesMisc_last,
     
     TC_LABEL_COL,
+    TC_LABEL_COUNT,
+    TC_LABEL_DIR,
     TC_LABEL_FILE,
     TC_LABEL_LANG,
     TC_LABEL_LEVL,
     TC_LABEL_OPT,
+    TC_LABEL_SIZE,
     TC_MAIN_ERROR_LOAD_CONFIG,
+    TC_MAIN_ERROR_SERVE,
+    TC_MAIN_ERROR_SERVE_REQUEST,
+    TC_MAIN_ERROR_SERVE_SIZE,
     TC_OPT_ACCESS,
     TC_OPT_ASCII,
     TC_OPT_ASHTML,
     TC_OPT_ASXML,
     TC_OPT_BARE,
     TC_OPT_BIG5,
+    TC_OPT_CACHEDIR,
+    TC_OPT_CACHESIZE,
     TC_OPT_CLEAN,
     TC_OPT_CONFIG,
     TC_OPT_ERRORS,
@@ -1225,6 +1244,10 @@ typedef enum
     TC_OPT_OUTPUT,
     TC_OPT_QUIET,
     TC_OPT_RAW,
+    TC_OPT_SERVE,
+    TC_OPT_SERVEMAXSIZE,
+    TC_OPT_SERVESOCKET,
+    TC_OPT_SERVETHREADS,
     TC_OPT_SHIFTJIS,
     TC_OPT_SHOWCFG,
     TC_OPT_UPPER,
@@ -70,6 +70,13 @@ extern "C" {
 #define SUPPORT_LOCALIZATIONS 1
 #endif
     
+/* Enable/disable printing the body of large documents on several
+   threads. This needs POSIX threads, so it is off unless the build
+   turns it on. */
+#ifndef SUPPORT_PARALLEL_PRINT
+#define SUPPORT_PARALLEL_PRINT 0
+#endif
+
 /* Enable/disable support for console */
 #ifndef SUPPORT_CONSOLE_APP
 #define SUPPORT_CONSOLE_APP 1
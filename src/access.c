@@ -1014,42 +1014,33 @@ static void CheckObject( TidyDocImpl* doc, Node* node )
 
 
 /***************************************************************
-* CheckMissingStyleSheets
+* IsStyleSheetNode
 *
-* Ensures that stylesheets are used to control the presentation.
+* Tells whether node shows that stylesheets are used to control
+* the presentation. The document index records whether any
+* element does, see BuildAccessIndex.
 ***************************************************************/
 
-static Bool CheckMissingStyleSheets( TidyDocImpl* doc, Node* node )
+static Bool IsStyleSheetNode( Node* node )
 {
     AttVal* av;
-    Node* content;
-    Bool sspresent = no;
+    Bool sspresent = ( nodeIsLINK(node)  ||
+                       nodeIsSTYLE(node) ||
+                       nodeIsFONT(node)  ||
+                       nodeIsBASEFONT(node) );
 
-    for ( content = node->content;
-          !sspresent && content != NULL;
-          content = content->next )
+    for ( av = node->attributes;
+          !sspresent && av != NULL;
+          av = av->next )
     {
-        sspresent = ( nodeIsLINK(content)  ||
-                      nodeIsSTYLE(content) ||
-                      nodeIsFONT(content)  ||
-                      nodeIsBASEFONT(content) );
+        sspresent = ( attrIsSTYLE(av) || attrIsTEXT(av)  ||
+                      attrIsVLINK(av) || attrIsALINK(av) ||
+                      attrIsLINK(av) );
 
-        for ( av = content->attributes;
-              !sspresent && av != NULL;
-              av = av->next )
+        if ( !sspresent && attrIsREL(av) )
         {
-            sspresent = ( attrIsSTYLE(av) || attrIsTEXT(av)  ||
-                          attrIsVLINK(av) || attrIsALINK(av) ||
-                          attrIsLINK(av) );
-
-            if ( !sspresent && attrIsREL(av) )
-            {
-                sspresent = AttrValueIs(av, "stylesheet");
-            }
+            sspresent = AttrValueIs(av, "stylesheet");
         }
-
-        if ( ! sspresent )
-            sspresent = CheckMissingStyleSheets( doc, content );
     }
     return sspresent;
 }
@@ -2588,7 +2579,6 @@ static void CheckDeprecated( TidyDocImpl* doc, Node* node )
 
 static void CheckScriptKeyboardAccessible( TidyDocImpl* doc, Node* node )
 {
-    Node* content;
     int HasOnMouseDown = 0;
     int HasOnMouseUp = 0;
     int HasOnClick = 0;
@@ -2653,11 +2643,6 @@ static void CheckScriptKeyboardAccessible( TidyDocImpl* doc, Node* node )
 
         if ( HasOnMouseMove == 1 )
             TY_(ReportAccessError)( doc, node, SCRIPT_NOT_KEYBOARD_ACCESSIBLE_ON_MOUSE_MOVE);
-
-        /* Recursively check all child nodes.
-         */
-        for ( content = node->content; content != NULL; content = content->next )
-            CheckScriptKeyboardAccessible( doc, content );
     }
 }
 
@@ -2814,20 +2799,64 @@ static Bool urlMatch( ctmbstr url1, ctmbstr url2 )
   return ( TY_(tmbstrcmp)( url1, url2 ) == 0 );
 }
 
-static Bool FindLinkA( TidyDocImpl* doc, Node* node, ctmbstr url )
+static uint hrefHash( ctmbstr s )
 {
-  Bool found = no;
-  for ( node = node->content; !found && node; node = node->next )
-  {
-    if ( nodeIsA(node) )
+    uint hashval;
+
+    for (hashval = 0; *s != '\0'; s++)
+        hashval = *s + 31*hashval;
+
+    return hashval;
+}
+
+/* Index slot of url, or the empty slot where it belongs */
+static uint HrefSlot( ctmbstr* hrefs, uint size, ctmbstr url )
+{
+    uint mask = size - 1;
+    uint h = hrefHash( url ) & mask;
+
+    while ( hrefs[h] && !urlMatch(url, hrefs[h]) )
+        h = (h + 1) & mask;
+    return h;
+}
+
+static void AddHrefToIndex( TidyDocImpl* doc, ctmbstr url )
+{
+    TidyAccessImpl* access = &doc->access;
+    uint h;
+
+    /* keep the table at most half full */
+    if ( 2 * (access->hrefCount + 1) > access->hrefSize )
+    {
+        uint i, size = access->hrefSize ? 2 * access->hrefSize : 64;
+        ctmbstr* hrefs = (ctmbstr*) TidyDocAlloc( doc, size * sizeof(ctmbstr) );
+        TidyClearMemory( hrefs, size * sizeof(ctmbstr) );
+
+        for ( i = 0; i < access->hrefSize; ++i )
+        {
+            if ( access->hrefs[i] )
+                hrefs[ HrefSlot(hrefs, size, access->hrefs[i]) ] = access->hrefs[i];
+        }
+        TidyDocFree( doc, access->hrefs );
+        access->hrefs = hrefs;
+        access->hrefSize = size;
+    }
+
+    h = HrefSlot( access->hrefs, access->hrefSize, url );
+    if ( !access->hrefs[h] )
     {
-      AttVal* href = attrGetHREF( node );
-      found = ( hasValue(href) && urlMatch(url, href->value) );
+        access->hrefs[h] = url;
+        access->hrefCount++;
     }
-    else
-        found = FindLinkA( doc, node, url );
-  }
-  return found;
+}
+
+static Bool FindLinkA( TidyDocImpl* doc, ctmbstr url )
+{
+    TidyAccessImpl* access = &doc->access;
+
+    if ( !access->hrefCount )
+        return no;
+    return access->hrefs[ HrefSlot(access->hrefs, access->hrefSize, url) ] != NULL;
 }
 
 static void CheckMapLinks( TidyDocImpl* doc, Node* node )
@@ -2845,7 +2874,7 @@ static void CheckMapLinks( TidyDocImpl* doc, Node* node )
             /* Checks for 'HREF' attribute */                
             AttVal* href = attrGetHREF( child );
             if ( hasValue(href) &&
-                 !FindLinkA( doc, &doc->root, href->value ) )
+                 !FindLinkA( doc, href->value ) )
             {
                 TY_(ReportAccessError)( doc, node, IMG_MAP_CLIENT_MISSING_TEXT_LINKS );
             }
@@ -2857,13 +2886,12 @@ static void CheckMapLinks( TidyDocImpl* doc, Node* node )
 /****************************************************
 * CheckForStyleAttribute
 *
-* Checks all elements within the document to check 
-* for the use of 'STYLE' attribute.
+* Checks an element carrying a 'STYLE' attribute
+* for its use.
 ****************************************************/
 
 static void CheckForStyleAttribute( TidyDocImpl* doc, Node* node )
 {
-    Node* content;
     if (Level1_Enabled( doc ))
     {
         /* Must not contain 'STYLE' attribute */
@@ -2873,35 +2901,6 @@ static void CheckForStyleAttribute( TidyDocImpl* doc, Node* node )
             TY_(ReportAccessWarning)( doc, node, STYLESHEETS_REQUIRE_TESTING_STYLE_ATTR );
         }
     }
-
-    /* Recursively check all child nodes.
-    */
-    for ( content = node->content; content != NULL; content = content->next )
-        CheckForStyleAttribute( doc, content );
-}
-
-
-/*****************************************************
-* CheckForListElements
-*
-* Checks document for list elements (<ol>, <ul>, <li>)
-*****************************************************/
-
-static void CheckForListElements( TidyDocImpl* doc, Node* node )
-{
-    if ( nodeIsLI(node) )
-    {
-        doc->access.ListElements++;
-    }
-    else if ( nodeIsOL(node) || nodeIsUL(node) )
-    {
-        doc->access.OtherListElements++;
-    }
-
-    for ( node = node->content; node != NULL; node = node->next )
-    {
-        CheckForListElements( doc, node );
-    }
 }
 
 
@@ -2964,289 +2963,379 @@ static void CheckListUsage( TidyDocImpl* doc, Node* node )
 }
 
 /************************************************************
-* InitAccessibilityChecks
-*
-* Initializes the AccessibilityChecks variables as necessary
+* Rule tables
+*
+* The element checks are keyed on the tag of the element, the
+* attribute checks on the attributes an element carries.  An
+* element runs its checks in table order, so the rules for one
+* tag must be kept together.  Each rule names the lowest
+* priority level it is needed at; the tables are resolved
+* against the configured level once, before any node is seen.
 ************************************************************/
 
-static void InitAccessibilityChecks( TidyDocImpl* doc, int level123 )
+typedef void (AccessCheck)( TidyDocImpl* doc, Node* node );
+
+typedef struct _AccessTagRule
 {
-    TidyClearMemory( &doc->access, sizeof(doc->access) );
-    doc->access.PRIORITYCHK = level123;
+    TidyTagId    tag;
+    int          level;
+    AccessCheck* check;
+} AccessTagRule;
+
+typedef struct _AccessAttrCheck
+{
+    int          level;
+    AccessCheck* check;
+} AccessAttrCheck;
+
+typedef struct _AccessAttrRule
+{
+    TidyAttrId   attr;
+    uint         check;     /* index into attrChecks[] */
+} AccessAttrRule;
+
+/* Checks document for MetaData */
+static void CheckHeadMetaData( TidyDocImpl* doc, Node* node )
+{
+    if ( !CheckMetaData( doc, node, no ) )
+        MetaDataPresent( doc, node );
 }
 
-/************************************************************
-* CleanupAccessibilityChecks
-*
-* Cleans up the AccessibilityChecks variables as necessary
-************************************************************/
+static const AccessTagRule tagRules[] =
+{
+    { TidyTag_BODY,     3, CheckColorContrast },
+    { TidyTag_HEAD,     2, CheckHeadMetaData },
+    { TidyTag_A,        1, CheckAnchorAccess },
+
+    { TidyTag_IMG,      1, CheckFlicker },
+    { TidyTag_IMG,      1, CheckColorAvailable },
+    { TidyTag_IMG,      1, CheckImage },
+
+    { TidyTag_MAP,      3, CheckMapLinks },
+    { TidyTag_AREA,     1, CheckArea },
+
+    { TidyTag_APPLET,   2, CheckDeprecated },
+    { TidyTag_APPLET,   1, ProgrammaticObjects },
+    { TidyTag_APPLET,   1, DynamicContent },
+    { TidyTag_APPLET,   1, AccessibleCompatible },
+    { TidyTag_APPLET,   1, CheckFlicker },
+    { TidyTag_APPLET,   1, CheckColorAvailable },
+    { TidyTag_APPLET,   1, CheckApplet },
+
+    { TidyTag_OBJECT,   1, ProgrammaticObjects },
+    { TidyTag_OBJECT,   1, DynamicContent },
+    { TidyTag_OBJECT,   1, AccessibleCompatible },
+    { TidyTag_OBJECT,   1, CheckFlicker },
+    { TidyTag_OBJECT,   1, CheckColorAvailable },
+    { TidyTag_OBJECT,   1, CheckObject },
+
+    { TidyTag_FRAME,    1, CheckFrame },
+    { TidyTag_IFRAME,   1, CheckIFrame },
 
+    { TidyTag_SCRIPT,   1, DynamicContent },
+    { TidyTag_SCRIPT,   1, ProgrammaticObjects },
+    { TidyTag_SCRIPT,   1, AccessibleCompatible },
+    { TidyTag_SCRIPT,   1, CheckFlicker },
+    { TidyTag_SCRIPT,   1, CheckColorAvailable },
+    { TidyTag_SCRIPT,   1, CheckScriptAcc },
 
-static void FreeAccessibilityChecks( TidyDocImpl* ARG_UNUSED(doc) )
+    { TidyTag_TABLE,    3, CheckColorContrast },
+    { TidyTag_TABLE,    1, CheckTable },
+
+    /* ASCII art */
+    { TidyTag_PRE,      1, CheckASCII },
+    { TidyTag_XMP,      1, CheckASCII },
+
+    { TidyTag_LABEL,    2, CheckLabel },
+
+    { TidyTag_INPUT,    1, CheckColorAvailable },
+    { TidyTag_INPUT,    2, CheckInputLabel },
+    { TidyTag_INPUT,    1, CheckInputAttributes },
+
+    { TidyTag_FRAMESET, 1, CheckFrameSet },
+
+    /* valid header increase */
+    { TidyTag_H1,       2, CheckHeaderNesting },
+    { TidyTag_H2,       2, CheckHeaderNesting },
+    { TidyTag_H3,       2, CheckHeaderNesting },
+    { TidyTag_H4,       2, CheckHeaderNesting },
+    { TidyTag_H5,       2, CheckHeaderNesting },
+    { TidyTag_H6,       2, CheckHeaderNesting },
+
+    { TidyTag_P,        2, CheckParagraphHeader },
+    { TidyTag_HTML,     3, CheckHTMLAccess },
+    { TidyTag_BLINK,    2, CheckBlink },
+    { TidyTag_MARQUEE,  2, CheckMarquee },
+    { TidyTag_LINK,     1, CheckLink },
+
+    { TidyTag_STYLE,    3, CheckColorContrast },
+    { TidyTag_STYLE,    1, CheckStyle },
+
+    { TidyTag_EMBED,    1, CheckEmbed },
+    { TidyTag_EMBED,    1, ProgrammaticObjects },
+    { TidyTag_EMBED,    1, AccessibleCompatible },
+    { TidyTag_EMBED,    1, CheckFlicker },
+
+    /* Deprecated HTML */
+    { TidyTag_BASEFONT, 2, CheckDeprecated },
+    { TidyTag_CENTER,   2, CheckDeprecated },
+    { TidyTag_ISINDEX,  2, CheckDeprecated },
+    { TidyTag_U,        2, CheckDeprecated },
+    { TidyTag_FONT,     2, CheckDeprecated },
+    { TidyTag_DIR,      2, CheckDeprecated },
+    { TidyTag_S,        2, CheckDeprecated },
+    { TidyTag_STRIKE,   2, CheckDeprecated },
+    { TidyTag_MENU,     2, CheckDeprecated },
+
+    { TidyTag_TH,       3, CheckTH },
+
+    /* lists are properly used */
+    { TidyTag_LI,       2, CheckListUsage },
+    { TidyTag_OL,       2, CheckListUsage },
+    { TidyTag_UL,       2, CheckListUsage },
+};
+
+#define N_ACCESS_TAG_RULES (sizeof(tagRules)/sizeof(tagRules[0]))
+
+/* Run over all elements collected for them, in this order */
+static const AccessAttrCheck attrChecks[ N_ACCESS_ATTR_CHECKS ] =
 {
-    /* free any memory allocated for the lists
+    { 2, CheckScriptKeyboardAccessible },
+    { 1, CheckForStyleAttribute },
+};
 
-    Linked List of Links not used.  Just search document as 
-    AREA tags are encountered.  Same algorithm, but no
-    data structures necessary.
+static const AccessAttrRule attrRules[] =
+{
+    { TidyAttr_OnMOUSEDOWN, 0 },
+    { TidyAttr_OnMOUSEUP,   0 },
+    { TidyAttr_OnCLICK,     0 },
+    { TidyAttr_OnMOUSEOUT,  0 },
+    { TidyAttr_OnMOUSEOVER, 0 },
+    { TidyAttr_OnMOUSEMOVE, 0 },
+    { TidyAttr_OnKEYDOWN,   0 },
+    { TidyAttr_OnKEYUP,     0 },
+    { TidyAttr_OnKEYPRESS,  0 },
+    { TidyAttr_OnBLUR,      0 },
+    { TidyAttr_STYLE,       1 },
+};
 
-    current = start;
-    while (current)
-    {
-        void    *templink = (void *)current;
-        
-        current = current->next;
-        TidyDocFree(doc, templink);
-    }
-    start = NULL;
-    */
-}
+#define N_ACCESS_ATTR_RULES (sizeof(attrRules)/sizeof(attrRules[0]))
 
-/************************************************************
-* AccessibilityChecks
-*
-* Traverses through the individual nodes of the tree
-* and checks attributes and elements for accessibility.
-* after the tree structure has been formed.
-************************************************************/
+/* The rules enabled at the configured level */
+typedef struct _AccessRules
+{
+    AccessCheck* checks[ N_ACCESS_TAG_RULES ];
+    uint         first[ N_TIDY_TAGS ];
+    uint         count[ N_TIDY_TAGS ];
+    uint         attrCheck[ N_TIDY_ATTRIBS ];  /* attrChecks[] index + 1 */
+} AccessRules;
 
-static void AccessibilityCheckNode( TidyDocImpl* doc, Node* node )
+static Bool LevelEnabled( TidyDocImpl* doc, int level )
 {
-    Node* content;
-    
-    /* Check BODY for color contrast */
-    if ( nodeIsBODY(node) )
+    switch ( level )
     {
-        CheckColorContrast( doc, node );
+    case 1:  return Level1_Enabled( doc );
+    case 2:  return Level2_Enabled( doc );
+    case 3:  return Level3_Enabled( doc );
+    default: return no;
     }
+}
 
-    /* Checks document for MetaData */
-    else if ( nodeIsHEAD(node) )
-    {
-        if ( !CheckMetaData( doc, node, no ) )
-          MetaDataPresent( doc, node );
-    }
-    
-    /* Check the ANCHOR tag */
-    else if ( nodeIsA(node) )
-    {
-        CheckAnchorAccess( doc, node );
-    }
+static void ResolveAccessRules( TidyDocImpl* doc, AccessRules* rules )
+{
+    uint i, n = 0;
 
-    /* Check the IMAGE tag */
-    else if ( nodeIsIMG(node) )
-    {
-        CheckFlicker( doc, node );
-        CheckColorAvailable( doc, node );
-        CheckImage( doc, node );
-    }
+    TidyClearMemory( rules, sizeof(*rules) );
 
-        /* Checks MAP for client-side text links */
-    else if ( nodeIsMAP(node) )
+    for ( i = 0; i < N_ACCESS_TAG_RULES; ++i )
     {
-        CheckMapLinks( doc, node );
-    }
+        const AccessTagRule* rule = &tagRules[i];
+        if ( !LevelEnabled(doc, rule->level) )
+            continue;
 
-    /* Check the AREA tag */
-    else if ( nodeIsAREA(node) )
-    {
-        CheckArea( doc, node );
+        if ( rules->count[rule->tag] == 0 )
+            rules->first[rule->tag] = n;
+        assert( rules->first[rule->tag] + rules->count[rule->tag] == n );
+        rules->count[rule->tag]++;
+        rules->checks[n++] = rule->check;
     }
 
-    /* Check the APPLET tag */
-    else if ( nodeIsAPPLET(node) )
-    {
-        CheckDeprecated( doc, node );
-        ProgrammaticObjects( doc, node );
-        DynamicContent( doc, node );
-        AccessibleCompatible( doc, node );
-        CheckFlicker( doc, node );
-        CheckColorAvailable( doc, node );
-        CheckApplet(doc, node );
-    }
-    
-    /* Check the OBJECT tag */
-    else if ( nodeIsOBJECT(node) )
-    {
-        ProgrammaticObjects( doc, node );
-        DynamicContent( doc, node );
-        AccessibleCompatible( doc, node );
-        CheckFlicker( doc, node );
-        CheckColorAvailable( doc, node );
-        CheckObject( doc, node );
-    }
-    
-    /* Check the FRAME tag */
-    else if ( nodeIsFRAME(node) )
-    {
-        CheckFrame( doc, node );
-    }
-    
-    /* Check the IFRAME tag */
-    else if ( nodeIsIFRAME(node) )
+    for ( i = 0; i < N_ACCESS_ATTR_RULES; ++i )
     {
-        CheckIFrame( doc, node );
-    }
-    
-    /* Check the SCRIPT tag */
-    else if ( nodeIsSCRIPT(node) )
-    {
-        DynamicContent( doc, node );
-        ProgrammaticObjects( doc, node );
-        AccessibleCompatible( doc, node );
-        CheckFlicker( doc, node );
-        CheckColorAvailable( doc, node );
-        CheckScriptAcc( doc, node );
+        const AccessAttrRule* rule = &attrRules[i];
+        if ( LevelEnabled(doc, attrChecks[rule->check].level) )
+            rules->attrCheck[rule->attr] = rule->check + 1;
     }
+}
 
-    /* Check the TABLE tag */
-    else if ( nodeIsTABLE(node) )
-    {
-        CheckColorContrast( doc, node );
-        CheckTable( doc, node );
-    }
 
-    /* Check the PRE for ASCII art */
-    else if ( nodeIsPRE(node) || nodeIsXMP(node) )
-    {
-        CheckASCII( doc, node );
-    }
+/*****************************************************
+* BuildAccessIndex
+*
+* Collects, in a single pass over the document, what the
+* checks need to know about the document as a whole:
+* the HREF values of A elements, the number of list
+* elements (<ol>, <ul>, <li>), whether stylesheets are
+* used and the elements the attribute checks apply to.
+*****************************************************/
 
-    /* Check the LABEL tag */
-    else if ( nodeIsLABEL(node) )
+static void AddNodeToList( TidyDocImpl* doc, AccessNodeList* list, Node* node )
+{
+    if ( list->count == list->size )
     {
-        CheckLabel( doc, node );
+        list->size = list->size ? 2 * list->size : 16;
+        list->nodes = (Node**) TidyDocRealloc( doc, list->nodes,
+                                               list->size * sizeof(Node*) );
     }
+    list->nodes[ list->count++ ] = node;
+}
 
-    /* Check INPUT tag for validity */
-    else if ( nodeIsINPUT(node) )
+static void BuildAccessIndex( TidyDocImpl* doc, const AccessRules* rules,
+                              Node* node )
+{
+    Node* content;
+    AttVal* av;
+    uint i, found = 0;
+
+    if ( nodeIsA(node) && Level3_Enabled(doc) )
     {
-        CheckColorAvailable( doc, node );
-        CheckInputLabel( doc, node );
-        CheckInputAttributes( doc, node );
+        AttVal* href = attrGetHREF( node );
+        if ( hasValue(href) )
+            AddHrefToIndex( doc, href->value );
     }
 
-    /* Checks FRAMESET element for NOFRAME section */
-    else if ( nodeIsFRAMESET(node) )
+    if ( nodeIsLI(node) )
     {
-        CheckFrameSet( doc, node );
+        doc->access.ListElements++;
     }
-    
-    /* Checks for header elements for valid header increase */
-    else if ( TY_(nodeIsHeader)(node) )
+    else if ( nodeIsOL(node) || nodeIsUL(node) )
     {
-        CheckHeaderNesting( doc, node );
+        doc->access.OtherListElements++;
     }
 
-    /* Checks P element to ensure that it is not a header */
-    else if ( nodeIsP(node) )
-    {
-        CheckParagraphHeader( doc, node );
-    }
+    /* the root itself does not count */
+    if ( Level2_Enabled(doc) && !doc->access.HasStyleSheets &&
+         node != &doc->root )
+        doc->access.HasStyleSheets = IsStyleSheetNode( node );
 
-    /* Checks HTML elemnt for valid 'LANG' */
-    else if ( nodeIsHTML(node) )
+    /* an element is listed once per check, whatever its attributes */
+    for ( av = node->attributes; av != NULL; av = av->next )
     {
-        CheckHTMLAccess( doc, node );
+        uint check = rules->attrCheck[ AttrId(av) ];
+        if ( check )
+            found |= 1u << (check - 1);
     }
-
-    /* Checks BLINK for any blinking text */
-    else if ( nodeIsBLINK(node) )
+    for ( i = 0; found != 0; ++i, found >>= 1 )
     {
-        CheckBlink( doc, node );
+        if ( found & 1u )
+            AddNodeToList( doc, &doc->access.attrNodes[i], node );
     }
 
-    /* Checks MARQUEE for any MARQUEE text */
-    else if ( nodeIsMARQUEE(node) )
+    for ( content = node->content; content != NULL; content = content->next )
     {
-        CheckMarquee( doc, node );
+        BuildAccessIndex( doc, rules, content );
     }
+}
 
-    /* Checks LINK for 'REL' attribute */
-    else if ( nodeIsLINK(node) )
-    {
-        CheckLink( doc, node );
-    }
+/************************************************************
+* InitAccessibilityChecks
+*
+* Initializes the AccessibilityChecks variables as necessary
+************************************************************/
 
-    /* Checks to see if STYLE is used */
-    else if ( nodeIsSTYLE(node) )
-    {
-        CheckColorContrast( doc, node );
-        CheckStyle( doc, node );
-    }
+static void InitAccessibilityChecks( TidyDocImpl* doc, int level123 )
+{
+    TidyClearMemory( &doc->access, sizeof(doc->access) );
+    doc->access.PRIORITYCHK = level123;
+}
 
-    /* Checks to see if EMBED is used */
-    else if ( nodeIsEMBED(node) )
-    {
-        CheckEmbed( doc, node );
-        ProgrammaticObjects( doc, node );
-        AccessibleCompatible( doc, node );
-        CheckFlicker( doc, node );
-    }
+/************************************************************
+* CleanupAccessibilityChecks
+*
+* Cleans up the AccessibilityChecks variables as necessary
+************************************************************/
 
-    /* Deprecated HTML if the following tags are found in the document */
-    else if ( nodeIsBASEFONT(node) ||
-              nodeIsCENTER(node)   ||
-              nodeIsISINDEX(node)  ||
-              nodeIsU(node)        ||
-              nodeIsFONT(node)     ||
-              nodeIsDIR(node)      ||
-              nodeIsS(node)        ||
-              nodeIsSTRIKE(node)   ||
-              nodeIsMENU(node) )
-    {
-        CheckDeprecated( doc, node );
-    }
 
-    /* Checks for 'ABBR' attribute if needed */
-    else if ( nodeIsTH(node) )
-    {
-        CheckTH( doc, node );
-    }
+static void FreeAccessibilityChecks( TidyDocImpl* doc )
+{
+    /* free the document index */
+    uint i;
+
+    TidyDocFree( doc, doc->access.hrefs );
+    doc->access.hrefs = NULL;
+    doc->access.hrefCount = doc->access.hrefSize = 0;
 
-    /* Ensures that lists are properly used */
-    else if ( nodeIsLI(node) || nodeIsOL(node) || nodeIsUL(node) )
+    for ( i = 0; i < N_ACCESS_ATTR_CHECKS; ++i )
     {
-        CheckListUsage( doc, node );
+        AccessNodeList* list = &doc->access.attrNodes[i];
+        TidyDocFree( doc, list->nodes );
+        list->nodes = NULL;
+        list->count = list->size = 0;
     }
+}
+
+/************************************************************
+* AccessibilityChecks
+*
+* Traverses through the individual nodes of the tree
+* and checks attributes and elements for accessibility.
+* after the tree structure has been formed.
+************************************************************/
+
+static void AccessibilityCheckNode( TidyDocImpl* doc, const AccessRules* rules,
+                                    Node* node )
+{
+    Node* content;
+    TidyTagId tid = TagId( node );
+    uint i, last = rules->first[tid] + rules->count[tid];
+
+    for ( i = rules->first[tid]; i < last; ++i )
+        rules->checks[i]( doc, node );
 
     /* Recursively check all child nodes.
     */
     for ( content = node->content; content != NULL; content = content->next )
     {
-        AccessibilityCheckNode( doc, content );
+        AccessibilityCheckNode( doc, rules, content );
     }
 }
 
 
 void TY_(AccessibilityChecks)( TidyDocImpl* doc )
 {
+    AccessRules rules;
+    uint i, j;
+
     /* Initialize */
     InitAccessibilityChecks( doc, cfg(doc, TidyAccessibilityCheckLevel) );
+    ResolveAccessRules( doc, &rules );
 
     /* Hello there, ladies and gentlemen... */
     TY_(AccessibilityHelloMessage)( doc );
 
-    /* Checks all elements for script accessibility */
-    CheckScriptKeyboardAccessible( doc, &doc->root );
+    /* Indexes links, lists, stylesheets and attributes of the document */
+    BuildAccessIndex( doc, &rules, &doc->root );
 
-    /* Checks entire document for the use of 'STYLE' attribute */
-    CheckForStyleAttribute( doc, &doc->root );
+    /* Checks all elements for script accessibility and for the
+    ** use of 'STYLE' attribute
+    */
+    for ( i = 0; i < N_ACCESS_ATTR_CHECKS; ++i )
+    {
+        const AccessNodeList* list = &doc->access.attrNodes[i];
+        for ( j = 0; j < list->count; ++j )
+            attrChecks[i].check( doc, list->nodes[j] );
+    }
 
     /* Checks for '!DOCTYPE' */
     CheckDocType( doc );
 
     
     /* Checks to see if stylesheets are used to control the layout */
-    if ( Level2_Enabled( doc )
-         && ! CheckMissingStyleSheets( doc, &doc->root ) )
+    if ( Level2_Enabled( doc ) && !doc->access.HasStyleSheets )
     {
         TY_(ReportAccessWarning)( doc, &doc->root, STYLE_SHEET_CONTROL_PRESENTATION );
     }
 
-    /* Check to see if any list elements are found within the document */
-    CheckForListElements( doc, &doc->root );
-
     /* Checks for natural language change */
     /* Must contain more than 3 words of text in the document
     **
@@ -3265,7 +3354,7 @@ void TY_(AccessibilityChecks)( TidyDocImpl* doc )
     /* Recursively apply all remaining checks to 
     ** each node in document.
     */
-    AccessibilityCheckNode( doc, &doc->root );
+    AccessibilityCheckNode( doc, &rules, &doc->root );
 
     /* Cleanup */
     FreeAccessibilityChecks( doc );
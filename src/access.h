@@ -47,6 +47,16 @@ enum {
 struct _TidyAccessImpl;
 typedef struct _TidyAccessImpl TidyAccessImpl;
 
+/* Elements collected for one of the attribute-triggered checks */
+#define N_ACCESS_ATTR_CHECKS 2
+
+typedef struct _AccessNodeList
+{
+    Node** nodes;
+    uint   count;
+    uint   size;    /* allocated */
+} AccessNodeList;
+
 struct _TidyAccessImpl
 {
     /* gets set from Tidy variable AccessibilityCheckLevel */
@@ -88,6 +98,14 @@ struct _TidyAccessImpl
     Bool HasInvalidColumnHeader;
     int  ForID;
 
+    /* Index of the document, built in one pass before the checks run */
+    ctmbstr* hrefs;           /* open hash of the HREF values of A elements */
+    uint     hrefCount;
+    uint     hrefSize;        /* allocated, always a power of 2 */
+    Bool     HasStyleSheets;  /* style sheets control the presentation */
+
+    /* Elements carrying the attributes of each attribute-triggered check */
+    AccessNodeList attrNodes[ N_ACCESS_ATTR_CHECKS ];
 };
 
 
@@ -1015,14 +1015,6 @@ Bool TY_(IsCSS1Selector)( ctmbstr buf )
     return valid;
 }
 
-/* free single anchor */
-static void FreeAnchor(TidyDocImpl* doc, Anchor *a)
-{
-    if ( a )
-        TidyDocFree( doc, a->name );
-    TidyDocFree( doc, a );
-}
-
 static uint anchorNameHash(ctmbstr s)
 {
     uint hashval = 0;
@@ -1034,146 +1026,214 @@ static uint anchorNameHash(ctmbstr s)
             hashval = c + 31*hashval;
         }
     }
-    return hashval % ANCHOR_HASH_SIZE;
+    return hashval;
 }
 
 /*\
- *  New Service for HTML5
  *  Issue #185 - Treat elements ids as case-sensitive
- *  if in HTML5 modes, make hash of value AS IS!
+ *  if in HTML5 modes, compare the value AS IS!
+ *  The hash ignores case in all modes, so that entries
+ *  are found whichever mode they were added in.  Anchors
+ *  used to be stored lower cased, so in HTML5 modes only
+ *  names without upper case letters ever matched.
 \*/
-static uint anchorNameHash5(ctmbstr s)
+static Bool anchorNameMatch( ctmbstr a, ctmbstr b, Bool caseSensitive )
 {
-    uint hashval = 0;
-    /* Issue #149 - an inferred name can be null. avoid crash */
-    if (s) 
+    if ( a == NULL || b == NULL )
+        return a == b;
+    if ( !caseSensitive )
+        return TY_(tmbstrcasecmp)( a, b ) == 0;
+
+    for ( ; *a == *b; a++, b++ )
     {
-        for ( ; *s != '\0'; s++) {
-            tmbchar c = *s;
-            hashval = c + 31*hashval;
-        }
+        if ( *a == '\0' )
+            return yes;
+        if ( (uint)TY_(ToLower)( *a ) != (uint)*a )
+            break;
     }
-    return hashval % ANCHOR_HASH_SIZE;
+    return no;
 }
 
+/* empty slot i, moving up entries that probed past it */
+static void anchorDeleteSlot( TidyAttribImpl* attribs, uint i )
+{
+    Anchor* anchors = attribs->anchor_hash;
+    uint mask = attribs->anchor_size - 1;
+    uint j = i;
+
+    for (;;)
+    {
+        uint k;
+        j = (j + 1) & mask;
+        if ( anchors[j].node == NULL )
+            break;
+
+        /* k is where the entry at j would like to be; it may fill i
+        ** unless k lies cyclically within (i, j]
+        */
+        k = anchors[j].hash & mask;
+        if ( i <= j ? (k <= i || k > j) : (k <= i && k > j) )
+        {
+            anchors[i] = anchors[j];
+            i = j;
+        }
+    }
+    anchors[i].node = NULL;
+    anchors[i].name = NULL;
+    attribs->anchor_count--;
+}
 
 /*\ 
  *  removes anchor for specific node 
- *  Issue #185 - Treat elements ids as case-sensitive
- *  if in HTML5 modes, make hash of value AS IS!
 \*/
 void TY_(RemoveAnchorByNode)( TidyDocImpl* doc, ctmbstr name, Node *node )
 {
     TidyAttribImpl* attribs = &doc->attribs;
-    Anchor *delme = NULL, *curr, *prev = NULL;
-    uint h;
-    if (TY_(HTMLVersion)(doc) == HT50)
-        h = anchorNameHash5(name);
-    else
-        h = anchorNameHash(name);
+    uint mask = attribs->anchor_size - 1;
+    uint h, i;
+
+    if ( attribs->anchor_count == 0 )
+        return;
 
-    for ( curr=attribs->anchor_hash[h]; curr!=NULL; curr=curr->next )
+    h = anchorNameHash(name);
+    for ( i = h & mask; attribs->anchor_hash[i].node != NULL; i = (i + 1) & mask )
     {
-        if ( curr->node == node )
+        Anchor *a = &attribs->anchor_hash[i];
+        if ( a->node == node && a->hash == h )
         {
-            if ( prev )
-                prev->next = curr->next;
-            else
-                attribs->anchor_hash[h] = curr->next;
-            delme = curr;
+            TidyDocFree( doc, a->name );
+            anchorDeleteSlot( attribs, i );
             break;
         }
-        prev = curr;
     }
-    FreeAnchor( doc, delme );
 }
 
-/* initialize new anchor */
-static Anchor* NewAnchor( TidyDocImpl* doc, ctmbstr name, Node* node )
+/*\
+ *  keeps the anchors of a tree that is about to be freed, so that
+ *  later duplicates are still reported, see ParseBody()
+\*/
+void TY_(RetireAnchors)( TidyDocImpl* doc, Node *node )
 {
-    Anchor *a = (Anchor*) TidyDocAlloc( doc, sizeof(Anchor) );
+    TidyAttribImpl* attribs = &doc->attribs;
+    uint mask = attribs->anchor_size - 1;
+    AttVal* av;
+    Node* child;
+    uint h, i;
 
-    a->name = TY_(tmbstrdup)( doc->allocator, name );
-    a->name = TY_(tmbstrtolower)(a->name);
-    a->node = node;
-    a->next = NULL;
+    if ( attribs->anchor_count == 0 )
+        return;
+
+    for ( av = node->attributes; av; av = av->next )
+    {
+        if ( !(attrIsID(av) || attrIsNAME(av)) || !AttrHasValue(av) )
+            continue;
+
+        h = anchorNameHash(av->value);
+        for ( i = h & mask; attribs->anchor_hash[i].node != NULL; i = (i + 1) & mask )
+        {
+            Anchor *a = &attribs->anchor_hash[i];
+            if ( a->node == node && a->hash == h )
+                a->node = &doc->root;
+        }
+    }
 
-    return a;
+    for ( child = node->content; child; child = child->next )
+        TY_(RetireAnchors)( doc, child );
+}
+
+/* first empty slot for an entry with hash h */
+static uint anchorFreeSlot( Anchor* anchors, uint size, uint h )
+{
+    uint mask = size - 1;
+    uint i = h & mask;
+
+    while ( anchors[i].node != NULL )
+        i = (i + 1) & mask;
+    return i;
 }
 
 /*\
  *  add new anchor to namespace 
- *  Issue #185 - Treat elements ids as case-sensitive
- *  if in HTML5 modes, make hash of value AS IS!
 \*/
-static Anchor* AddAnchor( TidyDocImpl* doc, ctmbstr name, Node *node )
+static void AddAnchor( TidyDocImpl* doc, ctmbstr name, Node *node )
 {
     TidyAttribImpl* attribs = &doc->attribs;
-    Anchor *a = NewAnchor( doc, name, node );
+    Anchor *a;
     uint h;
-    if (TY_(HTMLVersion)(doc) == HT50)
-        h = anchorNameHash5(name);
-    else
-        h = anchorNameHash(name);
 
-    if ( attribs->anchor_hash[h] == NULL)
-         attribs->anchor_hash[h] = a;
-    else
+    /* keep the table at most half full */
+    if ( 2 * (attribs->anchor_count + 1) > attribs->anchor_size )
     {
-        Anchor *here =  attribs->anchor_hash[h];
-        while (here->next)
-            here = here->next;
-        here->next = a;
+        uint i, size = attribs->anchor_size ? 2 * attribs->anchor_size
+                                            : ANCHOR_HASH_SIZE;
+        Anchor* anchors = (Anchor*) TidyDocAlloc( doc, size * sizeof(Anchor) );
+        TidyClearMemory( anchors, size * sizeof(Anchor) );
+
+        for ( i = 0; i < attribs->anchor_size; ++i )
+        {
+            Anchor *old = &attribs->anchor_hash[i];
+            if ( old->node != NULL )
+                anchors[ anchorFreeSlot(anchors, size, old->hash) ] = *old;
+        }
+        TidyDocFree( doc, attribs->anchor_hash );
+        attribs->anchor_hash = anchors;
+        attribs->anchor_size = size;
     }
 
-    return attribs->anchor_hash[h];
+    h = anchorNameHash(name);
+    a = &attribs->anchor_hash[ anchorFreeSlot(attribs->anchor_hash,
+                                              attribs->anchor_size, h) ];
+    a->node = node;
+    a->name = TY_(tmbstrdup)( doc->allocator, name );
+    a->hash = h;
+    attribs->anchor_count++;
 }
 
 /*\
  *  return node associated with anchor 
- *  Issue #185 - Treat elements ids as case-sensitive
- *  if in HTML5 modes, make hash of value AS IS!
 \*/
 static Node* GetNodeByAnchor( TidyDocImpl* doc, ctmbstr name )
 {
     TidyAttribImpl* attribs = &doc->attribs;
-    Anchor *found;
-    uint h;
-    tmbstr lname = TY_(tmbstrdup)(doc->allocator, name);
-    if (TY_(HTMLVersion)(doc) == HT50) {
-        h = anchorNameHash5(name);
-    }
-    else
-    {
-        h = anchorNameHash(name);
-        lname = TY_(tmbstrtolower)(lname);
-    }
+    uint mask = attribs->anchor_size - 1;
+    Bool caseSensitive;
+    uint h, i;
 
-    for ( found = attribs->anchor_hash[h]; found != NULL; found = found->next )
+    if ( attribs->anchor_count == 0 )
+        return NULL;
+
+    caseSensitive = ( TY_(HTMLVersion)(doc) == HT50 );
+    h = anchorNameHash(name);
+    for ( i = h & mask; attribs->anchor_hash[i].node != NULL; i = (i + 1) & mask )
     {
-        if ( TY_(tmbstrcmp)(found->name, lname) == 0 )
-            break;
+        Anchor *a = &attribs->anchor_hash[i];
+        if ( a->hash == h && anchorNameMatch(a->name, name, caseSensitive) )
+            return a->node;
     }
-    
-    TidyDocFree(doc, lname);
-    if ( found )
-        return found->node;
     return NULL;
 }
 
+/* remove all anchors, keeping the table */
+void TY_(ClearAnchors)( TidyDocImpl* doc )
+{
+    TidyAttribImpl* attribs = &doc->attribs;
+    uint i;
+    if ( attribs->anchor_count == 0 )
+        return;
+    for (i = 0; i < attribs->anchor_size; i++)
+        TidyDocFree( doc, attribs->anchor_hash[i].name );
+    TidyClearMemory( attribs->anchor_hash, attribs->anchor_size * sizeof(Anchor) );
+    attribs->anchor_count = 0;
+}
+
 /* free all anchors */
 void TY_(FreeAnchors)( TidyDocImpl* doc )
 {
     TidyAttribImpl* attribs = &doc->attribs;
-    Anchor* a;
-    uint h;
-    for (h = 0; h < ANCHOR_HASH_SIZE; h++) {
-        while (NULL != (a = attribs->anchor_hash[h]) )
-        {
-            attribs->anchor_hash[h] = a->next;
-            FreeAnchor(doc, a);
-        }
-    }
+    TY_(ClearAnchors)( doc );
+    TidyDocFree( doc, attribs->anchor_hash );
+    attribs->anchor_hash = NULL;
+    attribs->anchor_count = attribs->anchor_size = 0;
 }
 
 /* public method for inititializing attribute dictionary */
@@ -1383,7 +1443,8 @@ const Attribute* TY_(CheckAttribute)( TidyDocImpl* doc, Node *node, AttVal *attv
         if (attrIsXML_LANG(attval) || attrIsXML_SPACE(attval))
         {
             doc->lexer->isvoyager = yes;
-            if (!cfgBool(doc, TidyHtmlOut))
+            /* streamed output has already started as HTML */
+            if (!cfgBool(doc, TidyHtmlOut) && !doc->streaming)
             {
                 TY_(SetOptionBool)(doc, TidyXhtmlOut, yes);
                 TY_(SetOptionBool)(doc, TidyXmlOut, yes);
@@ -24,14 +24,14 @@ struct _Attribute
 
 
 /*
- Anchor/Node linked list
+ Anchor/Node hash table entry
 */
 
 struct _Anchor
 {
-    struct _Anchor *next;
-    Node *node;
+    Node *node;         /* NULL for an empty slot */
     char *name;
+    uint hash;          /* of name, ignoring case */
 };
 
 typedef struct _Anchor Anchor;
@@ -57,13 +57,15 @@ typedef struct _AttrHash AttrHash;
 
 enum
 {
-    ANCHOR_HASH_SIZE=1021u
+    ANCHOR_HASH_SIZE=64u    /* initial size */
 };
 
 struct _TidyAttribImpl
 {
-    /* anchor/node lookup */
-    Anchor*    anchor_hash[ANCHOR_HASH_SIZE];
+    /* anchor/node lookup, open addressing with linear probing */
+    Anchor*    anchor_hash;
+    uint       anchor_count;
+    uint       anchor_size;     /* allocated, always a power of 2 */
 
     /* Declared literal attributes */
     Attribute* declared_attr_list;
@@ -124,6 +126,12 @@ Bool TY_(IsValidXMLID)(ctmbstr id);
 /* removes anchor for specific node */
 void TY_(RemoveAnchorByNode)( TidyDocImpl* doc, ctmbstr name, Node *node );
 
+/* point the anchors of a tree at the root before it is freed */
+void TY_(RetireAnchors)( TidyDocImpl* doc, Node *node );
+
+/* remove all anchors, keeping the table */
+void TY_(ClearAnchors)( TidyDocImpl* doc );
+
 /* free all anchors */
 void TY_(FreeAnchors)( TidyDocImpl* doc );
 
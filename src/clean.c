@@ -57,7 +57,7 @@ static Node* CleanNode( TidyDocImpl* doc, Node *node );
 
 static void RenameElem( TidyDocImpl* doc, Node* node, TidyTagId tid )
 {
-    const Dict* dict = TY_(LookupTagDef)( tid );
+    const Dict* dict = TY_(LookupTagDef)( doc, tid );
     TidyDocFree( doc, node->element );
     node->element = TY_(tmbstrdup)( doc->allocator, dict->name );
     node->tag = dict;
@@ -987,7 +987,7 @@ static Bool Dir2Div( TidyDocImpl* doc, Node *node, Node **ARG_UNUSED(pnode))
             return no;
 
         /* coerce dir to div */
-        node->tag = TY_(LookupTagDef)( TidyTag_DIV );
+        node->tag = TY_(LookupTagDef)( doc, TidyTag_DIV );
         TidyDocFree( doc, node->element );
         node->element = TY_(tmbstrdup)(doc->allocator, "div");
         TY_(AddStyleProperty)( doc, node, "margin-left: 2em" );
@@ -1496,7 +1496,9 @@ static Node* CleanTree( TidyDocImpl* doc, Node *node )
     if (node->content)
     {
         Node *child;
-        for (child = node->content; child != NULL; child = child->next)
+        for (child = node->content;
+             child != NULL && !TidyCancelled(doc, CANCEL_NODE_TICKS);
+             child = child->next)
         {
             child = CleanTree( doc, child );
             if ( !child )
@@ -1537,6 +1539,19 @@ void TY_(CleanDocument)( TidyDocImpl* doc )
     }
 }
 
+/* strips a <b> or <i> nested directly in the same element */
+static Bool NestedEmphasisNode( TidyDocImpl* doc, Node* node, Node** pnext )
+{
+    if ( (nodeIsB(node) || nodeIsI(node))
+         && node->parent && node->parent->tag == node->tag)
+    {
+        /* strip redundant inner element */
+        DiscardContainer( doc, node, pnext );
+        return yes;
+    }
+    return no;
+}
+
 /* simplifies <b><b> ... </b> ...</b> etc. */
 void TY_(NestedEmphasis)( TidyDocImpl* doc, Node* node )
 {
@@ -1546,11 +1561,8 @@ void TY_(NestedEmphasis)( TidyDocImpl* doc, Node* node )
     {
         next = node->next;
 
-        if ( (nodeIsB(node) || nodeIsI(node))
-             && node->parent && node->parent->tag == node->tag)
+        if ( NestedEmphasisNode(doc, node, &next) )
         {
-            /* strip redundant inner element */
-            DiscardContainer( doc, node, &next );
             node = next;
             continue;
         }
@@ -1563,16 +1575,20 @@ void TY_(NestedEmphasis)( TidyDocImpl* doc, Node* node )
 }
 
 
+static void EmFromINode( TidyDocImpl* doc, Node* node )
+{
+    if ( nodeIsI(node) )
+        RenameElem( doc, node, TidyTag_EM );
+    else if ( nodeIsB(node) )
+        RenameElem( doc, node, TidyTag_STRONG );
+}
 
 /* replace i by em and b by strong */
 void TY_(EmFromI)( TidyDocImpl* doc, Node* node )
 {
     while (node)
     {
-        if ( nodeIsI(node) )
-            RenameElem( doc, node, TidyTag_EM );
-        else if ( nodeIsB(node) )
-            RenameElem( doc, node, TidyTag_STRONG );
+        EmFromINode( doc, node );
 
         if ( node->content )
             TY_(EmFromI)( doc, node->content );
@@ -1593,6 +1609,19 @@ static Bool HasOneChild(Node *node)
  li. This is recursively replaced by an
  implicit blockquote.
 */
+static Bool List2BQNode( TidyDocImpl* doc, Node* node )
+{
+    if ( node->tag && node->tag->parser == TY_(ParseList) &&
+         HasOneChild(node) && node->content->implicit )
+    {
+        StripOnlyChild( doc, node );
+        RenameElem( doc, node, TidyTag_BLOCKQUOTE );
+        node->implicit = yes;
+        return yes;
+    }
+    return no;
+}
+
 void TY_(List2BQ)( TidyDocImpl* doc, Node* node )
 {
     while (node)
@@ -1600,13 +1629,7 @@ void TY_(List2BQ)( TidyDocImpl* doc, Node* node )
         if (node->content)
             TY_(List2BQ)( doc, node->content );
 
-        if ( node->tag && node->tag->parser == TY_(ParseList) &&
-             HasOneChild(node) && node->content->implicit )
-        {
-            StripOnlyChild( doc, node );
-            RenameElem( doc, node, TidyTag_BLOCKQUOTE );
-            node->implicit = yes;
-        }
+        List2BQNode( doc, node );
 
         node = node->next;
     }
@@ -2062,7 +2085,7 @@ void TY_(CleanWord2000)( TidyDocImpl* doc, Node *node)
 
                 if ( !list || TagId(list) != listType )
                 {
-                    const Dict* tag = TY_(LookupTagDef)( listType );
+                    const Dict* tag = TY_(LookupTagDef)( doc, listType );
                     list = TY_(InferredTag)(doc, tag->id);
                     TY_(InsertNodeBeforeElement)(node, list);
                 }
@@ -2527,6 +2550,45 @@ void TY_(ConvertCDATANodes)(TidyDocImpl* doc, Node* node)
   'xml:lang' and 'lang' are desired, for XHTML 1.1 only 'xml:lang'
   is desired and for HTML 4.01 only 'lang' is desired.
 */
+static void FixLanguageInformationNode(TidyDocImpl* doc, Node* node, Bool wantXmlLang, Bool wantLang)
+{
+    /* todo: report modifications made here to the report system */
+
+    if (TY_(nodeIsElement)(node))
+    {
+        AttVal* lang = TY_(AttrGetById)(node, TidyAttr_LANG);
+        AttVal* xmlLang = TY_(AttrGetById)(node, TidyAttr_XML_LANG);
+
+        if (lang && xmlLang)
+        {
+            /*
+              todo: check whether both attributes are in sync,
+              here or elsewhere, where elsewhere is probably
+              preferable.
+              AD - March 2005: not mandatory according the standards.
+            */
+        }
+        else if (lang && wantXmlLang)
+        {
+            if (TY_(NodeAttributeVersions)( node, TidyAttr_XML_LANG )
+                & doc->lexer->versionEmitted)
+                TY_(RepairAttrValue)(doc, node, "xml:lang", lang->value);
+        }
+        else if (xmlLang && wantLang)
+        {
+            if (TY_(NodeAttributeVersions)( node, TidyAttr_LANG )
+                & doc->lexer->versionEmitted)
+                TY_(RepairAttrValue)(doc, node, "lang", xmlLang->value);
+        }
+
+        if (lang && !wantLang)
+            TY_(RemoveAttribute)(doc, node, lang);
+        
+        if (xmlLang && !wantXmlLang)
+            TY_(RemoveAttribute)(doc, node, xmlLang);
+    }
+}
+
 void TY_(FixLanguageInformation)(TidyDocImpl* doc, Node* node, Bool wantXmlLang, Bool wantLang)
 {
     Node* next;
@@ -2535,41 +2597,7 @@ void TY_(FixLanguageInformation)(TidyDocImpl* doc, Node* node, Bool wantXmlLang,
     {
         next = node->next;
 
-        /* todo: report modifications made here to the report system */
-
-        if (TY_(nodeIsElement)(node))
-        {
-            AttVal* lang = TY_(AttrGetById)(node, TidyAttr_LANG);
-            AttVal* xmlLang = TY_(AttrGetById)(node, TidyAttr_XML_LANG);
-
-            if (lang && xmlLang)
-            {
-                /*
-                  todo: check whether both attributes are in sync,
-                  here or elsewhere, where elsewhere is probably
-                  preferable.
-                  AD - March 2005: not mandatory according the standards.
-                */
-            }
-            else if (lang && wantXmlLang)
-            {
-                if (TY_(NodeAttributeVersions)( node, TidyAttr_XML_LANG )
-                    & doc->lexer->versionEmitted)
-                    TY_(RepairAttrValue)(doc, node, "xml:lang", lang->value);
-            }
-            else if (xmlLang && wantLang)
-            {
-                if (TY_(NodeAttributeVersions)( node, TidyAttr_LANG )
-                    & doc->lexer->versionEmitted)
-                    TY_(RepairAttrValue)(doc, node, "lang", xmlLang->value);
-            }
-
-            if (lang && !wantLang)
-                TY_(RemoveAttribute)(doc, node, lang);
-            
-            if (xmlLang && !wantXmlLang)
-                TY_(RemoveAttribute)(doc, node, xmlLang);
-        }
+        FixLanguageInformationNode(doc, node, wantXmlLang, wantLang);
 
         if (node->content)
             TY_(FixLanguageInformation)(doc, node->content, wantXmlLang, wantLang);
@@ -2605,75 +2633,80 @@ void TY_(FixXhtmlNamespace)(TidyDocImpl* doc, Bool wantXmlns)
 /*
   ...
 */
-void TY_(FixAnchors)(TidyDocImpl* doc, Node *node, Bool wantName, Bool wantId)
+static void FixAnchorsNode(TidyDocImpl* doc, Node *node, Bool wantName, Bool wantId)
 {
-    Node* next;
-
-    while (node)
+    if (TY_(IsAnchorElement)(doc, node))
     {
-        next = node->next;
+        AttVal *name = TY_(AttrGetById)(node, TidyAttr_NAME);
+        AttVal *id = TY_(AttrGetById)(node, TidyAttr_ID);
+        Bool hadName = name!=NULL;
+        Bool hadId = id!=NULL;
+        Bool IdEmitted = no;
+        Bool NameEmitted = no;
 
-        if (TY_(IsAnchorElement)(doc, node))
-        {
-            AttVal *name = TY_(AttrGetById)(node, TidyAttr_NAME);
-            AttVal *id = TY_(AttrGetById)(node, TidyAttr_ID);
-            Bool hadName = name!=NULL;
-            Bool hadId = id!=NULL;
-            Bool IdEmitted = no;
-            Bool NameEmitted = no;
-
-            /* todo: how are empty name/id attributes handled? */
+        /* todo: how are empty name/id attributes handled? */
 
-            if (name && id)
-            {
-                Bool NameHasValue = AttrHasValue(name);
-                Bool IdHasValue = AttrHasValue(id);
-                if ( (NameHasValue != IdHasValue) ||
-                     (NameHasValue && IdHasValue &&
-                     TY_(tmbstrcmp)(name->value, id->value) != 0 ) )
-                    TY_(ReportAttrError)( doc, node, name, ID_NAME_MISMATCH);
-            }
-            else if (name && wantId)
-            {
-                if (TY_(NodeAttributeVersions)( node, TidyAttr_ID )
-                    & doc->lexer->versionEmitted)
-                {
-                    if (TY_(IsValidHTMLID)(name->value))
-                    {
-                        TY_(RepairAttrValue)(doc, node, "id", name->value);
-                        IdEmitted = yes;
-                    }
-                    else
-                        TY_(ReportAttrError)(doc, node, name, INVALID_XML_ID);
-                 }
-            }
-            else if (id && wantName)
+        if (name && id)
+        {
+            Bool NameHasValue = AttrHasValue(name);
+            Bool IdHasValue = AttrHasValue(id);
+            if ( (NameHasValue != IdHasValue) ||
+                 (NameHasValue && IdHasValue &&
+                 TY_(tmbstrcmp)(name->value, id->value) != 0 ) )
+                TY_(ReportAttrError)( doc, node, name, ID_NAME_MISMATCH);
+        }
+        else if (name && wantId)
+        {
+            if (TY_(NodeAttributeVersions)( node, TidyAttr_ID )
+                & doc->lexer->versionEmitted)
             {
-                if (TY_(NodeAttributeVersions)( node, TidyAttr_NAME )
-                    & doc->lexer->versionEmitted)
+                if (TY_(IsValidHTMLID)(name->value))
                 {
-                    /* todo: do not assume id is valid */
-                    TY_(RepairAttrValue)(doc, node, "name", id->value);
-                    NameEmitted = yes;
+                    TY_(RepairAttrValue)(doc, node, "id", name->value);
+                    IdEmitted = yes;
                 }
+                else
+                    TY_(ReportAttrError)(doc, node, name, INVALID_XML_ID);
+             }
+        }
+        else if (id && wantName)
+        {
+            if (TY_(NodeAttributeVersions)( node, TidyAttr_NAME )
+                & doc->lexer->versionEmitted)
+            {
+                /* todo: do not assume id is valid */
+                TY_(RepairAttrValue)(doc, node, "name", id->value);
+                NameEmitted = yes;
             }
+        }
 
-            if (id && !wantId
-                /* make sure that Name has been emitted if requested */
-                && (hadName || !wantName || NameEmitted) ) {
-                if (!wantId && !wantName)
-                    TY_(RemoveAnchorByNode)(doc, id->value, node);
-                TY_(RemoveAttribute)(doc, node, id);
-            }
+        if (id && !wantId
+            /* make sure that Name has been emitted if requested */
+            && (hadName || !wantName || NameEmitted) ) {
+            if (!wantId && !wantName)
+                TY_(RemoveAnchorByNode)(doc, id->value, node);
+            TY_(RemoveAttribute)(doc, node, id);
+        }
 
-            if (name && !wantName
-                /* make sure that Id has been emitted if requested */
-                && (hadId || !wantId || IdEmitted) ) {
-                if (!wantId && !wantName)
-                    TY_(RemoveAnchorByNode)(doc, name->value, node);
-                TY_(RemoveAttribute)(doc, node, name);
-            }
+        if (name && !wantName
+            /* make sure that Id has been emitted if requested */
+            && (hadId || !wantId || IdEmitted) ) {
+            if (!wantId && !wantName)
+                TY_(RemoveAnchorByNode)(doc, name->value, node);
+            TY_(RemoveAttribute)(doc, node, name);
         }
+    }
+}
+
+void TY_(FixAnchors)(TidyDocImpl* doc, Node *node, Bool wantName, Bool wantId)
+{
+    Node* next;
+
+    while (node)
+    {
+        next = node->next;
+
+        FixAnchorsNode(doc, node, wantName, wantId);
 
         if (node->content)
             TY_(FixAnchors)(doc, node->content, wantName, wantId);
@@ -2682,6 +2715,220 @@ void TY_(FixAnchors)(TidyDocImpl* doc, Node *node, Bool wantName, Bool wantId)
     }
 }
 
+/*
+  Fused traversals.
+
+  Each rule is stored once in func[]/data[], and its bit is set in
+  the masks of the tag ids it applies to, so dispatching a node is
+  a single table lookup on its TidyTagId. Rules run in the order
+  they were registered.
+*/
+void TY_(InitNodeVisitors)( NodeVisitors* visitors )
+{
+    TidyClearMemory( visitors, sizeof(NodeVisitors) );
+}
+
+void TY_(AddNodeVisitor)( NodeVisitors* visitors, NodeVisitFunc* func,
+                          void* data, Bool post, const TidyTagId* tags )
+{
+    uint bit;
+
+    assert( visitors->count < MAX_NODE_VISITORS );
+    bit = 1u << visitors->count;
+    visitors->func[visitors->count] = func;
+    visitors->data[visitors->count] = data;
+    visitors->count++;
+
+    if ( tags == NULL )
+    {
+        if ( post )
+            visitors->anyPost |= bit;
+        else
+            visitors->anyPre |= bit;
+        return;
+    }
+
+    for ( ; *tags != TidyTag_UNKNOWN; ++tags )
+    {
+        if ( post )
+            visitors->postMask[*tags] |= bit;
+        else
+            visitors->preMask[*tags] |= bit;
+    }
+}
+
+static Bool RunNodeVisitors( TidyDocImpl* doc, const NodeVisitors* visitors,
+                             uint mask, Node* node, Node** pnext )
+{
+    uint i;
+
+    for ( i = 0; mask; ++i, mask >>= 1 )
+    {
+        if ( (mask & 1) &&
+             visitors->func[i]( doc, node, pnext, visitors->data[i] ) )
+            return yes;
+    }
+    return no;
+}
+
+/* visits node and its content, returns the node to continue with */
+static Node* VisitNode( TidyDocImpl* doc, const NodeVisitors* visitors, Node* node )
+{
+    Node* next = node->next;
+    uint mask;
+
+    mask = visitors->anyPre | visitors->preMask[ TagId(node) ];
+    if ( mask && RunNodeVisitors(doc, visitors, mask, node, &next) )
+        return next;
+
+    if (node->content)
+        TY_(VisitNodes)( doc, visitors, node->content );
+
+    mask = visitors->anyPost | visitors->postMask[ TagId(node) ];
+    if ( mask )
+        RunNodeVisitors( doc, visitors, mask, node, &next );
+
+    return next;
+}
+
+void TY_(VisitNodes)( TidyDocImpl* doc, const NodeVisitors* visitors, Node* node )
+{
+    while ( node && !TidyCancelled(doc, CANCEL_NODE_TICKS) )
+        node = VisitNode( doc, visitors, node );
+}
+
+void TY_(VisitTree)( TidyDocImpl* doc, const NodeVisitors* visitors, Node* node )
+{
+    VisitNode( doc, visitors, node );
+}
+
+static Bool NestedEmphasisVisitor( TidyDocImpl* doc, Node* node, Node** pnext,
+                                   void* ARG_UNUSED(data) )
+{
+    return NestedEmphasisNode( doc, node, pnext );
+}
+
+static Bool List2BQVisitor( TidyDocImpl* doc, Node* node, Node** ARG_UNUSED(pnext),
+                            void* data )
+{
+    if ( List2BQNode(doc, node) )
+        *(Bool*)data = yes;
+    return no;
+}
+
+static Bool ImplicitBQVisitor( TidyDocImpl* ARG_UNUSED(doc), Node* node,
+                               Node** ARG_UNUSED(pnext), void* data )
+{
+    if ( node->implicit )
+        *(Bool*)data = yes;
+    return no;
+}
+
+static Bool EmFromIVisitor( TidyDocImpl* doc, Node* node, Node** ARG_UNUSED(pnext),
+                            void* ARG_UNUSED(data) )
+{
+    EmFromINode( doc, node );
+    return no;
+}
+
+/*
+ NestedEmphasis has to look at the original tag of the parent, so it
+ runs pre-order, while List2BQ and EmFromI only rename a node after
+ its content is done. BQ2Div collapses whole chains of blockquotes
+ from the top down and so still needs its own traversal, but only
+ when there is an implicit blockquote to replace.
+*/
+void TY_(CleanListsAndEmphasis)( TidyDocImpl* doc, Node* node,
+                                 Bool mergeEmphasis, Bool logical )
+{
+    static const TidyTagId emphasisTags[] =
+        { TidyTag_B, TidyTag_I, TidyTag_UNKNOWN };
+    /* tags parsed by ParseList */
+    static const TidyTagId listTags[] =
+        { TidyTag_DIR, TidyTag_MENU, TidyTag_OL, TidyTag_UL, TidyTag_UNKNOWN };
+    static const TidyTagId blockquoteTags[] =
+        { TidyTag_BLOCKQUOTE, TidyTag_UNKNOWN };
+    NodeVisitors visitors;
+    Bool implicitBQ = no;
+
+    TY_(InitNodeVisitors)( &visitors );
+    if ( mergeEmphasis )
+        TY_(AddNodeVisitor)( &visitors, NestedEmphasisVisitor, NULL, no, emphasisTags );
+    TY_(AddNodeVisitor)( &visitors, List2BQVisitor, &implicitBQ, yes, listTags );
+    TY_(AddNodeVisitor)( &visitors, ImplicitBQVisitor, &implicitBQ, yes, blockquoteTags );
+    if ( logical )
+        TY_(AddNodeVisitor)( &visitors, EmFromIVisitor, NULL, yes, emphasisTags );
+
+    TY_(VisitTree)( doc, &visitors, node );
+
+    if ( implicitBQ )
+        TY_(BQ2Div)( doc, node );
+}
+
+typedef struct _AnchorLangInfo
+{
+    Bool wantName;
+    Bool wantId;
+    Bool wantXmlLang;
+    Bool wantLang;
+    Bool intact;
+} AnchorLangInfo;
+
+static Bool IntegrityVisitor( TidyDocImpl* ARG_UNUSED(doc), Node* node,
+                              Node** ARG_UNUSED(pnext), void* data )
+{
+    AnchorLangInfo* info = (AnchorLangInfo*)data;
+    if ( !TY_(CheckNodeLinks)(node) )
+        info->intact = no;
+    return no;
+}
+
+static Bool FixAnchorsVisitor( TidyDocImpl* doc, Node* node,
+                               Node** ARG_UNUSED(pnext), void* data )
+{
+    AnchorLangInfo* info = (AnchorLangInfo*)data;
+    FixAnchorsNode( doc, node, info->wantName, info->wantId );
+    return no;
+}
+
+static Bool FixLanguageVisitor( TidyDocImpl* doc, Node* node,
+                                Node** ARG_UNUSED(pnext), void* data )
+{
+    AnchorLangInfo* info = (AnchorLangInfo*)data;
+    FixLanguageInformationNode( doc, node, info->wantXmlLang, info->wantLang );
+    return no;
+}
+
+/*
+ Both rules only touch the attributes of the node at hand, and
+ FixLanguageInformation reports nothing, so applying them node by
+ node gives the same tree and messages as two separate passes.
+*/
+Bool TY_(FixAnchorsAndLanguage)( TidyDocImpl* doc, Node* node, Bool wantName,
+                                  Bool wantId, Bool wantXmlLang, Bool wantLang )
+{
+    /* see TY_(IsAnchorElement) */
+    static const TidyTagId anchorTags[] =
+        { TidyTag_A, TidyTag_APPLET, TidyTag_FORM, TidyTag_FRAME,
+          TidyTag_IFRAME, TidyTag_IMG, TidyTag_MAP, TidyTag_UNKNOWN };
+    NodeVisitors visitors;
+    AnchorLangInfo info;
+
+    info.wantName = wantName;
+    info.wantId = wantId;
+    info.wantXmlLang = wantXmlLang;
+    info.wantLang = wantLang;
+    info.intact = yes;
+
+    TY_(InitNodeVisitors)( &visitors );
+    TY_(AddNodeVisitor)( &visitors, IntegrityVisitor, &info, no, NULL );
+    TY_(AddNodeVisitor)( &visitors, FixAnchorsVisitor, &info, no, anchorTags );
+    TY_(AddNodeVisitor)( &visitors, FixLanguageVisitor, &info, no, NULL );
+
+    TY_(VisitTree)( doc, &visitors, node );
+    return info.intact;
+}
+
 /*
  * local variables:
  * mode: c
@@ -78,5 +78,53 @@ void TY_(FixAnchors)(TidyDocImpl* doc, Node *node, Bool wantName, Bool wantId);
 void TY_(FixXhtmlNamespace)(TidyDocImpl* doc, Bool wantXmlns);
 void TY_(FixLanguageInformation)(TidyDocImpl* doc, Node* node, Bool wantXmlLang, Bool wantLang);
 
+/*
+ Fused traversals: per-node rules are registered against the TidyTagIds
+ they apply to (or against every node) and then run together in a single
+ walk of the tree. Pre-order rules run before the node's content is
+ visited, post-order rules after it. A rule returns yes if it removed
+ the node, in which case *pnext holds the node to continue with.
+*/
+typedef Bool (NodeVisitFunc)( TidyDocImpl* doc, Node* node, Node** pnext, void* data );
+
+#define MAX_NODE_VISITORS 8
+
+typedef struct _NodeVisitors
+{
+    NodeVisitFunc* func[MAX_NODE_VISITORS];
+    void*          data[MAX_NODE_VISITORS];
+    uint           count;
+    uint           anyPre;                  /* rules run on every node */
+    uint           anyPost;
+    uint           preMask[N_TIDY_TAGS];    /* rules run on nodes by tag id */
+    uint           postMask[N_TIDY_TAGS];
+} NodeVisitors;
+
+void TY_(InitNodeVisitors)( NodeVisitors* visitors );
+
+/* tags is terminated by TidyTag_UNKNOWN; NULL registers for every node */
+void TY_(AddNodeVisitor)( NodeVisitors* visitors, NodeVisitFunc* func,
+                          void* data, Bool post, const TidyTagId* tags );
+
+void TY_(VisitNodes)( TidyDocImpl* doc, const NodeVisitors* visitors, Node* node );
+
+/* like VisitNodes, but for node and its content only, not its siblings */
+void TY_(VisitTree)( TidyDocImpl* doc, const NodeVisitors* visitors, Node* node );
+
+/*
+ NestedEmphasis, List2BQ and EmFromI in one traversal of the tree
+ at node, followed by BQ2Div if that left any implicit blockquotes.
+*/
+void TY_(CleanListsAndEmphasis)( TidyDocImpl* doc, Node* node,
+                                 Bool mergeEmphasis, Bool logical );
+
+/*
+ FixAnchors and FixLanguageInformation in one traversal of the tree
+ at node, checking its integrity along the way. Returns no if the
+ tree has lost its integrity.
+*/
+Bool TY_(FixAnchorsAndLanguage)( TidyDocImpl* doc, Node* node, Bool wantName,
+                                  Bool wantId, Bool wantXmlLang, Bool wantLang );
+
 
 #endif /* __CLEAN_H__ */
@@ -46,11 +46,21 @@
 void TY_(InitConfig)( TidyDocImpl* doc )
 {
     TidyClearMemory( &doc->config, sizeof(TidyConfigImpl) );
+    doc->config.value = doc->config.local;
     TY_(ResetConfigToDefault)( doc );
 }
 
 void TY_(FreeConfig)( TidyDocImpl* doc )
 {
+    TidyConfigImpl* config = &doc->config;
+    if ( config->shared )
+    {
+        /* local and snapshot hold defaults while the shared values are used */
+        config->value = config->local;
+        config->sharedSnapshot = no;
+        TY_(ReleaseSharedConfig)( config->shared );
+        config->shared = NULL;
+    }
     TY_(ResetConfigToDefault)( doc );
     TY_(TakeConfigSnapshot)( doc );
 }
@@ -315,6 +325,16 @@ static const TidyOptionImpl option_defs[] =
   { TidySkipNested,              MU, "skip-nested",                 BL, yes,             ParseBool,         boolPicks       }, /* 1642186 - Issue #65 */
   { TidyStrictTagsAttr,          MU, "strict-tags-attributes",      BL, no,              ParseBool,         boolPicks       }, /* 20160209 - Issue #350 */
   { TidyEscapeScripts,           PP, "escape-scripts",              BL, yes,             ParseBool,         boolPicks       }, /* 20160227 - Issue #348 */
+  { TidyPrescanEncoding,         CE, "prescan-encoding",            BL, no,              ParseBool,         boolPicks       },
+  { TidyParseHeadOnly,           MU, "parse-head-only",             BL, no,              ParseBool,         boolPicks       },
+  { TidyLintOnly,                DG, "lint-only",                   BL, no,              ParseBool,         boolPicks       },
+  { TidyPrintThreads,            PP, "print-threads",               IN, 0,               ParseInt,          NULL            },
+  { TidyMinify,                  PP, "minify",                      BL, no,              ParseBool,         boolPicks       },
+  { TidyMaxInputBytes,           MS, "max-input-bytes",             IN, 0,               ParseInt,          NULL            },
+  { TidyMaxNodes,                MS, "max-nodes",                   IN, 0,               ParseInt,          NULL            },
+  { TidyMaxAttributes,           MS, "max-attributes",              IN, 0,               ParseInt,          NULL            },
+  { TidyMaxDepth,                MS, "max-depth",                   IN, 0,               ParseInt,          NULL            },
+  { TidyMaxMessages,             MS, "max-messages",                IN, 0,               ParseInt,          NULL            },
   { N_TIDY_OPTIONS,              XX, NULL,                          XY, 0,               NULL,              NULL            }
 };
 
@@ -351,6 +371,13 @@ static void CopyOptionValue( TidyDocImpl* doc, const TidyOptionImpl* option,
                              TidyOptionValue* oldval, const TidyOptionValue* newval )
 {
     assert( oldval != NULL );
+
+    /* a copy of the same string is kept rather than made again */
+    if ( option->type == TidyString && oldval->p && newval->p &&
+         oldval->p != option->pdflt && newval->p != option->pdflt &&
+         TY_(tmbstrcmp)(oldval->p, newval->p) == 0 )
+        return;
+
     FreeOptionValue( doc, option, oldval );
 
     if ( option->type == TidyString )
@@ -364,6 +391,52 @@ static void CopyOptionValue( TidyDocImpl* doc, const TidyOptionImpl* option,
         oldval->v = newval->v;
 }
 
+static void CopyOptionValues( TidyDocImpl* doc, TidyOptionValue* to,
+                              const TidyOptionValue* from )
+{
+    uint ixVal;
+    const TidyOptionImpl* option = option_defs;
+    for ( ixVal=0; ixVal < N_TIDY_OPTIONS; ++option, ++ixVal )
+    {
+        assert( ixVal == (uint) option->id );
+        CopyOptionValue( doc, option, &to[ixVal], &from[ixVal] );
+    }
+}
+
+static void GetOptionDefault( const TidyOptionImpl* option,
+                              TidyOptionValue* dflt );
+
+static void ResetOptionValues( TidyDocImpl* doc, TidyOptionValue* value )
+{
+    uint ixVal;
+    const TidyOptionImpl* option = option_defs;
+    for ( ixVal=0; ixVal < N_TIDY_OPTIONS; ++option, ++ixVal )
+    {
+        TidyOptionValue dflt;
+        assert( ixVal == (uint) option->id );
+        GetOptionDefault( option, &dflt );
+        CopyOptionValue( doc, option, &value[ixVal], &dflt );
+    }
+}
+
+/* Are the values read from the shared config? */
+static Bool UsingSharedValues( TidyDocImpl* doc )
+{
+    TidyConfigImpl* config = &doc->config;
+    return config->shared && config->value == config->shared->value;
+}
+
+/* Copy the shared values before the document changes one */
+static void UnshareConfig( TidyDocImpl* doc )
+{
+    TidyConfigImpl* config = &doc->config;
+    if ( UsingSharedValues(doc) )
+    {
+        CopyOptionValues( doc, config->local, config->shared->value );
+        config->value = config->local;
+    }
+}
+
 
 static Bool SetOptionValue( TidyDocImpl* doc, TidyOptionId optId, ctmbstr val )
 {
@@ -372,6 +445,14 @@ static Bool SetOptionValue( TidyDocImpl* doc, TidyOptionId optId, ctmbstr val )
    if ( status )
    {
       assert( option->id == optId && option->type == TidyString );
+      if ( UsingSharedValues(doc) )
+      {
+          ctmbstr curr = doc->config.value[ optId ].p;
+          if ( TY_(tmbstrlen)(val) == 0 ? curr == NULL :
+               curr != NULL && TY_(tmbstrcmp)(curr, val) == 0 )
+              return status;
+          UnshareConfig( doc );
+      }
       FreeOptionValue( doc, option, &doc->config.value[ optId ] );
       if ( TY_(tmbstrlen)(val)) /* Issue #218 - ONLY if it has LENGTH! */
           doc->config.value[ optId ].p = TY_(tmbstrdup)( doc->allocator, val );
@@ -387,7 +468,11 @@ Bool TY_(SetOptionInt)( TidyDocImpl* doc, TidyOptionId optId, ulong val )
    if ( status )
    {
        assert( option_defs[ optId ].type == TidyInteger );
-       doc->config.value[ optId ].v = val;
+       if ( doc->config.value[ optId ].v != val )
+       {
+           UnshareConfig( doc );
+           doc->config.value[ optId ].v = val;
+       }
    }
    return status;
 }
@@ -398,7 +483,11 @@ Bool TY_(SetOptionBool)( TidyDocImpl* doc, TidyOptionId optId, Bool val )
    if ( status )
    {
        assert( option_defs[ optId ].type == TidyBoolean );
-       doc->config.value[ optId ].v = val;
+       if ( doc->config.value[ optId ].v != (ulong) val )
+       {
+           UnshareConfig( doc );
+           doc->config.value[ optId ].v = val;
+       }
    }
    return status;
 }
@@ -427,10 +516,13 @@ Bool TY_(ResetOptionToDefault)( TidyDocImpl* doc, TidyOptionId optId )
     {
         TidyOptionValue dflt;
         const TidyOptionImpl* option = option_defs + optId;
-        TidyOptionValue* value = &doc->config.value[ optId ];
         assert( optId == option->id );
         GetOptionDefault( option, &dflt );
-        CopyOptionValue( doc, option, value, &dflt );
+        if ( UsingSharedValues(doc) &&
+             OptionValueEqDefault(option, &doc->config.value[ optId ]) )
+            return status;
+        UnshareConfig( doc );
+        CopyOptionValue( doc, option, &doc->config.value[ optId ], &dflt );
     }
     return status;
 }
@@ -506,51 +598,72 @@ static void ReparseTagDecls( TidyDocImpl* doc, uint changedUserTags  )
     REPARSE_USERTAGS(TidyPreTags,tagtype_pre);
 }
 
-void TY_(ResetConfigToDefault)( TidyDocImpl* doc )
+/* Point the document at the shared values, declaring the user tags
+** they name.  Local values are dropped.
+*/
+static void UseSharedValues( TidyDocImpl* doc )
 {
-    uint ixVal;
-    const TidyOptionImpl* option = option_defs;
-    TidyOptionValue* value = &doc->config.value[ 0 ];
-    for ( ixVal=0; ixVal < N_TIDY_OPTIONS; ++option, ++ixVal )
+    TidyConfigImpl* config = &doc->config;
+    uint changedUserTags;
+
+    if ( NeedReparseTagDecls( config->value, config->shared->value,
+                              &changedUserTags ) )
     {
-        TidyOptionValue dflt;
-        assert( ixVal == (uint) option->id );
-        GetOptionDefault( option, &dflt );
-        CopyOptionValue( doc, option, &value[ixVal], &dflt );
+        /* reparsing writes the values back, as the shared ones are */
+        CopyOptionValues( doc, config->local, config->shared->value );
+        config->value = config->local;
+        ReparseTagDecls( doc, changedUserTags );
     }
+    ResetOptionValues( doc, config->local );
+    config->value = config->shared->value;
+}
+
+void TY_(ResetConfigToDefault)( TidyDocImpl* doc )
+{
+    /* local values are the defaults while the shared ones are used */
+    doc->config.value = doc->config.local;
+    ResetOptionValues( doc, doc->config.value );
     TY_(FreeDeclaredTags)( doc, tagtype_null );
 }
 
 void TY_(TakeConfigSnapshot)( TidyDocImpl* doc )
 {
-    uint ixVal;
-    const TidyOptionImpl* option = option_defs;
-    const TidyOptionValue* value = &doc->config.value[ 0 ];
-    TidyOptionValue* snap  = &doc->config.snapshot[ 0 ];
+    TidyConfigImpl* config = &doc->config;
 
     AdjustConfig( doc );  /* Make sure it's consistent */
-    for ( ixVal=0; ixVal < N_TIDY_OPTIONS; ++option, ++ixVal )
+
+    /* shared values were adjusted when created and never change */
+    if ( UsingSharedValues(doc) )
     {
-        assert( ixVal == (uint) option->id );
-        CopyOptionValue( doc, option, &snap[ixVal], &value[ixVal] );
+        if ( !config->sharedSnapshot )
+        {
+            ResetOptionValues( doc, config->snapshot );
+            config->sharedSnapshot = yes;
+        }
+        return;
     }
+
+    config->sharedSnapshot = no;
+    CopyOptionValues( doc, config->snapshot, config->value );
 }
 
 void TY_(ResetConfigToSnapshot)( TidyDocImpl* doc )
 {
-    uint ixVal;
-    const TidyOptionImpl* option = option_defs;
-    TidyOptionValue* value = &doc->config.value[ 0 ];
-    const TidyOptionValue* snap  = &doc->config.snapshot[ 0 ];
+    TidyConfigImpl* config = &doc->config;
     uint changedUserTags;
-    Bool needReparseTagsDecls = NeedReparseTagDecls( value, snap,
-                                                     &changedUserTags );
-    
-    for ( ixVal=0; ixVal < N_TIDY_OPTIONS; ++option, ++ixVal )
+    Bool needReparseTagsDecls;
+
+    if ( config->sharedSnapshot )
     {
-        assert( ixVal == (uint) option->id );
-        CopyOptionValue( doc, option, &value[ixVal], &snap[ixVal] );
+        if ( !UsingSharedValues(doc) )
+            UseSharedValues( doc );
+        return;
     }
+
+    needReparseTagsDecls = NeedReparseTagDecls( config->value, config->snapshot,
+                                                &changedUserTags );
+    UnshareConfig( doc );
+    CopyOptionValues( doc, config->value, config->snapshot );
     if ( needReparseTagsDecls )
         ReparseTagDecls( doc, changedUserTags );
 }
@@ -559,20 +672,14 @@ void TY_(CopyConfig)( TidyDocImpl* docTo, TidyDocImpl* docFrom )
 {
     if ( docTo != docFrom )
     {
-        uint ixVal;
-        const TidyOptionImpl* option = option_defs;
-        const TidyOptionValue* from = &docFrom->config.value[ 0 ];
-        TidyOptionValue* to   = &docTo->config.value[ 0 ];
+        const TidyOptionValue* from = docFrom->config.value;
         uint changedUserTags;
-        Bool needReparseTagsDecls = NeedReparseTagDecls( to, from,
-                                                         &changedUserTags );
+        Bool needReparseTagsDecls = NeedReparseTagDecls( docTo->config.value,
+                                                         from, &changedUserTags );
 
         TY_(TakeConfigSnapshot)( docTo );
-        for ( ixVal=0; ixVal < N_TIDY_OPTIONS; ++option, ++ixVal )
-        {
-            assert( ixVal == (uint) option->id );
-            CopyOptionValue( docTo, option, &to[ixVal], &from[ixVal] );
-        }
+        UnshareConfig( docTo );
+        CopyOptionValues( docTo, docTo->config.value, from );
         if ( needReparseTagsDecls )
             ReparseTagDecls( docTo, changedUserTags  );
         AdjustConfig( docTo );  /* Make sure it's consistent */
@@ -580,6 +687,100 @@ void TY_(CopyConfig)( TidyDocImpl* docTo, TidyDocImpl* docFrom )
 }
 
 
+/* Documents on several threads may hold the same shared config */
+#if defined(__GNUC__)
+#define AtomicIncrement(p)  __sync_add_and_fetch( (p), 1 )
+#define AtomicDecrement(p)  __sync_sub_and_fetch( (p), 1 )
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define AtomicIncrement(p)  _InterlockedIncrement( (p) )
+#define AtomicDecrement(p)  _InterlockedDecrement( (p) )
+#else
+#define AtomicIncrement(p)  (++*(p))
+#define AtomicDecrement(p)  (--*(p))
+#endif
+
+TidySharedConfigImpl* TY_(NewSharedConfig)( TidyDocImpl* doc )
+{
+    TidySharedConfigImpl* shared;
+    const TidyOptionImpl* option = option_defs;
+    const TidyOptionValue* value;
+    uint ixVal;
+
+    AdjustConfig( doc );  /* Make sure it's consistent */
+    value = doc->config.value;
+
+    shared = (TidySharedConfigImpl*) TidyAlloc( doc->allocator,
+                                                sizeof(TidySharedConfigImpl) );
+    TidyClearMemory( shared, sizeof(TidySharedConfigImpl) );
+    shared->allocator = doc->allocator;
+    shared->refs = 1;
+
+    for ( ixVal=0; ixVal < N_TIDY_OPTIONS; ++option, ++ixVal )
+    {
+        assert( ixVal == (uint) option->id );
+        if ( option->type == TidyString && value[ixVal].p &&
+             value[ixVal].p != option->pdflt )
+            shared->value[ixVal].p = TY_(tmbstrdup)( shared->allocator,
+                                                     value[ixVal].p );
+        else
+            shared->value[ixVal] = value[ixVal];
+    }
+    return shared;
+}
+
+void TY_(RetainSharedConfig)( TidySharedConfigImpl* shared )
+{
+    AtomicIncrement( &shared->refs );
+}
+
+void TY_(ReleaseSharedConfig)( TidySharedConfigImpl* shared )
+{
+    const TidyOptionImpl* option = option_defs;
+    uint ixVal;
+
+    if ( AtomicDecrement( &shared->refs ) != 0 )
+        return;
+
+    for ( ixVal=0; ixVal < N_TIDY_OPTIONS; ++option, ++ixVal )
+    {
+        if ( option->type == TidyString && shared->value[ixVal].p &&
+             shared->value[ixVal].p != option->pdflt )
+            TidyFree( shared->allocator, shared->value[ixVal].p );
+    }
+    TidyFree( shared->allocator, shared );
+}
+
+/* Make the document read the values of shared (NULL for a copy of
+** its own), which it keeps a reference to.
+*/
+void TY_(UseSharedConfig)( TidyDocImpl* doc, TidySharedConfigImpl* shared )
+{
+    TidyConfigImpl* config = &doc->config;
+    TidySharedConfigImpl* old = config->shared;
+
+    if ( shared != old )
+    {
+        if ( shared )
+            TY_(RetainSharedConfig)( shared );
+
+        /* keep what the values and snapshot were, before dropping old */
+        UnshareConfig( doc );
+        if ( config->sharedSnapshot )
+        {
+            CopyOptionValues( doc, config->snapshot, old->value );
+            config->sharedSnapshot = no;
+        }
+        config->shared = shared;
+        if ( old )
+            TY_(ReleaseSharedConfig)( old );
+    }
+
+    if ( shared && !UsingSharedValues(doc) )
+        UseSharedValues( doc );
+}
+
+
 #ifdef _DEBUG
 
 /* Debug accessor functions will be type-safe and assert option type match */
@@ -1528,9 +1729,9 @@ Bool ParseRepeatAttr( TidyDocImpl* doc, const TidyOptionImpl* option )
     buf[i] = '\0';
 
     if ( TY_(tmbstrcasecmp)(buf, "keep-first") == 0 )
-        cfg->value[ TidyDuplicateAttrs ].v = TidyKeepFirst;
+        TY_(SetOptionInt)( doc, TidyDuplicateAttrs, TidyKeepFirst );
     else if ( TY_(tmbstrcasecmp)(buf, "keep-last") == 0 )
-        cfg->value[ TidyDuplicateAttrs ].v = TidyKeepLast;
+        TY_(SetOptionInt)( doc, TidyDuplicateAttrs, TidyKeepLast );
     else
     {
         TY_(ReportBadArgument)( doc, option->name );
@@ -1556,9 +1757,9 @@ Bool ParseSorter( TidyDocImpl* doc, const TidyOptionImpl* option )
     buf[i] = '\0';
 
     if ( TY_(tmbstrcasecmp)(buf, "alpha") == 0 )
-        cfg->value[ TidySortAttributes ].v = TidySortAttrAlpha;
+        TY_(SetOptionInt)( doc, TidySortAttributes, TidySortAttrAlpha );
     else if ( TY_(tmbstrcasecmp)(buf, "none") == 0)
-        cfg->value[ TidySortAttributes ].v = TidySortAttrNone;
+        TY_(SetOptionInt)( doc, TidySortAttributes, TidySortAttrNone );
     else
     {
         TY_(ReportBadArgument)( doc, option->name );
@@ -1662,11 +1863,23 @@ static int  WriteOptionPick( const TidyOptionImpl* option, uint ival, StreamOut*
 
 Bool  TY_(ConfigDiffThanSnapshot)( TidyDocImpl* doc )
 {
-  int diff = memcmp( &doc->config.value, &doc->config.snapshot,
+  const TidyConfigImpl* config = &doc->config;
+  const TidyOptionValue* snap = config->sharedSnapshot ?
+                                config->shared->value : config->snapshot;
+  int diff = memcmp( config->value, snap,
                      N_TIDY_OPTIONS * sizeof(uint) );
   return ( diff != 0 );
 }
 
+/* Value of an integer or boolean option when the snapshot was taken */
+ulong TY_(SnapshotValue)( TidyDocImpl* doc, TidyOptionId optId )
+{
+  const TidyConfigImpl* config = &doc->config;
+  const TidyOptionValue* snap = config->sharedSnapshot ?
+                                config->shared->value : config->snapshot;
+  return snap[ optId ].v;
+}
+
 Bool  TY_(ConfigDiffThanDefault)( TidyDocImpl* doc )
 {
   Bool diff = no;
@@ -48,11 +48,26 @@ typedef union
   char *p;  /* Value for TidyString */
 } TidyOptionValue;
 
+/* Option values made consistent once and then only read, by any
+** number of documents.  Freed when the last reference is released.
+*/
+typedef struct _tidy_shared_config
+{
+    TidyOptionValue value[ N_TIDY_OPTIONS + 1 ];
+    TidyAllocator*  allocator;
+    volatile long   refs;
+} TidySharedConfigImpl;
+
 typedef struct _tidy_config
 {
-    TidyOptionValue value[ N_TIDY_OPTIONS + 1 ];     /* current config values */
+    TidyOptionValue* value;                          /* current config values, local or shared */
+    TidyOptionValue local[ N_TIDY_OPTIONS + 1 ];     /* values owned by the document */
     TidyOptionValue snapshot[ N_TIDY_OPTIONS + 1 ];  /* Snapshot of values to be restored later */
 
+    /* values read until the document changes one, then copied to local */
+    TidySharedConfigImpl* shared;
+    Bool sharedSnapshot;                             /* snapshot is shared->value */
+
     /* track what tags user has defined to eliminate unnecessary searches */
     uint  defined_tags;
 
@@ -96,6 +111,11 @@ void TY_(ResetConfigToSnapshot)( TidyDocImpl* doc );
 
 void TY_(CopyConfig)( TidyDocImpl* docTo, TidyDocImpl* docFrom );
 
+TidySharedConfigImpl* TY_(NewSharedConfig)( TidyDocImpl* doc );
+void TY_(RetainSharedConfig)( TidySharedConfigImpl* shared );
+void TY_(ReleaseSharedConfig)( TidySharedConfigImpl* shared );
+void TY_(UseSharedConfig)( TidyDocImpl* doc, TidySharedConfigImpl* shared );
+
 int  TY_(ParseConfigFile)( TidyDocImpl* doc, ctmbstr cfgfil );
 int  TY_(ParseConfigFileEnc)( TidyDocImpl* doc,
                               ctmbstr cfgfil, ctmbstr charenc );
@@ -114,6 +134,7 @@ Bool  TY_(AdjustCharEncoding)( TidyDocImpl* doc, int encoding );
 
 Bool  TY_(ConfigDiffThanDefault)( TidyDocImpl* doc );
 Bool  TY_(ConfigDiffThanSnapshot)( TidyDocImpl* doc );
+ulong TY_(SnapshotValue)( TidyDocImpl* doc, TidyOptionId optId );
 
 int TY_(CharEncodingId)( TidyDocImpl* doc, ctmbstr charenc );
 ctmbstr TY_(CharEncodingName)( int encoding );
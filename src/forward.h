@@ -50,6 +50,12 @@ typedef struct _IStack IStack;
 struct _Lexer;
 typedef struct _Lexer Lexer;
 
+struct _NodeIndex;
+typedef struct _NodeIndex NodeIndex;
+
+struct _NodeIterator;
+typedef struct _NodeIterator NodeIterator;
+
 extern TidyAllocator TY_(g_default_allocator);
 
 /** Wrappers for easy memory allocation using an allocator */
@@ -28,6 +28,7 @@ AttVal *TY_(DupAttrs)( TidyDocImpl* doc, AttVal *attrs)
     newattrs->attribute = TY_(tmbstrdup)(doc->allocator, attrs->attribute);
     newattrs->value = TY_(tmbstrdup)(doc->allocator, attrs->value);
     newattrs->dict = TY_(FindAttribute)(doc, newattrs);
+    newattrs->srcStart = newattrs->srcEnd = 0;
     newattrs->asp = attrs->asp ? TY_(CloneNode)(doc, attrs->asp) : NULL;
     newattrs->php = attrs->php ? TY_(CloneNode)(doc, attrs->php) : NULL;
     return newattrs;
@@ -84,6 +84,7 @@ static languageDefinition language_en = { whichPluralForm_en, {
     {/* This is not a formal name and can be translated. */
       STRING_HTML_PROPRIETARY,      0,   "HTML Proprietary"
     },
+    { STRING_LIMIT_EXCEEDED,        0,   "%s limit of %lu exceeded, the rest of the document is not parsed"        },
     { STRING_MISSING_MALFORMED,     0,   "missing or malformed argument for option: %s"                            },
     { STRING_NO_ERRORS,             0,   "No warnings or errors were found."                                       },
     { STRING_NO_SYSID,              0,   "No system identifier in emitted doctype"                                 },
@@ -2030,6 +2031,176 @@ static languageDefinition language_en = { whichPluralForm_en, {
         "This option causes items that look like closing tags, like <code>&lt;/g</code> to be escaped "
         "to <code>&lt;\\/g</code>. Set this option to 'no' if you do not want this."
     },
+    {/* Important notes for translators:
+        - Use only <code></code>, <var></var>, <em></em>, <strong></strong>, and
+          <br/>.
+        - Entities, tags, attributes, etc., should be enclosed in <code></code>.
+        - Option values should be enclosed in <var></var>.
+        - It's very important that <br/> be self-closing!
+        - The strings "Tidy" and "HTML Tidy" are the program name and must not
+          be translated. */
+      TidyPrescanEncoding,        0,
+        "This option causes Tidy to look for the character encoding declared by a document "
+        "before parsing it. When the input has no byte order mark, the first 1024 bytes are "
+        "searched for an XML declaration <code>encoding</code> or a <code>&lt;meta&gt;</code> "
+        "element giving a <code>charset</code>, and a supported encoding found there replaces "
+        "<code>input-encoding</code> for that document. "
+        "<br/>"
+        "Only files and buffers are prescanned; input from a custom input source is not."
+    },
+    {/* Important notes for translators:
+        - Use only <code></code>, <var></var>, <em></em>, <strong></strong>, and
+          <br/>.
+        - Entities, tags, attributes, etc., should be enclosed in <code></code>.
+        - Option values should be enclosed in <var></var>.
+        - It's very important that <br/> be self-closing!
+        - The strings "Tidy" and "HTML Tidy" are the program name and must not
+          be translated. */
+      TidyParseHeadOnly,          0,
+        "This option causes Tidy to stop reading the input as soon as the "
+        "<code>&lt;head&gt;</code> is complete, that is at the first element or text "
+        "that belongs in the <code>&lt;body&gt;</code>. The document then has an empty "
+        "<code>&lt;body&gt;</code>, which keeps the attributes of an explicit "
+        "<code>&lt;body&gt;</code> start tag. "
+        "<br/>"
+        "This is useful when only the title, <code>&lt;meta&gt;</code> and "
+        "<code>&lt;link&gt;</code> elements of a document are needed. "
+        "It does not apply to XML input."
+    },
+    {/* Important notes for translators:
+        - Use only <code></code>, <var></var>, <em></em>, <strong></strong>, and
+          <br/>.
+        - Entities, tags, attributes, etc., should be enclosed in <code></code>.
+        - Option values should be enclosed in <var></var>.
+        - It's very important that <br/> be self-closing!
+        - The strings "Tidy" and "HTML Tidy" are the program name and must not
+          be translated. */
+      TidyLintOnly,               0,
+        "This option causes Tidy to only report the problems it finds in a document. "
+        "The document is checked and repaired as far as needed to give the same "
+        "messages, but no output is written, not even an empty file. "
+        "<br/>"
+        "Use this to check documents when the tidied markup is not wanted."
+    },
+    {/* Important notes for translators:
+        - Use only <code></code>, <var></var>, <em></em>, <strong></strong>, and
+          <br/>.
+        - Entities, tags, attributes, etc., should be enclosed in <code></code>.
+        - Option values should be enclosed in <var></var>.
+        - It's very important that <br/> be self-closing!
+        - The strings "Tidy" and "HTML Tidy" are the program name and must not
+          be translated. */
+      TidyPrintThreads,           0,
+        "This option specifies the number of threads Tidy may use to print the "
+        "<code>&lt;body&gt;</code> of a large document. The children of the "
+        "<code>&lt;body&gt;</code> are split into that many runs, which are printed "
+        "at the same time and then written in order. The output is the same as when "
+        "printing on one thread. "
+        "<br/>"
+        "The default of <var>0</var> prints on one thread, as do builds without "
+        "thread support. Documents printed with a progress callback, a custom "
+        "allocator or ISO-2022 output are also printed on one thread."
+    },
+    {/* Important notes for translators:
+        - Use only <code></code>, <var></var>, <em></em>, <strong></strong>, and
+          <br/>.
+        - Entities, tags, attributes, etc., should be enclosed in <code></code>.
+        - Option values should be enclosed in <var></var>.
+        - It's very important that <br/> be self-closing!
+        - The strings "Tidy" and "HTML Tidy" are the program name and must not
+          be translated. */
+      TidyMinify,                 0,
+        "This option specifies if Tidy should write HTML output in its shortest "
+        "form, for serving rather than for reading. No indentation or line breaks "
+        "are added, whitespace is collapsed where the content model makes it "
+        "insignificant, optional start and end tags such as "
+        "<code>&lt;/li&gt;</code>, <code>&lt;/p&gt;</code> and "
+        "<code>&lt;tbody&gt;</code> are left out following the HTML5 rules, "
+        "boolean attributes are written without a value and attribute values are "
+        "written without quotes where that is allowed. "
+        "<br/>"
+        "The wrap and indent options have no effect on minified output. This "
+        "option is ignored for XML and XHTML output."
+    },
+    {/* Important notes for translators:
+        - Use only <code></code>, <var></var>, <em></em>, <strong></strong>, and
+          <br/>.
+        - Entities, tags, attributes, etc., should be enclosed in <code></code>.
+        - Option values should be enclosed in <var></var>.
+        - It's very important that <br/> be self-closing!
+        - The strings "Tidy" and "HTML Tidy" are the program name and must not
+          be translated. */
+      TidyMaxInputBytes,          0,
+        "This option sets the largest number of bytes Tidy reads from a document. "
+        "Reading stops there, as if the input had ended, and parsing reports an "
+        "error and returns a negative status, so that one oversized document "
+        "cannot hold up a server. "
+        "<br/>"
+        "The default of <var>0</var> sets no limit."
+    },
+    {/* Important notes for translators:
+        - Use only <code></code>, <var></var>, <em></em>, <strong></strong>, and
+          <br/>.
+        - Entities, tags, attributes, etc., should be enclosed in <code></code>.
+        - Option values should be enclosed in <var></var>.
+        - It's very important that <br/> be self-closing!
+        - The strings "Tidy" and "HTML Tidy" are the program name and must not
+          be translated. */
+      TidyMaxNodes,               0,
+        "This option sets the largest number of nodes Tidy creates while parsing a "
+        "document. This counts elements, text and comments, including the "
+        "elements Tidy inserts to repair the markup. Parsing stops there with an "
+        "error and returns a negative status. "
+        "<br/>"
+        "The default of <var>0</var> sets no limit."
+    },
+    {/* Important notes for translators:
+        - Use only <code></code>, <var></var>, <em></em>, <strong></strong>, and
+          <br/>.
+        - Entities, tags, attributes, etc., should be enclosed in <code></code>.
+        - Option values should be enclosed in <var></var>.
+        - It's very important that <br/> be self-closing!
+        - The strings "Tidy" and "HTML Tidy" are the program name and must not
+          be translated. */
+      TidyMaxAttributes,          0,
+        "This option sets the largest number of attributes Tidy creates while "
+        "parsing a document. Parsing stops there with an error and returns a "
+        "negative status. "
+        "<br/>"
+        "The default of <var>0</var> sets no limit."
+    },
+    {/* Important notes for translators:
+        - Use only <code></code>, <var></var>, <em></em>, <strong></strong>, and
+          <br/>.
+        - Entities, tags, attributes, etc., should be enclosed in <code></code>.
+        - Option values should be enclosed in <var></var>.
+        - It's very important that <br/> be self-closing!
+        - The strings "Tidy" and "HTML Tidy" are the program name and must not
+          be translated. */
+      TidyMaxDepth,               0,
+        "This option sets how deeply elements may be nested in a document. Parsing "
+        "stops at the first element that would be nested deeper, with an error, "
+        "and returns a negative status. "
+        "<br/>"
+        "The default of <var>0</var> sets no limit."
+    },
+    {/* Important notes for translators:
+        - Use only <code></code>, <var></var>, <em></em>, <strong></strong>, and
+          <br/>.
+        - Entities, tags, attributes, etc., should be enclosed in <code></code>.
+        - Option values should be enclosed in <var></var>.
+        - It's very important that <br/> be self-closing!
+        - The strings "Tidy" and "HTML Tidy" are the program name and must not
+          be translated. */
+      TidyMaxMessages,            0,
+        "This option sets the largest number of messages Tidy reports for a "
+        "document. Parsing stops once there are more, with an error, and returns a "
+        "negative status; no further messages are shown. "
+        "<br/>"
+        "Unlike <code>show-errors</code>, which only limits the errors shown, this "
+        "limits the work done on a document that has very many problems. "
+        "The default of <var>0</var> sets no limit."
+    },
 
 #if SUPPORT_CONSOLE_APP
     /********************************************************
@@ -2045,11 +2216,17 @@ static languageDefinition language_en = { whichPluralForm_en, {
     { TidyMiscellaneous,            0,   "misc"                                                                    },
     { TidyPrettyPrint,              0,   "print"                                                                   },
     { TC_LABEL_COL,                 0,   "column"                                                                  },
+    { TC_LABEL_COUNT,               0,   "number"                                                                  },
+    { TC_LABEL_DIR,                 0,   "directory"                                                               },
     { TC_LABEL_FILE,                0,   "file"                                                                    },
     { TC_LABEL_LANG,                0,   "lang"                                                                    },
     { TC_LABEL_LEVL,                0,   "level"                                                                   },
     { TC_LABEL_OPT,                 0,   "option"                                                                  },
+    { TC_LABEL_SIZE,                0,   "MB"                                                                      },
     { TC_MAIN_ERROR_LOAD_CONFIG,    0,   "Loading config file \"%s\" failed, err = %d"                             },
+    { TC_MAIN_ERROR_SERVE,          0,   "Serving requests on \"%s\" failed: %s"                                   },
+    { TC_MAIN_ERROR_SERVE_REQUEST,  0,   "Dropped a malformed request on \"%s\""                                   },
+    { TC_MAIN_ERROR_SERVE_SIZE,     0,   "Refused a request part of %u bytes, over the -serve-max-size of %u MB"  },
     { TC_OPT_ACCESS,                0,
         "do additional accessibility checks (<level> = 0, 1, 2, 3). 0 is "
         "assumed if <level> is missing."
@@ -2059,6 +2236,11 @@ static languageDefinition language_en = { whichPluralForm_en, {
     { TC_OPT_ASXML,                 0,   "convert HTML to well formed XHTML"                                       },
     { TC_OPT_BARE,                  0,   "strip out smart quotes and em dashes, etc."                              },
     { TC_OPT_BIG5,                  0,   "use Big5 for both input and output"                                      },
+    { TC_OPT_CACHEDIR,              0,
+        "keep the output and messages for each file in <directory>, and use them "
+        "again for the same file and options"
+    },
+    { TC_OPT_CACHESIZE,             0,   "limit the -cache-dir entries to <MB>, 100 by default, 0 for no limit"   },
     { TC_OPT_CLEAN,                 0,   "replace FONT, NOBR and CENTER tags with CSS"                             },
     { TC_OPT_CONFIG,                0,   "set configuration options from the specified <file>"                     },
     { TC_OPT_ERRORS,                0,   "show only errors and warnings"                                           },
@@ -2087,6 +2269,14 @@ static languageDefinition language_en = { whichPluralForm_en, {
     { TC_OPT_OUTPUT,                0,   "write output to the specified <file>"                                    },
     { TC_OPT_QUIET,                 0,   "suppress nonessential output"                                            },
     { TC_OPT_RAW,                   0,   "output values above 127 without conversion to entities"                  },
+    { TC_OPT_SERVE,                 0,
+        "read requests, each the options and a document, from stdin and write "
+        "the output, messages and status of each to stdout, keeping tidy loaded "
+        "between them"
+    },
+    { TC_OPT_SERVEMAXSIZE,          0,   "refuse -serve requests with options or a document over <MB>, 16 by default" },
+    { TC_OPT_SERVESOCKET,           0,   "as -serve, but take requests on the UNIX domain socket <file>"           },
+    { TC_OPT_SERVETHREADS,          0,   "run -serve requests on <number> threads, one per processor by default"  },
     { TC_OPT_SHIFTJIS,              0,   "use Shift_JIS for both input and output"                                 },
     { TC_OPT_SHOWCFG,               0,   "list the current configuration settings"                                 },
     { TC_OPT_UPPER,                 0,   "force tags to upper case"                                                },
@@ -38,6 +38,7 @@
 #include "tmbstr.h"
 #include "clean.h"
 #include "utf8.h"
+#include "nodeindex.h"
 #include "streamio.h"
 #ifdef _MSC_VER
 #include "sprtf.h"
@@ -901,23 +902,31 @@ static tmbchar LastChar( tmbstr str )
     #define StartEndTag 4
 */
 
+static void InitLexer( TidyDocImpl* doc, Lexer* lexer )
+{
+    TidyClearMemory( lexer, sizeof(Lexer) );
+
+    lexer->allocator = doc->allocator;
+    lexer->lines = 1;
+    lexer->columns = 1;
+    lexer->state = LEX_CONTENT;
+
+    lexer->versions = (VERS_ALL|VERS_PROPRIETARY);
+    lexer->doctype = VERS_UNKNOWN;
+    lexer->root = &doc->root;
+
+    lexer->xmlTags = cfgBool( doc, TidyXmlTags );
+    lexer->preserveEntities = cfgBool( doc, TidyPreserveEntities );
+    lexer->fixComments = cfgBool( doc, TidyFixComments );
+    lexer->xmlPIs = cfgBool( doc, TidyXmlPIs );
+}
+
 Lexer* TY_(NewLexer)( TidyDocImpl* doc )
 {
     Lexer* lexer = (Lexer*) TidyDocAlloc( doc, sizeof(Lexer) );
 
     if ( lexer != NULL )
-    {
-        TidyClearMemory( lexer, sizeof(Lexer) );
-
-        lexer->allocator = doc->allocator;
-        lexer->lines = 1;
-        lexer->columns = 1;
-        lexer->state = LEX_CONTENT;
-
-        lexer->versions = (VERS_ALL|VERS_PROPRIETARY);
-        lexer->doctype = VERS_UNKNOWN;
-        lexer->root = &doc->root;
-    }
+        InitLexer( doc, lexer );
     return lexer;
 }
 
@@ -927,23 +936,66 @@ static Bool EndOfInput( TidyDocImpl* doc )
     return ( !doc->docIn->pushed && TY_(IsEOF)(doc->docIn) );
 }
 
+/* free a token pushed back by UngetToken() and not yet read again */
+static void DropPushedTokens( TidyDocImpl* doc, Lexer* lexer )
+{
+    /* See GetToken() */
+    if ( lexer->pushed || lexer->itoken )
+    {
+        if (lexer->pushed)
+            TY_(FreeNode)( doc, lexer->itoken );
+        TY_(FreeNode)( doc, lexer->token );
+    }
+    lexer->pushed = no;
+    lexer->itoken = NULL;
+    lexer->token = NULL;
+}
+
+/* free what the lexer holds for the current document */
+static void FreeLexerState( TidyDocImpl* doc, Lexer* lexer )
+{
+    TY_(FreeStyles)( doc );
+    DropPushedTokens( doc, lexer );
+
+    while ( lexer->istacksize > 0 )
+        TY_(PopInline)( doc, NULL );
+}
+
+/* make the lexer ready for a new document, keeping its buffers */
+void TY_(ResetLexer)( TidyDocImpl* doc )
+{
+    Lexer *lexer = doc->lexer;
+    tmbstr lexbuf;
+    uint lexlength;
+    IStack* istack;
+    uint istacklength;
+
+    if ( !lexer )
+        return;
+
+    FreeLexerState( doc, lexer );
+
+    lexbuf = lexer->lexbuf;
+    lexlength = lexer->lexlength;
+    istack = lexer->istack;
+    istacklength = lexer->istacklength;
+
+    InitLexer( doc, lexer );
+
+    lexer->lexbuf = lexbuf;
+    lexer->lexlength = lexlength;
+    lexer->istack = istack;
+    lexer->istacklength = istacklength;
+    if ( lexbuf )
+        lexbuf[0] = '\0';
+}
+
 void TY_(FreeLexer)( TidyDocImpl* doc )
 {
     Lexer *lexer = doc->lexer;
     if ( lexer )
     {
-        TY_(FreeStyles)( doc );
-
-        /* See GetToken() */
-        if ( lexer->pushed || lexer->itoken )
-        {
-            if (lexer->pushed)
-                TY_(FreeNode)( doc, lexer->itoken );
-            TY_(FreeNode)( doc, lexer->token );
-        }
-
-        while ( lexer->istacksize > 0 )
-            TY_(PopInline)( doc, NULL );
+        FreeLexerState( doc, lexer );
 
         TidyDocFree( doc, lexer->istack );
         TidyDocFree( doc, lexer->lexbuf );
@@ -995,8 +1047,21 @@ static void ChangeChar( Lexer *lexer, tmbchar c )
 void TY_(AddCharToLexer)( Lexer *lexer, uint c )
 {
     int i, err, count = 0;
-    tmbchar buf[10] = {0};
-    
+    tmbchar buf[10];
+
+    /* one and two byte sequences need no validation */
+    if ( c <= 0x7F )
+    {
+        AddByte( lexer, (tmbchar) c );
+        return;
+    }
+    if ( c <= 0x7FF )
+    {
+        AddByte( lexer, (tmbchar) (0xC0 | (c >> 6)) );
+        AddByte( lexer, (tmbchar) (0x80 | (c & 0x3F)) );
+        return;
+    }
+
     err = TY_(EncodeCharToUTF8Bytes)( c, buf, NULL, &count );
     if (err)
     {
@@ -1194,10 +1259,10 @@ static void ParseEntity( TidyDocImpl* doc, GetTokenMode mode )
     ENTState entState = ENT_default;
     uint charRead = 0;
     Bool semicolon = no, found = no;
-    Bool isXml = cfgBool( doc, TidyXmlTags );
-    Bool preserveEntities = cfgBool( doc, TidyPreserveEntities );
-    uint c, ch, startcol, entver = 0;
     Lexer* lexer = doc->lexer;
+    Bool isXml = lexer->xmlTags;
+    Bool preserveEntities = lexer->preserveEntities;
+    uint c, ch, startcol, entver = 0;
 
     start = lexer->lexsize - 1;  /* to start at "&" */
     startcol = doc->docIn->curcol - 1;
@@ -1402,17 +1467,28 @@ static void ParseEntity( TidyDocImpl* doc, GetTokenMode mode )
     }
 }
 
+/* The input ends early once the run is cancelled, see
+   tidySetCancelCallback(). Checked by the loops reading text, CDATA,
+   tag names and attributes, any of which may go on for a long time
+   without a token. */
+static uint ReadCancellableChar( TidyDocImpl* doc )
+{
+    if ( TidyCancelled(doc, CANCEL_CHAR_TICKS) )
+        return EndOfStream;
+    return TY_(ReadChar)( doc->docIn );
+}
+
 static tmbchar ParseTagName( TidyDocImpl* doc )
 {
     Lexer *lexer = doc->lexer;
     uint c = lexer->lexbuf[ lexer->txtstart ];
-    Bool xml = cfgBool(doc, TidyXmlTags);
+    Bool xml = lexer->xmlTags;
 
     /* fold case of first character in buffer */
     if (!xml && TY_(IsUpper)(c))
         lexer->lexbuf[lexer->txtstart] = (tmbchar) TY_(ToLower)(c);
 
-    while ((c = TY_(ReadChar)(doc->docIn)) != EndOfStream)
+    while ((c = ReadCancellableChar(doc)) != EndOfStream)
     {
         if ((!xml && !TY_(IsNamechar)(c)) ||
             (xml && !TY_(IsXMLNamechar)(c)))
@@ -1452,6 +1528,7 @@ Node *TY_(NewNode)(TidyAllocator* allocator, Lexer *lexer)
     {
         node->line = lexer->lines;
         node->column = lexer->columns;
+        lexer->nodes++;
     }
     node->type = TextNode;
 #if !defined(NDEBUG) && defined(_MSC_VER) && defined(DEBUG_ALLOCATION)
@@ -1558,17 +1635,18 @@ void TY_(FreeNode)( TidyDocImpl* doc, Node *node )
         }
     }
       ----------------- */
+    if ( node && doc->nodeIndex )
+        TY_(FreeNodeIndex)( doc );
+
     while ( node )
     {
         Node* next = node->next;
 
+        if ( doc->nodeIterators )
+            TY_(IndexFreeNode)( doc, node );
         TY_(FreeAttrs)( doc, node );
         TY_(FreeNode)( doc, node->content );
         TidyDocFree( doc, node->element );
-#ifdef TIDY_STORE_ORIGINAL_TEXT
-        if (node->otext)
-            TidyDocFree(doc, node->otext);
-#endif
         if (RootNode != node->type)
             TidyDocFree( doc, node );
         else
@@ -1579,49 +1657,37 @@ void TY_(FreeNode)( TidyDocImpl* doc, Node *node )
 }
 
 #ifdef TIDY_STORE_ORIGINAL_TEXT
+/* The token takes the text read since the last token, except for the
+** last count bytes, which are left for the next one.
+*/
 void StoreOriginalTextInToken(TidyDocImpl* doc, Node* node, uint count)
 {
-    if (!doc->storeText)
-        return;
+    StreamIn* in = doc->docIn;
 
-    if (count >= doc->docIn->otextlen)
+    if (!doc->storeText)
         return;
 
-    if (!doc->docIn->otextsize)
+    if (count >= in->otextlen - in->otextstart)
         return;
 
-    if (count == 0)
-    {
-        node->otext = doc->docIn->otextbuf;
-        doc->docIn->otextbuf = NULL;
-        doc->docIn->otextlen = 0;
-        doc->docIn->otextsize = 0;
-    }
-    else
-    {
-        uint len = doc->docIn->otextlen;
-        tmbstr buf1 = (tmbstr)TidyDocAlloc(doc, len - count + 1);
-        tmbstr buf2 = (tmbstr)TidyDocAlloc(doc, count + 1);
-        uint i, j;
-
-        /* strncpy? */
-
-        for (i = 0; i < len - count; ++i)
-            buf1[i] = doc->docIn->otextbuf[i];
-
-        buf1[i] = 0;
-
-        for (j = 0; j + i < len; ++j)
-            buf2[j] = doc->docIn->otextbuf[j + i];
+    node->otextStart = in->otextstart;
+    node->otextLen = in->otextlen - in->otextstart - count;
+    in->otextstart += node->otextLen;
+}
 
-        buf2[j] = 0;
+/* The bytes of the chars pushed back with UngetChar(), which belong
+** to the next token.
+*/
+static uint PushedTextLength(StreamIn* in)
+{
+    uint i, len = 0;
 
-        TidyDocFree(doc, doc->docIn->otextbuf);
-        node->otext = buf1;
-        doc->docIn->otextbuf = buf2;
-        doc->docIn->otextlen = count;
-        doc->docIn->otextsize = count + 1;
+    for (i = 0; i < in->bufpos; ++i)
+    {
+        uint c = in->charbuf[i];
+        len += c < 0x80 ? 1 : c < 0x800 ? 2 : c < 0x10000 ? 3 : 4;
     }
+    return len;
 }
 #endif
 
@@ -1667,6 +1733,9 @@ static Node* TagToken( TidyDocImpl* doc, NodeType type )
     if ( type == StartTag || type == StartEndTag || type == EndTag )
         TY_(FindTag)(doc, node);
 
+    if ( type != EndTag && node->tag && (node->tag->model & CM_OBSOLETE) )
+        lexer->seenObsolete = yes;
+
     return node;
 }
 
@@ -1678,7 +1747,7 @@ static Node* NewToken(TidyDocImpl* doc, NodeType type)
     node->start = lexer->txtstart;
     node->end = lexer->txtend;
 #ifdef TIDY_STORE_ORIGINAL_TEXT
-    StoreOriginalTextInToken(doc, node, 0);
+    StoreOriginalTextInToken(doc, node, PushedTextLength(doc->docIn));
 #endif
     return node;
 }
@@ -2241,7 +2310,7 @@ Node* TY_(InferredTag)(TidyDocImpl* doc, TidyTagId id)
 {
     Lexer *lexer = doc->lexer;
     Node *node = TY_(NewNode)( lexer->allocator, lexer );
-    const Dict* dict = TY_(LookupTagDef)(id);
+    const Dict* dict = TY_(LookupTagDef)(doc, id);
 
     assert( dict != NULL );
 
@@ -2305,7 +2374,7 @@ static Node *GetCDATA( TidyDocImpl* doc, Node *container )
     lexer->txtstart = lexer->txtend = lexer->lexsize;
 
     /* seen start tag, look for matching end tag */
-    while ((c = TY_(ReadChar)(doc->docIn)) != EndOfStream)
+    while ((c = ReadCancellableChar(doc)) != EndOfStream)
     {
         TY_(AddCharToLexer)(lexer, c);
         lexer->txtend = lexer->lexsize;
@@ -2521,11 +2590,42 @@ void TY_(UngetToken)( TidyDocImpl* doc )
 */
 static Node* GetTokenFromStream( TidyDocImpl* doc, GetTokenMode mode );
 
+Bool TY_(LimitExceeded)( TidyDocImpl* doc )
+{
+    Lexer* lexer = doc->lexer;
+    ulong max;
+
+    if ( doc->limitExceeded != TidyUnknownOption )
+        return yes;
+
+    if ( (max = cfg(doc, TidyMaxNodes)) > 0 && lexer->nodes > max )
+        TY_(ReportLimit)( doc, TidyMaxNodes );
+    else if ( (max = cfg(doc, TidyMaxAttributes)) > 0 && lexer->attrs > max )
+        TY_(ReportLimit)( doc, TidyMaxAttributes );
+    else if ( (max = cfg(doc, TidyMaxDepth)) > 0 && lexer->depth > max )
+        TY_(ReportLimit)( doc, TidyMaxDepth );
+    else if ( (max = cfg(doc, TidyMaxMessages)) > 0 &&
+              doc->errors + doc->warnings + doc->infoMessages +
+              doc->accessErrors + doc->docErrors > max )
+        TY_(ReportLimit)( doc, TidyMaxMessages );
+
+    return doc->limitExceeded != TidyUnknownOption;
+}
+
 Node* TY_(GetToken)( TidyDocImpl* doc, GetTokenMode mode )
 {
     Node *node;
     Lexer* lexer = doc->lexer;
 
+    /* past a max-* limit or once cancelled the input ends here, and the
+       parsers unwind. A pushed back token is dropped too, or a parser that
+       keeps pushing it back for its parent would never see the end. */
+    if ( TY_(LimitExceeded)(doc) || doc->cancelled )
+    {
+        DropPushedTokens( doc, lexer );
+        return NULL;
+    }
+
     if (lexer->pushed || lexer->itoken)
     {
         /* Deal with previously returned duplicate inline token */
@@ -2576,13 +2676,29 @@ Node* TY_(GetToken)( TidyDocImpl* doc, GetTokenMode mode )
 
     if (mode == CdataContent)
     {
+        uint start = TY_(StreamInOffset)( doc->docIn );
         assert( lexer->parent != NULL );
         node = GetCDATA(doc, lexer->parent);
+        node->srcStart = start;
+        node->srcEnd = TY_(StreamInOffset)( doc->docIn );
         GTDBG(doc,"lex-cdata", node);
         return node;
     }
 
-    return GetTokenFromStream( doc, mode );
+    node = GetTokenFromStream( doc, mode );
+
+    /* text is cut short by the markup that follows it */
+    if ( node )
+    {
+        node->srcStart = lexer->tokenStart;
+        if ( node->type == TextNode && lexer->state != LEX_CONTENT )
+            node->srcEnd = lexer->markupStart;
+        else if ( lexer->tokenEnd )
+            node->srcEnd = lexer->tokenEnd;
+        else
+            node->srcEnd = TY_(StreamInOffset)( doc->docIn );
+    }
+    return node;
 }
 
 #if !defined(NDEBUG) && defined(_MSC_VER)
@@ -2605,10 +2721,15 @@ static Node* GetTokenFromStream( TidyDocImpl* doc, GetTokenMode mode )
 
     SetLexerLocus( doc, lexer );
     lexer->waswhite = no;
+    if ( lexer->state == LEX_CONTENT )
+        lexer->tokenStart = TY_(StreamInOffset)( doc->docIn );
+    else
+        lexer->tokenStart = lexer->markupStart;
+    lexer->tokenEnd = 0;
 
     lexer->txtstart = lexer->txtend = lexer->lexsize;
 
-    while ((c = TY_(ReadChar)(doc->docIn)) != EndOfStream)
+    while ((c = ReadCancellableChar(doc)) != EndOfStream)
     {
         if (lexer->insertspace)
         {
@@ -2637,11 +2758,13 @@ static Node* GetTokenFromStream( TidyDocImpl* doc, GetTokenMode mode )
                     --(lexer->lexsize);
                     lexer->waswhite = no;
                     SetLexerLocus( doc, lexer );
+                    lexer->tokenStart = TY_(StreamInOffset)( doc->docIn );
                     continue;
                 }
 
                 if (c == '<')
                 {
+                    lexer->markupStart = TY_(StreamInCharOffset)( doc->docIn );
                     lexer->state = LEX_GT;
                     continue;
                 }
@@ -2936,7 +3059,7 @@ static Node* GetTokenFromStream( TidyDocImpl* doc, GetTokenMode mode )
                 lexer->state = LEX_CONTENT;
                 lexer->waswhite = no;
 #ifdef TIDY_STORE_ORIGINAL_TEXT
-                StoreOriginalTextInToken(doc, lexer->token, 0); /* hmm... */
+                StoreOriginalTextInToken(doc, lexer->token, PushedTextLength(doc->docIn));
 #endif
                 node = lexer->token;
                 GTDBG(doc,"endtag", node);
@@ -2984,6 +3107,7 @@ static Node* GetTokenFromStream( TidyDocImpl* doc, GetTokenMode mode )
                 if ((mode != Preformatted && ExpectsContent(lexer->token))
                     || nodeIsBR(lexer->token) || nodeIsHR(lexer->token))
                 {
+                    lexer->tokenEnd = TY_(StreamInOffset)( doc->docIn );
                     c = TY_(ReadChar)(doc->docIn);
 
                     if ((c == '\n') && (mode != IgnoreWhitespace)) /* Issue #329 - Can NOT afford to lose this newline */
@@ -3002,14 +3126,14 @@ static Node* GetTokenFromStream( TidyDocImpl* doc, GetTokenMode mode )
                     if (mode != OtherNamespace) /* [i_a]2 only issue warning if NOT 'OtherNamespace', and tag null */
                         TY_(ReportFatal)( doc, NULL, lexer->token, UNKNOWN_ELEMENT );
                 }
-                else if ( !cfgBool(doc, TidyXmlTags) )
+                else if ( !lexer->xmlTags )
                 {
                     TY_(ConstrainVersion)( doc, lexer->token->tag->versions );
                     TY_(RepairDuplicateAttributes)( doc, lexer->token, no );
                 } else 
                     TY_(RepairDuplicateAttributes)( doc, lexer->token, yes );
 #ifdef TIDY_STORE_ORIGINAL_TEXT
-                StoreOriginalTextInToken(doc, lexer->token, 0);
+                StoreOriginalTextInToken(doc, lexer->token, PushedTextLength(doc->docIn));
 #endif
                 node = lexer->token;
                 GTDBG(doc,"starttag", node);
@@ -3044,6 +3168,7 @@ static Node* GetTokenFromStream( TidyDocImpl* doc, GetTokenMode mode )
 
                     /* now look for a line break */
 
+                    lexer->tokenEnd = TY_(StreamInOffset)( doc->docIn );
                     c = TY_(ReadChar)(doc->docIn);
 
                     if (c == '\n')
@@ -3065,7 +3190,7 @@ static Node* GetTokenFromStream( TidyDocImpl* doc, GetTokenMode mode )
 
                 badcomment++;
 
-                if ( cfgBool(doc, TidyFixComments) )
+                if ( lexer->fixComments )
                     lexer->lexbuf[lexer->lexsize - 2] = '=';
 
                 /* if '-' then look for '>' to end the comment */
@@ -3096,7 +3221,7 @@ static Node* GetTokenFromStream( TidyDocImpl* doc, GetTokenMode mode )
                 lexer->waswhite = no;
 
                 /* make a note of the version named by the 1st doctype */
-                if (lexer->doctype == VERS_UNKNOWN && lexer->token && !cfgBool(doc, TidyXmlTags))
+                if (lexer->doctype == VERS_UNKNOWN && lexer->token && !lexer->xmlTags)
                 {
                     lexer->doctype = FindGivenVersion(doc, lexer->token);
                     if (lexer->doctype != VERS_HTML5)
@@ -3137,7 +3262,7 @@ static Node* GetTokenFromStream( TidyDocImpl* doc, GetTokenMode mode )
                     }
                 }
 
-                if (cfgBool(doc, TidyXmlPIs) || lexer->isvoyager) /* insist on ?> as terminator */
+                if (lexer->xmlPIs || lexer->isvoyager) /* insist on ?> as terminator */
                 {
                     if (c != '?')
                         continue;
@@ -3448,7 +3573,7 @@ static Node* GetTokenFromStream( TidyDocImpl* doc, GetTokenMode mode )
             }
             lexer->token = TY_(TextToken)(lexer);
 #ifdef TIDY_STORE_ORIGINAL_TEXT
-            StoreOriginalTextInToken(doc, lexer->token, 0); /* ? */
+            StoreOriginalTextInToken(doc, lexer->token, PushedTextLength(doc->docIn));
 #endif
             node = lexer->token;
             GTDBG(doc,"textstring", node);
@@ -3612,7 +3737,7 @@ static tmbstr  ParseAttribute( TidyDocImpl* doc, Bool *isempty,
 
     for (;;)
     {
-        c = TY_(ReadChar)( doc->docIn );
+        c = ReadCancellableChar( doc );
 
 
         if (c == '/')
@@ -3678,6 +3803,7 @@ static tmbstr  ParseAttribute( TidyDocImpl* doc, Bool *isempty,
            break;
     }
 
+    lexer->attrStart = TY_(StreamInCharOffset)( doc->docIn );
     start = lexer->lexsize;
     lastc = c;
 
@@ -3710,14 +3836,20 @@ static tmbstr  ParseAttribute( TidyDocImpl* doc, Bool *isempty,
         /* what should be done about non-namechar characters? */
         /* currently these are incorporated into the attr name */
 
-        if ( !cfgBool(doc, TidyXmlTags) && TY_(IsUpper)(c) )
+        if ( !lexer->xmlTags && TY_(IsUpper)(c) )
             c = TY_(ToLower)(c);
 
         TY_(AddCharToLexer)( lexer, c );
         lastc = c;
-        c = TY_(ReadChar)(doc->docIn);
+        c = ReadCancellableChar( doc );
     }
 
+    /* the white space that ended the name is not part of it */
+    if ( TY_(IsWhite)(c) )
+        lexer->attrEnd = TY_(StreamInCharOffset)( doc->docIn );
+    else
+        lexer->attrEnd = TY_(StreamInOffset)( doc->docIn );
+
     /* handle attribute names with multibyte chars */
     len = lexer->lexsize - start;
     attr = (len > 0 ? TY_(tmbstrndup)(doc->allocator,
@@ -3747,7 +3879,7 @@ static int ParseServerInstruction( TidyDocImpl* doc )
 
     for (;;)
     {
-        c = TY_(ReadChar)(doc->docIn);
+        c = ReadCancellableChar( doc );
 
         if (c == EndOfStream)
             break;
@@ -3850,7 +3982,7 @@ static tmbstr ParseValue( TidyDocImpl* doc, ctmbstr name,
 
     for (;;)
     {
-        c = TY_(ReadChar)(doc->docIn);
+        c = ReadCancellableChar( doc );
 
         if (c == EndOfStream)
         {
@@ -3878,7 +4010,7 @@ static tmbstr ParseValue( TidyDocImpl* doc, ctmbstr name,
 
     for (;;)
     {
-        c = TY_(ReadChar)(doc->docIn);
+        c = ReadCancellableChar( doc );
 
         if (c == EndOfStream)
         {
@@ -3899,6 +4031,7 @@ static tmbstr ParseValue( TidyDocImpl* doc, ctmbstr name,
         start = lexer->lexsize;
         TY_(AddCharToLexer)(lexer, c);
         *pdelim = ParseServerInstruction( doc );
+        lexer->attrEnd = TY_(StreamInOffset)( doc->docIn );
         len = lexer->lexsize - start;
         lexer->lexsize = start;
         return (len > 0 ? TY_(tmbstrndup)(doc->allocator,
@@ -3919,7 +4052,7 @@ static tmbstr ParseValue( TidyDocImpl* doc, ctmbstr name,
     for (;;)
     {
         lastc = c;  /* track last character */
-        c = TY_(ReadChar)(doc->docIn);
+        c = ReadCancellableChar( doc );
 
         if (c == EndOfStream)
         {
@@ -4060,6 +4193,11 @@ static tmbstr ParseValue( TidyDocImpl* doc, ctmbstr name,
         TY_(AddCharToLexer)(lexer, c);
     }
 
+    if ( delim == 0 && TY_(IsWhite)(c) )
+        lexer->attrEnd = TY_(StreamInCharOffset)( doc->docIn );
+    else
+        lexer->attrEnd = TY_(StreamInOffset)( doc->docIn );
+
     if (quotewarning > 10 && seen_gt && munge)
     {
         /*
@@ -4145,6 +4283,8 @@ AttVal *TY_(NewAttribute)( TidyDocImpl* doc )
 {
     AttVal *av = (AttVal*) TidyDocAlloc( doc, sizeof(AttVal) );
     TidyClearMemory( av, sizeof(AttVal) );
+    if ( doc->lexer )
+        doc->lexer->attrs++;
     return av;
 }
 
@@ -4196,7 +4336,7 @@ static AttVal* ParseAttrs( TidyDocImpl* doc, Bool *isempty )
 
     list = NULL;
 
-    while ( !EndOfInput(doc) )
+    while ( !EndOfInput(doc) && !TY_(LimitExceeded)(doc) )
     {
         tmbstr attribute = ParseAttribute( doc, isempty, &asp, &php );
 
@@ -4226,12 +4366,14 @@ static AttVal* ParseAttrs( TidyDocImpl* doc, Bool *isempty )
         value = ParseValue( doc, attribute, no, isempty, &delim );
 
         if (attribute && (IsValidAttrName(attribute) ||
-            (cfgBool(doc, TidyXmlTags) && IsValidXMLAttrName(attribute))))
+            (lexer->xmlTags && IsValidXMLAttrName(attribute))))
         {
             av = TY_(NewAttribute)(doc);
             av->delim = delim;
             av->attribute = attribute;
             av->value = value;
+            av->srcStart = lexer->attrStart;
+            av->srcEnd = lexer->attrEnd;
             av->dict = TY_(FindAttribute)( doc, av );
             AddAttrToList( &list, av ); 
         }
@@ -4352,7 +4494,7 @@ static Node *ParseDocTypeDecl(TidyDocImpl* doc)
                     return NULL;
                 }
 #ifdef TIDY_STORE_ORIGINAL_TEXT
-                StoreOriginalTextInToken(doc, node, 0);
+                StoreOriginalTextInToken(doc, node, PushedTextLength(doc->docIn));
 #endif
                 return node;
             }
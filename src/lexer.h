@@ -261,6 +261,8 @@ struct _AttVal
     int               delim;
     tmbstr            attribute;
     tmbstr            value;
+    uint              srcStart;   /* byte offsets in the input, as for Node */
+    uint              srcEnd;
 };
 
 
@@ -314,20 +316,24 @@ struct _Node
     uint        line;           /* current line of document */
     uint        column;         /* current column of document */
 
+    uint        srcStart;       /* byte offsets of the token in the input, */
+    uint        srcEnd;         /* srcEnd is 0 for nodes not read from it */
+
     Bool        closed;         /* true if closed by explicit end tag */
     Bool        implicit;       /* true if inferred */
     Bool        linebreak;      /* true if followed by a line break */
 
 #ifdef TIDY_STORE_ORIGINAL_TEXT
-    tmbstr      otext;
+    uint        otextStart;     /* original text of the token, as offset */
+    uint        otextLen;       /* and length in TidyDocImpl otext */
 #endif
 };
 
 
 /*
   The following are private to the lexer
-  Use NewLexer() to create a lexer, and
-  FreeLexer() to free it.
+  Use NewLexer() to create a lexer, ResetLexer()
+  to reuse it and FreeLexer() to free it.
 */
 
 struct _Lexer
@@ -367,6 +373,25 @@ struct _Lexer
     
     Bool seenEndBody;       /* true if a </body> tag has been encountered */
     Bool seenEndHtml;       /* true if a </html> tag has been encountered */
+    Bool seenObsolete;      /* true if a start tag with CM_OBSOLETE has been lexed */
+
+    /* options read by the tokenizer, resolved when the lexer is set up */
+    Bool xmlTags;           /* TidyXmlTags */
+    Bool preserveEntities;  /* TidyPreserveEntities */
+    Bool fixComments;       /* TidyFixComments */
+    Bool xmlPIs;            /* TidyXmlPIs */
+
+    /* work done so far, checked against the max-* options */
+    uint nodes;             /* nodes created */
+    uint attrs;             /* attributes created */
+    uint depth;             /* elements open in the parser */
+
+    /* byte offsets into the input, for Node and AttVal srcStart/srcEnd */
+    uint tokenStart;        /* of the token being read */
+    uint tokenEnd;          /* of its end, if followed by a swallowed newline */
+    uint markupStart;       /* of the last '<' seen in content */
+    uint attrStart;         /* of the attribute being read */
+    uint attrEnd;
 
     /*
       Lexer character buffer
@@ -427,6 +452,9 @@ uint TY_(ToUpper)(uint c);
 Lexer* TY_(NewLexer)( TidyDocImpl* doc );
 void TY_(FreeLexer)( TidyDocImpl* doc );
 
+/* clear the lexer for a new document, keeping its buffers */
+void TY_(ResetLexer)( TidyDocImpl* doc );
+
 /* store character c as UTF-8 encoded byte stream */
 void TY_(AddCharToLexer)( Lexer *lexer, uint c );
 
@@ -534,6 +562,9 @@ typedef enum
 
 Node* TY_(GetToken)( TidyDocImpl* doc, GetTokenMode mode );
 
+/* true once one of the max-* options has been exceeded, reported once */
+Bool TY_(LimitExceeded)( TidyDocImpl* doc );
+
 void TY_(InitMap)(void);
 
 
@@ -59,6 +59,10 @@ static Bool UpdateCount( TidyDocImpl* doc, TidyReportLevel level )
   /* keep quiet after <ShowErrors> errors */
   Bool go = ( doc->errors < cfg(doc, TidyShowErrors) );
 
+  /* and after <MaxMessages> messages, once parsing has stopped for them */
+  if ( doc->limitExceeded == TidyMaxMessages )
+    go = no;
+
   switch ( level )
   {
   case TidyInfo:
@@ -804,6 +808,22 @@ void TY_(ReportMarkupVersion)( TidyDocImpl* doc )
 }
 
 
+/* Reports the first max-* option exceeded while parsing, which stops the
+** parse. The option is recorded after the report, so that this message
+** itself is shown even when it is max-messages that ran out.
+*/
+void TY_(ReportLimit)( TidyDocImpl* doc, TidyOptionId limit )
+{
+    const TidyOptionImpl* option = TY_(getOption)( limit );
+
+    assert( option != NULL );
+    messageLexer( doc, TidyError, STRING_LIMIT_EXCEEDED,
+                  tidyLocalizedString(STRING_LIMIT_EXCEEDED),
+                  option->name, cfg(doc, limit) );
+    doc->limitExceeded = limit;
+}
+
+
 void TY_(ReportMissingAttr)( TidyDocImpl* doc, Node* node, ctmbstr name )
 {
     char tagdesc[ 64 ];
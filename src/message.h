@@ -60,6 +60,7 @@ void TY_(ReportEncodingError)(TidyDocImpl* doc, uint code, uint c, Bool discarde
 void TY_(ReportEncodingWarning)(TidyDocImpl* doc, uint code, uint encoding);
 void TY_(ReportEntityError)( TidyDocImpl* doc, uint code, ctmbstr entity, int c );
 void TY_(ReportMarkupVersion)( TidyDocImpl* doc );
+void TY_(ReportLimit)( TidyDocImpl* doc, TidyOptionId limit );
 void TY_(ReportMissingAttr)( TidyDocImpl* doc, Node* node, ctmbstr name );
 void TY_(ReportSurrogateError)(TidyDocImpl* doc, uint code, uint c1, uint c2);
 void TY_(ReportUnknownOption)( TidyDocImpl* doc, ctmbstr option );
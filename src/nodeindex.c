@@ -0,0 +1,567 @@
+/* nodeindex.c -- find elements by tag, id and class
+
+  Copyright 2026 HTACG
+  See tidy.h for the copyright notice.
+
+  Two passes over the tree count the elements for each tag, id and
+  class name, then file them in document order.  Rather than follow
+  the tree through RemoveNode() and the InsertNode*() helpers, which
+  are not given the document, the index is dropped by FreeNode() and
+  as parsing, clean and repair and saving start and end.  Each drop
+  starts a new generation.  The changes made through the API are
+  followed in place: an element discarded, or its class, is replaced
+  in the lists by a marker that iterators step over, and a discarded
+  id has the ids filed again on the next query.
+
+  An iterator belongs to the document and remembers the generation of
+  the list it points into and the last element it returned.  When the
+  generation has moved on, it takes the list from the rebuilt index
+  and carries on after that element in document order, so a dropped
+  index is freed at once.  An iterator ends when its last element is
+  freed, or the document is cleared, and is freed when it ends or with
+  the document.
+
+*/
+
+#include "tidy-int.h"
+#include "nodeindex.h"
+#include "attrs.h"
+#include "tags.h"
+#include "tmbstr.h"
+
+/* an id or class name, open addressing with linear probing */
+typedef struct _IndexKey
+{
+    tmbstr  name;       /* NULL for an empty slot */
+    uint    hash;
+    uint    count;      /* elements with the name */
+    Node*   first;      /* first of them, for ids */
+    Node*   last;       /* last one filed, for classes */
+    Node**  nodes;      /* all of them, for classes */
+} IndexKey;
+
+typedef struct _KeyTable
+{
+    IndexKey* keys;
+    uint      count;
+    uint      size;     /* allocated, always a power of 2 */
+} KeyTable;
+
+enum
+{
+    INDEX_HASH_SIZE=64u     /* initial size */
+};
+
+struct _NodeIndex
+{
+    Node**    tagNodes;             /* the elements of each tag in turn */
+    uint      tagStart[N_TIDY_TAGS];
+    uint      tagCount[N_TIDY_TAGS];
+    KeyTable  ids;
+    KeyTable  classes;
+    Node**    classNodes;           /* the elements of each class in turn */
+    Bool      idsStale;             /* an id was discarded since */
+};
+
+/* in place of an element that was discarded, or its class, so that
+   the lists don't move under their iterators */
+static Node discarded;
+
+struct _NodeIterator
+{
+    TidyTagId     tid;              /* the tag found, or */
+    tmbstr        className;        /* the class, if not NULL */
+    uint          generation;       /* of the index pos points into */
+    Node**        pos;              /* next in the list */
+    Node*         last;             /* returned before it, or NULL */
+    Bool          ended;
+    NodeIterator* next;             /* next of the document's iterators */
+};
+
+static uint keyHash( ctmbstr s, uint len )
+{
+    uint hashval = 0;
+
+    while ( len-- > 0 )
+        hashval = (byte)*s++ + 31*hashval;
+
+    return hashval;
+}
+
+/* slot of the name, or the empty slot where it belongs */
+static uint keySlot( IndexKey* keys, uint size, ctmbstr name, uint len,
+                     uint h )
+{
+    uint mask = size - 1;
+    uint i = h & mask;
+
+    for ( ; keys[i].name != NULL; i = (i + 1) & mask )
+    {
+        if ( keys[i].hash == h &&
+             TY_(tmbstrncmp)(keys[i].name, name, len) == 0 &&
+             keys[i].name[len] == '\0' )
+            break;
+    }
+    return i;
+}
+
+static IndexKey* findKey( KeyTable* table, ctmbstr name, uint len )
+{
+    IndexKey* key;
+
+    if ( table->count == 0 )
+        return NULL;
+    key = &table->keys[ keySlot(table->keys, table->size, name, len,
+                                keyHash(name, len)) ];
+    return key->name ? key : NULL;
+}
+
+static IndexKey* addKey( TidyDocImpl* doc, KeyTable* table,
+                         ctmbstr name, uint len )
+{
+    uint h = keyHash( name, len );
+    IndexKey* key;
+
+    /* keep the table at most half full */
+    if ( 2 * (table->count + 1) > table->size )
+    {
+        uint i, size = table->size ? 2 * table->size : INDEX_HASH_SIZE;
+        IndexKey* keys = (IndexKey*) TidyDocAlloc( doc, size * sizeof(IndexKey) );
+        TidyClearMemory( keys, size * sizeof(IndexKey) );
+
+        for ( i = 0; i < table->size; ++i )
+        {
+            IndexKey* old = &table->keys[i];
+            if ( old->name != NULL )
+                keys[ keySlot(keys, size, old->name,
+                              TY_(tmbstrlen)(old->name), old->hash) ] = *old;
+        }
+        TidyDocFree( doc, table->keys );
+        table->keys = keys;
+        table->size = size;
+    }
+
+    key = &table->keys[ keySlot(table->keys, table->size, name, len, h) ];
+    if ( key->name == NULL )
+    {
+        key->name = TY_(tmbstrndup)( doc->allocator, name, len );
+        key->hash = h;
+        table->count++;
+    }
+    return key;
+}
+
+static void freeKeys( TidyDocImpl* doc, KeyTable* table )
+{
+    uint i;
+    for ( i = 0; i < table->size; ++i )
+        TidyDocFree( doc, table->keys[i].name );
+    TidyDocFree( doc, table->keys );
+}
+
+/* next node in document order, or NULL past the last one */
+static Node* nextNode( Node* node, Node* root )
+{
+    if ( node->content )
+        return node->content;
+
+    for ( ; node && node != root; node = node->parent )
+    {
+        if ( node->next )
+            return node->next;
+    }
+    return NULL;
+}
+
+static TidyTagId tagOf( Node* node )
+{
+    return node->tag ? node->tag->id : TidyTag_UNKNOWN;
+}
+
+/* the next name in a class attribute value, or NULL after the last */
+static ctmbstr nextClassName( ctmbstr* s, uint* len )
+{
+    ctmbstr name;
+
+    while ( TY_(IsWhite)((byte)**s) )
+        ++*s;
+    if ( **s == '\0' )
+        return NULL;
+    for ( name = *s; **s && !TY_(IsWhite)((byte)**s); ++*s )
+        /**/;
+    *len = (uint)( *s - name );
+    return name;
+}
+
+static void indexId( TidyDocImpl* doc, NodeIndex* index, Node* node )
+{
+    AttVal* av = TY_(AttrGetById)( node, TidyAttr_ID );
+
+    if ( AttrHasValue(av) )
+    {
+        IndexKey* key = addKey( doc, &index->ids, av->value,
+                                TY_(tmbstrlen)(av->value) );
+        if ( key->count++ == 0 )
+            key->first = node;
+    }
+}
+
+/* count the elements, or with fill, file them */
+static void indexTree( TidyDocImpl* doc, NodeIndex* index, Bool fill )
+{
+    Node* node;
+
+    for ( node = doc->root.content; node; node = nextNode(node, &doc->root) )
+    {
+        AttVal* av;
+        TidyTagId tid;
+
+        if ( !TY_(nodeIsElement)(node) )
+            continue;
+
+        tid = tagOf( node );
+        if ( fill )
+            index->tagNodes[ index->tagStart[tid] + index->tagCount[tid]++ ] = node;
+        else
+        {
+            index->tagCount[tid]++;
+            indexId( doc, index, node );
+        }
+
+        av = TY_(AttrGetById)( node, TidyAttr_CLASS );
+        if ( AttrHasValue(av) )
+        {
+            ctmbstr s = av->value, name;
+            uint len;
+
+            while ( (name = nextClassName(&s, &len)) != NULL )
+            {
+                IndexKey* key = fill ? findKey( &index->classes, name, len )
+                                     : addKey( doc, &index->classes, name, len );
+
+                /* a name given twice files the element once */
+                if ( key->last == node )
+                    continue;
+                key->last = node;
+                if ( fill )
+                    key->nodes[ key->count ] = node;
+                key->count++;
+            }
+        }
+    }
+}
+
+static NodeIndex* buildIndex( TidyDocImpl* doc )
+{
+    NodeIndex* index = (NodeIndex*) TidyDocAlloc( doc, sizeof(NodeIndex) );
+    uint i, total = 0;
+
+    TidyClearMemory( index, sizeof(NodeIndex) );
+    indexTree( doc, index, no );
+
+    /* each list is followed by a NULL */
+    for ( i = 0; i < N_TIDY_TAGS; ++i )
+    {
+        index->tagStart[i] = total;
+        total += index->tagCount[i] + 1;
+        index->tagCount[i] = 0;
+    }
+    index->tagNodes = (Node**) TidyDocAlloc( doc, total * sizeof(Node*) );
+    TidyClearMemory( index->tagNodes, total * sizeof(Node*) );
+
+    total = 0;
+    for ( i = 0; i < index->classes.size; ++i )
+        total += index->classes.keys[i].count + 1;
+    if ( total > 0 )
+    {
+        index->classNodes = (Node**) TidyDocAlloc( doc, total * sizeof(Node*) );
+        TidyClearMemory( index->classNodes, total * sizeof(Node*) );
+    }
+
+    total = 0;
+    for ( i = 0; i < index->classes.size; ++i )
+    {
+        IndexKey* key = &index->classes.keys[i];
+        if ( key->name == NULL )
+            continue;
+        key->nodes = index->classNodes + total;
+        total += key->count + 1;
+        key->count = 0;
+        key->last = NULL;
+    }
+
+    indexTree( doc, index, yes );
+    return index;
+}
+
+static NodeIndex* getIndex( TidyDocImpl* doc )
+{
+    if ( doc->nodeIndex == NULL )
+        doc->nodeIndex = buildIndex( doc );
+    return doc->nodeIndex;
+}
+
+void TY_(FreeNodeIndex)( TidyDocImpl* doc )
+{
+    NodeIndex* index = doc->nodeIndex;
+
+    if ( index == NULL )
+        return;
+
+    doc->nodeIndex = NULL;
+    doc->indexGeneration++;
+    freeKeys( doc, &index->ids );
+    freeKeys( doc, &index->classes );
+    TidyDocFree( doc, index->classNodes );
+    TidyDocFree( doc, index->tagNodes );
+    TidyDocFree( doc, index );
+}
+
+static Node** tagList( TidyDocImpl* doc, TidyTagId tid )
+{
+    NodeIndex* index = getIndex( doc );
+    return index->tagNodes + index->tagStart[tid];
+}
+
+static Node** classList( TidyDocImpl* doc, ctmbstr name )
+{
+    IndexKey* key = findKey( &getIndex(doc)->classes, name, TY_(tmbstrlen)(name) );
+    return key ? key->nodes : NULL;
+}
+
+static NodeIterator* newIterator( TidyDocImpl* doc, Node** nodes,
+                                  TidyTagId tid, ctmbstr className )
+{
+    NodeIterator* iter;
+
+    if ( nodes == NULL || *nodes == NULL )
+        return NULL;
+
+    iter = (NodeIterator*) TidyDocAlloc( doc, sizeof(NodeIterator) );
+    TidyClearMemory( iter, sizeof(NodeIterator) );
+    iter->tid = tid;
+    if ( className )
+        iter->className = TY_(tmbstrdup)( doc->allocator, className );
+    iter->generation = doc->indexGeneration;
+    iter->pos = nodes;
+    iter->next = doc->nodeIterators;
+    doc->nodeIterators = iter;
+    return iter;
+}
+
+static void freeIterator( TidyDocImpl* doc, NodeIterator* iter )
+{
+    NodeIterator** link = &doc->nodeIterators;
+
+    while ( *link != iter )
+        link = &(*link)->next;
+    *link = iter->next;
+    TidyDocFree( doc, iter->className );
+    TidyDocFree( doc, iter );
+}
+
+/* the entry of nodes after last in document order, or NULL if last
+   is no longer in the tree */
+static Node** resumeAfter( TidyDocImpl* doc, Node** nodes, Node* last )
+{
+    Node* node;
+
+    for ( node = doc->root.content; node; node = nextNode(node, &doc->root) )
+    {
+        if ( *nodes == node )
+            ++nodes;
+        if ( node == last )
+            return nodes;
+    }
+    return NULL;
+}
+
+NodeIterator* TY_(IndexFindTag)( TidyDocImpl* doc, TidyTagId tid )
+{
+    return newIterator( doc, tagList(doc, tid), tid, NULL );
+}
+
+NodeIterator* TY_(IndexFindClass)( TidyDocImpl* doc, ctmbstr name )
+{
+    return newIterator( doc, classList(doc, name), TidyTag_UNKNOWN, name );
+}
+
+Node* TY_(IndexNextFound)( TidyDocImpl* doc, NodeIterator** piter )
+{
+    NodeIterator* iter = *piter;
+    Node* node = NULL;
+
+    if ( iter == NULL )
+        return NULL;
+
+    if ( !iter->ended && iter->generation != doc->indexGeneration )
+    {
+        Node** nodes = iter->className ? classList( doc, iter->className )
+                                       : tagList( doc, iter->tid );
+
+        if ( nodes && iter->last )
+            nodes = resumeAfter( doc, nodes, iter->last );
+        iter->pos = nodes;
+        iter->generation = doc->indexGeneration;
+        iter->ended = ( nodes == NULL );
+    }
+
+    if ( !iter->ended )
+    {
+        while ( *iter->pos == &discarded )
+            iter->pos++;
+        node = *iter->pos;
+        while ( node && *++iter->pos == &discarded )
+            /**/;
+    }
+
+    /* like the option iterators, NULL after the last one */
+    if ( node == NULL || *iter->pos == NULL )
+    {
+        freeIterator( doc, iter );
+        *piter = NULL;
+    }
+    else
+        iter->last = node;
+    return node;
+}
+
+Node* TY_(IndexFindId)( TidyDocImpl* doc, ctmbstr id )
+{
+    NodeIndex* index = getIndex( doc );
+    IndexKey* key;
+
+    if ( index->idsStale )
+    {
+        Node* node;
+
+        freeKeys( doc, &index->ids );
+        TidyClearMemory( &index->ids, sizeof(KeyTable) );
+        for ( node = doc->root.content; node; node = nextNode(node, &doc->root) )
+        {
+            if ( TY_(nodeIsElement)(node) )
+                indexId( doc, index, node );
+        }
+        index->idsStale = no;
+    }
+    key = findKey( &index->ids, id, TY_(tmbstrlen)(id) );
+    return key ? key->first : NULL;
+}
+
+/* an id is about to be discarded: the ids are filed again on the next
+   query, the lists of tags and classes stay as they are */
+void TY_(IndexDiscardId)( TidyDocImpl* doc )
+{
+    if ( doc->nodeIndex )
+        doc->nodeIndex->idsStale = yes;
+}
+
+/* takes node out of a list in place */
+static void unfile( Node** nodes, Node* node )
+{
+    for ( ; nodes && *nodes; ++nodes )
+    {
+        if ( *nodes == node )
+        {
+            *nodes = &discarded;
+            break;
+        }
+    }
+}
+
+static void unfileClass( NodeIndex* index, Node* node, ctmbstr value )
+{
+    ctmbstr name;
+    uint len;
+
+    while ( (name = nextClassName(&value, &len)) != NULL )
+    {
+        IndexKey* key = findKey( &index->classes, name, len );
+        if ( key )
+            unfile( key->nodes, node );
+    }
+}
+
+/* the class of node is about to be discarded */
+void TY_(IndexDiscardClass)( TidyDocImpl* doc, Node* node, ctmbstr value )
+{
+    if ( doc->nodeIndex && value )
+        unfileClass( doc->nodeIndex, node, value );
+}
+
+/* node is about to be taken out of the tree, and freed.  Its elements
+   are taken out of the index in place.  Iterators that returned one of
+   them go back to the node before it, in case the index is rebuilt. */
+void TY_(IndexDiscardNode)( TidyDocImpl* doc, Node* node )
+{
+    NodeIndex* index = doc->nodeIndex;
+    NodeIterator* iter;
+    Node *before, *elem;
+
+    for ( elem = node; index && elem; elem = nextNode(elem, node) )
+    {
+        AttVal* av;
+
+        if ( !TY_(nodeIsElement)(elem) )
+            continue;
+        unfile( index->tagNodes + index->tagStart[tagOf(elem)], elem );
+        av = TY_(AttrGetById)( elem, TidyAttr_CLASS );
+        if ( AttrHasValue(av) )
+            unfileClass( index, elem, av->value );
+        if ( TY_(AttrGetById)(elem, TidyAttr_ID) )
+            index->idsStale = yes;
+    }
+
+    if ( node->prev )
+        for ( before = node->prev; before->last; before = before->last )
+            /**/;
+    else
+        before = node->parent;
+    if ( before == &doc->root )
+        before = NULL;
+
+    for ( iter = doc->nodeIterators; iter; iter = iter->next )
+    {
+        Node* last;
+
+        for ( last = iter->last; last && last != node; last = last->parent )
+            /**/;
+        if ( last == node )
+            iter->last = before;
+    }
+}
+
+/* node is being freed, an iterator that returned it can't carry on */
+void TY_(IndexFreeNode)( TidyDocImpl* doc, Node* node )
+{
+    NodeIterator* iter;
+
+    for ( iter = doc->nodeIterators; iter; iter = iter->next )
+        if ( iter->last == node )
+            iter->ended = yes;
+}
+
+void TY_(EndNodeIterators)( TidyDocImpl* doc )
+{
+    NodeIterator* iter;
+
+    TY_(FreeNodeIndex)( doc );
+    for ( iter = doc->nodeIterators; iter; iter = iter->next )
+        iter->ended = yes;
+}
+
+void TY_(FreeNodeIterators)( TidyDocImpl* doc )
+{
+    TY_(FreeNodeIndex)( doc );
+    while ( doc->nodeIterators )
+        freeIterator( doc, doc->nodeIterators );
+}
+
+/*
+ * local variables:
+ * mode: c
+ * indent-tabs-mode: nil
+ * c-basic-offset: 4
+ * eval: (c-set-offset 'substatement-open 0)
+ * end:
+ */
@@ -0,0 +1,32 @@
+#ifndef __NODEINDEX_H__
+#define __NODEINDEX_H__
+
+/* nodeindex.h -- find elements by tag, id and class
+
+  Copyright 2026 HTACG
+  See tidy.h for the copyright notice.
+
+  The index is built on the first query, kept up to date through the
+  API's discards and dropped whenever else the tree may change, see
+  nodeindex.c.  Lists of nodes are NULL terminated and in document
+  order.  Iterators over them carry on through a rebuilt index, and go
+  with the document.
+
+*/
+
+#include "forward.h"
+
+void   TY_(FreeNodeIndex)( TidyDocImpl* doc );
+void   TY_(EndNodeIterators)( TidyDocImpl* doc );
+void   TY_(FreeNodeIterators)( TidyDocImpl* doc );
+void   TY_(IndexDiscardId)( TidyDocImpl* doc );
+void   TY_(IndexDiscardClass)( TidyDocImpl* doc, Node* node, ctmbstr value );
+void   TY_(IndexDiscardNode)( TidyDocImpl* doc, Node* node );
+void   TY_(IndexFreeNode)( TidyDocImpl* doc, Node* node );
+
+Node*  TY_(IndexFindId)( TidyDocImpl* doc, ctmbstr id );
+NodeIterator* TY_(IndexFindTag)( TidyDocImpl* doc, TidyTagId tid );
+NodeIterator* TY_(IndexFindClass)( TidyDocImpl* doc, ctmbstr name );
+Node*  TY_(IndexNextFound)( TidyDocImpl* doc, NodeIterator** piter );
+
+#endif /* __NODEINDEX_H__ */
@@ -31,7 +31,7 @@
 #define showingBodyOnly(doc) (cfgAutoBool(doc,TidyBodyOnly) == TidyYesState) ? yes : no
 
 
-Bool TY_(CheckNodeIntegrity)(Node *node)
+Bool TY_(CheckNodeLinks)(Node *node)
 {
 #ifndef NO_NODE_INTEGRITY_CHECK
     Node *child;
@@ -58,7 +58,23 @@ Bool TY_(CheckNodeIntegrity)(Node *node)
     }
 
     for (child = node->content; child; child = child->next)
-        if ( child->parent != node || !TY_(CheckNodeIntegrity)(child) )
+        if ( child->parent != node )
+            return no;
+
+#endif
+    return yes;
+}
+
+Bool TY_(CheckNodeIntegrity)(Node *node)
+{
+#ifndef NO_NODE_INTEGRITY_CHECK
+    Node *child;
+
+    if ( !TY_(CheckNodeLinks)(node) )
+        return no;
+
+    for (child = node->content; child; child = child->next)
+        if ( !TY_(CheckNodeIntegrity)(child) )
             return no;
 
 #endif
@@ -82,7 +98,7 @@ Bool TY_(IsNewNode)(Node *node)
 
 void TY_(CoerceNode)(TidyDocImpl* doc, Node *node, TidyTagId tid, Bool obsolete, Bool unexpected)
 {
-    const Dict* tag = TY_(LookupTagDef)(tid);
+    const Dict* tag = TY_(LookupTagDef)(doc, tid);
     Node* tmp = TY_(InferredTag)(doc, tag->id);
 
     if (obsolete)
@@ -627,36 +643,24 @@ static Bool CleanLeadingWhitespace(TidyDocImpl* ARG_UNUSED(doc), Node* node)
     return no;
 }
 
-static void CleanSpaces(TidyDocImpl* doc, Node* node)
+/* returns yes if node was left empty and has been discarded */
+static Bool CleanSpacesNode(TidyDocImpl* doc, Node* node)
 {
-    Node* next;
-
-    while (node)
-    {
-        next = node->next;
-
-        if (TY_(nodeIsText)(node) && CleanLeadingWhitespace(doc, node))
-            while (node->start < node->end && TY_(IsWhite)(doc->lexer->lexbuf[node->start]))
-                ++(node->start);
-
-        if (TY_(nodeIsText)(node) && CleanTrailingWhitespace(doc, node))
-            while (node->end > node->start && TY_(IsWhite)(doc->lexer->lexbuf[node->end - 1]))
-                --(node->end);
-
-        if (TY_(nodeIsText)(node) && !(node->start < node->end))
-        {
-            TY_(RemoveNode)(node);
-            TY_(FreeNode)(doc, node);
-            node = next;
-
-            continue;
-        }
+    if (TY_(nodeIsText)(node) && CleanLeadingWhitespace(doc, node))
+        while (node->start < node->end && TY_(IsWhite)(doc->lexer->lexbuf[node->start]))
+            ++(node->start);
 
-        if (node->content)
-            CleanSpaces(doc, node->content);
+    if (TY_(nodeIsText)(node) && CleanTrailingWhitespace(doc, node))
+        while (node->end > node->start && TY_(IsWhite)(doc->lexer->lexbuf[node->end - 1]))
+            --(node->end);
 
-        node = next;
+    if (TY_(nodeIsText)(node) && !(node->start < node->end))
+    {
+        TY_(RemoveNode)(node);
+        TY_(FreeNode)(doc, node);
+        return yes;
     }
+    return no;
 }
 
 /* 
@@ -771,7 +775,11 @@ static void ParseTag( TidyDocImpl* doc, Node *node, GetTokenMode mode )
 
     lexer->parent = node; /* [i_a]2 added this - not sure why - CHECKME: */
 
-    (*node->tag->parser)( doc, node, mode );
+    /* max-depth bounds this recursion, an element past it is left empty */
+    ++lexer->depth;
+    if ( !TY_(LimitExceeded)(doc) )
+        (*node->tag->parser)( doc, node, mode );
+    --lexer->depth;
 }
 
 /*
@@ -812,6 +820,10 @@ static void MoveToHead( TidyDocImpl* doc, Node *element, Node *node )
         head = TY_(FindHEAD)(doc);
         assert(head != NULL);
 
+        /* the head of streamed output has already been written */
+        if ( doc->streaming )
+            head = element;
+
         TY_(InsertNodeAtEnd)(head, node);
 
         if ( node->tag->parser )
@@ -1260,7 +1272,7 @@ void TY_(ParseBlock)( TidyDocImpl* doc, Node *element, GetTokenMode mode)
                         node = element->parent;
                         TidyDocFree(doc, node->element);
                         node->element = TY_(tmbstrdup)(doc->allocator, "th");
-                        node->tag = TY_(LookupTagDef)( TidyTag_TH );
+                        node->tag = TY_(LookupTagDef)( doc, TidyTag_TH );
                         continue;
                     }
                 }
@@ -1836,7 +1848,7 @@ void TY_(ParseInline)( TidyDocImpl* doc, Node *element, GetTokenMode mode )
              )
            )
         {
-            node->tag = TY_(LookupTagDef)( TidyTag_BR );
+            node->tag = TY_(LookupTagDef)( doc, TidyTag_BR );
             TidyDocFree(doc, node->element);
             node->element = TY_(tmbstrdup)(doc->allocator, "br");
             TrimSpaces(doc, element);
@@ -3894,11 +3906,15 @@ Bool TY_(FindNodeById)( TidyDocImpl* doc, TidyTagId tid )
 }
 
 
+static void StartStreamedBody( TidyDocImpl* doc, Node* body );
+static void StreamBody( TidyDocImpl* doc, Node* body, Bool all );
+
 void TY_(ParseBody)(TidyDocImpl* doc, Node *body, GetTokenMode mode)
 {
     Lexer* lexer = doc->lexer;
     Node *node;
     Bool checkstack, iswhitenode;
+    Bool streaming;
 
     mode = IgnoreWhitespace;
     checkstack = yes;
@@ -3908,8 +3924,18 @@ void TY_(ParseBody)(TidyDocImpl* doc, Node *body, GetTokenMode mode)
     SPRTF("Enter ParseBody...\n");
 #endif
 
+    if ( doc->streamSink && !doc->streaming && !doc->streamed &&
+         body->content == NULL && nodeIsHTML(body->parent) &&
+         body->parent->parent == &doc->root )
+        StartStreamedBody( doc, body );
+    streaming = doc->streaming && nodeIsHTML(body->parent);
+
     while ((node = TY_(GetToken)(doc, mode)) != NULL)
     {
+        /* write out the children that are complete */
+        if ( streaming )
+            StreamBody( doc, body, no );
+
         /* find and discard multiple <body> elements */
         if (node->tag == body->tag && node->type == StartTag)
         {
@@ -4381,6 +4407,7 @@ void TY_(ParseHTML)(TidyDocImpl* doc, Node *html, GetTokenMode mode)
     SPRTF("Entering ParseHTML...\n");
 #endif
     TY_(SetOptionBool)( doc, TidyXmlTags, no );
+    doc->lexer->xmlTags = no;
 
     for (;;)
     {
@@ -4455,6 +4482,21 @@ void TY_(ParseHTML)(TidyDocImpl* doc, Node *html, GetTokenMode mode)
         if (InsertMisc(html, node))
             continue;
 
+        /* stop at the first thing that does not belong in the head,
+           leaving the rest of the input unread and the body empty */
+        if ( cfgBool(doc, TidyParseHeadOnly) &&
+             !(TY_(nodeIsElement)(node) && node->tag &&
+               (node->tag->model & CM_HEAD)) )
+        {
+            if ( !(nodeIsBODY(node) && node->type == StartTag) )
+            {
+                TY_(UngetToken)( doc );
+                node = TY_(InferredTag)(doc, TidyTag_BODY);
+            }
+            TY_(InsertNodeAtEnd)(html, node);
+            return;
+        }
+
         /* if frameset document coerce <body> to <noframes> */
         if ( nodeIsBODY(node) )
         {
@@ -4649,47 +4691,33 @@ static void EncloseBodyText(TidyDocImpl* doc)
 
 /* <form>, <blockquote> and <noscript> do not allow #PCDATA in
    HTML 4.01 Strict (%block; model instead of %flow;).
-  When requested, text nodes in these elements are wrapped in <p>. */
-static void EncloseBlockText(TidyDocImpl* doc, Node* node)
+  When requested, text nodes in these elements are wrapped in <p>.
+  Only the leading run of inline content is wrapped. */
+static void EncloseBlockTextNode(TidyDocImpl* doc, Node* node)
 {
-    Node *next;
     Node *block;
 
-    while (node)
-    {
-        next = node->next;
-
-        if (node->content)
-            EncloseBlockText(doc, node->content);
-
-        if (!(nodeIsFORM(node) || nodeIsNOSCRIPT(node) ||
-              nodeIsBLOCKQUOTE(node))
-            || !node->content)
-        {
-            node = next;
-            continue;
-        }
+    if (!(nodeIsFORM(node) || nodeIsNOSCRIPT(node) ||
+          nodeIsBLOCKQUOTE(node))
+        || !node->content)
+        return;
 
-        block = node->content;
+    block = node->content;
 
-        if ((TY_(nodeIsText)(block) && !TY_(IsBlank)(doc->lexer, block)) ||
-            (TY_(nodeIsElement)(block) && nodeCMIsOnlyInline(block)))
+    if ((TY_(nodeIsText)(block) && !TY_(IsBlank)(doc->lexer, block)) ||
+        (TY_(nodeIsElement)(block) && nodeCMIsOnlyInline(block)))
+    {
+        Node* p = TY_(InferredTag)(doc, TidyTag_P);
+        TY_(InsertNodeBeforeElement)(block, p);
+        while (block &&
+               (!TY_(nodeIsElement)(block) || nodeCMIsOnlyInline(block)))
         {
-            Node* p = TY_(InferredTag)(doc, TidyTag_P);
-            TY_(InsertNodeBeforeElement)(block, p);
-            while (block &&
-                   (!TY_(nodeIsElement)(block) || nodeCMIsOnlyInline(block)))
-            {
-                Node* tempNext = block->next;
-                TY_(RemoveNode)(block);
-                TY_(InsertNodeAtEnd)(p, block);
-                block = tempNext;
-            }
-            TrimSpaces(doc, p);
-            continue;
+            Node* tempNext = block->next;
+            TY_(RemoveNode)(block);
+            TY_(InsertNodeAtEnd)(p, block);
+            block = tempNext;
         }
-
-        node = next;
+        TrimSpaces(doc, p);
     }
 }
 
@@ -4717,6 +4745,39 @@ static void ReplaceObsoleteElements(TidyDocImpl* doc, Node* node)
     }
 }
 
+static Bool CleanSpacesVisitor( TidyDocImpl* doc, Node* node,
+                                Node** ARG_UNUSED(pnext), void* ARG_UNUSED(data) )
+{
+    return CleanSpacesNode( doc, node );
+}
+
+static Bool EncloseBlockTextVisitor( TidyDocImpl* doc, Node* node,
+                                     Node** ARG_UNUSED(pnext), void* ARG_UNUSED(data) )
+{
+    EncloseBlockTextNode( doc, node );
+    return no;
+}
+
+/*
+  Neither rule reports anything. CleanSpaces only looks at the node,
+  its siblings and its ancestors, which the post-order wrapping of
+  block text below them leaves alone, and EncloseBodyText only looks
+  at the children of <body>, so it is still applied afterwards.
+*/
+static void CleanSpacesAndEncloseBlockText(TidyDocImpl* doc)
+{
+    static const TidyTagId blockTextTags[] =
+        { TidyTag_BLOCKQUOTE, TidyTag_FORM, TidyTag_NOSCRIPT, TidyTag_UNKNOWN };
+    NodeVisitors visitors;
+
+    TY_(InitNodeVisitors)( &visitors );
+    TY_(AddNodeVisitor)( &visitors, CleanSpacesVisitor, NULL, no, NULL );
+    if (cfgBool(doc, TidyEncloseBlockText))
+        TY_(AddNodeVisitor)( &visitors, EncloseBlockTextVisitor, NULL, yes, blockTextTags );
+
+    TY_(VisitNodes)( doc, &visitors, &doc->root );
+}
+
 static void AttributeChecks(TidyDocImpl* doc, Node* node)
 {
     Node *next;
@@ -4741,6 +4802,219 @@ static void AttributeChecks(TidyDocImpl* doc, Node* node)
     }
 }
 
+/*
+  Checks and fixes on the whole tree once it has been parsed.
+
+  These are not run as the parser closes each element. AttributeChecks,
+  ReplaceObsoleteElements and DropEmptyElements report messages, and
+  must keep their order in the report. CleanSpaces and EncloseBlockText
+  report nothing, but depend on the other passes. CleanSpaces looks at
+  siblings that DropEmptyElements may still remove, and at ancestors
+  that ReplaceObsoleteElements may still turn into <pre>. The parser
+  also still moves closed elements about, as with misplaced table
+  content. So the walks only stay fewer: the two quiet passes share one
+  walk, and ReplaceObsoleteElements is skipped when the lexer saw no
+  obsolete element. Streamed output does apply these per child of
+  <body>, see below.
+*/
+static void CheckParsedTree(TidyDocImpl* doc)
+{
+    if (!TY_(FindTITLE)(doc))
+    {
+        Node* head = TY_(FindHEAD)(doc);
+        /* #72, avoid MISSING_TITLE_ELEMENT if show-body-only (but allow InsertNodeAtEnd to avoid new warning) */
+        if (!showingBodyOnly(doc))
+        {
+            TY_(ReportError)(doc, head, NULL, MISSING_TITLE_ELEMENT);
+        }
+        TY_(InsertNodeAtEnd)(head, TY_(InferredTag)(doc, TidyTag_TITLE));
+    }
+
+    AttributeChecks(doc, &doc->root);
+
+    /* nothing to replace unless the lexer has seen an obsolete element */
+    if (doc->lexer->seenObsolete)
+        ReplaceObsoleteElements(doc, &doc->root);
+
+    TY_(DropEmptyElements)(doc, &doc->root);
+    CleanSpacesAndEncloseBlockText(doc);
+
+    if (cfgBool(doc, TidyEncloseBodyText))
+        EncloseBodyText(doc);
+}
+
+/*
+  Streamed output, see tidySetStreamingOutput()
+
+  Once the head is complete, the tree so far is checked, repaired
+  and written up to the start tag of <body>. Each child of <body>
+  then gets the checks above, and the repairs of tidyCleanAndRepair,
+  on its own, before it is written and freed. A child only moves on
+  once its neighbours are far enough along that the result is the
+  same as for the whole tree:
+
+  - it is checked once two more siblings follow it, as closing an
+    inline element may still add a space to the sibling before it;
+  - its spaces are cleaned once its next sibling has been checked,
+    as that looks at the siblings either side;
+  - it is repaired and written once its next sibling has been
+    cleaned. The last child written stays in the tree as the
+    previous sibling of the next one.
+*/
+
+typedef void (TreePass)( TidyDocImpl* doc, Node* node );
+
+/* the passes also walk the later siblings, which are not ready yet */
+static void PassOverTree( TidyDocImpl* doc, Node* node, TreePass* pass )
+{
+    Node* next = node->next;
+    Node* last = node->parent->last;
+
+    node->next = NULL;
+    node->parent->last = node;
+    pass( doc, node );
+    node->next = next;
+    node->parent->last = last;
+}
+
+/* returns yes if node was empty and has been discarded */
+static Bool CheckStreamedNode( TidyDocImpl* doc, Node* node )
+{
+    PassOverTree( doc, node, AttributeChecks );
+
+    if (doc->lexer->seenObsolete)
+        PassOverTree( doc, node, ReplaceObsoleteElements );
+
+    if (node->content)
+        TY_(DropEmptyElements)(doc, node->content);
+
+    if ((TY_(nodeIsElement)(node) ||
+         (TY_(nodeIsText)(node) && !(node->start < node->end))) &&
+        CanPrune(doc, node))
+    {
+        TY_(TrimEmptyElement)(doc, node);
+        return yes;
+    }
+    return no;
+}
+
+/* returns yes if node was left empty and has been discarded */
+static Bool CleanStreamedNode( TidyDocImpl* doc, Node* node,
+                               const NodeVisitors* visitors )
+{
+    if (CleanSpacesNode(doc, node))
+        return yes;
+
+    if (node->content)
+        TY_(VisitNodes)( doc, visitors, node->content );
+    return no;
+}
+
+static void WriteStreamedNode( TidyDocImpl* doc, Node* node )
+{
+    PassOverTree( doc, node, TY_(RepairStreamedNode) );
+    TY_(PPrintStreamNode)( doc, node );
+}
+
+static void FreeStreamedNode( TidyDocImpl* doc, Node* node )
+{
+    TY_(RetireAnchors)( doc, node );
+    TY_(RemoveNode)( node );
+    TY_(FreeNode)( doc, node );
+}
+
+static void StartStreamedBody( TidyDocImpl* doc, Node* body )
+{
+    if ( body->type != StartTag || body->parent->type != StartTag ||
+         !TY_(CanStreamOutput)(doc) )
+        return;
+
+    doc->streaming = yes;
+    CheckParsedTree( doc );
+    TY_(StartStreamedOutput)( doc, body );
+}
+
+/* the child of body after node, the first one if node is NULL */
+static Node* StreamedNext( Node* body, Node* node )
+{
+    return node ? node->next : body->content;
+}
+
+/* moves the children of body on as far as they can go, see above */
+static void StreamBody( TidyDocImpl* doc, Node* body, Bool all )
+{
+    NodeVisitors visitors;
+    Node *node, *prev;
+
+    while ((node = StreamedNext(body, doc->streamChecked)) != NULL &&
+           (all || (node->next && node->next->next)))
+    {
+        if (!CheckStreamedNode(doc, node))
+            doc->streamChecked = node;
+    }
+
+    TY_(InitNodeVisitors)( &visitors );
+    TY_(AddNodeVisitor)( &visitors, CleanSpacesVisitor, NULL, no, NULL );
+
+    while (doc->streamCleaned != doc->streamChecked &&
+           (node = StreamedNext(body, doc->streamCleaned)) != NULL &&
+           (all || node != doc->streamChecked))
+    {
+        prev = node->prev;
+        if (!CleanStreamedNode(doc, node, &visitors))
+            doc->streamCleaned = node;
+        else if (doc->streamChecked == node)
+            doc->streamChecked = prev;
+    }
+
+    while (doc->streamPrinted != doc->streamCleaned &&
+           (node = StreamedNext(body, doc->streamPrinted)) != NULL &&
+           (all || node != doc->streamCleaned))
+    {
+        WriteStreamedNode( doc, node );
+        if (doc->streamPrinted)
+            FreeStreamedNode( doc, doc->streamPrinted );
+        doc->streamPrinted = node;
+    }
+}
+
+/* nodes after <body> go through all steps at once */
+static void StreamTrailingNodes( TidyDocImpl* doc, Node* node )
+{
+    NodeVisitors visitors;
+    Node* next;
+
+    TY_(InitNodeVisitors)( &visitors );
+    TY_(AddNodeVisitor)( &visitors, CleanSpacesVisitor, NULL, no, NULL );
+
+    for ( ; node; node = next )
+    {
+        next = node->next;
+        if (CheckStreamedNode(doc, node))
+            continue;
+        if (CleanStreamedNode(doc, node, &visitors))
+            continue;
+        WriteStreamedNode( doc, node );
+    }
+}
+
+static void EndStreamedBody( TidyDocImpl* doc )
+{
+    Node* body = TY_(FindBody)( doc );
+    Node* html = body->parent;
+
+    StreamBody( doc, body, yes );
+    if (doc->streamPrinted)
+        FreeStreamedNode( doc, doc->streamPrinted );
+    doc->streamChecked = doc->streamCleaned = doc->streamPrinted = NULL;
+
+    TY_(PPrintStreamEnd)( doc, body );
+    StreamTrailingNodes( doc, body->next );
+    TY_(PPrintStreamEnd)( doc, html );
+    StreamTrailingNodes( doc, html->next );
+    TY_(EndStreamedOutput)( doc );
+}
+
 /*
   HTML is the top level element
 */
@@ -4860,6 +5134,13 @@ void TY_(ParseDocument)(TidyDocImpl* doc)
         break;
     }
 
+    /* the checks have been applied while streaming */
+    if (doc->streaming)
+    {
+        EndStreamedBody(doc);
+        return;
+    }
+
 #if SUPPORT_ACCESSIBILITY_CHECKS
     /* do this before any more document fixes */
     if ( cfg( doc, TidyAccessibilityCheckLevel ) > 0 )
@@ -4874,26 +5155,75 @@ void TY_(ParseDocument)(TidyDocImpl* doc)
         TY_(ParseHTML)(doc, html, IgnoreWhitespace);
     }
 
-    if (!TY_(FindTITLE)(doc))
+    CheckParsedTree(doc);
+}
+
+/*
+  Token callback, see tidySetTokenCallback()
+
+  Each token is handed to the callback as it comes from the lexer
+  and freed again, so no tree is built. The only context kept is
+  what the lexer needs: script and style content is read as CDATA
+  and text inside <pre> and its kin is preformatted, as it is when
+  parsing. As no token outlives the callback, the lexer buffer is
+  rewound before each one and stays as large as the largest token.
+*/
+void TY_(ParseTokens)(TidyDocImpl* doc)
+{
+    Lexer* lexer = doc->lexer;
+    Node *node, *script = NULL;
+    uint pre = 0;
+    Bool more = yes;
+
+    while (more)
     {
-        Node* head = TY_(FindHEAD)(doc);
-        /* #72, avoid MISSING_TITLE_ELEMENT if show-body-only (but allow InsertNodeAtEnd to avoid new warning) */
-        if (!showingBodyOnly(doc))
+        lexer->lexsize = 0;
+
+        if (script)
         {
-            TY_(ReportError)(doc, head, NULL, MISSING_TITLE_ELEMENT);
+            lexer->parent = script;
+            node = TY_(GetToken)(doc, CdataContent);
+            lexer->parent = NULL;
+            TY_(FreeNode)(doc, script);
+            script = NULL;
         }
-        TY_(InsertNodeAtEnd)(head, TY_(InferredTag)(doc, TidyTag_TITLE));
-    }
+        else
+            node = TY_(GetToken)(doc, pre ? Preformatted : MixedContent);
 
-    AttributeChecks(doc, &doc->root);
-    ReplaceObsoleteElements(doc, &doc->root);
-    TY_(DropEmptyElements)(doc, &doc->root);
-    CleanSpaces(doc, &doc->root);
+        if (node == NULL)
+            break;
 
-    if (cfgBool(doc, TidyEncloseBodyText))
-        EncloseBodyText(doc);
-    if (cfgBool(doc, TidyEncloseBlockText))
-        EncloseBlockText(doc, &doc->root);
+        /* an empty script yields an empty text node */
+        if (node->type == TextNode && node->end == node->start)
+        {
+            TY_(FreeNode)(doc, node);
+            continue;
+        }
+
+        more = doc->tokenCallback( tidyImplToDoc(doc), tidyImplToNode(node) );
+
+        if (!lexer->xmlTags && node->tag)
+        {
+            if (node->type == StartTag && node->tag->parser == TY_(ParseScript))
+            {
+                script = node;
+                continue;
+            }
+
+            if (node->tag->parser == TY_(ParsePre))
+            {
+                if (node->type == StartTag)
+                    ++pre;
+                else if (node->type == EndTag && pre > 0)
+                    --pre;
+            }
+        }
+
+        TY_(FreeNode)(doc, node);
+    }
+
+    if (script)
+        TY_(FreeNode)(doc, script);
 }
 
 Bool TY_(XMLPreserveWhiteSpace)( TidyDocImpl* doc, Node *element)
@@ -5014,6 +5344,7 @@ void TY_(ParseXMLDocument)(TidyDocImpl* doc)
     Node *node, *doctype = NULL;
 
     TY_(SetOptionBool)( doc, TidyXmlTags, yes );
+    doc->lexer->xmlTags = yes;
 
     while ((node = TY_(GetToken)(doc, IgnoreWhitespace)) != NULL)
     {
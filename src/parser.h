@@ -12,6 +12,9 @@
 
 Bool TY_(CheckNodeIntegrity)(Node *node);
 
+/* checks the links of node and of its immediate children only */
+Bool TY_(CheckNodeLinks)(Node *node);
+
 Bool TY_(TextNodeEndWithSpace)( Lexer *lexer, Node *node );
 
 /*
@@ -58,6 +61,10 @@ Bool TY_(IsJavaScript)(Node *node);
 */
 void TY_(ParseDocument)( TidyDocImpl* doc );
 
+/*
+  Hand each token to the token callback instead of building a tree
+*/
+void TY_(ParseTokens)( TidyDocImpl* doc );
 
 
 /*
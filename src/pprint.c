@@ -17,6 +17,10 @@
 #include "tmbstr.h"
 #include "utf8.h"
 
+#if SUPPORT_PARALLEL_PRINT
+#include <pthread.h>
+#endif
+
 /* *** FOR DEBUG ONLY *** */
 #if !defined(NDEBUG) && defined(_MSC_VER)
 /* #define DEBUG_PPRINT */
@@ -54,21 +58,6 @@ static Bool ShouldIndent( TidyDocImpl* doc, Node *node );
 #define TidyClassicVS ((cfgAutoBool( doc, TidyVertSpace ) == TidyYesState) ? yes : no)
 #define TidyAddVS ((cfgAutoBool( doc, TidyVertSpace ) == TidyAutoState) ? no : yes )
 
-/*\
- * 20150515 - support using tabs instead of spaces - Issue #108
- * GH: https://github.com/htacg/tidy-html5/issues/108 - Keep indent with tabs #108
- * SF: https://sourceforge.net/p/tidy/feature-requests/3/ - #3 tabs in place of spaces
-\*/
-static uint indent_char = ' ';
-void TY_(PPrintTabs)(void)
-{
-    indent_char = '\t';
-}
-void TY_(PPrintSpaces)(void)
-{
-    indent_char = ' ';
-}
-
 #if SUPPORT_ASIAN_ENCODINGS
 /* #431953 - start RJ Wraplen adjusted for smooth international ride */
 
@@ -303,6 +292,7 @@ void TY_(InitPrintBuf)( TidyDocImpl* doc )
     InitIndent( &doc->pprint.indent[1] );
     doc->pprint.allocator = doc->allocator;
     doc->pprint.line = 0;
+    doc->pprint.indentChar = ' ';
 }
 
 void TY_(FreePrintBuf)( TidyDocImpl* doc )
@@ -311,6 +301,40 @@ void TY_(FreePrintBuf)( TidyDocImpl* doc )
     TY_(InitPrintBuf)( doc );
 }
 
+void TY_(ResolvePrintOptions)( TidyDocImpl* doc )
+{
+    TidyPrintImpl* pprint = &doc->pprint;
+
+    pprint->outenc = cfg( doc, TidyOutCharEncoding );
+    pprint->wraplen = cfg( doc, TidyWrapLen );
+    pprint->numEntities = cfgBool( doc, TidyNumEntities );
+    pprint->xmlTags = cfgBool( doc, TidyXmlTags );
+    pprint->quoteAmp = ( cfgBool(doc, TidyQuoteAmpersand) &&
+                         !cfgBool(doc, TidyPreserveEntities) );
+    pprint->quoteMarks = cfgBool( doc, TidyQuoteMarks );
+    pprint->quoteNbsp = cfgBool( doc, TidyQuoteNbsp );
+    pprint->punctWrap = cfgBool( doc, TidyPunctWrap );
+    /*\
+     * 20150515 - support using tabs instead of spaces - Issue #108
+     * GH: https://github.com/htacg/tidy-html5/issues/108 - Keep indent with tabs #108
+     * SF: https://sourceforge.net/p/tidy/feature-requests/3/ - #3 tabs in place of spaces
+    \*/
+    pprint->indentChar = cfgBool( doc, TidyPPrintTabs ) ? '\t' : ' ';
+    pprint->versionKnown = no;
+    pprint->version = VERS_UNKNOWN;
+}
+
+static int PrintVersion( TidyDocImpl* doc )
+{
+    TidyPrintImpl* pprint = &doc->pprint;
+    if ( !pprint->versionKnown )
+    {
+        pprint->version = TY_(HTMLVersion)( doc );
+        pprint->versionKnown = yes;
+    }
+    return pprint->version;
+}
+
 static void expand( TidyPrintImpl* pprint, uint len )
 {
     uint* ip;
@@ -409,21 +433,21 @@ static Bool WantIndent( TidyDocImpl* doc )
 
 static uint  WrapOff( TidyDocImpl* doc )
 {
-    uint saveWrap = cfg( doc, TidyWrapLen );
-    TY_(SetOptionInt)( doc, TidyWrapLen, 0xFFFFFFFF );  /* very large number */
+    uint saveWrap = doc->pprint.wraplen;
+    doc->pprint.wraplen = 0xFFFFFFFF;  /* very large number */
     return saveWrap;
 }
 
 static void  WrapOn( TidyDocImpl* doc, uint saveWrap )
 {
-    TY_(SetOptionInt)( doc, TidyWrapLen, saveWrap );
+    doc->pprint.wraplen = saveWrap;
 }
 
 static uint  WrapOffCond( TidyDocImpl* doc, Bool onoff )
 {
     if ( onoff )
         return WrapOff( doc );
-    return cfg( doc, TidyWrapLen );
+    return doc->pprint.wraplen;
 }
 
 
@@ -463,7 +487,7 @@ static uint AddString( TidyPrintImpl* pprint, ctmbstr str )
 static Bool SetWrap( TidyDocImpl* doc, uint indent )
 {
     TidyPrintImpl* pprint = &doc->pprint;
-    Bool wrap = ( indent + pprint->linelen < cfg(doc, TidyWrapLen) );
+    Bool wrap = ( indent + pprint->linelen < pprint->wraplen );
     if ( wrap )
     {
         if ( pprint->indent[0].spaces < 0 )
@@ -495,7 +519,7 @@ static Bool SetWrapAttr( TidyDocImpl* doc,
     TidyPrintImpl* pprint = &doc->pprint;
     TidyIndent *ind = pprint->indent + 0;
 
-    Bool wrap = ( indent + pprint->linelen < cfg(doc, TidyWrapLen) );
+    Bool wrap = ( indent + pprint->linelen < pprint->wraplen );
     if ( wrap )
     {
         if ( ind[0].spaces < 0 )
@@ -594,7 +618,7 @@ static void WrapLine( TidyDocImpl* doc )
     {
         uint spaces = GetSpaces( pprint );
         for ( i = 0; i < spaces; ++i )
-            TY_(WriteChar)( indent_char, doc->docOut ); /* 20150515 - Issue #108 */
+            TY_(WriteChar)( pprint->indentChar, doc->docOut ); /* 20150515 - Issue #108 */
     }
 
     for ( i = 0; i < pprint->wraphere; ++i )
@@ -615,7 +639,7 @@ static void WrapLine( TidyDocImpl* doc )
 static Bool CheckWrapLine( TidyDocImpl* doc )
 {
     TidyPrintImpl* pprint = &doc->pprint;
-    if ( GetSpaces(pprint) + pprint->linelen >= cfg(doc, TidyWrapLen) )
+    if ( GetSpaces(pprint) + pprint->linelen >= pprint->wraplen )
     {
         WrapLine( doc );
         return yes;
@@ -626,7 +650,7 @@ static Bool CheckWrapLine( TidyDocImpl* doc )
 static Bool CheckWrapIndent( TidyDocImpl* doc, uint indent )
 {
     TidyPrintImpl* pprint = &doc->pprint;
-    if ( GetSpaces(pprint) + pprint->linelen >= cfg(doc, TidyWrapLen) )
+    if ( GetSpaces(pprint) + pprint->linelen >= pprint->wraplen )
     {
         WrapLine( doc );
         if ( pprint->indent[ 0 ].spaces < 0 )
@@ -651,7 +675,7 @@ static void WrapAttrVal( TidyDocImpl* doc )
     {
         uint spaces = GetSpaces( pprint );
         for ( i = 0; i < spaces; ++i )
-            TY_(WriteChar)( indent_char, doc->docOut ); /* 20150515 - Issue #108 */
+            TY_(WriteChar)( pprint->indentChar, doc->docOut ); /* 20150515 - Issue #108 */
     }
 
     for ( i = 0; i < pprint->wraphere; ++i )
@@ -679,7 +703,7 @@ static void PFlushLineImpl( TidyDocImpl* doc )
     {
         uint spaces = GetSpaces( pprint );
         for ( i = 0; i < spaces; ++i )
-            TY_(WriteChar)( indent_char, doc->docOut ); /* 20150515 - Issue #108 */
+            TY_(WriteChar)( pprint->indentChar, doc->docOut ); /* 20150515 - Issue #108 */
     }
 
     for ( i = 0; i < pprint->linelen; ++i )
@@ -795,8 +819,8 @@ static void PPrintChar( TidyDocImpl* doc, uint c, uint mode )
     tmbchar entity[128];
     ctmbstr p;
     TidyPrintImpl* pprint  = &doc->pprint;
-    uint outenc = cfg( doc, TidyOutCharEncoding );
-    Bool qmark = cfgBool( doc, TidyQuoteMarks );
+    uint outenc = pprint->outenc;
+    Bool qmark = pprint->quoteMarks;
 
     if ( c == ' ' && !(mode & (PREFORMATTED | COMMENT | ATTRIBVALUE | CDATA)))
     {
@@ -805,7 +829,7 @@ static void PPrintChar( TidyDocImpl* doc, uint c, uint mode )
         {
             ctmbstr ent = "&nbsp;";
             /* by default XML doesn't define &nbsp; */
-            if ( cfgBool(doc, TidyNumEntities) || cfgBool(doc, TidyXmlTags) )
+            if ( pprint->numEntities || pprint->xmlTags )
                 ent = "&#160;";
             AddString( pprint, ent );
             return;
@@ -841,8 +865,7 @@ static void PPrintChar( TidyDocImpl* doc, uint c, uint mode )
           quoted as &amp; The latter is required
           for XML where naked '&' are illegal.
         */
-        if ( c == '&' && cfgBool(doc, TidyQuoteAmpersand)
-             && !cfgBool(doc, TidyPreserveEntities)
+        if ( c == '&' && pprint->quoteAmp
              && ( mode != OtherNamespace) ) /* #130 MathML attr and entity fix! */
         {
             AddString( pprint, "&amp;" );
@@ -863,10 +886,9 @@ static void PPrintChar( TidyDocImpl* doc, uint c, uint mode )
 
         if ( c == 160 && outenc != RAW )
         {
-            if ( cfgBool(doc, TidyQuoteNbsp) )
+            if ( pprint->quoteNbsp )
             {
-                if ( cfgBool(doc, TidyNumEntities) ||
-                     cfgBool(doc, TidyXmlTags) )
+                if ( pprint->numEntities || pprint->xmlTags )
                     AddString( pprint, "&#160;" );
                 else
                     AddString( pprint, "&nbsp;" );
@@ -889,7 +911,7 @@ static void PPrintChar( TidyDocImpl* doc, uint c, uint mode )
     case UTF16LE:
     case UTF16BE:
 #endif
-        if (!(mode & PREFORMATTED) && cfg(doc, TidyPunctWrap))
+        if (!(mode & PREFORMATTED) && pprint->punctWrap)
         {
             WrapPoint wp = CharacterWrapPoint(c);
             if (wp == WrapBefore)
@@ -903,7 +925,7 @@ static void PPrintChar( TidyDocImpl* doc, uint c, uint mode )
         /* Allow linebreak at Chinese punctuation characters */
         /* There are not many spaces in Chinese */
         AddChar( pprint, c );
-        if (!(mode & PREFORMATTED)  && cfg(doc, TidyPunctWrap))
+        if (!(mode & PREFORMATTED) && pprint->punctWrap)
         {
             WrapPoint wp = Big5WrapPoint(c);
             if (wp == WrapBefore)
@@ -943,8 +965,8 @@ static void PPrintChar( TidyDocImpl* doc, uint c, uint mode )
     {
         if (c > 255)  /* multi byte chars */
         {
-            uint vers = TY_(HTMLVersion)( doc );
-            if ( !cfgBool(doc, TidyNumEntities) && (p = TY_(EntityName)(c, vers)) )
+            uint vers = PrintVersion( doc );
+            if ( !pprint->numEntities && (p = TY_(EntityName)(c, vers)) )
                 TY_(tmbsnprintf)(entity, sizeof(entity), "&%s;", p);
             else
                 TY_(tmbsnprintf)(entity, sizeof(entity), "&#%u;", c);
@@ -981,7 +1003,7 @@ static void PPrintChar( TidyDocImpl* doc, uint c, uint mode )
 #endif
 
     /* use numeric entities only  for XML */
-    if ( cfgBool(doc, TidyXmlTags) )
+    if ( pprint->xmlTags )
     {
         /* if ASCII use numeric entities for chars > 127 */
         if ( c > 127 && outenc == ASCII )
@@ -999,8 +1021,8 @@ static void PPrintChar( TidyDocImpl* doc, uint c, uint mode )
     /* default treatment for ASCII */
     if ( outenc == ASCII && (c > 126 || (c < ' ' && c != '\t')) )
     {
-        uint vers = TY_(HTMLVersion)( doc );
-        if (!cfgBool(doc, TidyNumEntities) && (p = TY_(EntityName)(c, vers)) )
+        uint vers = PrintVersion( doc );
+        if ( !pprint->numEntities && (p = TY_(EntityName)(c, vers)) )
             TY_(tmbsnprintf)(entity, sizeof(entity), "&%s;", p);
         else
             TY_(tmbsnprintf)(entity, sizeof(entity), "&#%u;", c);
@@ -1061,7 +1083,7 @@ static void PPrintText( TidyDocImpl* doc, uint mode, uint indent,
             ixWS = TextStartsWithWhitespace( doc->lexer, node, ix+1, mode );
             ix = IncrWS( ix, end, indent, ixWS );
         }
-        else if (( c == '&' ) && (TY_(HTMLVersion)(doc) == HT50) &&
+        else if (( c == '&' ) && (PrintVersion(doc) == HT50) &&
             (((ix + 1) == end) || (((ix + 1) < end) && (isspace(doc->lexer->lexbuf[ix+1] & 0xff)))) )
         {
             /*\
@@ -1124,7 +1146,7 @@ static void PPrintAttrValue( TidyDocImpl* doc, uint indent,
 
     if ( value )
     {
-        uint wraplen = cfg( doc, TidyWrapLen );
+        uint wraplen = pprint->wraplen;
         int attrStart = SetInAttrVal( pprint );
         int strStart = ClearInString( pprint );
 
@@ -1521,14 +1543,14 @@ static void PPrintTag( TidyDocImpl* doc,
      *  A complete list of the void elements in HTML:
      *  area, base, br, col, command, embed, hr, img, input, keygen, link, meta, param, source, track, wbr
     \*/
-    if ((node->type == StartEndTag && TY_(HTMLVersion)(doc) == HT50) && !TY_(isVoidElement)(node) )
+    if ((node->type == StartEndTag && PrintVersion(doc) == HT50) && !TY_(isVoidElement)(node) )
     {
         PPrintEndTag( doc, mode, indent, node );
     }
 
-    if ( (node->type != StartEndTag || xhtmlOut || (node->type == StartEndTag && TY_(HTMLVersion)(doc) == HT50)) && !(mode & PREFORMATTED) )
+    if ( (node->type != StartEndTag || xhtmlOut || (node->type == StartEndTag && PrintVersion(doc) == HT50)) && !(mode & PREFORMATTED) )
     {
-        uint wraplen = cfg( doc, TidyWrapLen );
+        uint wraplen = pprint->wraplen;
         CheckWrapIndent( doc, indent );
 
         if ( indent + pprint->linelen < wraplen )
@@ -1622,7 +1644,7 @@ static void PPrintComment( TidyDocImpl* doc, uint indent, Node* node )
 static void PPrintDocType( TidyDocImpl* doc, uint indent, Node *node )
 {
     TidyPrintImpl* pprint = &doc->pprint;
-    uint wraplen = cfg( doc, TidyWrapLen );
+    uint wraplen = pprint->wraplen;
     uint spaces = cfg( doc, TidyIndentSpaces );
     AttVal* fpi = TY_(GetAttrByName)(node, "PUBLIC");
     AttVal* sys = TY_(GetAttrByName)(node, "SYSTEM");
@@ -2154,13 +2176,408 @@ static void PPrintMathML( TidyDocImpl* doc, uint indent, Node *node )
     PPrintEndTag( doc, mode, indent, node );
 }
 
+/*
+ The block container path of TY_(PPrintTree)() is split into the
+ start tag, one call per child and the end tag, so that the
+ streamed output can print <html> and <body> while their children
+ are still being parsed.
+*/
+static void PPrintContainerStart( TidyDocImpl* doc, uint mode, uint indent,
+                                  Node *node, TidyPrintContainer* pc )
+{
+    uint spaces = cfg( doc, TidyIndentSpaces );
+    Bool indsmart = ( cfgAutoBool(doc, TidyIndentContent) == TidyAutoState );
+    Bool hideend  = cfgBool( doc, TidyHideEndTags ) ||
+      cfgBool( doc, TidyOmitOptionalTags );
+    Bool classic  = TidyClassicVS; /* #228 - cfgBool( doc, TidyVertSpace ); */
+    uint contentIndent = indent;
+
+    /* insert extra newline for classic formatting */
+    if (classic && node->parent && node->parent->content != node && !nodeIsHTML(node))
+    {
+        TY_(PFlushLineSmart)( doc, indent );
+    }
+
+    if ( ShouldIndent(doc, node) )
+        contentIndent += spaces;
+
+    PCondFlushLineSmart( doc, indent );
+
+    /*\
+     *  Issue #180 - with the above PCondFlushLine, 
+     *  this adds an uneccessary additional line!
+     *  Maybe only if 'classic' ie --vertical-space yes 
+    \*/
+    if ( indsmart && node->prev != NULL && classic)
+        TY_(PFlushLineSmart)( doc, indent );
+
+    /* do not omit elements with attributes */
+    if ( !hideend || !TY_(nodeHasCM)(node, CM_OMITST) ||
+         node->attributes != NULL )
+    {
+        PPrintTag( doc, mode, indent, node );
+
+        if ( ShouldIndent(doc, node) )
+        {
+            /* fix for bug 530791, don't wrap after */
+            /* <li> if first child is text node     */
+            if (!(nodeIsLI(node) && TY_(nodeIsText)(node->content)))
+                PCondFlushLineSmart( doc, contentIndent );
+        }
+        else if ( TY_(nodeHasCM)(node, CM_HTML) || nodeIsNOFRAMES(node) ||
+                  (TY_(nodeHasCM)(node, CM_HEAD) && !nodeIsTITLE(node)) )
+            TY_(PFlushLineSmart)( doc, contentIndent );
+    }
+    else if ( ShouldIndent(doc, node) )
+    {
+        /*\
+         * Issue #180 - If the tag was NOT printed due to the -omit option,
+         * then reduce the bumped indent under the same ShouldIndent(doc, node) 
+         * conditions that caused the indent to be bumped.
+        \*/
+        contentIndent -= spaces;
+    }
+
+    pc->mode = mode;
+    pc->indent = indent;
+    pc->contentIndent = contentIndent;
+    pc->lastIsText = no;
+}
+
+/* the kludge for naked text before a block level tag */
+static void PPrintContainerBreak( TidyDocImpl* doc, TidyPrintContainer* pc,
+                                  Node *content )
+{
+    Bool indcont = ( cfgAutoBool(doc, TidyIndentContent) != TidyNoState );
+
+    if ( pc->lastIsText && !indcont &&
+         content->tag && !TY_(nodeHasCM)(content, CM_INLINE) )
+    {
+        /* TY_(PFlushLine)(fout, indent); */
+        TY_(PFlushLineSmart)( doc, pc->contentIndent );
+    }
+}
+
+static void PPrintContainerChild( TidyDocImpl* doc, TidyPrintContainer* pc,
+                                  Node *content )
+{
+    PPrintContainerBreak( doc, pc, content );
+    TY_(PPrintTree)( doc, pc->mode, pc->contentIndent, content );
+    pc->lastIsText = TY_(nodeIsText)(content);
+}
+
+static void PPrintContainerEnd( TidyDocImpl* doc, TidyPrintContainer* pc,
+                                Node *node )
+{
+    uint mode = pc->mode;
+    uint indent = pc->indent;
+    Bool indcont  = ( cfgAutoBool(doc, TidyIndentContent) != TidyNoState );
+    Bool hideend  = cfgBool( doc, TidyHideEndTags ) ||
+      cfgBool( doc, TidyOmitOptionalTags );
+    Bool classic  = TidyClassicVS; /* #228 - cfgBool( doc, TidyVertSpace ); */
+
+    /* don't flush line for td and th */
+    if ( ShouldIndent(doc, node) ||
+         ( !hideend &&
+           ( TY_(nodeHasCM)(node, CM_HTML) || 
+             nodeIsNOFRAMES(node) ||
+             (TY_(nodeHasCM)(node, CM_HEAD) && !nodeIsTITLE(node))
+           )
+         )
+       )
+    {
+        PCondFlushLineSmart( doc, indent );
+        if ( !hideend || !TY_(nodeHasCM)(node, CM_OPT) )
+        {
+            PPrintEndTag( doc, mode, indent, node );
+            /* TY_(PFlushLine)( doc, indent ); */
+        }
+    }
+    else
+    {
+        if ( !hideend || !TY_(nodeHasCM)(node, CM_OPT) )
+        {
+            /* newline before endtag for classic formatting */
+            if ( classic && !HasMixedContent(node) )
+                TY_(PFlushLineSmart)( doc, indent );
+            PPrintEndTag( doc, mode, indent, node );
+        }
+        else if (hideend)
+        {
+            /* Issue #390  - must still deal with adjusting indent */
+            TidyPrintImpl* pprint = &doc->pprint;
+            if (pprint->indent[ 0 ].spaces != (int)indent)
+            {
+#if !defined(NDEBUG) && defined(_MSC_VER) && defined(DEBUG_INDENT)
+                SPRTF("%s Indent from %d to %d\n", __FUNCTION__, pprint->indent[ 0 ].spaces, indent );
+#endif  
+                pprint->indent[ 0 ].spaces = indent;
+            }
+        }
+    }
+
+    if (!indcont && !hideend && !nodeIsHTML(node) && !classic)
+        TY_(PFlushLineSmart)( doc, indent );
+    else if (classic && node->next != NULL && TY_(nodeHasCM)(node, CM_LIST|CM_DEFLIST|CM_TABLE|CM_BLOCK/*|CM_HEADING*/))
+        TY_(PFlushLineSmart)( doc, indent );
+}
+
+#if SUPPORT_PARALLEL_PRINT
+/* Parallel printing of the children of <body>, see print-threads.
+
+   The children are split into runs of about the same size. The first
+   run is printed as usual while each other run is printed on its own
+   thread, through a private copy of the document with its own print
+   buffer and output buffer. Each of those runs starts at a block level
+   element, from the state the printer is nearly always in there: an
+   empty line indented for the content of <body>.
+
+   The runs are then taken in order. If the printer really is in that
+   state at the start of a run, the run's output is written and the
+   printer takes over the state the run ended in. Otherwise the run is
+   printed again, as usual. Either way the result is the same as
+   printing on one thread.
+*/
+
+#ifndef PRINT_RANGE_MIN_WEIGHT
+#define PRINT_RANGE_MIN_WEIGHT  65536   /* smallest body worth splitting */
+#endif
+#define PRINT_RANGE_MAX_COUNT   64      /* most runs, whatever print-threads says */
+
+typedef struct _PrintRange
+{
+    TidyDocImpl* doc;           /* private copy of the document */
+    Node* first;
+    Node* next;                 /* first child of the next run, or NULL */
+    TidyPrintContainer pc;
+    TidyBuffer out;
+    pthread_t thread;
+    Bool started;
+} PrintRange;
+
+static Bool CanPrintInParallel( TidyDocImpl* doc )
+{
+    /* the callbacks are not made from other threads */
+    if ( cfg(doc, TidyPrintThreads) < 2 || doc->progressCallback ||
+         doc->cancelCallback )
+        return no;
+
+    /* the workers allocate, so the allocator must be thread safe */
+    if ( doc->allocator != &TY_(g_default_allocator) )
+        return no;
+
+    /* output with shift states can't be split */
+    if ( doc->docOut->encoding == ISO2022
+#ifdef TIDY_WIN32_MLANG_SUPPORT
+         || doc->docOut->encoding > WIN32MLANG
+#endif
+       )
+        return no;
+
+    /* printing would add this attribute, which is not thread safe */
+    if ( cfgBool(doc, TidyXmlOut) && cfgBool(doc, TidyXmlSpace) )
+        return no;
+
+    return yes;
+}
+
+/* roughly the work of printing a subtree */
+static ulong PrintWeight( Node* node )
+{
+    ulong weight = 8;
+    Node* content;
+
+    if ( TY_(nodeIsText)(node) && node->end > node->start )
+        weight += node->end - node->start;
+
+    for ( content = node->content; content; content = content->next )
+        weight += PrintWeight( content );
+
+    return weight;
+}
+
+/* a run starts at a block, where printing begins by flushing the
+   line with PCondFlushLineSmart(), unless there is the naked text
+   kludge or classic vertical space */
+static Bool CanStartPrintRange( Node* node )
+{
+    return ( TY_(nodeIsElement)(node) && node->tag &&
+             !TY_(nodeHasCM)(node, CM_INLINE) &&
+             !nodeIsSCRIPT(node) && !nodeIsSTYLE(node) &&
+             !nodeIsMATHML(node) && !TY_(nodeIsText)(node->prev) );
+}
+
+/* the state a run is printed from */
+static void SetSettledState( TidyPrintImpl* pprint, uint indent )
+{
+    pprint->linelen = 0;
+    pprint->wraphere = 0;
+    pprint->ixInd = 0;
+    InitIndent( &pprint->indent[0] );
+    InitIndent( &pprint->indent[1] );
+    pprint->indent[0].spaces = indent;
+}
+
+static Bool IsSettledState( TidyPrintImpl* pprint, uint indent )
+{
+    TidyPrintImpl settled;
+
+    SetSettledState( &settled, indent );
+    return ( pprint->linelen == 0 && pprint->wraphere == 0 &&
+             pprint->ixInd == 0 &&
+             memcmp( pprint->indent, settled.indent,
+                     sizeof(settled.indent) ) == 0 );
+}
+
+/* continue from where a run left the printer */
+static void TakePrintState( TidyPrintImpl* pprint, TidyPrintImpl* from )
+{
+    if ( from->linelen > 0 )
+    {
+        if ( from->linelen >= pprint->lbufsize )
+            expand( pprint, from->linelen );
+        memcpy( pprint->linebuf, from->linebuf, from->linelen * sizeof(uint) );
+    }
+    pprint->linelen = from->linelen;
+    pprint->wraphere = from->wraphere;
+    pprint->ixInd = from->ixInd;
+    pprint->indent[0] = from->indent[0];
+    pprint->indent[1] = from->indent[1];
+    pprint->line += from->line;
+}
+
+static void* PrintRangeThread( void* arg )
+{
+    PrintRange* range = (PrintRange*) arg;
+    Node* content;
+
+    for ( content = range->first; content != range->next; content = content->next )
+        PPrintContainerChild( range->doc, &range->pc, content );
+    return NULL;
+}
+
+static void StartPrintRange( TidyDocImpl* doc, TidyPrintContainer* pc,
+                             PrintRange* range )
+{
+    TidyDocImpl* rdoc = (TidyDocImpl*) TidyDocAlloc( doc, sizeof(TidyDocImpl) );
+    TidyPrintImpl* pprint;
+
+    memcpy( rdoc, doc, sizeof(TidyDocImpl) );
+    TY_(InitPrintBuf)( rdoc );
+    pprint = &rdoc->pprint;
+    pprint->outenc = doc->pprint.outenc;
+    pprint->wraplen = doc->pprint.wraplen;
+    pprint->numEntities = doc->pprint.numEntities;
+    pprint->xmlTags = doc->pprint.xmlTags;
+    pprint->quoteAmp = doc->pprint.quoteAmp;
+    pprint->quoteMarks = doc->pprint.quoteMarks;
+    pprint->quoteNbsp = doc->pprint.quoteNbsp;
+    pprint->punctWrap = doc->pprint.punctWrap;
+    pprint->indentChar = doc->pprint.indentChar;
+    pprint->version = PrintVersion( doc );
+    pprint->versionKnown = yes;
+    SetSettledState( pprint, pc->contentIndent );
+
+    tidyBufInitWithAllocator( &range->out, doc->allocator );
+    rdoc->docOut = TY_(BufferOutput)( doc, &range->out,
+                                      doc->docOut->encoding, doc->docOut->nl );
+    range->doc = rdoc;
+    range->pc = *pc;
+    range->pc.lastIsText = TY_(nodeIsText)( range->first->prev );
+    range->started =
+        ( pthread_create(&range->thread, NULL, PrintRangeThread, range) == 0 );
+}
+
+static void FreePrintRange( TidyDocImpl* doc, PrintRange* range )
+{
+    if ( range->doc )
+    {
+        TidyDocFree( doc, range->doc->pprint.linebuf );
+        TidyDocFree( doc, range->doc->docOut );
+        TidyDocFree( doc, range->doc );
+        tidyBufFree( &range->out );
+    }
+}
+
+static void PPrintChildrenParallel( TidyDocImpl* doc, TidyPrintContainer* pc,
+                                    Node *node )
+{
+    uint count = cfg( doc, TidyPrintThreads );
+    ulong total = 0, weight = 0;
+    PrintRange* ranges;
+    Node* content;
+    uint i, n = 1;
+
+    if ( count > PRINT_RANGE_MAX_COUNT )
+        count = PRINT_RANGE_MAX_COUNT;
+
+    for ( content = node->content; content; content = content->next )
+        total += PrintWeight( content );
+
+    ranges = (PrintRange*) TidyDocAlloc( doc, count * sizeof(PrintRange) );
+    TidyClearMemory( ranges, count * sizeof(PrintRange) );
+    ranges[0].first = node->content;
+
+    /* split into runs of about total/count, each starting at a block */
+    if ( total >= PRINT_RANGE_MIN_WEIGHT )
+    {
+        for ( content = node->content; content && n < count; content = content->next )
+        {
+            if ( weight >= total / count * n && content != ranges[n - 1].first &&
+                 CanStartPrintRange(content) )
+            {
+                ranges[n - 1].next = content;
+                ranges[n++].first = content;
+            }
+            weight += PrintWeight( content );
+        }
+    }
+
+    for ( i = 1; i < n; ++i )
+        StartPrintRange( doc, pc, &ranges[i] );
+
+    for ( i = 0; i < n; ++i )
+    {
+        PrintRange* range = &ranges[i];
+
+        if ( range->started )
+        {
+            pthread_join( range->thread, NULL );
+            if ( range->doc->cancelled )
+                doc->cancelled = yes;
+
+            /* the line left over is flushed first thing, as the run
+               would have done, unless classic vertical space adds
+               a newline to that */
+            if ( !TidyClassicVS )
+                PCondFlushLineSmart( doc, pc->contentIndent );
+        }
+
+        if ( range->started && IsSettledState(&doc->pprint, pc->contentIndent) )
+        {
+            TY_(WriteBytes)( range->out.bp, range->out.size, doc->docOut );
+            TakePrintState( &doc->pprint, &range->doc->pprint );
+            *pc = range->pc;
+        }
+        else
+        {
+            for ( content = range->first; content != range->next; content = content->next )
+                PPrintContainerChild( doc, pc, content );
+        }
+        FreePrintRange( doc, range );
+    }
+
+    TidyDocFree( doc, ranges );
+}
+#endif /* SUPPORT_PARALLEL_PRINT */
+
 void TY_(PPrintTree)( TidyDocImpl* doc, uint mode, uint indent, Node *node )
 {
-    Node *content, *last;
+    Node *content;
     uint spaces = cfg( doc, TidyIndentSpaces );
     Bool xhtml = cfgBool( doc, TidyXhtmlOut );
 
-    if ( node == NULL )
+    if ( node == NULL || TidyCancelled(doc, CANCEL_NODE_TICKS) )
         return;
 
     if (doc->progressCallback)
@@ -2326,118 +2743,17 @@ void TY_(PPrintTree)( TidyDocImpl* doc, uint mode, uint indent, Node *node )
         }
         else /* other tags */
         {
-            Bool indcont  = ( cfgAutoBool(doc, TidyIndentContent) != TidyNoState );
-            Bool indsmart = ( cfgAutoBool(doc, TidyIndentContent) == TidyAutoState );
-            Bool hideend  = cfgBool( doc, TidyHideEndTags ) ||
-              cfgBool( doc, TidyOmitOptionalTags );
-            Bool classic  = TidyClassicVS; /* #228 - cfgBool( doc, TidyVertSpace ); */
-            uint contentIndent = indent;
-
-            /* insert extra newline for classic formatting */
-            if (classic && node->parent && node->parent->content != node && !nodeIsHTML(node))
-            {
-                TY_(PFlushLineSmart)( doc, indent );
-            }
-
-            if ( ShouldIndent(doc, node) )
-                contentIndent += spaces;
-
-            PCondFlushLineSmart( doc, indent );
-
-            /*\
-             *  Issue #180 - with the above PCondFlushLine, 
-             *  this adds an uneccessary additional line!
-             *  Maybe only if 'classic' ie --vertical-space yes 
-            \*/
-            if ( indsmart && node->prev != NULL && classic)
-                TY_(PFlushLineSmart)( doc, indent );
-
-            /* do not omit elements with attributes */
-            if ( !hideend || !TY_(nodeHasCM)(node, CM_OMITST) ||
-                 node->attributes != NULL )
-            {
-                PPrintTag( doc, mode, indent, node );
+            TidyPrintContainer pc;
 
-                if ( ShouldIndent(doc, node) )
-                {
-                    /* fix for bug 530791, don't wrap after */
-                    /* <li> if first child is text node     */
-                    if (!(nodeIsLI(node) && TY_(nodeIsText)(node->content)))
-                        PCondFlushLineSmart( doc, contentIndent );
-                }
-                else if ( TY_(nodeHasCM)(node, CM_HTML) || nodeIsNOFRAMES(node) ||
-                          (TY_(nodeHasCM)(node, CM_HEAD) && !nodeIsTITLE(node)) )
-                    TY_(PFlushLineSmart)( doc, contentIndent );
-            }
-            else if ( ShouldIndent(doc, node) )
-            {
-                /*\
-                 * Issue #180 - If the tag was NOT printed due to the -omit option,
-                 * then reduce the bumped indent under the same ShouldIndent(doc, node) 
-                 * conditions that caused the indent to be bumped.
-                \*/
-                contentIndent -= spaces;
-            }
-
-            last = NULL;
-            for ( content = node->content; content; content = content->next )
-            {
-                /* kludge for naked text before block level tag */
-                if ( last && !indcont && TY_(nodeIsText)(last) &&
-                     content->tag && !TY_(nodeHasCM)(content, CM_INLINE) )
-                {
-                    /* TY_(PFlushLine)(fout, indent); */
-                    TY_(PFlushLineSmart)( doc, contentIndent );
-                }
-
-                TY_(PPrintTree)( doc, mode, contentIndent, content );
-                last = content;
-            }
-
-            /* don't flush line for td and th */
-            if ( ShouldIndent(doc, node) ||
-                 ( !hideend &&
-                   ( TY_(nodeHasCM)(node, CM_HTML) || 
-                     nodeIsNOFRAMES(node) ||
-                     (TY_(nodeHasCM)(node, CM_HEAD) && !nodeIsTITLE(node))
-                   )
-                 )
-               )
-            {
-                PCondFlushLineSmart( doc, indent );
-                if ( !hideend || !TY_(nodeHasCM)(node, CM_OPT) )
-                {
-                    PPrintEndTag( doc, mode, indent, node );
-                    /* TY_(PFlushLine)( doc, indent ); */
-                }
-            }
+            PPrintContainerStart( doc, mode, indent, node, &pc );
+#if SUPPORT_PARALLEL_PRINT
+            if ( nodeIsBODY(node) && CanPrintInParallel(doc) )
+                PPrintChildrenParallel( doc, &pc, node );
             else
-            {
-                if ( !hideend || !TY_(nodeHasCM)(node, CM_OPT) )
-                {
-                    /* newline before endtag for classic formatting */
-                    if ( classic && !HasMixedContent(node) )
-                        TY_(PFlushLineSmart)( doc, indent );
-                    PPrintEndTag( doc, mode, indent, node );
-                }
-                else if (hideend)
-                {
-                    /* Issue #390  - must still deal with adjusting indent */
-                    TidyPrintImpl* pprint = &doc->pprint;
-                    if (pprint->indent[ 0 ].spaces != (int)indent)
-                    {
-#if !defined(NDEBUG) && defined(_MSC_VER) && defined(DEBUG_INDENT)
-                        SPRTF("%s Indent from %d to %d\n", __FUNCTION__, pprint->indent[ 0 ].spaces, indent );
-#endif  
-                        pprint->indent[ 0 ].spaces = indent;
-                    }
-                }
-            }
-
-            if (!indcont && !hideend && !nodeIsHTML(node) && !classic)
-                TY_(PFlushLineSmart)( doc, indent );
-            else if (classic && node->next != NULL && TY_(nodeHasCM)(node, CM_LIST|CM_DEFLIST|CM_TABLE|CM_BLOCK/*|CM_HEADING*/))
-                TY_(PFlushLineSmart)( doc, indent );
+#endif
+            for ( content = node->content; content; content = content->next )
+                PPrintContainerChild( doc, &pc, content );
+            PPrintContainerEnd( doc, &pc, node );
         }
     }
 }
@@ -2445,7 +2761,7 @@ void TY_(PPrintTree)( TidyDocImpl* doc, uint mode, uint indent, Node *node )
 void TY_(PPrintXMLTree)( TidyDocImpl* doc, uint mode, uint indent, Node *node )
 {
     Bool xhtmlOut = cfgBool( doc, TidyXhtmlOut );
-    if (node == NULL)
+    if (node == NULL || TidyCancelled(doc, CANCEL_NODE_TICKS))
         return;
 
     if (doc->progressCallback)
@@ -2538,6 +2854,680 @@ void TY_(PPrintXMLTree)( TidyDocImpl* doc, uint mode, uint indent, Node *node )
     }
 }
 
+/*
+ Minified output for the minify option. Characters are escaped by
+ PPrintChar() as for the other printers, but nothing here consults
+ the wrap or indent state: the line buffer only collects characters,
+ and MinifyFlush() writes them out as they are. Whitespace is
+ collapsed where the content model makes it insignificant, optional
+ start and end tags are left out by the HTML5 rules, and attributes
+ are printed in their shortest form.
+*/
+
+#define MINIFY_FLUSH_LEN 4096
+
+static void MinifyFlush( TidyDocImpl* doc )
+{
+    TidyPrintImpl* pprint = &doc->pprint;
+    uint i;
+
+    for ( i = 0; i < pprint->linelen; ++i )
+        TY_(WriteChar)( pprint->linebuf[i], doc->docOut );
+    pprint->linelen = 0;
+    pprint->wraphere = 0;
+}
+
+static void MinifyName( TidyDocImpl* doc, ctmbstr s, Bool uc )
+{
+    TidyPrintImpl* pprint = &doc->pprint;
+    tchar c;
+
+    while ( s && *s )
+    {
+        c = (unsigned char)*s;
+
+        if ( c > 0x7F )
+            s += TY_(GetUTF8)( s, &c );
+        else if ( uc )
+            c = TY_(ToUpper)( c );
+
+        AddChar( pprint, c );
+        ++s;
+    }
+}
+
+/* comments, scriptlets and the like are passed through as they are */
+static void MinifyRaw( TidyDocImpl* doc, Node* node )
+{
+    TidyPrintImpl* pprint = &doc->pprint;
+    Lexer* lexer = doc->lexer;
+    uint ix, c;
+
+    for ( ix = node->start; ix < node->end; ++ix )
+    {
+        c = (byte) lexer->lexbuf[ix];
+        if ( c > 0x7F )
+            ix += TY_(GetUTF8)( lexer->lexbuf + ix, &c );
+        AddChar( pprint, c );
+    }
+}
+
+static TidyTagId MinifyTagId( Node* node )
+{
+    return ( node && node->tag ) ? node->tag->id : TidyTag_UNKNOWN;
+}
+
+/* whitespace next to these elements is not rendered */
+static Bool MinifyIsBlock( Node* node )
+{
+    return ( node && node->tag && node->tag->model != CM_UNKNOWN &&
+             !TY_(nodeHasCM)(node, CM_INLINE) && !nodeIsCANVAS(node) );
+}
+
+/* a space at the end of node would end a line and not be rendered */
+static Bool MinifyEndsLine( Node* node )
+{
+    for ( ; node && node->parent; node = node->parent )
+    {
+        if ( node->next )
+            return ( MinifyIsBlock(node->next) || nodeIsBR(node->next) );
+        if ( MinifyIsBlock(node->parent) )
+            return yes;
+    }
+    return no;
+}
+
+static Bool MinifyFollowedBySpace( TidyDocImpl* doc, Node* node )
+{
+    Node* next = node->next;
+
+    if ( next && next->type == CommentTag )
+        return yes;
+
+    return ( TY_(nodeIsText)(next) && next->start < next->end &&
+             TY_(IsWhite)((byte) doc->lexer->lexbuf[next->start]) );
+}
+
+/* the "no more content in the parent element" case of </p> */
+static Bool MinifyCanEndParagraph( Node* parent )
+{
+    switch ( MinifyTagId(parent) )
+    {
+    case TidyTag_UNKNOWN:
+    case TidyTag_A:
+    case TidyTag_AUDIO:
+    case TidyTag_DEL:
+    case TidyTag_INS:
+    case TidyTag_MAP:
+    case TidyTag_NOSCRIPT:
+    case TidyTag_VIDEO:
+        return no;
+    default:
+        return yes;
+    }
+}
+
+/* not <table>, which leaves the <p> open in quirks mode */
+static Bool MinifyClosesParagraph( Node* node )
+{
+    switch ( MinifyTagId(node) )
+    {
+    case TidyTag_ADDRESS:
+    case TidyTag_ARTICLE:
+    case TidyTag_ASIDE:
+    case TidyTag_BLOCKQUOTE:
+    case TidyTag_DETAILS:
+    case TidyTag_DIV:
+    case TidyTag_DL:
+    case TidyTag_FIELDSET:
+    case TidyTag_FIGCAPTION:
+    case TidyTag_FIGURE:
+    case TidyTag_FOOTER:
+    case TidyTag_FORM:
+    case TidyTag_H1:
+    case TidyTag_H2:
+    case TidyTag_H3:
+    case TidyTag_H4:
+    case TidyTag_H5:
+    case TidyTag_H6:
+    case TidyTag_HEADER:
+    case TidyTag_HGROUP:
+    case TidyTag_HR:
+    case TidyTag_MAIN:
+    case TidyTag_MENU:
+    case TidyTag_NAV:
+    case TidyTag_OL:
+    case TidyTag_P:
+    case TidyTag_PRE:
+    case TidyTag_SECTION:
+    case TidyTag_UL:
+        return yes;
+    default:
+        return no;
+    }
+}
+
+/* the elements the "after head" insertion mode puts into <head> */
+static Bool MinifyGoesInHead( Node* node )
+{
+    switch ( MinifyTagId(node) )
+    {
+    case TidyTag_BASE:
+    case TidyTag_BASEFONT:
+    case TidyTag_BGSOUND:
+    case TidyTag_LINK:
+    case TidyTag_META:
+    case TidyTag_NOFRAMES:
+    case TidyTag_SCRIPT:
+    case TidyTag_STYLE:
+    case TidyTag_TEMPLATE:
+    case TidyTag_TITLE:
+        return yes;
+    default:
+        return no;
+    }
+}
+
+static Bool MinifyOmitEndTag( TidyDocImpl* doc, Node* node );
+
+static Bool MinifyOmitStartTag( TidyDocImpl* doc, Node* node )
+{
+    Node* first = node->content;
+    Node* prev = node->prev;
+
+    if ( node->attributes )
+        return no;
+
+    switch ( MinifyTagId(node) )
+    {
+    case TidyTag_HTML:
+        return ( !first || first->type != CommentTag );
+    case TidyTag_HEAD:
+        return ( !first || TY_(nodeIsElement)(first) );
+    case TidyTag_BODY:
+        return ( !first || (first->type != CommentTag &&
+                            !MinifyGoesInHead(first)) );
+    case TidyTag_COLGROUP:
+        return ( nodeIsCOL(first) &&
+                 !(nodeIsCOLGROUP(prev) && MinifyOmitEndTag(doc, prev)) );
+    case TidyTag_TBODY:
+        return ( nodeIsTR(first) &&
+                 !((nodeIsTBODY(prev) || nodeIsTHEAD(prev) ||
+                    nodeIsTFOOT(prev)) && MinifyOmitEndTag(doc, prev)) );
+    default:
+        return no;
+    }
+}
+
+static Bool MinifyOmitEndTag( TidyDocImpl* doc, Node* node )
+{
+    Node* next = node->next;
+
+    switch ( MinifyTagId(node) )
+    {
+    case TidyTag_HTML:
+    case TidyTag_BODY:
+        return ( !next || next->type != CommentTag );
+    case TidyTag_HEAD:
+    case TidyTag_COLGROUP:
+    case TidyTag_CAPTION:
+        return !MinifyFollowedBySpace( doc, node );
+    case TidyTag_LI:
+        return ( !next || nodeIsLI(next) );
+    case TidyTag_DT:
+        return ( nodeIsDT(next) || nodeIsDD(next) );
+    case TidyTag_DD:
+        return ( !next || nodeIsDT(next) || nodeIsDD(next) );
+    case TidyTag_P:
+        return ( next ? MinifyClosesParagraph(next)
+                      : MinifyCanEndParagraph(node->parent) );
+    case TidyTag_RT:
+    case TidyTag_RP:
+        return ( !next || MinifyTagId(next) == TidyTag_RT ||
+                 MinifyTagId(next) == TidyTag_RP );
+    case TidyTag_OPTGROUP:
+        return ( !next || nodeIsOPTGROUP(next) );
+    case TidyTag_OPTION:
+        return ( !next || nodeIsOPTION(next) || nodeIsOPTGROUP(next) );
+    case TidyTag_THEAD:
+        return ( nodeIsTBODY(next) || nodeIsTFOOT(next) );
+    case TidyTag_TBODY:
+        return ( !next || nodeIsTBODY(next) || nodeIsTFOOT(next) );
+    case TidyTag_TFOOT:
+        return !next;
+    case TidyTag_TR:
+        return ( !next || nodeIsTR(next) );
+    case TidyTag_TD:
+    case TidyTag_TH:
+        return ( !next || nodeIsTD(next) || nodeIsTH(next) );
+    default:
+        return no;
+    }
+}
+
+static Bool MinifyCanUnquote( ctmbstr value )
+{
+    for ( ; *value; ++value )
+    {
+        switch ( *value )
+        {
+        case '"':
+        case '\'':
+        case '=':
+        case '<':
+        case '>':
+        case '`':
+            return no;
+        }
+        if ( TY_(IsWhite)((byte) *value) )
+            return no;
+    }
+    return yes;
+}
+
+/* boolean attributes and empty values are printed as the bare name */
+static Bool MinifyBareAttr( AttVal* attr )
+{
+    if ( attr->value == NULL || attr->value[0] == '\0' )
+        return yes;
+
+    return ( TY_(IsBoolAttribute)(attr) &&
+             attr->dict->id != TidyAttr_TRANSLATE &&
+             TY_(tmbstrcasecmp)(attr->value, attr->attribute) == 0 );
+}
+
+static void MinifyAttrValue( TidyDocImpl* doc, ctmbstr value )
+{
+    TidyPrintImpl* pprint = &doc->pprint;
+    Bool quoteMarks = cfgBool( doc, TidyQuoteMarks );
+    uint mode = PREFORMATTED | ATTRIBVALUE;
+    uint delim = 0;
+    uint c;
+
+    /* ASP, Tango or PHP instructions as in PPrintAttrValue() */
+    if ( value[0] == '<' &&
+         (value[1] == '%' || value[1] == '@' ||
+          TY_(tmbstrncmp)(value, "<?php", 5) == 0) )
+        mode |= CDATA;
+
+    if ( !MinifyCanUnquote(value) )
+    {
+        delim = '"';
+        if ( TY_(tmbsubstr)(value, "\"") && !TY_(tmbsubstr)(value, "'") )
+            delim = '\'';
+    }
+
+    AddChar( pprint, '=' );
+    if ( delim )
+        AddChar( pprint, delim );
+
+    for ( ; *value; ++value )
+    {
+        c = (byte) *value;
+
+        if ( c == delim )
+        {
+            AddString( pprint, (c == '"' ? "&quot;" : "&#39;") );
+            continue;
+        }
+        if ( c == '"' || c == '\'' )
+        {
+            if ( quoteMarks )
+                AddString( pprint, (c == '"' ? "&quot;" : "&#39;") );
+            else
+                AddChar( pprint, c );
+            continue;
+        }
+
+        if ( c > 0x7F )
+            value += TY_(GetUTF8)( value, &c );
+        PPrintChar( doc, c, mode );
+    }
+
+    if ( delim )
+        AddChar( pprint, delim );
+}
+
+static void MinifyAttrs( TidyDocImpl* doc, Node* node )
+{
+    TidyPrintImpl* pprint = &doc->pprint;
+    Bool ucAttrs = cfgBool( doc, TidyUpperCaseAttrs );
+    AttVal* av;
+
+    for ( av = node->attributes; av; av = av->next )
+    {
+        if ( av->attribute != NULL )
+        {
+            AddChar( pprint, ' ' );
+            MinifyName( doc, av->attribute, ucAttrs );
+            if ( !MinifyBareAttr(av) )
+                MinifyAttrValue( doc, av->value );
+        }
+        else if ( av->asp != NULL )
+        {
+            AddString( pprint, " <%" );
+            MinifyRaw( doc, av->asp );
+            AddString( pprint, "%>" );
+        }
+        else if ( av->php != NULL )
+        {
+            AddString( pprint, " <?" );
+            MinifyRaw( doc, av->php );
+            AddString( pprint, "?>" );
+        }
+    }
+}
+
+static void MinifyTag( TidyDocImpl* doc, Node* node )
+{
+    AddChar( &doc->pprint, '<' );
+    MinifyName( doc, node->element, cfgBool(doc, TidyUpperCaseTags) );
+    MinifyAttrs( doc, node );
+    AddChar( &doc->pprint, '>' );
+}
+
+static void MinifyEndTag( TidyDocImpl* doc, Node* node )
+{
+    AddString( &doc->pprint, "</" );
+    MinifyName( doc, node->element, cfgBool(doc, TidyUpperCaseTags) );
+    AddChar( &doc->pprint, '>' );
+}
+
+/*
+ *collapse is set when a space printed here would not be rendered,
+ at the start of a line or after another space.
+*/
+static void MinifyText( TidyDocImpl* doc, uint mode, Node* node,
+                        Bool* collapse )
+{
+    Lexer* lexer = doc->lexer;
+    Bool keep = ( (mode & (PREFORMATTED | CDATA)) || mode == OtherNamespace );
+    Bool html5 = ( PrintVersion(doc) == HT50 );
+    Bool space = no;
+    uint ix, c;
+
+    for ( ix = node->start; ix < node->end; ++ix )
+    {
+        c = (byte) lexer->lexbuf[ix];
+
+        if ( c > 0x7F )
+            ix += TY_(GetUTF8)( lexer->lexbuf + ix, &c );
+        else if ( !keep && TY_(IsWhite)(c) )
+        {
+            space = yes;
+            continue;
+        }
+
+        if ( space && !*collapse )
+            PPrintChar( doc, ' ', mode );
+        space = no;
+        *collapse = no;
+
+        /* Issue #207 - an unambiguous ampersand is not quoted in HTML5 */
+        if ( c == '&' && html5 &&
+             (ix + 1 == node->end || isspace(lexer->lexbuf[ix + 1] & 0xff)) )
+            PPrintChar( doc, c, (mode | CDATA) );
+        else
+            PPrintChar( doc, c, mode );
+    }
+
+    if ( space && !*collapse && !MinifyEndsLine(node) )
+    {
+        PPrintChar( doc, ' ', mode );
+        *collapse = yes;
+    }
+}
+
+static void MinifyDocType( TidyDocImpl* doc, Node* node )
+{
+    TidyPrintImpl* pprint = &doc->pprint;
+    AttVal* fpi = TY_(GetAttrByName)( node, "PUBLIC" );
+    AttVal* sys = TY_(GetAttrByName)( node, "SYSTEM" );
+
+    AddString( pprint, "<!DOCTYPE " );
+    if ( node->element )
+        AddString( pprint, node->element );
+
+    if ( fpi && fpi->value )
+    {
+        AddString( pprint, " PUBLIC " );
+        AddChar( pprint, fpi->delim );
+        AddString( pprint, fpi->value );
+        AddChar( pprint, fpi->delim );
+    }
+
+    if ( sys && sys->value )
+    {
+        AddString( pprint, (fpi && fpi->value) ? " " : " SYSTEM " );
+        AddChar( pprint, sys->delim );
+        AddString( pprint, sys->value );
+        AddChar( pprint, sys->delim );
+    }
+
+    if ( node->content )
+    {
+        AddChar( pprint, '[' );
+        MinifyRaw( doc, node->content );
+        AddChar( pprint, ']' );
+    }
+
+    AddChar( pprint, '>' );
+}
+
+static void MinifyXmlDecl( TidyDocImpl* doc, Node* node )
+{
+    TidyPrintImpl* pprint = &doc->pprint;
+    AttVal* av;
+
+    AddString( pprint, "<?xml" );
+    for ( av = node->attributes; av; av = av->next )
+    {
+        if ( av->attribute == NULL || av->value == NULL )
+            continue;
+        AddChar( pprint, ' ' );
+        AddString( pprint, av->attribute );
+        AddString( pprint, "=\"" );
+        AddString( pprint, av->value );
+        AddChar( pprint, '"' );
+    }
+    AddString( pprint, "?>" );
+}
+
+static void MinifyTree( TidyDocImpl* doc, uint mode, Node* node,
+                        Bool* collapse );
+
+static void MinifyElement( TidyDocImpl* doc, uint mode, Node* node,
+                           Bool* collapse )
+{
+    Bool foreign = ( mode == OtherNamespace );
+    Bool block = MinifyIsBlock( node );
+    uint cmode = mode;
+    Node* content;
+
+    if ( node->tag && node->tag->parser == TY_(ParseNamespace) )
+        cmode = mode = OtherNamespace;
+    else if ( nodeIsSCRIPT(node) || nodeIsSTYLE(node) )
+        cmode = PREFORMATTED | CDATA;
+    else if ( node->tag &&
+              (node->tag->parser == TY_(ParsePre) || nodeIsTEXTAREA(node)) )
+        cmode = mode | PREFORMATTED;
+
+    if ( block )
+        *collapse = yes;
+
+    if ( foreign || !MinifyOmitStartTag(doc, node) )
+        MinifyTag( doc, node );
+
+    if ( !foreign && TY_(nodeCMIsEmpty)(node) )
+    {
+        *collapse = ( block || nodeIsBR(node) );
+        return;
+    }
+
+    for ( content = node->content; content; content = content->next )
+        MinifyTree( doc, cmode, content, collapse );
+
+    if ( foreign || !MinifyOmitEndTag(doc, node) )
+        MinifyEndTag( doc, node );
+
+    /* not knowing how inline elements render, keep the space after them */
+    *collapse = block;
+}
+
+static void MinifyTree( TidyDocImpl* doc, uint mode, Node* node,
+                        Bool* collapse )
+{
+    TidyPrintImpl* pprint = &doc->pprint;
+    Node* content;
+
+    if ( TidyCancelled(doc, CANCEL_NODE_TICKS) )
+        return;
+
+    switch ( node->type )
+    {
+    case TextNode:
+        MinifyText( doc, mode, node, collapse );
+        break;
+    case CommentTag:
+        AddString( pprint, "<!--" );
+        MinifyRaw( doc, node );
+        AddString( pprint, "-->" );
+        break;
+    case RootNode:
+        for ( content = node->content; content; content = content->next )
+            MinifyTree( doc, mode, content, collapse );
+        break;
+    case DocTypeTag:
+        MinifyDocType( doc, node );
+        break;
+    case ProcInsTag:
+        AddString( pprint, "<?" );
+        MinifyName( doc, node->element, no );
+        MinifyRaw( doc, node );
+        if ( node->closed )
+            AddChar( pprint, '?' );
+        AddChar( pprint, '>' );
+        break;
+    case XmlDecl:
+        MinifyXmlDecl( doc, node );
+        break;
+    case CDATATag:
+        AddString( pprint, "<![CDATA[" );
+        MinifyRaw( doc, node );
+        AddString( pprint, "]]>" );
+        break;
+    case SectionTag:
+        AddString( pprint, "<![" );
+        MinifyRaw( doc, node );
+        AddString( pprint, "]>" );
+        break;
+    case AspTag:
+        AddString( pprint, "<%" );
+        MinifyRaw( doc, node );
+        AddString( pprint, "%>" );
+        break;
+    case JsteTag:
+        AddString( pprint, "<#" );
+        MinifyRaw( doc, node );
+        AddString( pprint, "#>" );
+        break;
+    case PhpTag:
+        AddString( pprint, "<?" );
+        MinifyRaw( doc, node );
+        AddString( pprint, "?>" );
+        break;
+    default:
+        MinifyElement( doc, mode, node, collapse );
+        break;
+    }
+
+    if ( pprint->linelen >= MINIFY_FLUSH_LEN )
+        MinifyFlush( doc );
+}
+
+void TY_(PMinifyTree)( TidyDocImpl* doc, Node *node, Bool contentOnly )
+{
+    Bool collapse = yes;
+    Node* content;
+
+    if ( node == NULL )
+        return;
+
+    if ( contentOnly )
+    {
+        for ( content = node->content; content; content = content->next )
+            MinifyTree( doc, NORMAL, content, &collapse );
+    }
+    else
+        MinifyTree( doc, NORMAL, node, &collapse );
+
+    MinifyFlush( doc );
+}
+
+/*
+ Streamed output prints the same as TY_(PPrintTree)() on the root,
+ given that the content of <html> and <body> is only handed over
+ once nothing will change it any more, see ParseBody().
+*/
+static void PPrintStreamOpen( TidyDocImpl* doc, TidyPrintContainer* parent,
+                              TidyPrintContainer* pc, Node *node )
+{
+    uint mode = parent ? parent->mode : NORMAL;
+    uint indent = parent ? parent->contentIndent : 0;
+
+    if ( parent )
+        PPrintContainerBreak( doc, parent, node );
+
+    if (doc->progressCallback)
+    {
+        doc->progressCallback( tidyImplToDoc(doc), node->line, node->column, doc->pprint.line + 1 );
+    }
+
+    PPrintContainerStart( doc, mode, indent, node, pc );
+}
+
+void TY_(PPrintStreamStart)( TidyDocImpl* doc, Node *body )
+{
+    TidyPrintImpl* pprint = &doc->pprint;
+    Node *html = body->parent;
+    Node *node;
+
+    for ( node = doc->root.content; node != html; node = node->next )
+        TY_(PPrintTree)( doc, NORMAL, 0, node );
+
+    PPrintStreamOpen( doc, NULL, &pprint->streamHtml, html );
+
+    for ( node = html->content; node != body; node = node->next )
+        PPrintContainerChild( doc, &pprint->streamHtml, node );
+
+    PPrintStreamOpen( doc, &pprint->streamHtml, &pprint->streamBody, body );
+}
+
+void TY_(PPrintStreamNode)( TidyDocImpl* doc, Node *node )
+{
+    TidyPrintImpl* pprint = &doc->pprint;
+
+    if ( nodeIsBODY(node->parent) )
+        PPrintContainerChild( doc, &pprint->streamBody, node );
+    else if ( nodeIsHTML(node->parent) )
+        PPrintContainerChild( doc, &pprint->streamHtml, node );
+    else
+        TY_(PPrintTree)( doc, NORMAL, 0, node );
+}
+
+void TY_(PPrintStreamEnd)( TidyDocImpl* doc, Node *node )
+{
+    TidyPrintImpl* pprint = &doc->pprint;
+
+    if ( nodeIsBODY(node) )
+    {
+        PPrintContainerEnd( doc, &pprint->streamBody, node );
+        pprint->streamHtml.lastIsText = no;
+    }
+    else
+        PPrintContainerEnd( doc, &pprint->streamHtml, node );
+}
+
 /*
  * local variables:
  * mode: c
@@ -45,6 +45,16 @@ typedef struct _TidyIndent
     int attrStringStart;
 } TidyIndent;
 
+/* A block container whose children are printed one at a time
+*/
+typedef struct _TidyPrintContainer
+{
+    uint mode;
+    uint indent;
+    uint contentIndent;
+    Bool lastIsText;        /* for the naked text before block kludge */
+} TidyPrintContainer;
+
 typedef struct _TidyPrintImpl
 {
     TidyAllocator *allocator; /* Allocator */
@@ -57,6 +67,25 @@ typedef struct _TidyPrintImpl
   
     uint ixInd;
     TidyIndent indent[2];  /* Two lines worth of indent state */
+
+    /* Options consulted for every output character, resolved
+    ** once per print by TY_(ResolvePrintOptions)().
+    */
+    uint outenc;
+    uint wraplen;
+    Bool numEntities;
+    Bool xmlTags;
+    Bool quoteAmp;
+    Bool quoteMarks;
+    Bool quoteNbsp;
+    Bool punctWrap;
+    uint indentChar;        /* tab with indent-with-tabs, else space */
+    Bool versionKnown;
+    int  version;           /* TY_(HTMLVersion)(), computed on first use */
+
+    /* <html> and <body> while their content is streamed */
+    TidyPrintContainer streamHtml;
+    TidyPrintContainer streamBody;
 } TidyPrintImpl;
 
 
@@ -67,6 +96,7 @@ uint CWrapLen( TidyDocImpl* doc, uint ind );
 
 void TY_(InitPrintBuf)( TidyDocImpl* doc );
 void TY_(FreePrintBuf)( TidyDocImpl* doc );
+void TY_(ResolvePrintOptions)( TidyDocImpl* doc );
 
 void TY_(PFlushLine)( TidyDocImpl* doc, uint indent );
 
@@ -85,10 +115,17 @@ void TY_(PPrintTree)( TidyDocImpl* doc, uint mode, uint indent, Node *node );
 
 void TY_(PPrintXMLTree)( TidyDocImpl* doc, uint mode, uint indent, Node *node );
 
-/*\
- * 20150515 - support using tabs instead of spaces
-\*/
-void TY_(PPrintTabs)(void);
-void TY_(PPrintSpaces)(void);
+/* minified output: node, or only its content, without layout
+** and with optional tags left out.
+*/
+void TY_(PMinifyTree)( TidyDocImpl* doc, Node *node, Bool contentOnly );
+
+/* streamed output: print everything up to the start tag of body,
+** then each child of the root, <html> or <body> once it is final,
+** and the end tags of <body> and <html> when they are complete.
+*/
+void TY_(PPrintStreamStart)( TidyDocImpl* doc, Node *body );
+void TY_(PPrintStreamNode)( TidyDocImpl* doc, Node *node );
+void TY_(PPrintStreamEnd)( TidyDocImpl* doc, Node *node );
 
 #endif /* __PPRINT_H__ */
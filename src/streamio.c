@@ -19,6 +19,7 @@
 #include "message.h"
 #include "utf8.h"
 #include "tmbstr.h"
+#include "charsets.h"
 
 #ifdef TIDY_WIN32_MLANG_SUPPORT
 #include "win32tc.h"
@@ -40,9 +41,6 @@ static void EncodeMacRoman( uint c, StreamOut* out );
 static void EncodeIbm858( uint c, StreamOut* out );
 static void EncodeLatin0( uint c, StreamOut* out );
 
-static uint DecodeIbm850(uint c);
-static uint DecodeLatin0(uint c);
-
 static uint PopChar( StreamIn *in );
 
 /******************************
@@ -112,17 +110,21 @@ StreamIn* TY_(initStreamIn)( TidyDocImpl* doc, int encoding )
     TidyClearMemory( in, sizeof(StreamIn) );
     in->curline = 1;
     in->curcol = 1;
-    in->encoding = encoding;
+    TY_(SetStreamInEncoding)( in, encoding );
     in->state = FSM_ASCII;
     in->doc = doc;
+    in->tabsize = cfg( doc, TidyTabSize );
+    in->xmlTags = cfgBool( doc, TidyXmlTags );
     in->bufsize = CHARBUF_SIZE;
     in->allocator = doc->allocator;
     in->charbuf = (tchar*)TidyDocAlloc(doc, sizeof(tchar) * in->bufsize);
+    in->charoffs = (uint*)TidyDocAlloc(doc, sizeof(uint) * in->bufsize);
     InitLastPos( in );
 #ifdef TIDY_STORE_ORIGINAL_TEXT
     in->otextbuf = NULL;
     in->otextlen = 0;
     in->otextsize = 0;
+    in->otextstart = 0;
 #endif
     return in;
 }
@@ -134,6 +136,7 @@ void TY_(freeStreamIn)(StreamIn* in)
         TidyFree(in->allocator, in->otextbuf);
 #endif
     TidyFree(in->allocator, in->charbuf);
+    TidyFree(in->allocator, in->charoffs);
     TidyFree(in->allocator, in);
 }
 
@@ -153,6 +156,8 @@ StreamIn* TY_(BufferInput)( TidyDocImpl* doc, TidyBuffer* buf, int encoding )
 {
     StreamIn *in = TY_(initStreamIn)( doc, encoding );
     tidyInitInputBuffer( &in->source, buf );
+    in->bytes = buf;
+    in->bytebase = buf->next;
     in->iotype = BufferIO;
     return in;
 }
@@ -165,6 +170,73 @@ StreamIn* TY_(UserInput)( TidyDocImpl* doc, TidyInputSource* source, int encodin
     return in;
 }
 
+static int TIDY_CALL limited_getByte( void* sourceData )
+{
+    StreamIn* in = (StreamIn*) sourceData;
+    if ( in->bytesLeft == 0 )
+        return EOF;
+    --in->bytesLeft;
+    return (int) tidyGetByte( &in->unlimited );
+}
+
+static void TIDY_CALL limited_ungetByte( void* sourceData, byte bv )
+{
+    StreamIn* in = (StreamIn*) sourceData;
+    ++in->bytesLeft;
+    tidyUngetByte( &in->unlimited, bv );
+}
+
+static Bool TIDY_CALL limited_eof( void* sourceData )
+{
+    StreamIn* in = (StreamIn*) sourceData;
+    return in->bytesLeft == 0 || tidyIsEOF( &in->unlimited );
+}
+
+/* A TidyBuffer read in place is cut short, other sources are wrapped
+** in callbacks that count down the bytes left.
+*/
+void TY_(LimitStreamIn)( StreamIn* in, ulong limit )
+{
+    TidyBuffer* buf = in->bytes;
+
+    if ( buf )
+    {
+        if ( buf->size - buf->next > limit )
+        {
+            in->bytesSize = buf->size;
+            buf->size = buf->next + (uint) limit;
+        }
+        return;
+    }
+
+    in->bytesLeft = limit;
+    in->unlimited = in->source;
+    tidyInitSource( &in->source, in, limited_getByte, limited_ungetByte,
+                    limited_eof );
+}
+
+Bool TY_(UnlimitStreamIn)( StreamIn* in )
+{
+    TidyBuffer* buf = in->bytes;
+    Bool cut = no;
+
+    if ( buf )
+    {
+        if ( in->bytesSize > 0 )
+        {
+            cut = ( buf->next >= buf->size );
+            buf->size = in->bytesSize;
+            in->bytesSize = 0;
+        }
+    }
+    else if ( in->source.sourceData == in )
+    {
+        cut = ( in->bytesLeft == 0 && !tidyIsEOF(&in->unlimited) );
+        in->source = in->unlimited;
+    }
+    return cut;
+}
+
 int TY_(ReadBOMEncoding)(StreamIn *in)
 {
     uint c, c1;
@@ -235,23 +307,292 @@ int TY_(ReadBOMEncoding)(StreamIn *in)
     return -1;
 }
 
+/* Encoding prescan, after the HTML5 "prescan a byte stream to
+** determine its encoding" algorithm: look through the start of the
+** document for an XML declaration or a <meta> giving the charset.
+*/
+
+#define PRESCAN_SIZE   1024
+#define PRESCAN_NAME   32
+#define PRESCAN_VALUE  128
+
+static Bool IsPrescanSpace( uint c )
+{
+    return ( c == ' ' || c == '\t' || c == '\n' || c == '\f' || c == '\r' );
+}
+
+static Bool IsPrescanLetter( uint c )
+{
+    c |= 0x20;
+    return ( c >= 'a' && c <= 'z' );
+}
+
+/* case-insensitive match of lowercase "lit" at "p" */
+static Bool PrescanMatch( const byte* p, const byte* end, ctmbstr lit )
+{
+    for ( ; *lit; ++p, ++lit )
+        if ( p >= end || TY_(ToLower)(*p) != (byte) *lit )
+            return no;
+    return yes;
+}
+
+/* Get the next attribute of a tag, lowercased and truncated to fit.
+** Returns no at the closing '>' or when the window runs out.
+*/
+static Bool PrescanAttribute( const byte** pp, const byte* end,
+                              tmbstr name, tmbstr value )
+{
+    const byte* p = *pp;
+    uint n = 0, v = 0;
+
+    while ( p < end && (IsPrescanSpace(*p) || *p == '/') )
+        ++p;
+    *pp = p;
+    if ( p >= end || *p == '>' )
+        return no;
+
+    do
+    {
+        if ( n < PRESCAN_NAME - 1 )
+            name[n++] = (tmbchar) TY_(ToLower)( *p );
+        ++p;
+    } while ( p < end && *p != '=' && *p != '/' && *p != '>' &&
+              !IsPrescanSpace(*p) );
+    name[n] = '\0';
+
+    while ( p < end && IsPrescanSpace(*p) )
+        ++p;
+    if ( p < end && *p == '=' )
+    {
+        ++p;
+        while ( p < end && IsPrescanSpace(*p) )
+            ++p;
+        if ( p < end && (*p == '"' || *p == '\'') )
+        {
+            byte quote = *p++;
+            for ( ; p < end && *p != quote; ++p )
+                if ( v < PRESCAN_VALUE - 1 )
+                    value[v++] = (tmbchar) TY_(ToLower)( *p );
+            if ( p < end )
+                ++p;
+        }
+        else
+        {
+            for ( ; p < end && *p != '>' && !IsPrescanSpace(*p); ++p )
+                if ( v < PRESCAN_VALUE - 1 )
+                    value[v++] = (tmbchar) TY_(ToLower)( *p );
+        }
+    }
+    value[v] = '\0';
+
+    *pp = p;
+    return ( p < end );
+}
+
+/* charset=... within a <meta content="..."> value */
+static Bool PrescanContentCharset( ctmbstr content, tmbstr charset )
+{
+    ctmbstr s = content;
+    uint n = 0;
+
+    for (;;)
+    {
+        s = strstr( s, "charset" );
+        if ( s == NULL )
+            return no;
+        s += 7;
+        while ( IsPrescanSpace(*s) )
+            ++s;
+        if ( *s == '=' )
+            break;
+    }
+
+    ++s;
+    while ( IsPrescanSpace(*s) )
+        ++s;
+    if ( *s == '"' || *s == '\'' )
+    {
+        tmbchar quote = *s++;
+        while ( s[n] && s[n] != quote )
+            ++n;
+        if ( !s[n] )
+            return no;
+    }
+    else
+    {
+        while ( s[n] && s[n] != ';' && !IsPrescanSpace(s[n]) )
+            ++n;
+    }
+
+    if ( n == 0 )
+        return no;
+    TY_(tmbstrncpy)( charset, s, n < PRESCAN_VALUE ? n + 1 : PRESCAN_VALUE );
+    return yes;
+}
+
+static int PrescanCharset( ctmbstr charset )
+{
+    int enc = TY_(GetCharEncodingFromIanaName)( charset );
+
+#if SUPPORT_UTF16_ENCODINGS
+    /* a document whose markup reads as ASCII is not UTF-16 */
+    if ( enc == UTF16 || enc == UTF16LE || enc == UTF16BE )
+        enc = UTF8;
+#endif
+    return enc;
+}
+
+static int PrescanBytes( const byte* p, const byte* end )
+{
+    tmbchar name[PRESCAN_NAME], value[PRESCAN_VALUE], charset[PRESCAN_VALUE];
+
+    if ( PrescanMatch(p, end, "<?xml") )
+    {
+        p += 5;
+        while ( PrescanAttribute(&p, end, name, value) )
+            if ( TY_(tmbstrcmp)(name, "encoding") == 0 )
+                return PrescanCharset( value );
+    }
+
+    while ( p < end )
+    {
+        if ( PrescanMatch(p, end, "<!--") )
+        {
+            for ( p += 2; p < end && !PrescanMatch(p, end, "-->"); ++p )
+                /**/;
+            if ( p >= end )
+                break;
+            p += 3;
+            continue;
+        }
+
+        if ( PrescanMatch(p, end, "<meta") && p + 5 < end &&
+             (IsPrescanSpace(p[5]) || p[5] == '/') )
+        {
+            Bool gotPragma = no, needPragma = no, haveCharset = no;
+
+            p += 5;
+            while ( PrescanAttribute(&p, end, name, value) )
+            {
+                if ( TY_(tmbstrcmp)(name, "http-equiv") == 0 )
+                {
+                    if ( TY_(tmbstrcmp)(value, "content-type") == 0 )
+                        gotPragma = yes;
+                }
+                else if ( TY_(tmbstrcmp)(name, "content") == 0 )
+                {
+                    if ( !haveCharset && PrescanContentCharset(value, charset) )
+                        haveCharset = needPragma = yes;
+                }
+                else if ( TY_(tmbstrcmp)(name, "charset") == 0 )
+                {
+                    if ( !haveCharset && value[0] )
+                    {
+                        TY_(tmbstrcpy)( charset, value );
+                        haveCharset = yes;
+                        needPragma = no;
+                    }
+                }
+            }
+
+            if ( haveCharset && (gotPragma || !needPragma) )
+            {
+                int enc = PrescanCharset( charset );
+                if ( enc != -1 )
+                    return enc;
+            }
+            continue;
+        }
+
+        if ( *p == '<' && p + 1 < end &&
+             (IsPrescanLetter(p[1]) ||
+              (p[1] == '/' && p + 2 < end && IsPrescanLetter(p[2]))) )
+        {
+            /* any other tag: skip its name and attributes */
+            while ( p < end && *p != '>' && !IsPrescanSpace(*p) )
+                ++p;
+            while ( PrescanAttribute(&p, end, name, value) )
+                /**/;
+            continue;
+        }
+
+        if ( PrescanMatch(p, end, "<!") || PrescanMatch(p, end, "</") ||
+             PrescanMatch(p, end, "<?") )
+        {
+            while ( p < end && *p != '>' )
+                ++p;
+            continue;
+        }
+
+        ++p;
+    }
+
+    return -1;
+}
+
+/* Returns the encoding declared within the first PRESCAN_SIZE bytes,
+** or -1.  Input is left unread.  Custom input sources can't be
+** relied on to take back that much, so they are not prescanned.
+*/
+int TY_(PrescanEncoding)( StreamIn *in )
+{
+    byte window[PRESCAN_SIZE];
+    uint len = 0;
+    int enc;
+
+    if ( in->bytes )
+    {
+        TidyBuffer* buf = in->bytes;
+        len = buf->size - buf->next;
+        if ( len > PRESCAN_SIZE )
+            len = PRESCAN_SIZE;
+        if ( len == 0 )
+            return -1;
+        return PrescanBytes( buf->bp + buf->next, buf->bp + buf->next + len );
+    }
+
+    if ( in->iotype != FileIO )
+        return -1;
+
+    while ( len < PRESCAN_SIZE && !TY_(IsEOF)(in) )
+    {
+        uint c = ReadByte( in );
+        if ( c == EndOfStream )
+            break;
+        window[ len++ ] = (byte) c;
+    }
+
+    enc = PrescanBytes( window, window + len );
+
+    /* unget in reverse order */
+    while ( len > 0 )
+        UngetByte( in, window[ --len ] );
+
+    return enc;
+}
+
 #ifdef TIDY_STORE_ORIGINAL_TEXT
+/* The text read is kept for the whole document, tokens take their
+** part of it as an offset and length, see StoreOriginalTextInToken().
+*/
 void TY_(AddByteToOriginalText)(StreamIn *in, tmbchar c)
 {
-    if (in->otextlen + 1 >= in->otextsize)
+    if (in->otextlen >= in->otextsize)
     {
-        size_t size = in->otextsize ? 1 : 2;
-        in->otextbuf = TidyRealloc(in->allocator, in->otextbuf, in->otextsize + size);
-        in->otextsize += size;
+        uint size = in->otextsize ? in->otextsize * 2 : 8192;
+        in->otextbuf = TidyRealloc(in->allocator, in->otextbuf, size);
+        in->otextsize = size;
     }
     in->otextbuf[in->otextlen++] = c;
-    in->otextbuf[in->otextlen  ] = 0;
 }
 
 void TY_(AddCharToOriginalText)(StreamIn *in, tchar c)
 {
     int i, err, count = 0;
     tmbchar buf[10] = {0};
+
+    if (!in->doc->storeText)
+        return;
     
     err = TY_(EncodeCharToUTF8Bytes)(c, buf, NULL, &count);
 
@@ -301,10 +642,45 @@ static void RestoreLastPos( StreamIn *in )
     }
 }
 
+static uint RawOffset( StreamIn *in )
+{
+    if ( in->bytes )
+        return in->bytes->next - in->bytebase;
+    return in->bytepos;
+}
+
+static void PushOffset( StreamIn *in, uint offset )
+{
+    in->curlastoff = (in->curlastoff+1)%LASTPOS_SIZE;
+    in->lastoffs[in->curlastoff] = offset;
+}
+
+static uint PopOffset( StreamIn *in )
+{
+    uint offset = in->lastoffs[in->curlastoff];
+    if ( in->curlastoff == 0 )
+        in->curlastoff = LASTPOS_SIZE;
+    in->curlastoff--;
+    return offset;
+}
+
+uint TY_(StreamInOffset)( StreamIn *in )
+{
+    if ( in->pushed )
+        return in->charoffs[ in->bufpos - 1 ];
+    return RawOffset( in );
+}
+
+uint TY_(StreamInCharOffset)( StreamIn *in )
+{
+    return in->lastoffs[ in->curlastoff ];
+}
+
 uint TY_(ReadChar)( StreamIn *in )
 {
     uint c = EndOfStream;
-    uint tabsize = cfg( in->doc, TidyTabSize );
+    uint tabsize = in->tabsize;
+    uint offset;
 #ifdef TIDY_STORE_ORIGINAL_TEXT
     Bool added = no;
 #endif
@@ -318,11 +694,13 @@ uint TY_(ReadChar)( StreamIn *in )
     {
         in->curcol++;
         in->tabs--;
+        PushOffset( in, in->lastoffs[in->curlastoff] );
         return ' ';
     }
     
     for (;;)
     {
+        offset = RawOffset( in );
         c = ReadCharFromStream(in);
 
         if ( EndOfStream == c )
@@ -356,6 +734,7 @@ uint TY_(ReadChar)( StreamIn *in )
         /* #427663 - map '\r' to '\n' - Andy Quick 11 Aug 00 */
         if (c == '\r')
         {
+            uint next = RawOffset( in );
 #ifdef TIDY_STORE_ORIGINAL_TEXT
             added = yes;
             TY_(AddCharToOriginalText)(in, (tchar)c);
@@ -363,6 +742,14 @@ uint TY_(ReadChar)( StreamIn *in )
             c = ReadCharFromStream(in);
             if (c != '\n')
             {
+                /* UngetChar() takes the offset of the char it puts back */
+                if ( c != EndOfStream )
+                {
+                    PushOffset( in, next );
+#ifdef TIDY_STORE_ORIGINAL_TEXT
+                    TY_(AddCharToOriginalText)(in, (tchar)c);
+#endif
+                }
                 TY_(UngetChar)( c, in );
                 c = '\n';
             }
@@ -384,7 +771,7 @@ uint TY_(ReadChar)( StreamIn *in )
 #endif
 
         /* Form Feed is allowed in HTML */
-        if ( c == '\015' && !cfgBool(in->doc, TidyXmlTags) )
+        if ( c == '\015' && !in->xmlTags )
             break;
             
         if ( c < 32 )
@@ -443,19 +830,8 @@ uint TY_(ReadChar)( StreamIn *in )
         }
 #endif
 
-        /* Do first: acts on range 128 - 255 */
-        switch ( in->encoding )
-        {
-        case MACROMAN:
-            c = TY_(DecodeMacRoman)( c );
-            break;
-        case IBM858:
-            c = DecodeIbm850( c );
-            break;
-        case LATIN0:
-            c = DecodeLatin0( c );
-            break;
-        }
+        /* range 128 - 255 of MacRoman, IBM858 and Latin0 */
+        /* has already been mapped by the stream decoder */
 
         /* produced e.g. as a side-effect of smart quotes in Word */
         /* but can't happen if using MACROMAN encoding */
@@ -500,6 +876,7 @@ uint TY_(ReadChar)( StreamIn *in )
         TY_(AddCharToOriginalText)(in, (tchar)c);
 #endif
 
+    PushOffset( in, offset );
     return c;
 }
 
@@ -510,6 +887,7 @@ static uint PopChar( StreamIn *in )
     {
         assert( in->bufpos > 0 );
         c = in->charbuf[ --in->bufpos ];
+        PushOffset( in, in->charoffs[ in->bufpos ] );
         if ( in->bufpos == 0 )
             in->pushed = no;
 
@@ -537,8 +915,12 @@ void TY_(UngetChar)( uint c, StreamIn *in )
     in->pushed = yes;
 
     if (in->bufpos + 1 >= in->bufsize)
+    {
         in->charbuf = (tchar*)TidyRealloc(in->allocator, in->charbuf, sizeof(tchar) * ++(in->bufsize));
+        in->charoffs = (uint*)TidyRealloc(in->allocator, in->charoffs, sizeof(uint) * in->bufsize);
+    }
 
+    in->charoffs[in->bufpos] = PopOffset( in );
     in->charbuf[(in->bufpos)++] = c;
 
     if (c == '\n')
@@ -870,15 +1252,6 @@ static const uint IBM2Unicode[128] =
     0x00b0, 0x00a8, 0x00b7, 0x00b9, 0x00b3, 0x00b2, 0x25a0, 0x00a0
 };
 
-/* Function for conversion from OS/2-850 to Unicode */
-static uint DecodeIbm850(uint c)
-{
-    if (127 < c && c < 256)
-        c = IBM2Unicode[c - 128];
-
-    return c;
-}
-
 /* For OS/2,Java users, map Unicode back to IBM858 (IBM850+Euro). */
 static void EncodeIbm858( uint c, StreamOut* out )
 {
@@ -899,25 +1272,28 @@ static void EncodeIbm858( uint c, StreamOut* out )
 }
 
 
-/* Convert from Latin0 (aka Latin9, ISO-8859-15) to Unicode */
-static uint DecodeLatin0(uint c)
+/* Mapping for Latin0 (aka Latin9, ISO-8859-15)
+** (chars 128-255) to Unicode.
+*/
+static const uint Latin02Unicode[128] =
 {
-    if (159 < c && c < 191)
-    {
-        switch (c)
-        {
-        case 0xA4: c = 0x20AC; break;
-        case 0xA6: c = 0x0160; break;
-        case 0xA8: c = 0x0161; break;
-        case 0xB4: c = 0x017D; break;
-        case 0xB8: c = 0x017E; break;
-        case 0xBC: c = 0x0152; break;
-        case 0xBD: c = 0x0153; break;
-        case 0xBE: c = 0x0178; break;
-        }
-    }
-    return c;
-}
+    0x0080, 0x0081, 0x0082, 0x0083, 0x0084, 0x0085, 0x0086, 0x0087,
+    0x0088, 0x0089, 0x008A, 0x008B, 0x008C, 0x008D, 0x008E, 0x008F,
+    0x0090, 0x0091, 0x0092, 0x0093, 0x0094, 0x0095, 0x0096, 0x0097,
+    0x0098, 0x0099, 0x009A, 0x009B, 0x009C, 0x009D, 0x009E, 0x009F,
+    0x00A0, 0x00A1, 0x00A2, 0x00A3, 0x20AC, 0x00A5, 0x0160, 0x00A7,
+    0x0161, 0x00A9, 0x00AA, 0x00AB, 0x00AC, 0x00AD, 0x00AE, 0x00AF,
+    0x00B0, 0x00B1, 0x00B2, 0x00B3, 0x017D, 0x00B5, 0x00B6, 0x00B7,
+    0x017E, 0x00B9, 0x00BA, 0x00BB, 0x0152, 0x0153, 0x0178, 0x00BF,
+    0x00C0, 0x00C1, 0x00C2, 0x00C3, 0x00C4, 0x00C5, 0x00C6, 0x00C7,
+    0x00C8, 0x00C9, 0x00CA, 0x00CB, 0x00CC, 0x00CD, 0x00CE, 0x00CF,
+    0x00D0, 0x00D1, 0x00D2, 0x00D3, 0x00D4, 0x00D5, 0x00D6, 0x00D7,
+    0x00D8, 0x00D9, 0x00DA, 0x00DB, 0x00DC, 0x00DD, 0x00DE, 0x00DF,
+    0x00E0, 0x00E1, 0x00E2, 0x00E3, 0x00E4, 0x00E5, 0x00E6, 0x00E7,
+    0x00E8, 0x00E9, 0x00EA, 0x00EB, 0x00EC, 0x00ED, 0x00EE, 0x00EF,
+    0x00F0, 0x00F1, 0x00F2, 0x00F3, 0x00F4, 0x00F5, 0x00F6, 0x00F7,
+    0x00F8, 0x00F9, 0x00FA, 0x00FB, 0x00FC, 0x00FD, 0x00FE, 0x00FF
+};
 
 /* Map Unicode back to ISO-8859-15. */
 static void EncodeLatin0( uint c, StreamOut* out )
@@ -1068,7 +1444,10 @@ void TIDY_CALL tidyPutByte( TidyOutputSink* sink, uint ch )
 
 static uint ReadByte( StreamIn* in )
 {
-    return tidyGetByte( &in->source );
+    uint c = tidyGetByte( &in->source );
+    if ( c != EndOfStream )
+        ++in->bytepos;
+    return c;
 }
 Bool TY_(IsEOF)( StreamIn* in )
 {
@@ -1076,6 +1455,7 @@ Bool TY_(IsEOF)( StreamIn* in )
 }
 static void UngetByte( StreamIn* in, uint byteValue )
 {
+    --in->bytepos;
     tidyUngetByte( &in->source, byteValue );
 }
 static void PutByte( uint byteValue, StreamOut* out )
@@ -1131,175 +1511,335 @@ static void ReadRawBytesFromStream( StreamIn *in, byte* buf, int *count )
 }
 #endif /* 0 */
 
-/* read char from stream */
-static uint ReadCharFromStream( StreamIn* in )
+/* Next raw byte of input.  A TidyBuffer source is read in place,
+** other sources go through their callbacks.
+*/
+static uint NextByte( StreamIn* in )
 {
-    uint c, n;
-#ifdef TIDY_WIN32_MLANG_SUPPORT
-    uint bytesRead = 0;
-#endif
+    TidyBuffer* buf = in->bytes;
+
+    if ( buf )
+        return ( buf->next < buf->size ? buf->bp[ buf->next++ ] : EndOfStream );
 
     if ( TY_(IsEOF)(in) )
         return EndOfStream;
-    
-    c = ReadByte( in );
+    return ReadByte( in );
+}
 
-    if (c == EndOfStream)
-        return c;
+/* ASCII, Latin1, Windows-1252 and raw input: bytes are chars */
+static uint DecodeByteStream( StreamIn* in )
+{
+    return NextByte( in );
+}
+
+/* MacRoman, IBM858 and Latin0: map 128-255 through the code page */
+static uint DecodeCodePageStream( StreamIn* in )
+{
+    uint c = NextByte( in );
+
+    if ( c > 127 && c != EndOfStream )
+        c = in->hiChars[ c - 128 ];
+    return c;
+}
 
 #ifndef NO_NATIVE_ISO2022_SUPPORT
-    /*
-       A document in ISO-2022 based encoding uses some ESC sequences
-       called "designator" to switch character sets. The designators
-       defined and used in ISO-2022-JP are:
+/*
+   A document in ISO-2022 based encoding uses some ESC sequences
+   called "designator" to switch character sets. The designators
+   defined and used in ISO-2022-JP are:
 
-        "ESC" + "(" + ?     for ISO646 variants
+    "ESC" + "(" + ?     for ISO646 variants
 
-        "ESC" + "$" + ?     and
-        "ESC" + "$" + "(" + ?   for multibyte character sets
+    "ESC" + "$" + ?     and
+    "ESC" + "$" + "(" + ?   for multibyte character sets
 
-       Where ? stands for a single character used to indicate the
-       character set for multibyte characters.
+   Where ? stands for a single character used to indicate the
+   character set for multibyte characters.
 
-       Tidy handles this by preserving the escape sequence and
-       setting the top bit of each byte for non-ascii chars. This
-       bit is then cleared on output. The input stream keeps track
-       of the state to determine when to set/clear the bit.
-    */
+   Tidy handles this by preserving the escape sequence and
+   setting the top bit of each byte for non-ascii chars. This
+   bit is then cleared on output. The input stream keeps track
+   of the state to determine when to set/clear the bit.
+*/
+static uint DecodeISO2022Stream( StreamIn* in )
+{
+    uint c = NextByte( in );
 
-    if (in->encoding == ISO2022)
-    {
-        if (c == 0x1b)  /* ESC */
-        {
-            in->state = FSM_ESC;
-            return c;
-        }
+    if (c == EndOfStream)
+        return c;
 
-        switch (in->state)
-        {
-        case FSM_ESC:
-            if (c == '$')
-                in->state = FSM_ESCD;
-            else if (c == '(')
-                in->state = FSM_ESCP;
-            else
-                in->state = FSM_ASCII;
-            break;
+    if (c == 0x1b)  /* ESC */
+    {
+        in->state = FSM_ESC;
+        return c;
+    }
 
-        case FSM_ESCD:
-            if (c == '(')
-                in->state = FSM_ESCDP;
-            else
-                in->state = FSM_NONASCII;
-            break;
+    switch (in->state)
+    {
+    case FSM_ESC:
+        if (c == '$')
+            in->state = FSM_ESCD;
+        else if (c == '(')
+            in->state = FSM_ESCP;
+        else
+            in->state = FSM_ASCII;
+        break;
 
-        case FSM_ESCDP:
+    case FSM_ESCD:
+        if (c == '(')
+            in->state = FSM_ESCDP;
+        else
             in->state = FSM_NONASCII;
-            break;
+        break;
 
-        case FSM_ESCP:
-            in->state = FSM_ASCII;
-            break;
+    case FSM_ESCDP:
+        in->state = FSM_NONASCII;
+        break;
 
-        case FSM_NONASCII:
-            c |= 0x80;
-            break;
+    case FSM_ESCP:
+        in->state = FSM_ASCII;
+        break;
 
-        case FSM_ASCII:
-            break;
-        }
+    case FSM_NONASCII:
+        c |= 0x80;
+        break;
 
-        return c;
+    case FSM_ASCII:
+        break;
     }
+
+    return c;
+}
 #endif /* #ifndef NO_NATIVE_ISO2022_SUPPORT */
 
 #if SUPPORT_UTF16_ENCODINGS
-    if ( in->encoding == UTF16LE )
+static uint DecodeUTF16LEStream( StreamIn* in )
+{
+    uint c = NextByte( in ), c1;
+
+    if (c == EndOfStream)
+        return c;
+    c1 = NextByte( in );
+    if ( EndOfStream == c1 )
+        return EndOfStream;
+    return (c1 << 8) + c;
+}
+
+/* UTF-16 is big-endian by default */
+static uint DecodeUTF16BEStream( StreamIn* in )
+{
+    uint c = NextByte( in ), c1;
+
+    if (c == EndOfStream)
+        return c;
+    c1 = NextByte( in );
+    if ( EndOfStream == c1 )
+        return EndOfStream;
+    return (c << 8) + c1;
+}
+#endif
+
+/* Decode a well-formed UTF-8 sequence in place, "c" being its lead
+** byte just taken from "buf".  Returns 0 without consuming anything
+** when the sequence is truncated, overlong, out of range or a
+** noncharacter, leaving it to TY_(DecodeUTF8BytesToChar) to report.
+*/
+static uint DecodeBufferedUTF8( TidyBuffer* buf, uint c )
+{
+    const byte* p = buf->bp + buf->next;
+    uint avail = buf->size - buf->next;
+    uint n;
+
+    if ( c >= 0xC2 && c <= 0xDF )
     {
-        uint c1 = ReadByte( in );
-        if ( EndOfStream == c1 )
-            return EndOfStream;
-        n = (c1 << 8) + c;
-        return n;
+        if ( avail < 1 || (p[0] & 0xC0) != 0x80 )
+            return 0;
+        buf->next += 1;
+        return ((c & 0x1F) << 6) | (p[0] & 0x3F);
     }
 
-    if ((in->encoding == UTF16) || (in->encoding == UTF16BE)) /* UTF-16 is big-endian by default */
+    if ( c >= 0xE0 && c <= 0xEF )
     {
-        uint c1 = ReadByte( in );
-        if ( EndOfStream == c1 )
-            return EndOfStream;
-        n = (c << 8) + c1;
+        if ( avail < 2 || (p[0] & 0xC0) != 0x80 || (p[1] & 0xC0) != 0x80 )
+            return 0;
+        n = ((c & 0x0F) << 12) | ((p[0] & 0x3F) << 6) | (p[1] & 0x3F);
+        if ( n < 0x800 || n == 0xFFFE || n == 0xFFFF )
+            return 0;
+        buf->next += 2;
         return n;
     }
-#endif
 
-    if ( in->encoding == UTF8 )
+    if ( c >= 0xF0 && c <= 0xF4 )
     {
-        /* deal with UTF-8 encoded char */
+        if ( avail < 3 || (p[0] & 0xC0) != 0x80 ||
+             (p[1] & 0xC0) != 0x80 || (p[2] & 0xC0) != 0x80 )
+            return 0;
+        n = ((c & 0x07) << 18) | ((p[0] & 0x3F) << 12) |
+            ((p[1] & 0x3F) << 6) | (p[2] & 0x3F);
+        if ( n < 0x10000 || n > 0x10FFFF )
+            return 0;
+        buf->next += 3;
+        return n;
+    }
 
-        int err, count = 0;
-        
-        /* first byte "c" is passed in separately */
-        err = TY_(DecodeUTF8BytesToChar)( &n, c, NULL, &in->source, &count );
-        if (!err && (n == (uint)EndOfStream) && (count == 1)) /* EOF */
-            return EndOfStream;
-        else if (err)
-        {
-            /* set error position just before offending character */
-            in->doc->lexer->lines = in->curline;
-            in->doc->lexer->columns = in->curcol;
+    return 0;
+}
 
-            TY_(ReportEncodingError)(in->doc, INVALID_UTF8, n, no);
-            n = 0xFFFD; /* replacement char */
-        }
-        
+static uint DecodeUTF8Stream( StreamIn* in )
+{
+    uint c = NextByte( in ), n;
+    int err, count = 0;
+
+    /* ASCII needs no decoding */
+    if ( c < 128 || c == EndOfStream )
+        return c;
+
+    if ( in->bytes && (n = DecodeBufferedUTF8(in->bytes, c)) != 0 )
         return n;
+
+    /* first byte "c" is passed in separately */
+    err = TY_(DecodeUTF8BytesToChar)( &n, c, NULL, &in->source, &count );
+
+    /* successor bytes taken, less any put back, are one fewer than count */
+    if ( count > 1 )
+        in->bytepos += count - 1;
+
+    if (!err && (n == (uint)EndOfStream) && (count == 1)) /* EOF */
+        return EndOfStream;
+    else if (err)
+    {
+        /* set error position just before offending character */
+        in->doc->lexer->lines = in->curline;
+        in->doc->lexer->columns = in->curcol;
+
+        TY_(ReportEncodingError)(in->doc, INVALID_UTF8, n, no);
+        n = 0xFFFD; /* replacement char */
     }
-    
+
+    return n;
+}
+
 #if SUPPORT_ASIAN_ENCODINGS
-    /*
-       This section is suitable for any "multibyte" variable-width 
-       character encoding in which a one-byte code is less than
-       128, and the first byte of a two-byte code is greater or
-       equal to 128. Note that Big5 and ShiftJIS fit into this
-       kind, even though their second byte may be less than 128
-    */
-    if ((in->encoding == BIG5) || (in->encoding == SHIFTJIS))
+/*
+   This is suitable for any "multibyte" variable-width
+   character encoding in which a one-byte code is less than
+   128, and the first byte of a two-byte code is greater or
+   equal to 128. Note that Big5 and ShiftJIS fit into this
+   kind, even though their second byte may be less than 128
+*/
+static uint DecodeMultiByteStream( StreamIn* in )
+{
+    uint c = NextByte( in ), c1;
+
+    if (c < 128 || c == EndOfStream)
+        return c;
+
+    if ((in->encoding == SHIFTJIS) && (c >= 0xa1 && c <= 0xdf)) /* 461643 - fix suggested by Rick Cameron 14 Sep 01 */
     {
-        if (c < 128)
-            return c;
-        else if ((in->encoding == SHIFTJIS) && (c >= 0xa1 && c <= 0xdf)) /* 461643 - fix suggested by Rick Cameron 14 Sep 01 */
-        {
-            /*
-              Rick Cameron pointed out that for Shift_JIS, the values from
-              0xa1 through 0xdf represent singe-byte characters
-              (U+FF61 to U+FF9F - half-shift Katakana)
-            */
-            return c;
-        }
-        else
-        {
-            uint c1 = ReadByte( in );
-            if ( EndOfStream == c1 )
-                return EndOfStream;
-            n = (c << 8) + c1;
-            return n;
-        }
+        /*
+          Rick Cameron pointed out that for Shift_JIS, the values from
+          0xa1 through 0xdf represent singe-byte characters
+          (U+FF61 to U+FF9F - half-shift Katakana)
+        */
+        return c;
     }
+
+    c1 = NextByte( in );
+    if ( EndOfStream == c1 )
+        return EndOfStream;
+    return (c << 8) + c1;
+}
 #endif
 
 #ifdef TIDY_WIN32_MLANG_SUPPORT
-    else if (in->encoding > WIN32MLANG)
+static uint DecodeMLangStream( StreamIn* in )
+{
+    uint bytesRead = 0;
+    uint c = NextByte( in );
+
+    if (c == EndOfStream)
+        return c;
+
+    assert( in->mlang != NULL );
+    return TY_(Win32MLangGetChar)((byte)c, in, &bytesRead);
+}
+#endif
+
+/* Select the decoder once, rather than testing the encoding per char */
+void TY_(SetStreamInEncoding)( StreamIn* in, int encoding )
+{
+    in->encoding = encoding;
+    in->hiChars = NULL;
+    in->decode = DecodeByteStream;
+
+    switch ( encoding )
     {
-        assert( in->mlang != NULL );
-        return TY_(Win32MLangGetChar)((byte)c, in, &bytesRead);
-    }
+    case UTF8:
+        in->decode = DecodeUTF8Stream;
+        break;
+
+    case MACROMAN:
+        in->hiChars = Mac2Unicode;
+        in->decode = DecodeCodePageStream;
+        break;
+
+    case IBM858:
+        in->hiChars = IBM2Unicode;
+        in->decode = DecodeCodePageStream;
+        break;
+
+    case LATIN0:
+        in->hiChars = Latin02Unicode;
+        in->decode = DecodeCodePageStream;
+        break;
+
+#ifndef NO_NATIVE_ISO2022_SUPPORT
+    case ISO2022:
+        in->decode = DecodeISO2022Stream;
+        break;
 #endif
 
-    else
-        n = c;
-        
-    return n;
+#if SUPPORT_UTF16_ENCODINGS
+    case UTF16LE:
+        in->decode = DecodeUTF16LEStream;
+        break;
+
+    case UTF16:
+    case UTF16BE:
+        in->decode = DecodeUTF16BEStream;
+        break;
+#endif
+
+#if SUPPORT_ASIAN_ENCODINGS
+    case BIG5:
+    case SHIFTJIS:
+        in->decode = DecodeMultiByteStream;
+        break;
+#endif
+
+    default:
+#ifdef TIDY_WIN32_MLANG_SUPPORT
+        if ( encoding > WIN32MLANG )
+            in->decode = DecodeMLangStream;
+#endif
+        break;
+    }
+}
+
+/* read char from stream */
+static uint ReadCharFromStream( StreamIn* in )
+{
+    return in->decode( in );
+}
+
+/* Write bytes already encoded for this stream, such as the output
+** of another stream with the same encoding and newline style.
+*/
+void TY_(WriteBytes)( const byte* buf, uint len, StreamOut* out )
+{
+    uint i;
+    for ( i = 0; i < len; ++i )
+        PutByte( buf[i], out );
 }
 
 /* Output a Byte Order Mark if required */
@@ -1371,6 +1911,21 @@ ctmbstr TY_(GetEncodingOptNameFromTidyId)(uint id)
     return NULL;
 }
 
+/* Tidy encoding for an IANA charset name or alias, or -1 */
+int TY_(GetCharEncodingFromIanaName)( ctmbstr charset )
+{
+    uint i, id = TY_(GetEncodingIdFromName)( charset );
+
+    if ( id == 0 )
+        return -1;
+
+    for (i = 0; enc2iana[i].name; ++i)
+        if ( TY_(GetEncodingIdFromName)(enc2iana[i].name) == id )
+            return enc2iana[i].id;
+
+    return -1;
+}
+
 int TY_(GetCharEncodingFromOptName)( ctmbstr charenc )
 {
     uint i;
@@ -59,6 +59,9 @@ enum
     LASTPOS_SIZE=64
 };
 
+/* decodes the next character from the input source */
+typedef uint (StreamDecoder)( StreamIn* in );
+
 /* non-raw input is cleaned up*/
 struct _StreamIn
 {
@@ -66,6 +69,7 @@ struct _StreamIn
     Bool   pushed;
     TidyAllocator *allocator;
     tchar* charbuf;
+    uint*  charoffs;   /* where each char in charbuf starts in the input */
     uint   bufpos;
     uint   bufsize;
     int    tabs;
@@ -76,17 +80,34 @@ struct _StreamIn
     int    curline;
     int    encoding;
     IOType iotype;
+    StreamDecoder* decode;  /* chosen once per encoding */
+    const uint* hiChars;    /* code page map for bytes 128-255, or NULL */
+    TidyBuffer* bytes;      /* BufferIO source, read in place */
+    uint   tabsize;    /* TidyTabSize, resolved when the stream is created */
+    Bool   xmlTags;    /* TidyXmlTags, ditto */
 
     TidyInputSource source;
 
+    /* byte offsets into the input, see StreamInOffset() */
+    uint   bytepos;         /* bytes taken from source, when not read in place */
+    uint   bytebase;        /* bytes->next when reading started */
+    uint   lastoffs[LASTPOS_SIZE]; /* where the chars last read start */
+    unsigned short curlastoff;
+
+    /* TidyMaxInputBytes, see LimitStreamIn() */
+    ulong  bytesLeft;       /* bytes that may still be read from unlimited */
+    uint   bytesSize;       /* size of bytes before it was cut to the limit */
+    TidyInputSource unlimited;
+
 #ifdef TIDY_WIN32_MLANG_SUPPORT
     void* mlang;
 #endif
 
 #ifdef TIDY_STORE_ORIGINAL_TEXT
-    tmbstr otextbuf;
-    size_t otextsize;
+    tmbstr otextbuf;        /* all of the input read so far, as UTF-8 */
+    uint   otextsize;
     uint   otextlen;
+    uint   otextstart;      /* start of the text not yet in a token */
 #endif
 
     /* Pointer back to document for error reporting */
@@ -95,16 +116,31 @@ struct _StreamIn
 
 StreamIn* TY_(initStreamIn)( TidyDocImpl* doc, int encoding );
 void TY_(freeStreamIn)(StreamIn* in);
+void TY_(SetStreamInEncoding)( StreamIn* in, int encoding );
 
 StreamIn* TY_(FileInput)( TidyDocImpl* doc, FILE* fp, int encoding );
 StreamIn* TY_(BufferInput)( TidyDocImpl* doc, TidyBuffer* content, int encoding );
 StreamIn* TY_(UserInput)( TidyDocImpl* doc, TidyInputSource* source, int encoding );
 
+/* Reading stops after limit more bytes, as if the input ended there.
+** UnlimitStreamIn() undoes this, and returns yes if input was left unread.
+*/
+void TY_(LimitStreamIn)( StreamIn* in, ulong limit );
+Bool TY_(UnlimitStreamIn)( StreamIn* in );
+
 int       TY_(ReadBOMEncoding)(StreamIn *in);
+int       TY_(PrescanEncoding)(StreamIn *in);
 uint      TY_(ReadChar)( StreamIn* in );
 void      TY_(UngetChar)( uint c, StreamIn* in );
 Bool      TY_(IsEOF)( StreamIn* in );
 
+/* Byte offset into the input of the char ReadChar() returns next, and
+** of the one it returned last.  Chars made up by tab expansion share
+** the offset of their tab.
+*/
+uint      TY_(StreamInOffset)( StreamIn* in );
+uint      TY_(StreamInCharOffset)( StreamIn* in );
+
 
 /************************
 ** Sink
@@ -133,11 +169,13 @@ StreamOut* TY_(StdErrOutput)(void);
 void       TY_(ReleaseStreamOut)( TidyDocImpl *doc, StreamOut* out );
 
 void TY_(WriteChar)( uint c, StreamOut* out );
+void TY_(WriteBytes)( const byte* buf, uint len, StreamOut* out );
 void TY_(outBOM)( StreamOut *out );
 
 ctmbstr TY_(GetEncodingNameFromTidyId)(uint id);
 ctmbstr TY_(GetEncodingOptNameFromTidyId)(uint id);
 int TY_(GetCharEncodingFromOptName)(ctmbstr charenc);
+int TY_(GetCharEncodingFromIanaName)(ctmbstr charset);
 
 /************************
 ** Misc
@@ -162,10 +162,18 @@ static CheckAttribs CheckHTML;
 /*\ 
  * Issue #167 & #169 & #232
  * Tidy defaults to HTML5 mode
- * but allow this table to be ADJUSTED if NOT HTML5
- * was static const Dict tag_defs[] = 
+ * but allow the tags in adjusted_tags to be ADJUSTED if NOT HTML5.
+ * Each document changes its own copies of them, see AdjustTags(),
+ * so that documents can be parsed on several threads at once.
 \*/
-static Dict tag_defs[] =
+static const TidyTagId adjusted_tags[N_ADJUSTED_TAGS] =
+{
+    TidyTag_A,          /* ADJUSTED_A */
+    TidyTag_CAPTION,    /* ADJUSTED_CAPTION */
+    TidyTag_OBJECT      /* ADJUSTED_OBJECT */
+};
+
+static const Dict tag_defs[] =
 {
   { TidyTag_UNKNOWN,    "unknown!",   VERS_UNKNOWN,         NULL,                       (0),                                           NULL,          NULL           },
 
@@ -403,6 +411,22 @@ static void tagsEmptyHash( TidyDocImpl* doc, TidyTagImpl* tags )
 }
 #endif /* ELEMENT_HASH_LOOKUP */
 
+/* the document's own copy of a predefined tag, if it has one */
+static const Dict* docTagDef( TidyTagImpl* tags, const Dict* np )
+{
+    switch ( np->id )
+    {
+    case TidyTag_A:
+        return &tags->adjusted[ADJUSTED_A];
+    case TidyTag_CAPTION:
+        return &tags->adjusted[ADJUSTED_CAPTION];
+    case TidyTag_OBJECT:
+        return &tags->adjusted[ADJUSTED_OBJECT];
+    default:
+        return np;
+    }
+}
+
 static const Dict* tagsLookup( TidyDocImpl* doc, TidyTagImpl* tags, ctmbstr s )
 {
     const Dict *np;
@@ -425,7 +449,7 @@ static const Dict* tagsLookup( TidyDocImpl* doc, TidyTagImpl* tags, ctmbstr s )
 
     for (np = tag_defs + 1; np < tag_defs + N_TIDY_TAGS; ++np)
         if (TY_(tmbstrcmp)(s, np->name) == 0)
-            return tagsInstall(doc, tags, np);
+            return tagsInstall(doc, tags, docTagDef(tags, np));
 
     for (np = tags->declared_tag_list; np; np = np->next)
         if (TY_(tmbstrcmp)(s, np->name) == 0)
@@ -434,7 +458,7 @@ static const Dict* tagsLookup( TidyDocImpl* doc, TidyTagImpl* tags, ctmbstr s )
 
     for (np = tag_defs + 1; np < tag_defs + N_TIDY_TAGS; ++np)
         if (TY_(tmbstrcmp)(s, np->name) == 0)
-            return np;
+            return docTagDef(tags, np);
 
     for (np = tags->declared_tag_list; np; np = np->next)
         if (TY_(tmbstrcmp)(s, np->name) == 0)
@@ -562,7 +586,7 @@ Bool TY_(FindTag)( TidyDocImpl* doc, Node *node )
     return no;
 }
 
-const Dict* TY_(LookupTagDef)( TidyTagId tid )
+static const Dict* tagDef( TidyTagId tid )
 {
     const Dict *np;
 
@@ -573,6 +597,12 @@ const Dict* TY_(LookupTagDef)( TidyTagId tid )
     return NULL;
 }
 
+const Dict* TY_(LookupTagDef)( TidyDocImpl* doc, TidyTagId tid )
+{
+    const Dict *np = tagDef( tid );
+    return np ? docTagDef( &doc->tags, np ) : NULL;
+}
+
 Parser* TY_(FindParser)( TidyDocImpl* doc, Node *node )
 {
     const Dict* np = tagsLookup( doc, &doc->tags, node->element );
@@ -664,9 +694,13 @@ void TY_(InitTags)( TidyDocImpl* doc )
 {
     Dict* xml;
     TidyTagImpl* tags = &doc->tags;
+    uint i;
 
     TidyClearMemory( tags, sizeof(TidyTagImpl) );
 
+    for ( i = 0; i < N_ADJUSTED_TAGS; ++i )
+        tags->adjusted[i] = *tagDef( adjusted_tags[i] );
+
     /* create dummy entry for all xml tags */
     xml =  NewDict( doc, NULL );
     xml->versions = VERS_XML;
@@ -737,18 +771,16 @@ void TY_(FreeDeclaredTags)( TidyDocImpl* doc, UserTagType tagType )
  *
  * NOTE: For each change added to here, there must 
  * be a RESET added in TY_(ResetTags) below!
+ * The dictionary entries are changed in place, so the
+ * element hash, which only points at them, stays valid.
 \*/
 void TY_(AdjustTags)( TidyDocImpl *doc )
 {
-    Dict *np = (Dict *)TY_(LookupTagDef)( TidyTag_A );
-    TidyTagImpl* tags = &doc->tags;
+    Dict *np = (Dict *)TY_(LookupTagDef)( doc, TidyTag_A );
     if (np) 
     {
         np->parser = TY_(ParseInline);
         np->model  = CM_INLINE;
-#if ELEMENT_HASH_LOOKUP
-        tagsEmptyHash( doc, tags );
-#endif
     }
 
 /*\
@@ -756,13 +788,10 @@ void TY_(AdjustTags)( TidyDocImpl *doc )
  * TidyTag_CAPTION allows %flow; in HTML5,
  * but only %inline; in HTML4
 \*/
-    np = (Dict *)TY_(LookupTagDef)( TidyTag_CAPTION );
+    np = (Dict *)TY_(LookupTagDef)( doc, TidyTag_CAPTION );
     if (np)
     {
         np->parser = TY_(ParseInline);
-#if ELEMENT_HASH_LOOKUP
-        tagsEmptyHash( doc, tags );
-#endif
     }
 
 /*\
@@ -770,13 +799,10 @@ void TY_(AdjustTags)( TidyDocImpl *doc )
  * TidyTag_OBJECT not in head in HTML5,
  * but still allowed in HTML4
 \*/
-    np = (Dict *)TY_(LookupTagDef)( TidyTag_OBJECT );
+    np = (Dict *)TY_(LookupTagDef)( doc, TidyTag_OBJECT );
     if (np)
     {
         np->model |= CM_HEAD; /* add back allowed in head */
-#if ELEMENT_HASH_LOOKUP
-        tagsEmptyHash( doc, tags );
-#endif
     }
 }
 
@@ -794,27 +820,23 @@ Bool TY_(IsHTML5Mode)( TidyDocImpl *doc )
 \*/
 void TY_(ResetTags)( TidyDocImpl *doc )
 {
-    Dict *np = (Dict *)TY_(LookupTagDef)( TidyTag_A );
-    TidyTagImpl* tags = &doc->tags;
+    Dict *np = (Dict *)TY_(LookupTagDef)( doc, TidyTag_A );
     if (np) 
     {
         np->parser = TY_(ParseBlock);
         np->model  = (CM_INLINE|CM_BLOCK|CM_MIXED);
     }
-    np = (Dict *)TY_(LookupTagDef)( TidyTag_CAPTION );
+    np = (Dict *)TY_(LookupTagDef)( doc, TidyTag_CAPTION );
     if (np)
     {
         np->parser = TY_(ParseBlock);
     }
 
-    np = (Dict *)TY_(LookupTagDef)( TidyTag_OBJECT );
+    np = (Dict *)TY_(LookupTagDef)( doc, TidyTag_OBJECT );
     if (np)
     {
         np->model = (CM_OBJECT|CM_IMG|CM_INLINE|CM_PARAM); /* reset */
     }
-#if ELEMENT_HASH_LOOKUP
-    tagsEmptyHash( doc, tags ); /* not sure this is really required, but to be sure */
-#endif
     doc->HTML5Mode = yes;   /* set HTML5 mode */
 }
 
@@ -62,10 +62,20 @@ struct _DictHash
 typedef struct _DictHash DictHash;
 #endif
 
+/* the tags AdjustTags() changes, which each document has its own copy of */
+enum
+{
+    ADJUSTED_A,
+    ADJUSTED_CAPTION,
+    ADJUSTED_OBJECT,
+    N_ADJUSTED_TAGS
+};
+
 struct _TidyTagImpl
 {
     Dict* xml_tags;                /* placeholder for all xml tags */
     Dict* declared_tag_list;       /* User declared tags */
+    Dict  adjusted[N_ADJUSTED_TAGS]; /* own copies of the tags AdjustTags() changes */
 #if ELEMENT_HASH_LOOKUP
     DictHash* hashtab[ELEMENT_HASH_SIZE];
 #endif
@@ -74,7 +84,7 @@ struct _TidyTagImpl
 typedef struct _TidyTagImpl TidyTagImpl;
 
 /* interface for finding tag by name */
-const Dict* TY_(LookupTagDef)( TidyTagId tid );
+const Dict* TY_(LookupTagDef)( TidyDocImpl* doc, TidyTagId tid );
 Bool    TY_(FindTag)( TidyDocImpl* doc, Node *node );
 Parser* TY_(FindParser)( TidyDocImpl* doc, Node *node );
 void    TY_(DefineTag)( TidyDocImpl* doc, UserTagType tagType, ctmbstr name );
@@ -173,6 +183,9 @@ uint TY_(nodeHeaderLevel)( Node* node );  /* 1, 2, ..., 6 */
 #define nodeIsTD( node )         TagIsId( node, TidyTag_TD )
 #define nodeIsTH( node )         TagIsId( node, TidyTag_TH )
 #define nodeIsTR( node )         TagIsId( node, TidyTag_TR )
+#define nodeIsTHEAD( node )      TagIsId( node, TidyTag_THEAD )
+#define nodeIsTBODY( node )      TagIsId( node, TidyTag_TBODY )
+#define nodeIsTFOOT( node )      TagIsId( node, TidyTag_TFOOT )
 #define nodeIsCOL( node )        TagIsId( node, TidyTag_COL )
 #define nodeIsCOLGROUP( node )   TagIsId( node, TidyTag_COLGROUP )
 #define nodeIsBR( node )         TagIsId( node, TidyTag_BR )
@@ -61,6 +61,8 @@ struct _TidyDocImpl
     TidyReportFilter3   mssgFilt3;
     TidyOptCallback     pOptCallback;
     TidyPPProgress      progressCallback;
+    TidyTokenCallback   tokenCallback;
+    TidyCancelCallback  cancelCallback;
 
     /* Parse + Repair Results */
     uint                optionErrors;
@@ -70,6 +72,14 @@ struct _TidyDocImpl
     uint                infoMessages;
     uint                docErrors;
     int                 parseStatus;
+    TidyOptionId        limitExceeded;  /* max-* option that stopped the parse,
+                                           or TidyUnknownOption */
+
+    /* Cancellation, see tidySetCancelCallback() and tidySetDeadline() */
+    Bool                cancelWatch;    /* a callback or deadline is set */
+    Bool                cancelled;
+    ulong               deadline;       /* TY_(Milliseconds)() to stop at, or 0 */
+    uint                cancelTicks;    /* work done since the last check */
 
     uint                badAccess;   /* for accessibility errors */
     uint                badLayout;   /* for bad style errors */
@@ -78,6 +88,20 @@ struct _TidyDocImpl
 
     Bool                HTML5Mode;  /* current mode is html5 */
 
+    /* Streamed output, see tidySetStreamingOutput() */
+    TidyOutputSink*     streamSink;
+    Bool                streaming;      /* <body> is written while it is parsed */
+    Bool                streamed;       /* the document was written or handed
+                                           out as tokens while parsed */
+    Node*               streamChecked;  /* last child of <body> checked, */
+    Node*               streamCleaned;  /* cleaned of spaces */
+    Node*               streamPrinted;  /* and written, kept for its siblings */
+
+    /* Elements by tag, id and class, see tidyFindByTag() */
+    NodeIndex*          nodeIndex;      /* built on the first query, or NULL */
+    uint                indexGeneration; /* dropped indexes so far */
+    NodeIterator*       nodeIterators;  /* handed out and not yet ended */
+
     /* Memory allocator */
     TidyAllocator*      allocator;
 
@@ -88,6 +112,8 @@ struct _TidyDocImpl
 
 #ifdef TIDY_STORE_ORIGINAL_TEXT
     Bool                storeText;
+    tmbstr              otext;      /* the text read, see Node otextStart */
+    uint                otextLen;
 #endif
 
 #if PRESERVE_FILE_TIMES
@@ -134,6 +160,30 @@ TidyOption   tidyImplToOption( const TidyOptionImpl* option );
 
 int          TY_(DocParseStream)( TidyDocImpl* impl, StreamIn* in );
 
+/* Streamed output, see tidySetStreamingOutput() and ParseBody() */
+Bool         TY_(CanStreamOutput)( TidyDocImpl* doc );
+void         TY_(StartStreamedOutput)( TidyDocImpl* doc, Node* body );
+void         TY_(RepairStreamedNode)( TidyDocImpl* doc, Node* node );
+void         TY_(EndStreamedOutput)( TidyDocImpl* doc );
+
+/* Cancellation, see tidySetCancelCallback() and tidySetDeadline().
+   The loops that do the work call TidyCancelled() with the work done
+   since the last call, a character read or a node visited, and stop
+   once it is true. The callback and the clock are only consulted once
+   CANCEL_CHECK_TICKS of work has been done.
+*/
+#define CANCEL_CHECK_TICKS      4096
+#define CANCEL_CHAR_TICKS       1
+#define CANCEL_NODE_TICKS       16
+
+#define TidyCancelled(doc, ticks) \
+    ( (doc)->cancelled || ( (doc)->cancelWatch && \
+      ((doc)->cancelTicks += (ticks)) >= CANCEL_CHECK_TICKS && \
+      TY_(CheckCancel)(doc) ) )
+
+Bool         TY_(CheckCancel)( TidyDocImpl* doc );
+ulong        TY_(Milliseconds)( void );
+
 /*
    [i_a] generic node tree traversal code; used in several spots.
 
@@ -19,6 +19,7 @@
 */
 
 #include <errno.h>
+#include <time.h>
 
 #include "tidy-int.h"
 #include "parser.h"
@@ -31,6 +32,8 @@
 #include "tmbstr.h"
 #include "utf8.h"
 #include "mappedio.h"
+#include "nodeindex.h"
+#include "treeio.h"
 #include "language.h"
 
 #ifdef TIDY_WIN32_MLANG_SUPPORT
@@ -43,6 +46,7 @@
 /* Create/Destroy a Tidy "document" object */
 static TidyDocImpl* tidyDocCreate( TidyAllocator *allocator );
 static void         tidyDocRelease( TidyDocImpl* impl );
+static void         tidyDocReset( TidyDocImpl* impl );
 
 static int          tidyDocStatus( TidyDocImpl* impl );
 
@@ -52,6 +56,7 @@ static int          tidyDocParseStdin( TidyDocImpl* impl );
 static int          tidyDocParseString( TidyDocImpl* impl, ctmbstr content );
 static int          tidyDocParseBuffer( TidyDocImpl* impl, TidyBuffer* inbuf );
 static int          tidyDocParseSource( TidyDocImpl* impl, TidyInputSource* docIn );
+static int          tidyDocLoadTree( TidyDocImpl* impl, TidyBuffer* inbuf );
 
 
 /* Execute post-parse diagnostics and cleanup.
@@ -174,9 +179,13 @@ void          tidyDocRelease( TidyDocImpl* doc )
         TY_(FreePrintBuf)( doc );
         TY_(FreeNode)(doc, &doc->root);
         TidyClearMemory(&doc->root, sizeof(Node));
+        TY_(FreeNodeIterators)( doc );
 
         if (doc->givenDoctype)
             TidyDocFree(doc, doc->givenDoctype);
+#ifdef TIDY_STORE_ORIGINAL_TEXT
+        TidyDocFree( doc, doc->otext );
+#endif
 
         TY_(FreeConfig)( doc );
         TY_(FreeAttrTable)( doc );
@@ -190,6 +199,71 @@ void          tidyDocRelease( TidyDocImpl* doc )
     }
 }
 
+void TIDY_CALL          tidyReset( TidyDoc tdoc )
+{
+  TidyDocImpl* impl = tidyDocToImpl( tdoc );
+  if ( impl )
+    tidyDocReset( impl );
+}
+
+/* Free the document of the last parse, but keep the lexer, anchor
+** and print buffers for the next one.
+*/
+static void   tidyDocClearDocument( TidyDocImpl* doc )
+{
+    TY_(ClearAnchors)( doc );
+
+    TY_(FreeNode)(doc, &doc->root);
+    TidyClearMemory(&doc->root, sizeof(Node));
+    TY_(EndNodeIterators)( doc );
+
+    if (doc->givenDoctype)
+        TidyDocFree(doc, doc->givenDoctype);
+    doc->givenDoctype = NULL;
+
+#ifdef TIDY_STORE_ORIGINAL_TEXT
+    TidyDocFree( doc, doc->otext );
+    doc->otext = NULL;
+    doc->otextLen = 0;
+#endif
+
+    doc->streaming = no;
+    doc->streamed = no;
+    doc->streamChecked = NULL;
+    doc->streamCleaned = NULL;
+    doc->streamPrinted = NULL;
+
+    /*\ 
+     *  Issue #186 - Now FreeNode depend on the doctype, so the lexer is needed
+     *  to determine which hash is to be used, so reset it last.
+    \*/
+    TY_(ResetLexer)( doc );
+}
+
+void          tidyDocReset( TidyDocImpl* doc )
+{
+    assert( doc->docIn == NULL );
+    assert( doc->docOut == NULL );
+
+    tidyDocClearDocument( doc );
+
+    doc->errors = 0;
+    doc->warnings = 0;
+    doc->accessErrors = 0;
+    doc->infoMessages = 0;
+    doc->docErrors = 0;
+    doc->parseStatus = 0;
+    doc->limitExceeded = TidyUnknownOption;
+    doc->cancelled = no;
+    doc->cancelTicks = 0;
+    doc->badAccess = 0;
+    doc->badLayout = 0;
+    doc->badChars = 0;
+    doc->badForm = 0;
+    doc->nClassId = 0;
+    doc->inputHadBOM = no;
+}
+
 /* Let application store a chunk of data w/ each Tidy tdocance.
 ** Useful for callbacks.
 */
@@ -636,6 +710,37 @@ Bool TIDY_CALL tidyOptCopyConfig( TidyDoc to, TidyDoc from )
     return no;
 }
 
+TidySharedConfig TIDY_CALL tidyOptCreateSharedConfig( TidyDoc tdoc )
+{
+    TidyDocImpl* impl = tidyDocToImpl( tdoc );
+    if ( impl )
+        return (TidySharedConfig) TY_(NewSharedConfig)( impl );
+    return NULL;
+}
+
+void TIDY_CALL tidyOptRetainSharedConfig( TidySharedConfig tcfg )
+{
+    if ( tcfg )
+        TY_(RetainSharedConfig)( (TidySharedConfigImpl*) tcfg );
+}
+
+void TIDY_CALL tidyOptReleaseSharedConfig( TidySharedConfig tcfg )
+{
+    if ( tcfg )
+        TY_(ReleaseSharedConfig)( (TidySharedConfigImpl*) tcfg );
+}
+
+Bool TIDY_CALL tidyOptUseSharedConfig( TidyDoc tdoc, TidySharedConfig tcfg )
+{
+    TidyDocImpl* impl = tidyDocToImpl( tdoc );
+    if ( impl )
+    {
+        TY_(UseSharedConfig)( impl, (TidySharedConfigImpl*) tcfg );
+        return yes;
+    }
+    return no;
+}
+
 
 /* I/O and Message handling interface
 **
@@ -805,6 +910,76 @@ Bool TIDY_CALL        tidySetPrettyPrinterCallback(TidyDoc tdoc, TidyPPProgress
     return no;
 }
 
+Bool TIDY_CALL        tidySetTokenCallback(TidyDoc tdoc, TidyTokenCallback callback)
+{
+    TidyDocImpl* impl = tidyDocToImpl( tdoc );
+    if ( impl )
+    {
+        impl->tokenCallback = callback;
+        return yes;
+    }
+    return no;
+}
+
+Bool TIDY_CALL        tidySetCancelCallback(TidyDoc tdoc, TidyCancelCallback callback)
+{
+    TidyDocImpl* impl = tidyDocToImpl( tdoc );
+    if ( impl )
+    {
+        impl->cancelCallback = callback;
+        impl->cancelWatch = ( callback || impl->deadline );
+        return yes;
+    }
+    return no;
+}
+
+Bool TIDY_CALL        tidySetDeadline(TidyDoc tdoc, ulong milliseconds)
+{
+    TidyDocImpl* impl = tidyDocToImpl( tdoc );
+    if ( impl )
+    {
+        impl->deadline = milliseconds ? TY_(Milliseconds)() + milliseconds : 0;
+        impl->cancelWatch = ( impl->cancelCallback || impl->deadline );
+        return yes;
+    }
+    return no;
+}
+
+/* Called by TidyCancelled() once enough work has been done */
+Bool          TY_(CheckCancel)( TidyDocImpl* doc )
+{
+    doc->cancelTicks = 0;
+    if ( doc->deadline && TY_(Milliseconds)() >= doc->deadline )
+        doc->cancelled = yes;
+    else if ( doc->cancelCallback && doc->cancelCallback(tidyImplToDoc(doc)) )
+        doc->cancelled = yes;
+    return doc->cancelled;
+}
+
+/* A clock for deadlines, in milliseconds from some fixed point */
+ulong         TY_(Milliseconds)( void )
+{
+#if defined(CLOCK_MONOTONIC)
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (ulong) now.tv_sec * 1000 + (ulong) now.tv_nsec / 1000000;
+#else
+    /* elapsed time with the Microsoft runtime, processor time elsewhere */
+    return (ulong) ( (double) clock() * 1000 / CLOCKS_PER_SEC );
+#endif
+}
+
+Bool TIDY_CALL        tidySetStreamingOutput( TidyDoc tdoc, TidyOutputSink* sink )
+{
+    TidyDocImpl* impl = tidyDocToImpl( tdoc );
+    if ( impl )
+    {
+        impl->streamSink = sink;
+        return yes;
+    }
+    return no;
+}
+
 
 /* Document info */
 int TIDY_CALL        tidyStatus( TidyDoc tdoc )
@@ -1032,11 +1207,38 @@ int TIDY_CALL        tidySaveSink( TidyDoc tdoc, TidyOutputSink* sink )
     return tidyDocSaveSink( doc, sink );
 }
 
+int TIDY_CALL        tidySaveTree( TidyDoc tdoc, TidyBuffer* outbuf )
+{
+    TidyDocImpl* doc = tidyDocToImpl( tdoc );
+    if ( !doc || !outbuf )
+        return -EINVAL;
+    return TY_(SaveTree)( doc, outbuf );
+}
+int TIDY_CALL        tidyLoadTree( TidyDoc tdoc, TidyBuffer* inbuf )
+{
+    TidyDocImpl* doc = tidyDocToImpl( tdoc );
+    if ( !doc || !inbuf )
+        return -EINVAL;
+    return tidyDocLoadTree( doc, inbuf );
+}
+
+/* Nothing is written for a document that was streamed or tokenized,
+** or in lint-only mode, where no output stream is even created.
+*/
+static int  tidyDocSaveNothing( TidyDocImpl* doc )
+{
+    TY_(ResetConfigToSnapshot)( doc );
+    return tidyDocStatus( doc );
+}
+
 int         tidyDocSaveFile( TidyDocImpl* doc, ctmbstr filnam )
 {
     int status = -ENOENT;
     FILE* fout = NULL;
 
+    if ( cfgBool(doc, TidyLintOnly) )
+        return tidyDocSaveNothing( doc );
+
     /* Don't zap input file if no output */
     if ( doc->errors > 0 &&
          cfgBool(doc, TidyWriteBack) && !cfgBool(doc, TidyForceOutput) )
@@ -1101,7 +1303,12 @@ int         tidyDocSaveStdout( TidyDocImpl* doc )
     int status = 0;
     uint outenc = cfg( doc, TidyOutCharEncoding );
     uint nl = cfg( doc, TidyNewline );
-    StreamOut* out = TY_(FileOutput)( doc, stdout, outenc, nl );
+    StreamOut* out;
+
+    if ( cfgBool(doc, TidyLintOnly) )
+        return tidyDocSaveNothing( doc );
+
+    out = TY_(FileOutput)( doc, stdout, outenc, nl );
 
 #if !defined(NO_SETMODE_SUPPORT)
 
@@ -1141,6 +1348,12 @@ int         tidyDocSaveString( TidyDocImpl* doc, tmbstr buffer, uint* buflen )
     StreamOut* out;
     int status;
 
+    if ( cfgBool(doc, TidyLintOnly) )
+    {
+        *buflen = 0;
+        return tidyDocSaveNothing( doc );
+    }
+
     tidyBufInitWithAllocator( &outbuf, doc->allocator );
     out = TY_(BufferOutput)( doc, &outbuf, outenc, nl );
     status = tidyDocSaveStream( doc, out );
@@ -1159,7 +1372,9 @@ int         tidyDocSaveString( TidyDocImpl* doc, tmbstr buffer, uint* buflen )
 int         tidyDocSaveBuffer( TidyDocImpl* doc, TidyBuffer* outbuf )
 {
     int status = -EINVAL;
-    if ( outbuf )
+    if ( outbuf && cfgBool(doc, TidyLintOnly) )
+        status = tidyDocSaveNothing( doc );
+    else if ( outbuf )
     {
         uint outenc = cfg( doc, TidyOutCharEncoding );
         uint nl = cfg( doc, TidyNewline );
@@ -1175,14 +1390,22 @@ int         tidyDocSaveSink( TidyDocImpl* doc, TidyOutputSink* sink )
 {
     uint outenc = cfg( doc, TidyOutCharEncoding );
     uint nl = cfg( doc, TidyNewline );
-    StreamOut* out = TY_(UserOutput)( doc, sink, outenc, nl );
-    int status = tidyDocSaveStream( doc, out );
+    StreamOut* out;
+    int status;
+
+    if ( cfgBool(doc, TidyLintOnly) )
+        return tidyDocSaveNothing( doc );
+
+    out = TY_(UserOutput)( doc, sink, outenc, nl );
+    status = tidyDocSaveStream( doc, out );
     TidyDocFree( doc, out );
     return status;
 }
 
 int         tidyDocStatus( TidyDocImpl* doc )
 {
+    if ( doc->cancelled )
+        return -ECANCELED;
     if ( doc->errors > 0 )
         return 2;
     if ( doc->warnings > 0 || doc->accessErrors > 0 )
@@ -1240,41 +1463,51 @@ int         TY_(DocParseStream)( TidyDocImpl* doc, StreamIn* in )
 
     TY_(ResetTags)(doc);    /* reset table to html5 mode */
     TY_(TakeConfigSnapshot)( doc );    /* Save config state */
-    TY_(FreeAnchors)( doc );
-
-    TY_(FreeNode)(doc, &doc->root);
-    TidyClearMemory(&doc->root, sizeof(Node));
 
-    if (doc->givenDoctype)
-        TidyDocFree(doc, doc->givenDoctype);
-    /*\ 
-     *  Issue #186 - Now FreeNode depend on the doctype, so the lexer is needed
-     *  to determine which hash is to be used, so free it last.
-    \*/
-    TY_(FreeLexer)( doc );
-    doc->givenDoctype = NULL;
-
-    doc->lexer = TY_(NewLexer)( doc );
+    tidyDocClearDocument( doc );
+    if ( !doc->lexer )
+        doc->lexer = TY_(NewLexer)( doc );
     /* doc->lexer->root = &doc->root; */
     doc->root.line = doc->lexer->lines;
     doc->root.column = doc->lexer->columns;
     doc->inputHadBOM = no;
+    doc->limitExceeded = TidyUnknownOption;
+    doc->cancelled = no;
+    doc->cancelTicks = 0;
 
     bomEnc = TY_(ReadBOMEncoding)(in);
 
     if (bomEnc != -1)
     {
-        in->encoding = bomEnc;
+        TY_(SetStreamInEncoding)( in, bomEnc );
         TY_(SetOptionInt)(doc, TidyInCharEncoding, bomEnc);
     }
+    else if ( cfgBool(doc, TidyPrescanEncoding) )
+    {
+        /* pick the decoder from a declared charset before lexing */
+        int declEnc = TY_(PrescanEncoding)( in );
+        if ( declEnc != -1 && declEnc != in->encoding )
+        {
+            TY_(SetStreamInEncoding)( in, declEnc );
+            TY_(SetOptionInt)( doc, TidyInCharEncoding, declEnc );
+        }
+    }
 
 #ifdef TIDY_WIN32_MLANG_SUPPORT
     if (in->encoding > WIN32MLANG)
         TY_(Win32MLangInitInputTranscoder)(in, in->encoding);
 #endif /* TIDY_WIN32_MLANG_SUPPORT */
 
+    if ( cfg(doc, TidyMaxInputBytes) > 0 )
+        TY_(LimitStreamIn)( in, cfg(doc, TidyMaxInputBytes) );
+
+    if ( doc->tokenCallback )
+    {
+        TY_(ParseTokens)( doc );
+        doc->streamed = yes;
+    }
     /* Tidy doesn't alter the doctype for generic XML docs */
-    if ( xmlIn )
+    else if ( xmlIn )
     {
         TY_(ParseXMLDocument)( doc );
         if ( !TY_(CheckNodeIntegrity)( &doc->root ) )
@@ -1292,7 +1525,53 @@ int         TY_(DocParseStream)( TidyDocImpl* doc, StreamIn* in )
     TY_(Win32MLangUninitInputTranscoder)(in);
 #endif /* TIDY_WIN32_MLANG_SUPPORT */
 
+    if ( TY_(UnlimitStreamIn)(in) && doc->limitExceeded == TidyUnknownOption )
+        TY_(ReportLimit)( doc, TidyMaxInputBytes );
+
+#ifdef TIDY_STORE_ORIGINAL_TEXT
+    /* the nodes refer to the text read, keep it with the tree */
+    doc->otext = in->otextbuf;
+    doc->otextLen = in->otextlen;
+    in->otextbuf = NULL;
+    in->otextlen = in->otextsize = in->otextstart = 0;
+#endif
+
+    /* an index built by a callback while parsing is out of date */
+    TY_(FreeNodeIndex)( doc );
+
     doc->docIn = NULL;
+    if ( doc->limitExceeded != TidyUnknownOption && !doc->cancelled )
+        return -E2BIG;
+    return tidyDocStatus( doc );
+}
+
+/* In place of a parse, with the same setup.  A tree that does not load
+** leaves the document empty.
+*/
+int         tidyDocLoadTree( TidyDocImpl* doc, TidyBuffer* inbuf )
+{
+    int status;
+
+    assert( doc->docIn == NULL );
+
+    TY_(ResetTags)(doc);
+    TY_(TakeConfigSnapshot)( doc );
+
+    tidyDocClearDocument( doc );
+    if ( !doc->lexer )
+        doc->lexer = TY_(NewLexer)( doc );
+    doc->limitExceeded = TidyUnknownOption;
+    doc->cancelled = no;
+    doc->cancelTicks = 0;
+
+    status = TY_(LoadTree)( doc, inbuf );
+    TY_(FreeNodeIndex)( doc );
+    if ( status < 0 )
+        return status;
+    if ( !TY_(CheckNodeIntegrity)( &doc->root ) )
+        TidyPanic( doc->allocator, integrity );
+    if ( doc->limitExceeded != TidyUnknownOption && !doc->cancelled )
+        return -E2BIG;
     return tidyDocStatus( doc );
 }
 
@@ -1425,7 +1704,7 @@ void TY_(CheckHTML5)( TidyDocImpl* doc, Node* node )
 #if !defined(NDEBUG) && defined(_MSC_VER)
     //    list_not_html5();
 #endif
-    while (node)
+    while ( node && !TidyCancelled(doc, CANCEL_NODE_TICKS) )
     {
         if ( nodeHasAlignAttr( node ) ) {
             /* @todo: Is this for ALL elements that accept an 'align' attribute,
@@ -1614,7 +1893,7 @@ void TY_(CheckHTMLTagsAttribsVersions)( TidyDocImpl* doc, Node* node )
     Bool attrIsProprietary = no;
     Bool attrIsMismatched = yes;
 
-    while (node)
+    while ( node && !TidyCancelled(doc, CANCEL_NODE_TICKS) )
     {
         /* This bit here handles our HTML tags */
         if ( TY_(nodeIsElement)(node) && node->tag ) {
@@ -1818,26 +2097,24 @@ int         tidyDocCleanAndRepair( TidyDocImpl* doc )
     Bool tidyXmlTags = cfgBool( doc, TidyXmlTags );
     Bool wantNameAttr = cfgBool( doc, TidyAnchorAsName );
     Bool mergeEmphasis = cfgBool( doc, TidyMergeEmphasis );
+    Bool lintOnly = cfgBool( doc, TidyLintOnly );
+    Bool intact;
     Node* node;
 
+    TY_(FreeNodeIndex)( doc );
+
 #if !defined(NDEBUG) && defined(_MSC_VER)
     SPRTF("All nodes BEFORE clean and repair\n");
     dbg_show_all_nodes( doc, &doc->root, 0  );
 #endif
-    if (tidyXmlTags)
+    /* a streamed document was repaired as it was written, or has no tree */
+    if (tidyXmlTags || doc->streamed || doc->cancelled)
        return tidyDocStatus( doc );
 
-    /* simplifies <b><b> ... </b> ...</b> etc. */
-    if ( mergeEmphasis )
-        TY_(NestedEmphasis)( doc, &doc->root );
-
-    /* cleans up <dir>indented text</dir> etc. */
-    TY_(List2BQ)( doc, &doc->root );
-    TY_(BQ2Div)( doc, &doc->root );
-
-    /* replaces i by em and b by strong */
-    if ( logical )
-        TY_(EmFromI)( doc, &doc->root );
+    /* simplifies <b><b> ... </b> ...</b> etc., cleans up
+       <dir>indented text</dir> etc. and, if logical, replaces
+       i by em and b by strong */
+    TY_(CleanListsAndEmphasis)( doc, &doc->root, mergeEmphasis, logical );
 
     if ( word2K && TY_(IsWord2000)(doc) )
     {
@@ -1865,15 +2142,19 @@ int         tidyDocCleanAndRepair( TidyDocImpl* doc )
     FixBrakes( doc, TY_(FindBody)( doc ));
 #endif
 
-    /*  Reconcile http-equiv meta element with output encoding  */
-    if (cfg( doc, TidyOutCharEncoding) != RAW
+    /*  Reconcile http-equiv meta element with output encoding.
+        Like the generator and XML declaration below, this is only
+        for output, adds no messages and changes nothing checked
+        later, so it is left out in lint mode.  */
+    if (!lintOnly && cfg( doc, TidyOutCharEncoding) != RAW
 #ifndef NO_NATIVE_ISO2022_SUPPORT
         && cfg( doc, TidyOutCharEncoding) != ISO2022
 #endif
         )
         TY_(VerifyHTTPEquiv)( doc, TY_(FindHEAD)( doc ));
 
-    if ( !TY_(CheckNodeIntegrity)( &doc->root ) )
+    /* With content, the tree is checked while fixing anchors below */
+    if ( !doc->root.content && !TY_(CheckNodeIntegrity)( &doc->root ) )
         TidyPanic( doc->allocator, integrity );
 
     /* remember given doctype for reporting */
@@ -1901,27 +2182,30 @@ int         tidyDocCleanAndRepair( TidyDocImpl* doc )
               TY_(RemoveNode)(node);
         }
 
+        /* FixAnchors never touches <html>, so the namespace
+           can be fixed before anchors and language together */
         if (xhtmlOut && !htmlOut)
         {
             TY_(SetXHTMLDocType)(doc);
-            TY_(FixAnchors)(doc, &doc->root, wantNameAttr, yes);
             TY_(FixXhtmlNamespace)(doc, yes);
-            TY_(FixLanguageInformation)(doc, &doc->root, yes, yes);
+            intact = TY_(FixAnchorsAndLanguage)(doc, &doc->root, wantNameAttr, yes, yes, yes);
         }
         else
         {
             TY_(FixDocType)(doc);
-            TY_(FixAnchors)(doc, &doc->root, wantNameAttr, yes);
             TY_(FixXhtmlNamespace)(doc, no);
-            TY_(FixLanguageInformation)(doc, &doc->root, no, yes);
+            intact = TY_(FixAnchorsAndLanguage)(doc, &doc->root, wantNameAttr, yes, no, yes);
         }
 
-        if (tidyMark )
+        if ( !intact )
+            TidyPanic( doc->allocator, integrity );
+
+        if ( tidyMark && !lintOnly )
             TY_(AddGenerator)(doc);
     }
 
     /* ensure presence of initial <?xml version="1.0"?> */
-    if ( xmlOut && xmlDecl )
+    if ( xmlOut && xmlDecl && !lintOnly )
         TY_(FixXmlDecl)( doc );
 
     /* At this point the apparent doctype is going to be as stable as
@@ -1945,6 +2229,7 @@ int         tidyDocCleanAndRepair( TidyDocImpl* doc )
     SPRTF("All nodes AFTER clean and repair\n");
     dbg_show_all_nodes( doc, &doc->root, 0  );
 #endif
+    TY_(FreeNodeIndex)( doc );
     return tidyDocStatus( doc );
 }
 
@@ -1979,19 +2264,19 @@ int         tidyDocSaveStream( TidyDocImpl* doc, StreamOut* out )
     Bool xmlOut      = cfgBool( doc, TidyXmlOut );
     Bool xhtmlOut    = cfgBool( doc, TidyXhtmlOut );
     TidyTriState bodyOnly    = cfgAutoBool( doc, TidyBodyOnly );
+    Bool minify      = cfgBool( doc, TidyMinify ) && !xmlOut && !xhtmlOut &&
+                       !cfgBool( doc, TidyXmlTags );
 
     Bool dropComments = cfgBool(doc, TidyHideComments);
     Bool makeClean    = cfgBool(doc, TidyMakeClean);
     Bool asciiChars   = cfgBool(doc, TidyAsciiChars);
     Bool makeBare     = cfgBool(doc, TidyMakeBare);
     Bool escapeCDATA  = cfgBool(doc, TidyEscapeCdata);
-    Bool ppWithTabs   = cfgBool(doc, TidyPPrintTabs);
     TidyAttrSortStrategy sortAttrStrat = cfg(doc, TidySortAttributes);
 
-    if (ppWithTabs)
-        TY_(PPrintTabs)();
-    else
-        TY_(PPrintSpaces)();
+    /* a streamed document has already been written, or has no tree */
+    if (doc->streamed || doc->cancelled || cfgBool(doc, TidyLintOnly))
+        return tidyDocSaveNothing( doc );
 
     if (escapeCDATA)
         TY_(ConvertCDATANodes)(doc, &doc->root);
@@ -2018,6 +2303,9 @@ int         tidyDocSaveStream( TidyDocImpl* doc, StreamOut* out )
     if ( sortAttrStrat != TidySortAttrNone )
         TY_(SortAttributes)(&doc->root, sortAttrStrat);
 
+    /* the tree is not changed from here on */
+    TY_(FreeNodeIndex)( doc );
+
     if ( showMarkup && (doc->errors == 0 || forceOutput) )
     {
 #if SUPPORT_UTF16_ENCODINGS
@@ -2034,14 +2322,23 @@ int         tidyDocSaveStream( TidyDocImpl* doc, StreamOut* out )
         */
 
         doc->docOut = out;
+        TY_(ResolvePrintOptions)( doc );
         if ( xmlOut && !xhtmlOut )
             TY_(PPrintXMLTree)( doc, NORMAL, 0, &doc->root );
+        else if ( minify )
+        {
+            if ( showBodyOnly( doc, bodyOnly ) )
+                TY_(PMinifyTree)( doc, TY_(FindBody)(doc), yes );
+            else
+                TY_(PMinifyTree)( doc, &doc->root, no );
+        }
         else if ( showBodyOnly( doc, bodyOnly ) )
             TY_(PrintBody)( doc );
         else
             TY_(PPrintTree)( doc, NORMAL, 0, &doc->root );
 
-        TY_(PFlushLine)( doc, 0 );
+        if ( !minify )
+            TY_(PFlushLine)( doc, 0 );
         doc->docOut = NULL;
     }
 
@@ -2049,6 +2346,117 @@ int         tidyDocSaveStream( TidyDocImpl* doc, StreamOut* out )
     return tidyDocStatus( doc );
 }
 
+/* Streamed output
+**
+** ParseBody() starts it once the head is complete. The tree so far
+** gets the usual checks and repairs, and is written up to the start
+** tag of <body>. Each child of <body> then gets the same repairs as
+** tidyDocCleanAndRepair() and tidyDocSaveStream() apply to the whole
+** tree, and is written.
+*/
+Bool TY_(CanStreamOutput)( TidyDocImpl* doc )
+{
+    ulong dtmode = cfg( doc, TidyDoctypeMode );
+
+    /* the doctype must not depend on the content of <body> */
+    if ( !(dtmode == TidyDoctypeHtml5 ||
+           (dtmode == TidyDoctypeAuto && TY_(FindDocType)(doc) &&
+            doc->lexer->doctype == VERS_HTML5)) )
+        return no;
+
+    if ( !TY_(IsHTML5Mode)(doc) || doc->lexer->isvoyager )
+        return no;
+
+    /* output that would be withheld because of errors cannot wait */
+    if ( !cfgBool(doc, TidyShowMarkup) || !cfgBool(doc, TidyForceOutput) ||
+         cfgBool(doc, TidyLintOnly) )
+        return no;
+
+    if ( cfgBool(doc, TidyXmlTags) || cfgBool(doc, TidyXmlOut) ||
+         cfgBool(doc, TidyXhtmlOut) ||
+         cfgAutoBool(doc, TidyBodyOnly) != TidyNoState )
+        return no;
+
+    /* printing <html> and <body> must not look at their content */
+    if ( cfgAutoBool(doc, TidyIndentContent) != TidyNoState ||
+         cfgAutoBool(doc, TidyVertSpace) == TidyYesState ||
+         cfgBool(doc, TidyHideEndTags) || cfgBool(doc, TidyOmitOptionalTags) ||
+         cfgBool(doc, TidyMinify) )
+        return no;
+
+    /* no repairs that need the whole document */
+    if ( cfgBool(doc, TidyMakeClean) || cfgBool(doc, TidyDropFontTags) ||
+         cfgBool(doc, TidyWord2000) || cfgBool(doc, TidyGDocClean) ||
+         cfgBool(doc, TidyMakeBare) || cfgBool(doc, TidyEscapeCdata) ||
+         cfgBool(doc, TidyHideComments) || cfgBool(doc, TidyEncloseBodyText) ||
+         cfgBool(doc, TidyEncloseBlockText) )
+        return no;
+
+#if SUPPORT_ACCESSIBILITY_CHECKS
+    if ( cfg(doc, TidyAccessibilityCheckLevel) > 0 )
+        return no;
+#endif
+
+    return yes;
+}
+
+void TY_(StartStreamedOutput)( TidyDocImpl* doc, Node* body )
+{
+    uint outenc = cfg( doc, TidyOutCharEncoding );
+    uint nl = cfg( doc, TidyNewline );
+    TidyAttrSortStrategy sortAttrStrat = cfg( doc, TidySortAttributes );
+#if SUPPORT_UTF16_ENCODINGS
+    Bool outputBOM = ( cfgAutoBool(doc, TidyOutputBOM) == TidyYesState );
+    Bool smartBOM  = ( cfgAutoBool(doc, TidyOutputBOM) == TidyAutoState );
+#endif
+
+    tidyDocCleanAndRepair( doc );
+
+    TY_(ReplacePreformattedSpaces)( doc, &doc->root );
+    if ( sortAttrStrat != TidySortAttrNone )
+        TY_(SortAttributes)( &doc->root, sortAttrStrat );
+
+    doc->docOut = TY_(UserOutput)( doc, doc->streamSink, outenc, nl );
+#if SUPPORT_UTF16_ENCODINGS
+    if ( outputBOM || (doc->inputHadBOM && smartBOM) )
+        TY_(outBOM)( doc->docOut );
+#endif
+
+    TY_(ResolvePrintOptions)( doc );
+    TY_(PPrintStreamStart)( doc, body );
+}
+
+/* node is hidden from its later siblings, see ParseBody() */
+void TY_(RepairStreamedNode)( TidyDocImpl* doc, Node* node )
+{
+    Bool logical = cfgBool( doc, TidyLogicalEmphasis );
+    Bool wantNameAttr = cfgBool( doc, TidyAnchorAsName );
+    Bool mergeEmphasis = cfgBool( doc, TidyMergeEmphasis );
+    TidyAttrSortStrategy sortAttrStrat = cfg( doc, TidySortAttributes );
+
+    TY_(CleanListsAndEmphasis)( doc, node, mergeEmphasis, logical );
+
+    if ( !TY_(FixAnchorsAndLanguage)(doc, node, wantNameAttr, yes, no, yes) )
+        TidyPanic( doc->allocator, integrity );
+
+    if (doc->lexer->versionEmitted & VERS_HTML5)
+        TY_(CheckHTML5)( doc, node );
+    TY_(CheckHTMLTagsAttribsVersions)( doc, node );
+
+    TY_(ReplacePreformattedSpaces)( doc, node );
+    if ( sortAttrStrat != TidySortAttrNone )
+        TY_(SortAttributes)( node, sortAttrStrat );
+}
+
+void TY_(EndStreamedOutput)( TidyDocImpl* doc )
+{
+    TY_(PFlushLine)( doc, 0 );
+    TidyDocFree( doc, doc->docOut );
+    doc->docOut = NULL;
+    doc->streaming = no;
+    doc->streamed = yes;
+}
+
 /* Tree traversal functions
 **
 ** The big issue here is the degree to which we should mimic
@@ -2112,7 +2520,18 @@ TidyNode TIDY_CALL    tidyDiscardElement( TidyDoc tdoc, TidyNode tnod )
 {
   TidyDocImpl* doc = tidyDocToImpl( tdoc );
   Node* nimp = tidyNodeToImpl( tnod );
-  Node* next = TY_(DiscardElement)( doc, nimp );
+  NodeIndex* index = NULL;
+  Node* next;
+  /* the index is kept, without the element */
+  if ( doc && nimp )
+  {
+    TY_(IndexDiscardNode)( doc, nimp );
+    index = doc->nodeIndex;
+    doc->nodeIndex = NULL;
+  }
+  next = TY_(DiscardElement)( doc, nimp );
+  if ( doc )
+    doc->nodeIndex = index;
   return tidyImplToNode( next );
 }
 
@@ -2155,6 +2574,64 @@ uint TIDY_CALL tidyNodeColumn( TidyNode tnod )
   return col;
 }
 
+Bool TIDY_CALL tidyNodeGetSourceRange( TidyNode tnod, uint* start, uint* end )
+{
+  Node* nimp = tidyNodeToImpl( tnod );
+  if ( !nimp || nimp->srcEnd == 0 )
+    return no;
+  if ( start )
+    *start = nimp->srcStart;
+  if ( end )
+    *end = nimp->srcEnd;
+  return yes;
+}
+
+Bool TIDY_CALL tidySetStoreOriginalText( TidyDoc tdoc, Bool store )
+{
+#ifdef TIDY_STORE_ORIGINAL_TEXT
+  TidyDocImpl* impl = tidyDocToImpl( tdoc );
+  if ( impl )
+  {
+    impl->storeText = store;
+    return yes;
+  }
+#endif
+  return no;
+}
+
+Bool TIDY_CALL tidyNodeGetOriginalText( TidyDoc tdoc, TidyNode tnod, TidyBuffer* buf )
+{
+#ifdef TIDY_STORE_ORIGINAL_TEXT
+  TidyDocImpl* impl = tidyDocToImpl( tdoc );
+  Node* nimp = tidyNodeToImpl( tnod );
+  ctmbstr text = NULL;
+  uint len = 0;
+
+  if ( !impl || !nimp || !buf || nimp->otextLen == 0 )
+    return no;
+
+  /* while parsing, the text is still the input stream's */
+  if ( impl->docIn )
+  {
+    text = impl->docIn->otextbuf;
+    len = impl->docIn->otextlen;
+  }
+  else
+  {
+    text = impl->otext;
+    len = impl->otextLen;
+  }
+  if ( !text || nimp->otextStart + nimp->otextLen > len )
+    return no;
+
+  tidyBufClear( buf );
+  tidyBufAppend( buf, (void*) (text + nimp->otextStart), nimp->otextLen );
+  return yes;
+#else
+  return no;
+#endif
+}
+
 ctmbstr TIDY_CALL tidyNodeGetName( TidyNode tnod )
 {
   Node* nimp = tidyNodeToImpl( tnod );
@@ -2187,6 +2664,7 @@ Bool TIDY_CALL tidyNodeGetText( TidyDoc tdoc, TidyNode tnod, TidyBuffer* outbuf
       Bool xhtmlOut   = cfgBool( doc, TidyXhtmlOut );
 
       doc->docOut = out;
+      TY_(ResolvePrintOptions)( doc );
       if ( xmlOut && !xhtmlOut )
           TY_(PPrintXMLTree)( doc, NORMAL, 0, nimp );
       else
@@ -2320,9 +2798,49 @@ void TIDY_CALL           tidyAttrDiscard( TidyDoc tdoc, TidyNode tnod, TidyAttr
   TidyDocImpl* impl = tidyDocToImpl( tdoc );
   Node* nimp = tidyNodeToImpl( tnod );
   AttVal* attval = tidyAttrToImpl( tattr );
+  if ( attrIsID(attval) )
+    TY_(IndexDiscardId)( impl );
+  else if ( attrIsCLASS(attval) )
+    TY_(IndexDiscardClass)( impl, nimp, attval->value );
   TY_(RemoveAttribute)( impl, nimp, attval );
 }
 
+TidyNode TIDY_CALL tidyFindById( TidyDoc tdoc, ctmbstr id )
+{
+  TidyDocImpl* impl = tidyDocToImpl( tdoc );
+  Node* node = NULL;
+  if ( impl && id )
+    node = TY_(IndexFindId)( impl, id );
+  return tidyImplToNode( node );
+}
+
+TidyIterator TIDY_CALL tidyFindByTag( TidyDoc tdoc, TidyTagId tagId )
+{
+  TidyDocImpl* impl = tidyDocToImpl( tdoc );
+  NodeIterator* iter = NULL;
+  if ( impl && (uint)tagId < N_TIDY_TAGS )
+    iter = TY_(IndexFindTag)( impl, tagId );
+  return (TidyIterator) iter;
+}
+
+TidyIterator TIDY_CALL tidyFindByClass( TidyDoc tdoc, ctmbstr className )
+{
+  TidyDocImpl* impl = tidyDocToImpl( tdoc );
+  NodeIterator* iter = NULL;
+  if ( impl && className )
+    iter = TY_(IndexFindClass)( impl, className );
+  return (TidyIterator) iter;
+}
+
+TidyNode TIDY_CALL tidyGetNextFound( TidyDoc tdoc, TidyIterator* pos )
+{
+  TidyDocImpl* impl = tidyDocToImpl( tdoc );
+  Node* node = NULL;
+  if ( impl && pos )
+    node = TY_(IndexNextFound)( impl, (NodeIterator**) pos );
+  return tidyImplToNode( node );
+}
+
 TidyAttrId TIDY_CALL tidyAttrGetId( TidyAttr tattr )
 {
   AttVal* attval = tidyAttrToImpl( tattr );
@@ -2332,6 +2850,18 @@ TidyAttrId TIDY_CALL tidyAttrGetId( TidyAttr tattr )
   return attrId;
 }
 
+Bool TIDY_CALL tidyAttrGetSourceRange( TidyAttr tattr, uint* start, uint* end )
+{
+  AttVal* attval = tidyAttrToImpl( tattr );
+  if ( !attval || attval->srcEnd == 0 )
+    return no;
+  if ( start )
+    *start = attval->srcStart;
+  if ( end )
+    *end = attval->srcEnd;
+  return yes;
+}
+
 
 /*******************************************************************
  ** Message Key Management
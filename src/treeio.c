@@ -0,0 +1,805 @@
+/* treeio.c -- save the document tree and load it back
+
+  Copyright 2026 HTACG
+  See tidy.h for the copyright notice.
+
+  The format is a run of 32 bit little endian words, in which nodes,
+  attributes and strings refer to one another by index or offset, so
+  that it may be stored anywhere and loaded at any address:
+
+    header      HDR_WORDS words, see TreeHeader
+    options     id and value of each integer or boolean option that
+                differs from the snapshot taken when parsing began
+    nodes       NODE_WORDS words each, in document order, every node
+                after its parent; the asp and php nodes of attributes
+                come just before their element, without a parent
+    attributes  ATTR_WORDS words each, element by element
+    strings     names and values, each one once, NUL terminated
+    text        the parts of the lexer buffer the nodes span
+
+  The loader checks every count, offset and index before it makes the
+  first node, and then builds the tree in one pass over the records.
+  The lexer buffer may hold bytes that are not UTF-8 after it recovers
+  from bad input; they are saved as U+FFFD, which is what the printer
+  reads them as, and text that is not UTF-8 does not load.
+
+*/
+
+#include <errno.h>
+
+#include "tidy-int.h"
+#include "treeio.h"
+#include "tidybuffio.h"
+#include "config.h"
+#include "parser.h"
+#include "tags.h"
+#include "attrs.h"
+#include "tmbstr.h"
+#include "utf8.h"
+
+#define TREE_MAGIC      0x65657254u     /* "Tree" */
+#define TREE_FORMAT     1u
+#define TREE_NONE       0xFFFFFFFFu     /* no node, string or tag */
+#define TREE_BY_NAME    0xFFFFFFFEu     /* declared tag, found by name */
+#define TREE_HASH_SIZE  256u            /* first size of the string hash */
+
+typedef enum
+{
+    HDR_MAGIC,
+    HDR_FORMAT,
+    HDR_TAGS,               /* N_TIDY_TAGS and N_TIDY_OPTIONS, as */
+    HDR_OPTIONS,            /* tag and option ids depend on them */
+    HDR_CHANGED,            /* option id and value pairs */
+    HDR_NODES,
+    HDR_ATTRS,
+    HDR_STRINGS,            /* bytes */
+    HDR_TEXT,               /* bytes */
+    HDR_FLAGS,              /* TREE_* below */
+    HDR_ERRORS,
+    HDR_WARNINGS,
+    HDR_ACCESS_ERRORS,
+    HDR_INFO_MESSAGES,
+    HDR_DOC_ERRORS,
+    HDR_PARSE_STATUS,
+    HDR_LIMIT_EXCEEDED,
+    HDR_BAD_ACCESS,
+    HDR_BAD_LAYOUT,
+    HDR_BAD_CHARS,
+    HDR_BAD_FORM,
+    HDR_VERSIONS,
+    HDR_DOCTYPE,
+    HDR_VERSION_EMITTED,
+    HDR_GIVEN_DOCTYPE,      /* string */
+    HDR_WORDS
+} TreeHeader;
+
+typedef enum
+{
+    TREE_LEGACY_TAGS = 1,   /* tag table in HTML4 mode, see AdjustTags() */
+    TREE_HAD_BOM     = 2,
+    TREE_VOYAGER     = 4,
+    TREE_BAD_DOCTYPE = 8,
+    TREE_CANCELLED   = 16
+} TreeFlags;
+
+typedef enum
+{
+    NODE_PARENT,            /* node index */
+    NODE_TYPE,
+    NODE_FLAGS,             /* NODE_* below */
+    NODE_ELEMENT,           /* string */
+    NODE_TAG,               /* tag id, TREE_BY_NAME or TREE_NONE */
+    NODE_WAS,               /* tag id or TREE_NONE */
+    NODE_START,             /* span of the text */
+    NODE_END,
+    NODE_LINE,
+    NODE_COLUMN,
+    NODE_SRC_START,
+    NODE_SRC_END,
+    NODE_ATTRS,             /* count */
+    NODE_WORDS
+} TreeNode;
+
+typedef enum
+{
+    NODE_CLOSED    = 1,
+    NODE_IMPLICIT  = 2,
+    NODE_LINEBREAK = 4
+} TreeNodeFlags;
+
+typedef enum
+{
+    ATTR_NAME,              /* string */
+    ATTR_VALUE,             /* string */
+    ATTR_DELIM,
+    ATTR_ASP,               /* node index */
+    ATTR_PHP,               /* node index */
+    ATTR_SRC_START,
+    ATTR_SRC_END,
+    ATTR_WORDS
+} TreeAttr;
+
+typedef struct _TreeWriter
+{
+    TidyDocImpl* doc;
+    TidyBuffer   nodes;
+    TidyBuffer   attrs;
+    TidyBuffer   strings;
+    TidyBuffer   text;
+    uint         nodeCount;
+    uint         attrCount;
+    uint*        slots;         /* string offset + 1, or 0 when empty */
+    uint         slotCount;
+    uint         slotSize;      /* always a power of 2 */
+    Bool         failed;
+} TreeWriter;
+
+/* bytes in the UTF-8 sequence at s, no more than len, and whether it
+   is valid; bytes that are not are taken as GetUTF8() takes them */
+static uint utf8Sequence( const byte* s, uint len, Bool* valid )
+{
+    uint c, need;
+    int count = 1;
+
+    *valid = yes;
+    if ( s[0] < 0x80 )
+        return 1;
+
+    if ( s[0] < 0xC0 || s[0] >= 0xFE )
+        need = 1;
+    else if ( s[0] < 0xE0 )
+        need = 2;
+    else if ( s[0] < 0xF0 )
+        need = 3;
+    else if ( s[0] < 0xF8 )
+        need = 4;
+    else if ( s[0] < 0xFC )
+        need = 5;
+    else
+        need = 6;
+
+    /* DecodeUTF8BytesToChar() reads up to need - 1 successors */
+    if ( need > len ||
+         TY_(DecodeUTF8BytesToChar)(&c, s[0], (ctmbstr) s + 1, NULL, &count) != 0 )
+        *valid = no;
+    return ( need > len ) ? 1 : (uint) count;
+}
+
+/* append text, with each sequence that is not UTF-8 as U+FFFD */
+static void putText( TidyBuffer* buf, const byte* s, uint len )
+{
+    static const byte replacement[] = { 0xEF, 0xBF, 0xBD };
+    uint i = 0, run = 0;
+
+    while ( i + run < len )
+    {
+        Bool valid;
+        uint n = utf8Sequence( s + i + run, len - i - run, &valid );
+
+        if ( valid )
+        {
+            run += n;
+            continue;
+        }
+        tidyBufAppend( buf, (void*) (s + i), run );
+        tidyBufAppend( buf, (void*) replacement, sizeof(replacement) );
+        i += run + n;
+        run = 0;
+    }
+    tidyBufAppend( buf, (void*) (s + i), run );
+}
+
+static Bool validText( const byte* s, uint len )
+{
+    uint i = 0;
+
+    while ( i < len )
+    {
+        Bool valid;
+        i += utf8Sequence( s + i, len - i, &valid );
+        if ( !valid )
+            return no;
+    }
+    return yes;
+}
+
+static void putWord( TidyBuffer* buf, uint v )
+{
+    byte w[4];
+    w[0] = (byte)( v & 0xFF );
+    w[1] = (byte)( (v >> 8) & 0xFF );
+    w[2] = (byte)( (v >> 16) & 0xFF );
+    w[3] = (byte)( (v >> 24) & 0xFF );
+    tidyBufAppend( buf, w, 4 );
+}
+
+static uint getWord( const byte* rec, uint ix )
+{
+    const byte* p = rec + 4 * ix;
+    return (uint) p[0] | ((uint) p[1] << 8) |
+           ((uint) p[2] << 16) | ((uint) p[3] << 24);
+}
+
+static uint hashString( ctmbstr s )
+{
+    uint h = 0;
+    for ( ; *s; ++s )
+        h = 31 * h + (byte) *s;
+    return h;
+}
+
+static void growStrings( TreeWriter* w )
+{
+    uint i, j, size = w->slotSize ? 2 * w->slotSize : TREE_HASH_SIZE;
+    uint* slots = (uint*) TidyDocAlloc( w->doc, size * sizeof(uint) );
+
+    TidyClearMemory( slots, size * sizeof(uint) );
+    for ( i = 0; i < w->slotSize; ++i )
+    {
+        if ( w->slots[i] )
+        {
+            ctmbstr s = (ctmbstr) w->strings.bp + w->slots[i] - 1;
+            for ( j = hashString(s) & (size - 1); slots[j];
+                  j = (j + 1) & (size - 1) )
+                /**/;
+            slots[j] = w->slots[i];
+        }
+    }
+    TidyDocFree( w->doc, w->slots );
+    w->slots = slots;
+    w->slotSize = size;
+}
+
+/* Offset of the string in the table, adding it when it is new */
+static uint putString( TreeWriter* w, ctmbstr s )
+{
+    uint i, offset;
+
+    if ( !s )
+        return TREE_NONE;
+    if ( 2 * (w->slotCount + 1) > w->slotSize )
+        growStrings( w );
+
+    for ( i = hashString(s) & (w->slotSize - 1); w->slots[i];
+          i = (i + 1) & (w->slotSize - 1) )
+    {
+        offset = w->slots[i] - 1;
+        if ( TY_(tmbstrcmp)((ctmbstr) w->strings.bp + offset, s) == 0 )
+            return offset;
+    }
+
+    offset = w->strings.size;
+    tidyBufAppend( &w->strings, (void*) s, TY_(tmbstrlen)(s) + 1 );
+    w->slots[i] = offset + 1;
+    w->slotCount++;
+    return offset;
+}
+
+static uint tagRef( const Dict* tag )
+{
+    if ( !tag )
+        return TREE_NONE;
+    if ( tag->id == TidyTag_UNKNOWN )
+        return TREE_BY_NAME;
+    return tag->id;
+}
+
+static uint putNode( TreeWriter* w, Node* node, uint parent );
+
+/* The asp and php nodes of attributes are written as they are made,
+** with no attributes or content of their own, so that no attribute
+** can refer to the node that holds it.
+*/
+static void putLoose( TreeWriter* w, Node* node )
+{
+    if ( node->attributes || node->content )
+        w->failed = yes;
+    else
+        putNode( w, node, TREE_NONE );
+}
+
+static uint putNode( TreeWriter* w, Node* node, uint parent )
+{
+    Lexer* lexer = w->doc->lexer;
+    uint index, loose, start, end, flags = 0, nattrs = 0;
+    AttVal* av;
+    Node* child;
+
+    loose = w->nodeCount;
+    for ( av = node->attributes; av; av = av->next, ++nattrs )
+    {
+        if ( av->asp )
+            putLoose( w, av->asp );
+        if ( av->php )
+            putLoose( w, av->php );
+    }
+
+    start = end = w->text.size;
+    if ( node->start < node->end && node->end <= lexer->lexsize )
+    {
+        putText( &w->text, (const byte*) lexer->lexbuf + node->start,
+                 node->end - node->start );
+        end = w->text.size;
+    }
+    if ( node->closed )
+        flags |= NODE_CLOSED;
+    if ( node->implicit )
+        flags |= NODE_IMPLICIT;
+    if ( node->linebreak )
+        flags |= NODE_LINEBREAK;
+
+    index = w->nodeCount++;
+    putWord( &w->nodes, parent );
+    putWord( &w->nodes, node->type );
+    putWord( &w->nodes, flags );
+    putWord( &w->nodes, putString(w, node->element) );
+    putWord( &w->nodes, tagRef(node->tag) );
+    putWord( &w->nodes, tagRef(node->was) == TREE_BY_NAME ?
+                        TREE_NONE : tagRef(node->was) );
+    putWord( &w->nodes, start );
+    putWord( &w->nodes, end );
+    putWord( &w->nodes, node->line );
+    putWord( &w->nodes, node->column );
+    putWord( &w->nodes, node->srcStart );
+    putWord( &w->nodes, node->srcEnd );
+    putWord( &w->nodes, nattrs );
+
+    for ( av = node->attributes; av; av = av->next )
+    {
+        uint asp = TREE_NONE, php = TREE_NONE;
+        if ( av->asp )
+            asp = loose++;
+        if ( av->php )
+            php = loose++;
+        putWord( &w->attrs, putString(w, av->attribute) );
+        putWord( &w->attrs, putString(w, av->value) );
+        putWord( &w->attrs, (uint) av->delim );
+        putWord( &w->attrs, asp );
+        putWord( &w->attrs, php );
+        putWord( &w->attrs, av->srcStart );
+        putWord( &w->attrs, av->srcEnd );
+        w->attrCount++;
+    }
+
+    for ( child = node->content; child; child = child->next )
+        putNode( w, child, index );
+    return index;
+}
+
+/* Only AdjustTags() leaves the document's tags in HTML4 mode, where
+** <a> is parsed as inline.
+*/
+static Bool legacyTags( TidyDocImpl* doc )
+{
+    return TY_(LookupTagDef)( doc, TidyTag_A )->parser == TY_(ParseInline);
+}
+
+int TY_(SaveTree)( TidyDocImpl* doc, TidyBuffer* buf )
+{
+    Lexer* lexer = doc->lexer;
+    TidyBuffer options;
+    TreeWriter w;
+    uint i, doctype, changed = 0, flags = 0;
+
+    if ( !lexer || doc->streamed || doc->root.type != RootNode )
+        return -EINVAL;
+
+    TidyClearMemory( &w, sizeof(w) );
+    w.doc = doc;
+    tidyBufInitWithAllocator( &options, doc->allocator );
+    tidyBufInitWithAllocator( &w.nodes, doc->allocator );
+    tidyBufInitWithAllocator( &w.attrs, doc->allocator );
+    tidyBufInitWithAllocator( &w.strings, doc->allocator );
+    tidyBufInitWithAllocator( &w.text, doc->allocator );
+
+    /* what the parse set, such as output-xhtml for XHTML input */
+    for ( i = 0; i < N_TIDY_OPTIONS; ++i )
+    {
+        const TidyOptionImpl* option = TY_(getOption)( (TidyOptionId) i );
+        ulong v = doc->config.value[i].v;
+        if ( option && option->type != TidyString &&
+             v != TY_(SnapshotValue)(doc, (TidyOptionId) i) )
+        {
+            putWord( &options, i );
+            putWord( &options, (uint) v );
+            ++changed;
+        }
+    }
+
+    putNode( &w, &doc->root, TREE_NONE );
+    doctype = putString( &w, doc->givenDoctype );
+
+    if ( legacyTags( doc ) )
+        flags |= TREE_LEGACY_TAGS;
+    if ( doc->inputHadBOM )
+        flags |= TREE_HAD_BOM;
+    if ( lexer->isvoyager )
+        flags |= TREE_VOYAGER;
+    if ( lexer->bad_doctype )
+        flags |= TREE_BAD_DOCTYPE;
+    if ( doc->cancelled )
+        flags |= TREE_CANCELLED;
+
+    if ( !w.failed )
+    {
+        putWord( buf, TREE_MAGIC );
+        putWord( buf, TREE_FORMAT );
+        putWord( buf, N_TIDY_TAGS );
+        putWord( buf, N_TIDY_OPTIONS );
+        putWord( buf, changed );
+        putWord( buf, w.nodeCount );
+        putWord( buf, w.attrCount );
+        putWord( buf, w.strings.size );
+        putWord( buf, w.text.size );
+        putWord( buf, flags );
+        putWord( buf, doc->errors );
+        putWord( buf, doc->warnings );
+        putWord( buf, doc->accessErrors );
+        putWord( buf, doc->infoMessages );
+        putWord( buf, doc->docErrors );
+        putWord( buf, (uint) doc->parseStatus );
+        putWord( buf, doc->limitExceeded );
+        putWord( buf, doc->badAccess );
+        putWord( buf, doc->badLayout );
+        putWord( buf, doc->badChars );
+        putWord( buf, doc->badForm );
+        putWord( buf, lexer->versions );
+        putWord( buf, lexer->doctype );
+        putWord( buf, lexer->versionEmitted );
+        putWord( buf, doctype );
+
+        tidyBufAppend( buf, options.bp, options.size );
+        tidyBufAppend( buf, w.nodes.bp, w.nodes.size );
+        tidyBufAppend( buf, w.attrs.bp, w.attrs.size );
+        tidyBufAppend( buf, w.strings.bp, w.strings.size );
+        tidyBufAppend( buf, w.text.bp, w.text.size );
+    }
+
+    TidyDocFree( doc, w.slots );
+    tidyBufFree( &options );
+    tidyBufFree( &w.nodes );
+    tidyBufFree( &w.attrs );
+    tidyBufFree( &w.strings );
+    tidyBufFree( &w.text );
+    return w.failed ? -EINVAL : 0;
+}
+
+
+/* Loading */
+
+typedef struct _TreeReader
+{
+    const byte* header;
+    const byte* options;
+    const byte* nodes;
+    const byte* attrs;
+    ctmbstr     strings;
+    const byte* text;
+    uint        changed;
+    uint        nodeCount;
+    uint        attrCount;
+    uint        stringSize;
+    uint        textSize;
+} TreeReader;
+
+#define NODE_LOOSE  1   /* an asp or php node, without a parent */
+#define NODE_USED   2   /* and an attribute holds it */
+
+/* Finds the sections, or returns no if they do not fill the buffer */
+static Bool readSections( TreeReader* r, TidyBuffer* buf )
+{
+    const byte* p = buf->bp;
+    uint rest;
+
+    if ( !p || buf->size < HDR_WORDS * 4 )
+        return no;
+    r->header = p;
+    if ( getWord(p, HDR_MAGIC) != TREE_MAGIC ||
+         getWord(p, HDR_FORMAT) != TREE_FORMAT ||
+         getWord(p, HDR_TAGS) != N_TIDY_TAGS ||
+         getWord(p, HDR_OPTIONS) != N_TIDY_OPTIONS )
+        return no;
+
+    rest = buf->size - HDR_WORDS * 4;
+    p += HDR_WORDS * 4;
+
+    r->changed = getWord( r->header, HDR_CHANGED );
+    if ( r->changed > rest / 8 )
+        return no;
+    r->options = p;
+    p += r->changed * 8;
+    rest -= r->changed * 8;
+
+    r->nodeCount = getWord( r->header, HDR_NODES );
+    if ( r->nodeCount == 0 || r->nodeCount > rest / (NODE_WORDS * 4) )
+        return no;
+    r->nodes = p;
+    p += r->nodeCount * NODE_WORDS * 4;
+    rest -= r->nodeCount * NODE_WORDS * 4;
+
+    r->attrCount = getWord( r->header, HDR_ATTRS );
+    if ( r->attrCount > rest / (ATTR_WORDS * 4) )
+        return no;
+    r->attrs = p;
+    p += r->attrCount * ATTR_WORDS * 4;
+    rest -= r->attrCount * ATTR_WORDS * 4;
+
+    r->stringSize = getWord( r->header, HDR_STRINGS );
+    if ( r->stringSize > rest )
+        return no;
+    r->strings = (ctmbstr) p;
+    p += r->stringSize;
+    rest -= r->stringSize;
+    if ( r->stringSize > 0 && r->strings[r->stringSize - 1] != '\0' )
+        return no;
+
+    r->textSize = getWord( r->header, HDR_TEXT );
+    r->text = p;
+    return r->textSize == rest;
+}
+
+static Bool validString( TreeReader* r, uint ref )
+{
+    return ref == TREE_NONE || ref < r->stringSize;
+}
+
+static Bool validTag( uint ref )
+{
+    return ref == TREE_NONE ||
+           ( ref > TidyTag_UNKNOWN && ref < N_TIDY_TAGS );
+}
+
+static Bool checkOptions( TreeReader* r )
+{
+    uint i;
+    for ( i = 0; i < r->changed; ++i )
+    {
+        uint id = getWord( r->options, 2 * i );
+        const TidyOptionImpl* option;
+
+        if ( id == TidyUnknownOption || id >= N_TIDY_OPTIONS )
+            return no;
+        option = TY_(getOption)( (TidyOptionId) id );
+        if ( !option || option->type == TidyString )
+            return no;
+    }
+    return yes;
+}
+
+/* Every reference must be in range, every node after its parent, and
+** every asp or php node held by one attribute of a later element.
+*/
+static Bool checkNodes( TreeReader* r, byte* marks )
+{
+    uint i, j, attr = 0;
+
+    for ( i = 0; i < r->nodeCount; ++i )
+    {
+        const byte* rec = r->nodes + i * NODE_WORDS * 4;
+        uint parent = getWord( rec, NODE_PARENT );
+        uint type = getWord( rec, NODE_TYPE );
+        uint tag = getWord( rec, NODE_TAG );
+        uint start = getWord( rec, NODE_START );
+        uint end = getWord( rec, NODE_END );
+        uint nattrs = getWord( rec, NODE_ATTRS );
+
+        if ( i == 0 )
+        {
+            if ( parent != TREE_NONE || type != RootNode )
+                return no;
+        }
+        else if ( type == RootNode || type > XmlDecl )
+            return no;
+        else if ( parent == TREE_NONE )
+            marks[i] = NODE_LOOSE;
+        else if ( parent >= i || marks[parent] )
+            return no;
+
+        if ( !validString(r, getWord(rec, NODE_ELEMENT)) ||
+             !validTag(getWord(rec, NODE_WAS)) ||
+             !( validTag(tag) || ( tag == TREE_BY_NAME &&
+                                   getWord(rec, NODE_ELEMENT) != TREE_NONE ) ) ||
+             start > end || end > r->textSize )
+            return no;
+
+        if ( nattrs > r->attrCount - attr || ( marks[i] && nattrs ) )
+            return no;
+        for ( j = attr; j < attr + nattrs; ++j )
+        {
+            const byte* av = r->attrs + j * ATTR_WORDS * 4;
+            uint asp = getWord( av, ATTR_ASP );
+            uint php = getWord( av, ATTR_PHP );
+
+            if ( !validString(r, getWord(av, ATTR_NAME)) ||
+                 !validString(r, getWord(av, ATTR_VALUE)) ||
+                 getWord(av, ATTR_DELIM) > 0xFF )
+                return no;
+            if ( asp != TREE_NONE )
+            {
+                if ( asp >= i || marks[asp] != NODE_LOOSE )
+                    return no;
+                marks[asp] |= NODE_USED;
+            }
+            if ( php != TREE_NONE )
+            {
+                if ( php >= i || marks[php] != NODE_LOOSE )
+                    return no;
+                marks[php] |= NODE_USED;
+            }
+        }
+        attr += nattrs;
+    }
+
+    if ( attr != r->attrCount )
+        return no;
+    for ( i = 0; i < r->nodeCount; ++i )
+    {
+        if ( marks[i] == NODE_LOOSE )
+            return no;
+    }
+    return yes;
+}
+
+static tmbstr loadString( TidyDocImpl* doc, TreeReader* r, uint ref )
+{
+    if ( ref == TREE_NONE )
+        return NULL;
+    return TY_(tmbstrdup)( doc->allocator, r->strings + ref );
+}
+
+static void loadText( Lexer* lexer, TreeReader* r )
+{
+    if ( r->textSize + 2 >= lexer->lexlength )
+    {
+        uint size = r->textSize + 2;
+        lexer->lexbuf = (tmbstr) TidyRealloc( lexer->allocator,
+                                              lexer->lexbuf, size );
+        lexer->lexlength = size;
+    }
+    memcpy( lexer->lexbuf, r->text, r->textSize );
+    lexer->lexsize = r->textSize;
+    lexer->lexbuf[ lexer->lexsize ] = '\0';
+}
+
+static void loadNodes( TidyDocImpl* doc, TreeReader* r, Node** made )
+{
+    uint i, j, attr = 0;
+
+    for ( i = 0; i < r->nodeCount; ++i )
+    {
+        const byte* rec = r->nodes + i * NODE_WORDS * 4;
+        uint parent = getWord( rec, NODE_PARENT );
+        uint flags = getWord( rec, NODE_FLAGS );
+        uint tag = getWord( rec, NODE_TAG );
+        uint was = getWord( rec, NODE_WAS );
+        Node* node = i ? TY_(NewNode)( doc->allocator, doc->lexer )
+                       : &doc->root;
+
+        node->type = (NodeType) getWord( rec, NODE_TYPE );
+        node->closed = (flags & NODE_CLOSED) ? yes : no;
+        node->implicit = (flags & NODE_IMPLICIT) ? yes : no;
+        node->linebreak = (flags & NODE_LINEBREAK) ? yes : no;
+        node->element = loadString( doc, r, getWord(rec, NODE_ELEMENT) );
+        node->start = getWord( rec, NODE_START );
+        node->end = getWord( rec, NODE_END );
+        node->line = getWord( rec, NODE_LINE );
+        node->column = getWord( rec, NODE_COLUMN );
+        node->srcStart = getWord( rec, NODE_SRC_START );
+        node->srcEnd = getWord( rec, NODE_SRC_END );
+
+        if ( tag == TREE_BY_NAME )
+            TY_(FindTag)( doc, node );
+        else if ( tag != TREE_NONE )
+            node->tag = TY_(LookupTagDef)( doc, (TidyTagId) tag );
+        if ( was != TREE_NONE )
+            node->was = TY_(LookupTagDef)( doc, (TidyTagId) was );
+
+        made[i] = node;
+        if ( parent != TREE_NONE )
+            TY_(InsertNodeAtEnd)( made[parent], node );
+    }
+
+    for ( i = 0; i < r->nodeCount; ++i )
+    {
+        uint nattrs = getWord( r->nodes + i * NODE_WORDS * 4, NODE_ATTRS );
+        AttVal* last = NULL;
+
+        for ( j = attr; j < attr + nattrs; ++j )
+        {
+            const byte* rec = r->attrs + j * ATTR_WORDS * 4;
+            uint asp = getWord( rec, ATTR_ASP );
+            uint php = getWord( rec, ATTR_PHP );
+            AttVal* av = TY_(NewAttribute)( doc );
+
+            av->attribute = loadString( doc, r, getWord(rec, ATTR_NAME) );
+            av->value = loadString( doc, r, getWord(rec, ATTR_VALUE) );
+            av->delim = (int) getWord( rec, ATTR_DELIM );
+            av->asp = asp != TREE_NONE ? made[asp] : NULL;
+            av->php = php != TREE_NONE ? made[php] : NULL;
+            av->srcStart = getWord( rec, ATTR_SRC_START );
+            av->srcEnd = getWord( rec, ATTR_SRC_END );
+            av->dict = av->attribute ? TY_(FindAttribute)( doc, av ) : NULL;
+
+            if ( last )
+                last->next = av;
+            else
+                made[i]->attributes = av;
+            last = av;
+        }
+        attr += nattrs;
+    }
+}
+
+int TY_(LoadTree)( TidyDocImpl* doc, TidyBuffer* buf )
+{
+    Lexer* lexer = doc->lexer;
+    TreeReader r;
+    Node** made;
+    byte* marks;
+    uint i, flags;
+    Bool valid;
+
+    TidyClearMemory( &r, sizeof(r) );
+    if ( !buf || !readSections(&r, buf) || !checkOptions(&r) ||
+         !validString(&r, getWord(r.header, HDR_GIVEN_DOCTYPE)) ||
+         !validText(r.text, r.textSize) )
+        return -EINVAL;
+
+    marks = (byte*) TidyDocAlloc( doc, r.nodeCount );
+    TidyClearMemory( marks, r.nodeCount );
+    valid = checkNodes( &r, marks );
+    TidyDocFree( doc, marks );
+    if ( !valid )
+        return -EINVAL;
+
+    /* the options and tag table decide which tags the names find */
+    for ( i = 0; i < r.changed; ++i )
+    {
+        TidyOptionId id = (TidyOptionId) getWord( r.options, 2 * i );
+        ulong v = getWord( r.options, 2 * i + 1 );
+        if ( TY_(getOption)(id)->type == TidyBoolean )
+            TY_(SetOptionBool)( doc, id, v ? yes : no );
+        else
+            TY_(SetOptionInt)( doc, id, v );
+    }
+    flags = getWord( r.header, HDR_FLAGS );
+    if ( flags & TREE_LEGACY_TAGS )
+        TY_(AdjustTags)( doc );
+
+    made = (Node**) TidyDocAlloc( doc, r.nodeCount * sizeof(Node*) );
+    loadNodes( doc, &r, made );
+    TidyDocFree( doc, made );
+    loadText( lexer, &r );
+
+    doc->errors = getWord( r.header, HDR_ERRORS );
+    doc->warnings = getWord( r.header, HDR_WARNINGS );
+    doc->accessErrors = getWord( r.header, HDR_ACCESS_ERRORS );
+    doc->infoMessages = getWord( r.header, HDR_INFO_MESSAGES );
+    doc->docErrors = getWord( r.header, HDR_DOC_ERRORS );
+    doc->parseStatus = (int) getWord( r.header, HDR_PARSE_STATUS );
+    doc->limitExceeded = (TidyOptionId) getWord( r.header, HDR_LIMIT_EXCEEDED );
+    doc->badAccess = getWord( r.header, HDR_BAD_ACCESS );
+    doc->badLayout = getWord( r.header, HDR_BAD_LAYOUT );
+    doc->badChars = getWord( r.header, HDR_BAD_CHARS );
+    doc->badForm = getWord( r.header, HDR_BAD_FORM );
+    doc->inputHadBOM = (flags & TREE_HAD_BOM) ? yes : no;
+    doc->cancelled = (flags & TREE_CANCELLED) ? yes : no;
+    doc->givenDoctype = loadString( doc, &r,
+                                    getWord(r.header, HDR_GIVEN_DOCTYPE) );
+
+    lexer->versions = getWord( r.header, HDR_VERSIONS );
+    lexer->doctype = getWord( r.header, HDR_DOCTYPE );
+    lexer->versionEmitted = getWord( r.header, HDR_VERSION_EMITTED );
+    lexer->isvoyager = (flags & TREE_VOYAGER) ? yes : no;
+    lexer->bad_doctype = (flags & TREE_BAD_DOCTYPE) ? yes : no;
+    return 0;
+}
+
+/*
+ * local variables:
+ * mode: c
+ * indent-tabs-mode: nil
+ * c-basic-offset: 4
+ * eval: (c-set-offset 'substatement-open 0)
+ * end:
+ */
@@ -0,0 +1,20 @@
+#ifndef __TREEIO_H__
+#define __TREEIO_H__
+
+/* treeio.h -- save the document tree and load it back
+
+  Copyright 2026 HTACG
+  See tidy.h for the copyright notice.
+
+  The tree, the text it refers to and the state the printer needs are
+  written in a binary format, see treeio.c, that loads into a document
+  without parsing again.  Both return 0, or -EINVAL.
+
+*/
+
+#include "forward.h"
+
+int TY_(SaveTree)( TidyDocImpl* doc, TidyBuffer* buf );
+int TY_(LoadTree)( TidyDocImpl* doc, TidyBuffer* buf );
+
+#endif /* __TREEIO_H__ */
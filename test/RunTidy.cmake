@@ -0,0 +1,18 @@
+# RunTidy.cmake - run the console tidy on one input, for ctest
+#
+#   cmake -DTIDY=<exe> -DINPUT=<file> [-DOPTIONS="<opt> <value> ..."] -P RunTidy.cmake
+#
+# Passes when tidy finishes within the timeout with its usual exit status:
+# 0 (clean), 1 (warnings) or 2 (errors). A hang or a crash fails.
+
+separate_arguments( args UNIX_COMMAND "${OPTIONS}" )
+execute_process(
+    COMMAND ${TIDY} -q ${args} ${INPUT}
+    RESULT_VARIABLE result
+    OUTPUT_QUIET
+    ERROR_QUIET
+    TIMEOUT 30
+)
+if (NOT result MATCHES "^[012]$")
+    message( FATAL_ERROR "tidy ${OPTIONS} ${INPUT}: ${result}" )
+endif ()